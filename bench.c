@@ -0,0 +1,247 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <dnp3hammer.h>
+
+#define ITERATIONS 100000
+
+// sample inputs for each layer...
+
+// a READ request in a single link frame (cf. samples/read.hex)
+static const uint8_t frame[] =
+    "\x05\x64\x0F\xC4\x01\x00\x00\x00\xE2\xC8"
+    "\xC0\xC0\x01\x01\x00\x17\x03\x41\x43\x42\xF8\x4B";
+
+// the transport segment contained in the above
+static const uint8_t segment[] =
+    "\xC0\xC0\x01\x01\x00\x17\x03\x41\x43\x42";
+
+// the application fragment contained in the above
+static const uint8_t request[] =
+    "\xC0\x01\x01\x00\x17\x03\x41\x43\x42";
+
+// a response with four analog inputs (g30v1)
+static const uint8_t response[] =
+    "\xC0\x81\x00\x00\x1E\x01\x00\x00\x03"
+    "\x01\x78\x56\x34\x12" "\x01\x78\x56\x34\x12"
+    "\x01\x78\x56\x34\x12" "\x01\x78\x56\x34\x12";
+
+// a READ request with aggressive-mode authentication (g120v3 ... g120v9),
+// the MAC value (16 bytes) to be filled in
+static uint8_t auth_request[] =
+    "\xC0\x01\x78\x03\x07\x01\x05\x00\x00\x00\x01\x00"
+    "\x3C\x02\x06\x3C\x03\x06\x3C\x04\x06"
+    "\x78\x09\x5B\x01\x10\x00"
+    "0123456789abcdef";
+
+// a challenge (g120v1) by the outstation and its reply (g120v2) by the
+// master, the MAC value (16 bytes) to be filled in
+static const uint8_t auth_challenge[] =
+    "\xC0\x83\x00\x00\x78\x01\x5B\x01\x0C\x00\x05\x00\x00\x00\x01\x00"
+    "\x04\x01\xDE\xAD\xBE\xEF";
+static uint8_t auth_reply[] =
+    "\xC1\x20\x78\x02\x5B\x01\x16\x00\x05\x00\x00\x00\x01\x00"
+    "0123456789abcdef";
+
+static void bench(const char *name, const HParser *p,
+                  const uint8_t *input, size_t len)
+{
+    clock_t t0, t1;
+    double us;
+
+    t0 = clock();
+    for(int i=0; i<ITERATIONS; i++) {
+        HParseResult *r = h_parse(p, input, len);
+        if(!r) {
+            fprintf(stderr, "%s: parse failed\n", name);
+            exit(1);
+        }
+        h_parse_result_free(r);
+    }
+    t1 = clock();
+
+    us = (t1 - t0) * 1e6 / CLOCKS_PER_SEC / ITERATIONS;
+    printf("%-10s %8.3f us/parse  %8.1f MB/s\n", name, us, len / us);
+}
+
+// parse and pack a fragment with the given layout options
+static void bench_pack(const char *name, unsigned flags,
+                       const uint8_t *input, size_t len)
+{
+    clock_t t0, t1;
+    double us;
+    size_t size = 0, npoints = 0;
+
+    t0 = clock();
+    for(int i=0; i<ITERATIONS; i++) {
+        HParseResult *r = h_parse(dnp3_p_app_fragment, input, len);
+        if(!r || r->ast->token_type != (HTokenType)TT_DNP3_Fragment) {
+            fprintf(stderr, "%s: parse failed\n", name);
+            exit(1);
+        }
+        const DNP3_Fragment *frag = r->ast->user;
+        DNP3_Fragment *copy = dnp3_fragment_copy(frag, flags);
+        h_parse_result_free(r);
+
+        if(i == 0) {
+            size = dnp3_fragment_size(copy, 0);
+            for(size_t j=0; j<copy->nblocks; j++)
+                npoints += copy->odata[j]->count;
+        }
+        free(copy);
+    }
+    t1 = clock();
+
+    us = (t1 - t0) * 1e6 / CLOCKS_PER_SEC / ITERATIONS;
+    printf("%-10s %8.3f us/parse  %8.1f MB/s  %6zu bytes  %5.1f bytes/point\n",
+           name, us, len / us, size, (double)size / npoints);
+}
+
+// verify the MAC of an aggressive-mode fragment, one at a time or batched
+#define AUTH_BATCH 64
+static void bench_auth(void)
+{
+    static const uint8_t chal[] = "challenge data";
+    size_t len = sizeof(auth_request)-1;
+    DNP3_AuthKey key;
+    DNP3_AuthCheck checks[AUTH_BATCH];
+    bool ok[AUTH_BATCH];
+    uint8_t mac[32];
+    clock_t t0, t1;
+    size_t n = 0;
+
+    dnp3_auth_key(&key, (const uint8_t *)"0123456789abcdef", 16);
+    dnp3_auth_mac(&key, chal, sizeof(chal)-1, auth_request, len-16, mac);
+    memcpy(auth_request + len - 16, mac, 16);
+
+    HParseResult *r = h_parse(dnp3_p_app_request, auth_request, len);
+    if(!r || r->ast->token_type != (HTokenType)TT_DNP3_Fragment ||
+       !((DNP3_Fragment *)r->ast->user)->auth) {
+        fprintf(stderr, "auth: parse failed\n");
+        exit(1);
+    }
+    const DNP3_AuthData *auth = ((DNP3_Fragment *)r->ast->user)->auth;
+    for(int i=0; i<AUTH_BATCH; i++) {
+        checks[i] = (DNP3_AuthCheck)
+            {&key, chal, sizeof(chal)-1, auth_request, len, auth};
+    }
+
+    t0 = clock();
+    for(int i=0; i<ITERATIONS; i++)
+        n += dnp3_auth_verify(&key, chal, sizeof(chal)-1, auth_request, len, auth);
+    t1 = clock();
+    printf("%-10s %8.0f verifications/s\n", "auth",
+           ITERATIONS * (double)CLOCKS_PER_SEC / (t1 - t0));
+
+    t0 = clock();
+    for(int i=0; i<ITERATIONS/AUTH_BATCH; i++)
+        n += dnp3_auth_verify_batch(checks, AUTH_BATCH, ok);
+    t1 = clock();
+    printf("%-10s %8.0f verifications/s\n", "auth/batch",
+           ITERATIONS/AUTH_BATCH*AUTH_BATCH * (double)CLOCKS_PER_SEC / (t1 - t0));
+
+    h_parse_result_free(r);
+    if(n != ITERATIONS + ITERATIONS/AUTH_BATCH*AUTH_BATCH) {
+        fprintf(stderr, "auth: verification failed\n");
+        exit(1);
+    }
+}
+
+static const DNP3_Fragment *parse_fragment(const char *name,
+                                           const uint8_t *input, size_t len,
+                                           HParseResult **r)
+{
+    *r = h_parse(dnp3_p_app_fragment, input, len);
+    if(!*r || (*r)->ast->token_type != (HTokenType)TT_DNP3_Fragment) {
+        fprintf(stderr, "%s: parse failed\n", name);
+        exit(1);
+    }
+    return (*r)->ast->user;
+}
+
+// challenge and reply on each of many associations in turn
+#define AUTH_SESSIONS 4096
+static void bench_session(void)
+{
+    size_t clen = sizeof(auth_challenge)-1;
+    size_t rlen = sizeof(auth_reply)-1;
+    DNP3_AuthKey control, monitor;
+    DNP3_AuthStats stats;
+    HParseResult *rc, *rr;
+    uint8_t mac[32];
+    clock_t t0, t1;
+
+    dnp3_auth_key(&control, (const uint8_t *)"0123456789abcdef", 16);
+    dnp3_auth_key(&monitor, (const uint8_t *)"fedcba9876543210", 16);
+    dnp3_auth_mac(&control, auth_challenge, clen, NULL, 0, mac);
+    memcpy(auth_reply + rlen - 16, mac, 16);
+
+    const DNP3_Fragment *chal =
+        parse_fragment("session", auth_challenge, clen, &rc);
+    const DNP3_Fragment *reply =
+        parse_fragment("session", auth_reply, rlen, &rr);
+
+    DNP3_AuthEngine *eng = dnp3_auth_engine(AUTH_SESSIONS, NULL, NULL, NULL);
+    if(!eng) {
+        fprintf(stderr, "session: out of memory\n");
+        exit(1);
+    }
+    for(uint32_t a=0; a<AUTH_SESSIONS; a++)
+        dnp3_auth_set_keys(eng, a, 1, &control, &monitor);
+
+    t0 = clock();
+    for(int i=0; i<ITERATIONS; i++) {
+        uint32_t a = i % AUTH_SESSIONS;
+        dnp3_auth_update(eng, a, false, i, auth_challenge, clen, chal);
+        dnp3_auth_update(eng, a, true, i, auth_reply, rlen, reply);
+    }
+    t1 = clock();
+    printf("%-10s %8.3f us/challenge (%d associations)\n", "session",
+           (t1 - t0) * 1e6 / CLOCKS_PER_SEC / ITERATIONS, AUTH_SESSIONS);
+
+    dnp3_auth_stats(eng, &stats);
+    dnp3_auth_engine_free(eng);
+    h_parse_result_free(rc);
+    h_parse_result_free(rr);
+    if(stats.verified != ITERATIONS) {
+        fprintf(stderr, "session: verification failed\n");
+        exit(1);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    DNP3_InitStats st;
+    clock_t t0, t1;
+
+    // startup
+    t0 = clock();
+    dnp3_init();
+    t1 = clock();
+    dnp3_init_stats(&st);
+
+    printf("init: %.3f ms, %zu blocks, %zu bytes held, "
+           "%zu shared sub-parsers (%zu reuses), %zu compiled\n",
+           (t1 - t0) * 1000.0 / CLOCKS_PER_SEC, st.allocs, st.bytes,
+           st.interned, st.interned_hits, st.compiled);
+
+    // per-layer parsing throughput (NB: sizeof includes the terminating 0)
+    bench("link",      dnp3_p_link_frame,        frame,    sizeof(frame)-1);
+    bench("transport", dnp3_p_transport_segment, segment,  sizeof(segment)-1);
+    bench("request",   dnp3_p_app_request,       request,  sizeof(request)-1);
+    bench("response",  dnp3_p_app_response,      response, sizeof(response)-1);
+
+    // result layouts, including the copy out of the parse arena
+    bench_pack("objects",  0,                 response, sizeof(response)-1);
+    bench_pack("compact",  DNP3_PACK_COMPACT, response, sizeof(response)-1);
+
+    // aggressive-mode MAC verification
+    bench_auth();
+
+    // secure authentication sessions
+    bench_session();
+
+    return 0;
+}
@@ -171,11 +171,13 @@ int main(int argc, char *argv[])
     return main_();
 }
 
+#define INBUFSIZE 65536  // read up to this much per call
+
 int main_full(void)
 {
     StreamProcessor *p;
 
-    p = dnp3_dissector(callbacks, stdout);
+    p = dnp3_dissector_sized(INBUFSIZE, callbacks, stdout);
     if(p == NULL) {
         fprintf(stderr, "protocol init failed\n");
         return 1;
@@ -196,11 +198,6 @@ int main_full(void)
             fprintf(stderr, "processing error\n");
             return 1;
         }
-
-        if(p->bufsize == 0) {
-            fprintf(stderr, "input buffer exhausted\n");
-            return 1;
-        }
     }
 
     p->finish(p);
@@ -341,7 +341,13 @@ typedef enum {
 
     DNP3_VARIATION_APPL_ID = 1,
 
+    DNP3_VARIATION_AUTH_CHALLENGE = 1,
+    DNP3_VARIATION_AUTH_REPLY = 2,
     DNP3_VARIATION_AUTH_AGGR = 3,
+    DNP3_VARIATION_AUTH_KEYSTATREQ = 4,
+    DNP3_VARIATION_AUTH_KEYSTATUS = 5,
+    DNP3_VARIATION_AUTH_KEYCHANGE = 6,
+    DNP3_VARIATION_AUTH_ERROR = 7,
     DNP3_VARIATION_AUTH_MAC = 9,
 } DNP3_Variation;
 
@@ -444,6 +450,25 @@ typedef struct {
     };
 } DNP3_Analog;
 
+// g120v1, g120v2, g120v4-g120v7 (authentication messages).
+// data holds the challenge data (v1, v5), the MAC (v2), the wrapped key
+// data (v6), or the error text (v7). the MAC of v5 follows its challenge
+// data. kept out of line so as not to grow every DNP3_Object.
+typedef struct {
+    uint32_t seq;           // challenge (CSQ) or key change (KSQ) seq.
+    uint16_t usr;           // user number
+    uint16_t assoc;         // association id (v7)
+    uint8_t mal;            // MAC algorithm (v1, v5)
+    uint8_t code;           // reason (v1), key status (v5), error (v7)
+    uint8_t kwa;            // key wrap algorithm (v5)
+    uint16_t len;           // of data
+    uint16_t maclen;        // (v5)
+    DNP3_Time time;         // (v7)
+    uint8_t data[];
+} DNP3_AuthMessage;
+
+// a decoded object. 24 bytes, the size of a timestamped analog (timed);
+// anything larger is kept out of line.
 typedef union {
     // g1v1, g10v1 (binary in- and outputs, packed format)
     uint8_t bit:1;
@@ -482,6 +507,21 @@ typedef union {
         size_t len;
     } applid;
 
+    // g120v3 (aggressive mode request)
+    struct {
+        uint32_t csq;           // challenge sequence number
+        uint16_t usr;           // user number
+    } aggr;
+
+    // g120v9 (message authentication code)
+    struct {
+        uint8_t *data;
+        size_t len;
+    } mac;
+
+    // g120v1, g120v2, g120v4-g120v7 (authentication messages)
+    DNP3_AuthMessage *auth;
+
     // objects with timestamps (not group 50!)
     struct {
         union {
@@ -490,9 +530,13 @@ typedef union {
             DNP3_Counter ctr;
             DNP3_Analog ana;
         };
+        // relative time variations (g2v3, g4v3) are resolved against the
+        // "common time-of-occurance" (CTO, g51) preceding them in the same
+        // fragment: abstime = CTO + reltime. reltime is kept only if there
+        // is no CTO (see DNP3_ObjectBlock).
         union {
             DNP3_Time abstime;  // ms since 1970-01-01
-            uint16_t  reltime;  // ms since "common time-of-occurance" (CTO)
+            uint16_t  reltime;  // ms since CTO
         };
     } timed;
 
@@ -505,15 +549,32 @@ typedef struct {
     size_t      count;          // number of objects
     uint32_t    range_base;     // 0 if unused; only used with rangespecs 0-5
     uint32_t    *indexes;       // NULL if unused
-    DNP3_Object *objects;
+    DNP3_Object *objects;       // NULL if unused or stored otherwise
+    uint8_t     *records;       // compact records (see dnp3_oblock_get)
+    uint8_t     *raw;           // objects as on the wire (ditto)
+    uint16_t    stride;         // size of raw objects in bits
+
+    // relative time variations: the CTO in effect (see DNP3_Object.timed)
+    DNP3_Time   cto;
+    uint8_t     nocto:1;        // no CTO, objects hold reltime
+    uint8_t     unsync:1;       // the CTO was unsynchronized (g51v2)
 
     // low-level packet info
     uint8_t     prefixcode:4;
     uint8_t     rangespec:4;
 } DNP3_ObjectBlock;
 
+#define DNP3_AUTH_MAXMAC 32     // longest MAC supported (untruncated SHA-256)
+
+// aggressive-mode authentication: a request or response that starts with
+// g120v3 and ends with g120v9. the MAC covers the fragment up to the MAC
+// value itself (see dnp3_auth_verify).
 typedef struct {
-} DNP3_AuthData; // XXX
+    uint32_t    csq;            // challenge sequence number
+    uint16_t    usr;            // user number
+    uint8_t     maclen;
+    uint8_t     mac[DNP3_AUTH_MAXMAC];
+} DNP3_AuthData;
 
 // requests are messages from master to outstation.
 // responses (solicited or unsolicited) are messages from outstation to master.
@@ -529,6 +590,25 @@ typedef struct {
     DNP3_ObjectBlock    **odata;
 } DNP3_Fragment;
 
+// sets of group/variation pairs, e.g. the point types a consumer is interested
+// in. a zero-initialized DNP3_Interest is the empty set.
+typedef struct {
+    uint8_t bits[256 * 256 / 8];
+} DNP3_Interest;
+
+static inline
+void dnp3_interest_add(DNP3_Interest *m, DNP3_Group g, DNP3_Variation v)
+    { m->bits[g << 5 | v >> 3] |= 1 << (v & 7); }
+
+// add all variations of a group
+static inline
+void dnp3_interest_add_group(DNP3_Interest *m, DNP3_Group g)
+    { for(int i=0; i<256/8; i++) m->bits[g << 5 | i] = 0xFF; }
+
+static inline
+bool dnp3_interest_has(const DNP3_Interest *m, DNP3_Group g, DNP3_Variation v)
+    { return (m->bits[g << 5 | v >> 3] >> (v & 7)) & 1; }
+
 
 /// PARSERS ///
 
@@ -550,6 +630,27 @@ extern HParser *dnp3_p_app_request;
 extern HParser *dnp3_p_app_response;
 extern HParser *dnp3_p_app_fragment;    // request or response
 
+// like the above but only parse object headers, skipping over the objects.
+// yields DNP3_Fragments whose blocks have objects and indexes set to NULL.
+// NB: unlike the full parsers, these do not check which object types and
+//     qualifiers are allowed with a given function code.
+extern HParser *dnp3_p_app_request_ohdrs;
+extern HParser *dnp3_p_app_response_ohdrs;
+extern HParser *dnp3_p_app_fragment_ohdrs;
+
+// like dnp3_p_app_fragment but decode only the objects of interest. blocks
+// of other types in (solicited or unsolicited) responses are skipped as in
+// dnp3_p_app_fragment_ohdrs; mask NULL selects all. CTOs (g51) are always
+// decoded so relative times can be resolved. blocks not allowed in
+// responses, or with a qualifier not allowed for their type, are errors as
+// with dnp3_p_app_fragment. with flags containing
+// DNP3_PACK_RAW, the objects in responses are kept raw where possible (see
+// dnp3_oblock_get). one parser is built per distinct set and reused; past
+// 8 distinct sets, dnp3_p_app_fragment is returned. may be called from
+// several threads.
+HParser *dnp3_p_app_fragment_select(const DNP3_Interest *mask,
+                                    unsigned flags);
+
 extern HParser *dnp3_p_transport_segment;
 
 extern HParser *dnp3_p_link_frame;
@@ -564,14 +665,62 @@ struct StreamProcessor_ {
     size_t bufsize;
 
     // return 0 on success, < 0 on error
-    int (*feed)(StreamProcessor *self, size_t n); // eats either 0 or n bytes
+    int (*feed)(StreamProcessor *self, size_t n); // takes n bytes from buf
     int (*finish)(StreamProcessor *self);         // invalidates (frees) self
+
+    // set by feed(): the number of bytes processed in this call. input that
+    // may still complete a frame is held back, so this can be less than n.
+    // it includes bytes held back by previous calls once they are processed,
+    // so it can also be greater than n.
+    size_t consumed;
 };
 
+// events collected over one call to feed(), see DNP3_Callbacks.batch
+typedef struct {
+    DNP3_Frame frame;
+    const uint8_t *buf;         // raw input
+    size_t len;
+    bool invalid;               // as passed to link_invalid()
+} DNP3_BatchFrame;
+
+typedef struct {
+    DNP3_Segment segment;
+    size_t frame;               // index of the frame that carried it
+} DNP3_BatchSegment;
+
+typedef struct {
+    const uint8_t *buf;         // as passed to transport_payload()
+    size_t len;                 // or to transport_discard() if buf is NULL
+    size_t segment;             // index of the segment that completed it
+} DNP3_BatchPayload;
+
+typedef struct {
+    const DNP3_Fragment *fragment;  // NULL if invalid
+    DNP3_ParseError err;        // if invalid, as passed to app_invalid()
+    bool unchanged;             // repeated payload (cf. app_unchanged)
+    const uint8_t *buf;         // raw frames
+    size_t len;
+    size_t segment;             // index of the segment that completed it
+    size_t payload;             // index of the payload it was parsed from
+} DNP3_BatchFragment;
+
+typedef struct {
+    const DNP3_BatchFrame *frames;
+    size_t nframes;
+    const DNP3_BatchSegment *segments;
+    size_t nsegments;
+    const DNP3_BatchFragment *fragments;
+    size_t nfragments;
+    const DNP3_BatchPayload *payloads;
+    size_t npayloads;
+} DNP3_Batch;
+
 typedef struct {
     void (*link_invalid)(void *env, const DNP3_Frame *frame);
     int  (*link_frame)(void *env, const DNP3_Frame *frame,
                        const uint8_t *buf, size_t len); // raw input
+        // a nonzero return value drops the frame. in batch mode this
+        // callback is not used, so frames cannot be dropped (see batch).
     void (*transport_segment)(void *env, const DNP3_Segment *segment);
     void (*transport_discard)(void *env, size_t n);     // n = number of bytes
     void (*transport_payload)(void *env, const uint8_t *s, size_t n);
@@ -581,25 +730,494 @@ typedef struct {
         // XXX Passing raw frames to app_fragment() is a temporary measure.
         //     Those arguments should be removed when we can generate DNP3
         //     output ourselves.
+        // the fragment is allocated from mm_results (see dnp3_dissector__m)
+        // and valid until the callback returns; use dnp3_fragment_retain()
+        // to keep it longer and dnp3_fragment_release() when done.
+    void (*app_unchanged)(void *env, const DNP3_Fragment *fragment,
+                          const uint8_t *buf, size_t len);      // raw frames
+        // called instead of app_fragment() when the fragment cache (see
+        // dnp3_dissector_set_cache) recognizes a repeated payload. if not
+        // set, app_fragment() is called with the cached result. the same
+        // rules as for app_fragment() apply to the fragment.
+
+    void (*batch)(void *env, const DNP3_Batch *batch);
+        // if set, called once at the end of every feed() that produced any
+        // events, instead of all the callbacks above. invalid frames are
+        // among the frames, discards among the payloads. each array is in
+        // the order of the single callbacks and the indexes relate them to
+        // each other. the batch and everything it points to are valid until
+        // the callback returns; fragments can be retained as above.
+        // NB: frames cannot be filtered as with link_frame(); its return
+        //     value has no equivalent here.
 
     void (*log_error)(void *env, const char *fmt, ...);
 } DNP3_Callbacks;
 
+// dissector statistics
+typedef struct {
+    // fragment cache
+    size_t cache_hits;
+    size_t cache_misses;
+    size_t cache_evictions;
+    size_t cache_bytes;         // memory currently held by the cache
+} DNP3_DissectorStats;
+
+// resources used by dnp3_init
+typedef struct {
+    size_t allocs;              // blocks held by the parsers (nodes,
+                                // dispatch and lookup tables)
+    size_t bytes;               // total size of those blocks
+    size_t interned;            // number of distinct shared sub-parsers
+    size_t interned_hits;       // constructions avoided by sharing them
+    size_t compiled;            // of the exported top-level parsers,
+                                // those dnp3_p_compile moved off packrat
+} DNP3_InitStats;
+
+// parser statistics (global)
+typedef struct {
+    size_t admission_rejects;   // fragments rejected because an object
+                                // block's count or range exceeded what the
+                                // remaining input could hold
+} DNP3_ParserStats;
+
+// point database...
+
+// kinds of data points tracked by the point database
+typedef enum {
+    DNP3_POINT_BININ,           // g1, g2
+    DNP3_POINT_DBLBITIN,        // g3, g4
+    DNP3_POINT_BINOUT,          // g10, g11
+    DNP3_POINT_CTR,             // g20, g22
+    DNP3_POINT_FROZENCTR,       // g21, g23
+    DNP3_POINT_ANAIN,           // g30, g32
+    DNP3_POINT_FROZENANAIN,     // g31, g33
+    DNP3_POINT_ANAOUTSTATUS,    // g40, g42
+
+    DNP3_NPOINTTYPES
+} DNP3_PointType;
+
+// last known state of a data point
+typedef struct {
+    DNP3_Flags flags;   // binary states are in flags.state
+    double value;       // counter or analog value, 0 for binaries
+} DNP3_Point;
+
+// a point image, updated from response fragments
+typedef struct DNP3_PointDB_ DNP3_PointDB;
+
+// called for each point whose value or flags changed;
+// old is NULL if the point had not been seen before.
+typedef void (*DNP3_PointDelta)(void *env, uint32_t assoc,
+                                DNP3_PointType type, uint32_t index,
+                                const DNP3_Point *old, const DNP3_Point *cur);
+
+// transaction tracker...
+
+// pairs requests with responses per association, see dnp3_tracker_update
+typedef struct DNP3_Tracker_ DNP3_Tracker;
+
+typedef enum {
+    DNP3_TXN_COMPLETE,          // final response fragment seen
+    DNP3_TXN_NORESPONSE,        // request expects no response (*_NR)
+    DNP3_TXN_ABORTED,           // superseded by a new request (unsolicited
+                                // response) before the final fragment
+    DNP3_TXN_TIMEOUT            // see dnp3_tracker_expire
+} DNP3_TransactionStatus;
+
+// a request and its response, or an unsolicited response. times are in the
+// units passed to dnp3_tracker_update; latencies are relative to the
+// request (or the unsolicited response).
+typedef struct {
+    uint32_t assoc;
+    DNP3_FunctionCode fc;       // of the request, or UNSOLICITED_RESPONSE
+    uint8_t seq;                // of the request
+    DNP3_TransactionStatus status;
+
+    uint64_t time;              // of the request
+    uint64_t first;             // latency of the first response fragment
+    uint64_t final;             // latency of the final fragment (if fin)
+    uint64_t confirm;           // latency of its confirm (if confirmed)
+    size_t nfragments;          // response fragments
+    size_t nconfirms;           // confirms sent by the master
+    bool fin;                   // final fragment seen
+    bool confirmed;             // final fragment confirmed
+} DNP3_Transaction;
+
+// called for each finished transaction
+typedef void (*DNP3_TransactionDone)(void *env, const DNP3_Transaction *t);
+
+typedef struct {
+    size_t completed;           // incl. DNP3_TXN_NORESPONSE
+    size_t aborted;
+    size_t timeouts;
+    size_t unmatched;           // responses and confirms without a request
+} DNP3_TrackerStats;
+
+// response assembler...
+
+// joins multi-fragment responses per association, see dnp3_assembler_update
+typedef struct DNP3_Assembler_ DNP3_Assembler;
+
+// a complete (solicited or unsolicited) response. the object blocks are
+// those of the fragments; all is valid until the callback returns, retain
+// the fragments to keep them longer.
+typedef struct {
+    uint32_t assoc;
+    uint8_t seq;                            // of the first fragment
+    DNP3_IntIndications iin;                // of the last fragment
+    const DNP3_Fragment *const *fragments;  // in order
+    size_t nfragments;
+    DNP3_ObjectBlock *const *odata;         // of all fragments, in order
+    size_t nblocks;
+} DNP3_Response;
+
+// called for each complete response
+typedef void (*DNP3_ResponseDone)(void *env, const DNP3_Response *response);
+
+typedef struct {
+    size_t responses;           // delivered
+    size_t assembled;           // ...of more than one fragment
+    size_t aborted;             // partial responses superseded by a new one
+    size_t discontinuities;     // fragments out of sequence, dropping the
+                                // partial response (if any)
+    size_t duplicates;          // retransmitted fragments, ignored
+    size_t overflows;           // partial responses dropped at the limits
+    size_t timeouts;            // see dnp3_assembler_expire
+    size_t bytes;               // memory currently held
+} DNP3_AssemblerStats;
+
+#define DNP3_ASSEMBLER_MAXFRAGMENTS 64          // defaults, see
+#define DNP3_ASSEMBLER_MAXBYTES     (1 << 20)   // dnp3_assembler_set_limits
+
+// secure authentication...
+
+// a key holds the HMAC state precomputed from a session key, so that each
+// MAC only hashes the message itself, see dnp3_auth_key
+typedef struct {
+    uint32_t inner[8];          // hash state after the key xor ipad
+    uint32_t outer[8];          // hash state after the key xor opad
+} DNP3_AuthKey;
+
+// follows the challenges, replies, key status and key changes of each
+// association and user, see dnp3_auth_update
+typedef struct DNP3_AuthEngine_ DNP3_AuthEngine;
+
+typedef enum {
+    DNP3_AUTH_OK,               // MAC verified, or key change unwrapped
+    DNP3_AUTH_FAILED,           // MAC mismatch, or key data did not unwrap
+    DNP3_AUTH_NOKEY,            // no session key to check with
+    DNP3_AUTH_UNSUPPORTED,      // MAC algorithm other than HMAC-SHA-256
+    DNP3_AUTH_UNEXPECTED,       // no matching challenge or key status
+    DNP3_AUTH_REJECTED,         // a station reported an error (g120v7)
+    DNP3_AUTH_TIMEOUT           // see dnp3_auth_expire
+} DNP3_AuthResult;
+
+// the outcome of an authentication message, by the g120 variation it
+// concerns: a challenge that timed out (1), a reply (2), an aggressive-mode
+// request or response (3), a key status confirming a key change (5), a key
+// change (6), or an error (7).
+typedef struct {
+    uint32_t assoc;
+    uint16_t usr;
+    bool dir;                   // sender, true = master
+    DNP3_Variation variation;
+    uint32_t seq;               // CSQ or KSQ
+    uint8_t code;               // error code (7)
+    DNP3_AuthResult result;
+} DNP3_AuthEvent;
+
+// called for each event
+typedef void (*DNP3_AuthNotify)(void *env, const DNP3_AuthEvent *ev);
+
+// unwrap the new session keys of a key change (g120v6) with the user's
+// update key. returns false if the key data is invalid.
+typedef bool (*DNP3_AuthUnwrap)(void *env, uint32_t assoc, uint16_t usr,
+                                const uint8_t *data, size_t len,
+                                DNP3_AuthKey *control, DNP3_AuthKey *monitor);
+
+typedef struct {
+    size_t sessions;            // association/user pairs in the table
+    size_t challenges;
+    size_t verified;
+    size_t failed;
+    size_t nokey;
+    size_t unsupported;
+    size_t unexpected;
+    size_t keychanges;
+    size_t errors;              // DNP3_AUTH_REJECTED
+    size_t timeouts;
+    size_t unknown;             // messages for users not in the table
+    size_t overflows;           // messages too long to keep for their MAC
+} DNP3_AuthStats;
+
 
 /// EXPORTED FUNCTIONS ///
 
 // global one-time init
 void dnp3_init(void);
 void dnp3_p_init(void);     // initialize just the parsers  XXX needed?
+void dnp3_init_stats(DNP3_InitStats *stats);  // memory held by the parsers
+void dnp3_parser_stats(DNP3_ParserStats *stats);
 // XXX void dnp3_free(void);
 
 // create a protocol dissector bound to the given callbacks
+// mm_results provides the (reference-counted) fragments passed to callbacks
+// bufsize is the capacity of the input buffer, at least DNP3_MIN_BUFSIZE
+// (0 selects the default). feed() holds back less than one frame of input
+// and leaves room for at least bufsize/2 bytes.
 StreamProcessor *dnp3_dissector(DNP3_Callbacks cb, void *env);
+StreamProcessor *dnp3_dissector_sized(size_t bufsize,
+                                      DNP3_Callbacks cb, void *env);
 StreamProcessor *dnp3_dissector__m(HAllocator *mm_input,
                                    HAllocator *mm_parse,
                                    HAllocator *mm_context,
                                    HAllocator *mm_results,
                                    DNP3_Callbacks cb, void *env);
+StreamProcessor *dnp3_dissector_sized__m(HAllocator *mm_input,
+                                         HAllocator *mm_parse,
+                                         HAllocator *mm_context,
+                                         HAllocator *mm_results,
+                                         size_t bufsize,
+                                         DNP3_Callbacks cb, void *env);
+
+#define DNP3_MIN_BUFSIZE    (2 * DNP3_MAX_FRAME)
+
+// enable caching of parsed application fragments in a dissector.
+// a payload that is identical to one of the last 'entries' payloads from the
+// same source (apart from the sequence number) is not parsed again.
+// the cache holds at most 'maxbytes' of memory in total, entries=0 disables.
+// returns 0 on success, < 0 on error
+int dnp3_dissector_set_cache(StreamProcessor *p, size_t entries,
+                             size_t maxbytes);
+
+// set the layout options (DNP3_PACK_*) for fragments passed to the callbacks.
+// DNP3_PACK_RAW selects the parser as with dnp3_p_app_fragment_select.
+// returns 0 on success, < 0 on error
+int dnp3_dissector_set_pack(StreamProcessor *p, unsigned flags);
+
+// decode only objects of the given types in responses (see
+// dnp3_p_app_fragment_select); NULL decodes all. clears the fragment cache.
+// returns 0 on success, < 0 on error
+int dnp3_dissector_set_interest(StreamProcessor *p, const DNP3_Interest *mask);
+
+// retrieve the dissector's statistics
+void dnp3_dissector_stats(const StreamProcessor *p, DNP3_DissectorStats *stats);
+
+// track the transactions of all associations seen by the dissector; the
+// tracker remains owned by the caller. NULL disables.
+void dnp3_dissector_set_tracker(StreamProcessor *p, DNP3_Tracker *tr);
+
+// assemble the responses of all associations seen by the dissector; the
+// assembler remains owned by the caller. NULL disables.
+void dnp3_dissector_set_assembler(StreamProcessor *p, DNP3_Assembler *as);
+
+// follow the secure authentication sessions of all associations seen by the
+// dissector; the engine remains owned by the caller. NULL disables.
+void dnp3_dissector_set_auth(StreamProcessor *p, DNP3_AuthEngine *eng);
+
+// set the time passed to the tracker, assembler, and authentication engine
+// for input fed from now on
+void dnp3_dissector_set_time(StreamProcessor *p, uint64_t now);
+
+// create a point database that reports changes to the given callback
+DNP3_PointDB *dnp3_pointdb(DNP3_PointDelta delta, void *env);
+DNP3_PointDB *dnp3_pointdb__m(HAllocator *mm, DNP3_PointDelta delta, void *env);
+void dnp3_pointdb_free(DNP3_PointDB *db);
+
+// apply the objects of a (solicited or unsolicited) response fragment to the
+// image of the given association; requests are ignored.
+// returns the number of changed points.
+size_t dnp3_pointdb_update(DNP3_PointDB *db, uint32_t assoc,
+                           const DNP3_Fragment *fragment);
+
+// look up the current state of a point, NULL if unknown
+const DNP3_Point *dnp3_pointdb_get(const DNP3_PointDB *db, uint32_t assoc,
+                                   DNP3_PointType type, uint32_t index);
+
+// number of point updates dropped because the limit on high point indexes
+// (65536 per type and association above index 4095) was reached or memory
+// ran out
+size_t dnp3_pointdb_rejects(const DNP3_PointDB *db);
+
+// suggested association key for use with the point database
+static inline
+uint32_t dnp3_association(uint16_t outstation, uint16_t master)
+    { return ((uint32_t)outstation << 16 | master); }
+
+// create a transaction tracker that reports to the given callback
+DNP3_Tracker *dnp3_tracker(DNP3_TransactionDone done, void *env);
+DNP3_Tracker *dnp3_tracker__m(HAllocator *mm, DNP3_TransactionDone done,
+                              void *env);
+void dnp3_tracker_free(DNP3_Tracker *tr);   // drops pending transactions
+
+// feed a fragment of the given association (see dnp3_association) seen at
+// time now (monotonic, in any unit). dir is that of the link layer: true
+// from master to outstation. fragments that fit no pending transaction
+// are counted as unmatched.
+// returns 0 on success, < 0 on error (out of memory)
+int dnp3_tracker_update(DNP3_Tracker *tr, uint32_t assoc, bool dir,
+                        uint64_t now, const DNP3_Fragment *frag);
+
+// finish all transactions without activity for at least timeout, with
+// status TIMEOUT (or COMPLETE if just the final confirm is missing).
+// returns their number.
+size_t dnp3_tracker_expire(DNP3_Tracker *tr, uint64_t now, uint64_t timeout);
+
+void dnp3_tracker_stats(const DNP3_Tracker *tr, DNP3_TrackerStats *stats);
+
+// create a response assembler that reports to the given callback
+DNP3_Assembler *dnp3_assembler(DNP3_ResponseDone done, void *env);
+DNP3_Assembler *dnp3_assembler__m(HAllocator *mm, DNP3_ResponseDone done,
+                                  void *env);
+void dnp3_assembler_free(DNP3_Assembler *as);   // drops partial responses
+
+// limit the fragments per response and the memory held by all partial
+// responses (as counted by dnp3_fragment_size). partial responses over the
+// limits are dropped, those of other associations first.
+// returns 0 on success, < 0 on error
+int dnp3_assembler_set_limits(DNP3_Assembler *as, size_t maxfragments,
+                              size_t maxbytes);
+
+// feed a fragment of the given association seen at time now (monotonic, in
+// any unit). only responses are considered, requests are ignored. the
+// fragment must come from dnp3_fragment_share*, as do those passed by the
+// dissector, since partial responses retain their fragments; passing a
+// fragment from the parser or dnp3_fragment_copy is undefined behavior.
+// returns 0 on success, < 0 on error (out of memory)
+int dnp3_assembler_update(DNP3_Assembler *as, uint32_t assoc, uint64_t now,
+                          const DNP3_Fragment *frag);
+
+// drop all partial responses without a fragment for at least timeout.
+// returns their number.
+size_t dnp3_assembler_expire(DNP3_Assembler *as, uint64_t now,
+                             uint64_t timeout);
+
+void dnp3_assembler_stats(const DNP3_Assembler *as, DNP3_AssemblerStats *stats);
+
+
+// secure authentication: aggressive-mode MACs (HMAC-SHA-256).
+// keep one DNP3_AuthKey per user (DNP3_AuthData.usr) and direction.
+void dnp3_auth_key(DNP3_AuthKey *key, const uint8_t *k, size_t len);
+
+// compute the (untruncated) MAC over chal followed by msg into out[32]
+void dnp3_auth_mac(const DNP3_AuthKey *key, const uint8_t *chal,
+                   size_t chal_len, const uint8_t *msg, size_t len,
+                   uint8_t *out);
+
+// check the MAC of an aggressive-mode fragment. buf is the raw fragment of
+// len bytes as parsed into auth, ending in the MAC value. the MAC covers
+// chal (the last challenge, g120v1, received from the other station) and
+// buf up to the MAC value. truncated MACs are compared in full, in constant
+// time.
+bool dnp3_auth_verify(const DNP3_AuthKey *key, const uint8_t *chal,
+                      size_t chal_len, const uint8_t *buf, size_t len,
+                      const DNP3_AuthData *auth);
+
+typedef struct {
+    const DNP3_AuthKey *key;
+    const uint8_t *chal;
+    size_t chal_len;
+    const uint8_t *buf;
+    size_t len;
+    const DNP3_AuthData *auth;
+} DNP3_AuthCheck;
+
+// dnp3_auth_verify on n fragments at once, hashing several side by side.
+// ok[i] is set to the result of checks[i]. returns the number that passed.
+size_t dnp3_auth_verify_batch(const DNP3_AuthCheck *checks, size_t n,
+                              bool *ok);
+
+// secure authentication sessions (SAv5, IEEE 1815-2012 clause 7).
+// create a session engine for up to maxsessions association/user pairs,
+// all allocated up front. unwrap may be NULL; key changes then leave their
+// user without session keys.
+DNP3_AuthEngine *dnp3_auth_engine(size_t maxsessions, DNP3_AuthNotify notify,
+                                  DNP3_AuthUnwrap unwrap, void *env);
+DNP3_AuthEngine *dnp3_auth_engine__m(HAllocator *mm, size_t maxsessions,
+                                     DNP3_AuthNotify notify,
+                                     DNP3_AuthUnwrap unwrap, void *env);
+void dnp3_auth_engine_free(DNP3_AuthEngine *eng);
+
+// add a user of the given association, or set its session keys: control
+// for MACs sent by the master, monitor for those sent by the outstation.
+// both NULL add the user without session keys.
+// returns 0 on success, < 0 on error (table full)
+int dnp3_auth_set_keys(DNP3_AuthEngine *eng, uint32_t assoc, uint16_t usr,
+                       const DNP3_AuthKey *control,
+                       const DNP3_AuthKey *monitor);
+
+// feed a fragment of the given association seen at time now (monotonic, in
+// any unit). dir is true for fragments from master to outstation. buf is
+// the raw fragment of len bytes as parsed into frag; challenges and key
+// status messages are kept for the MACs that refer to them, as is the last
+// other fragment of each association, which a challenge may refer to. the
+// MAC of a reply (g120v2) covers the challenge message followed by the
+// challenged fragment; that of a key status following a key change covers
+// the key change message.
+void dnp3_auth_update(DNP3_AuthEngine *eng, uint32_t assoc, bool dir,
+                      uint64_t now, const uint8_t *buf, size_t len,
+                      const DNP3_Fragment *frag);
+
+// report all challenges without a reply for at least timeout.
+// returns their number.
+size_t dnp3_auth_expire(DNP3_AuthEngine *eng, uint64_t now, uint64_t timeout);
+
+void dnp3_auth_stats(const DNP3_AuthEngine *eng, DNP3_AuthStats *stats);
+
+
+// copy a fragment into a single contiguous block of memory.
+// the block holds the fragment with all its object blocks, indexes, objects
+// and strings; it is freed with a single call to the allocator's free.
+// flags is a combination of the following layout options:
+#define DNP3_PACK_COMPACT 0x1   // store objects as compact records if possible
+#define DNP3_PACK_RAW     0x2   // keep objects raw (parsing only, see below)
+DNP3_Fragment *dnp3_fragment_copy(const DNP3_Fragment *frag, unsigned flags);
+DNP3_Fragment *dnp3_fragment_copy__m(HAllocator *mm,
+                                     const DNP3_Fragment *frag, unsigned flags);
+
+// exact size of the copy made by the above
+size_t dnp3_fragment_size(const DNP3_Fragment *frag, unsigned flags);
+
+// lay out a copy of the fragment in the given buffer, which must be at least
+// dnp3_fragment_size(frag, flags) bytes and suitably aligned (as from malloc).
+// returns buf.
+DNP3_Fragment *dnp3_fragment_pack(void *buf, const DNP3_Fragment *frag,
+                                  unsigned flags);
+
+// fix up the internal pointers of a packed fragment that was moved (e.g.
+// with memcpy) from oldbase to buf. returns buf.
+DNP3_Fragment *dnp3_fragment_relocate(void *buf, const void *oldbase);
+
+// objects of common point types (binaries, counters, analogs) can be stored
+// as compact records sized exactly for their variation, instead of full
+// DNP3_Object structs. such blocks have objects == NULL and records != NULL.
+// with DNP3_PACK_RAW, the parser leaves them in wire format, stride bits
+// each, in raw; they are validated but only decoded on access.
+// use the following to access objects regardless of layout.
+static inline
+bool dnp3_oblock_has_objects(const DNP3_ObjectBlock *ob)
+    { return (ob->objects || ob->records || ob->raw); }
+
+// decode the i-th object of a block into *obj; false if there is none
+bool dnp3_oblock_get(const DNP3_ObjectBlock *ob, size_t i, DNP3_Object *obj);
+
+// decode up to n objects starting at i into out, returns the number decoded
+size_t dnp3_oblock_getn(const DNP3_ObjectBlock *ob, size_t i, size_t n,
+                        DNP3_Object *out);
+
+// reference-counted fragments, such as those passed to the dissector
+// callbacks. a shared fragment is a packed copy (see above) that is freed
+// when the last reference is released; the count is updated atomically, so
+// references may be handed to other threads. the fragment is read-only.
+// dnp3_fragment_share* return a new fragment with a count of one.
+// retain and release must only be applied to fragments obtained from
+// dnp3_fragment_share* (directly or via the dissector), never to those from
+// the parser or dnp3_fragment_copy/pack; debug builds assert this.
+DNP3_Fragment *dnp3_fragment_share(const DNP3_Fragment *frag, unsigned flags);
+DNP3_Fragment *dnp3_fragment_share__m(HAllocator *mm,
+                                      const DNP3_Fragment *frag, unsigned flags);
+const DNP3_Fragment *dnp3_fragment_retain(const DNP3_Fragment *frag);
+void dnp3_fragment_release(const DNP3_Fragment *frag);
 
 
 // check a raw link-layer frame as parsed by dnp3_p_link_frame for validity
@@ -615,8 +1233,122 @@ bool dnp3_link_fcv(const DNP3_Frame *frame);
 
 uint16_t dnp3_crc(uint8_t *bytes, size_t len);
 
+#define DNP3_MAX_PAYLOAD    250     // user data octets per frame
+#define DNP3_MAX_FRAME      292     // 10 header + 250 data + 16 CRC octets
+#define DNP3_MAX_FRAGMENT   2048    // largest application fragment
+
+// size of a frame with the given payload length on the wire
+static inline
+size_t dnp3_link_size(size_t len) { return 10 + len + 2 * ((len + 15) / 16); }
+
+// encode a link-layer frame into buf, including all CRCs, in a single pass
+// over the payload (frame->len bytes at frame->payload). flags are taken
+// from the frame as is, see dnp3_link_fcv. returns the number of bytes
+// written, 0 if the payload is too long or buf (bufsize) is too small.
+size_t dnp3_link_encode_frame(uint8_t *buf, size_t bufsize,
+                              const DNP3_Frame *frame);
+
+// like the above with the payload gathered from n slices (e.g. a transport
+// header and part of a fragment); frame->len and frame->payload are ignored.
+size_t dnp3_link_encode_framev(uint8_t *buf, size_t bufsize,
+                               const DNP3_Frame *frame,
+                               const HBytes *payload, size_t n);
+
+// encode n frames back to back; returns the total size, 0 on error
+size_t dnp3_link_encode_frames(uint8_t *buf, size_t bufsize,
+                               const DNP3_Frame *frames, size_t n);
+
+// transport-layer encoder, splits application fragments into segments
+// wrapped in link frames. keeps the next sequence number for every
+// source/destination pair (starting at 0).
+typedef struct DNP3_TransportEncoder_ DNP3_TransportEncoder;
+
+DNP3_TransportEncoder *dnp3_transport_encoder(void);
+DNP3_TransportEncoder *dnp3_transport_encoder__m(HAllocator *mm);
+void dnp3_transport_encoder_free(DNP3_TransportEncoder *enc);
+
+// number and total size of the frames for a fragment of len bytes
+size_t dnp3_transport_nframes(size_t len);
+size_t dnp3_transport_size(size_t len);
+
+// encode a fragment (len bytes) as a series of frames, written back to back
+// into buf (bufsize >= dnp3_transport_size(len)). the link header fields
+// are taken from hdr for every frame; hdr->len and hdr->payload are ignored.
+// if frames is not NULL, it receives the location of each frame in buf
+// (dnp3_transport_nframes(len) entries), e.g. for writev or one datagram
+// per frame. returns the number of bytes written, 0 on error.
+size_t dnp3_transport_encode(DNP3_TransportEncoder *enc,
+                             uint8_t *buf, size_t bufsize,
+                             const DNP3_Frame *hdr,
+                             const uint8_t *fragment, size_t len,
+                             HBytes *frames);
+
+// set the next sequence number (0-63) for the given pair
+// returns 0 on success, < 0 on error
+int dnp3_transport_set_seq(DNP3_TransportEncoder *enc,
+                           uint16_t source, uint16_t destination, uint8_t seq);
+
+// application-layer encoding, the inverse of dnp3_p_app_fragment...
+//
+// dnp3_fragment_encoded_size returns the exact size of the fragment on the
+// wire, 0 if it cannot be encoded (e.g. invalid qualifier, count or index
+// out of range for its field, unknown object type). blocks without object
+// data (as in requests) are encoded as object headers only. aggressive-mode
+// authentication (frag->auth) is encoded as a leading g120v3 and a trailing
+// g120v9 object around the blocks.
+size_t dnp3_fragment_encoded_size(const DNP3_Fragment *frag);
+
+// encode a fragment into buf; no memory is allocated. returns the number of
+// bytes written, 0 on error or if bufsize is too small.
+size_t dnp3_encode_fragment(uint8_t *buf, size_t bufsize,
+                            const DNP3_Fragment *frag);
+
+// response builder: collects point values and lays them out in as few bytes
+// as possible. it picks range (qc=00-02) or index-prefixed (qc=17,28,39)
+// blocks per run of consecutive indexes and the smallest variations that
+// represent the values (packed binaries, no flags if just ONLINE, 16-bit or
+// single-precision values). the result is split into response fragments of
+// at most maxfrag bytes as encoded by dnp3_encode_fragment.
+typedef struct DNP3_ResponseBuilder_ DNP3_ResponseBuilder;
+
+typedef struct {
+    size_t nfragments;
+    size_t nblocks;
+    size_t bytes;           // total size of the fragments
+    size_t naive_bytes;     // the same with one index-prefixed block (qc=28)
+                            // per full-width variation with flags
+    size_t saved;           // naive_bytes - bytes, 0 if negative
+} DNP3_BuildStats;
+
+#define DNP3_MIN_FRAGSIZE 24    // header plus one point in any variation
+
+// returns NULL if maxfrag is less than DNP3_MIN_FRAGSIZE
+DNP3_ResponseBuilder *dnp3_response_builder(size_t maxfrag);
+DNP3_ResponseBuilder *dnp3_response_builder__m(HAllocator *mm, size_t maxfrag);
+void dnp3_response_builder_free(DNP3_ResponseBuilder *b);
+
+// add a point. a later value for the same point replaces an earlier one.
+// returns 0 on success, < 0 on error (value not representable in the type's
+// variations, out of memory)
+int dnp3_response_add(DNP3_ResponseBuilder *b, DNP3_PointType type,
+                      uint32_t index, const DNP3_Point *pt);
+
+// forget all points and the last result
+void dnp3_response_reset(DNP3_ResponseBuilder *b);
+
+// lay out the points added so far. returns the number of fragments (at least
+// one), 0 on error. the fragments have function code RESPONSE, with FIR set
+// on the first and FIN on the last; seq, con, and iin are left to the caller.
+size_t dnp3_response_build(DNP3_ResponseBuilder *b, DNP3_BuildStats *stats);
+
+// the i-th fragment of the last build, NULL if out of range.
+// valid until the next build, reset, or free.
+DNP3_Fragment *dnp3_response_fragment(DNP3_ResponseBuilder *b, size_t i);
+
 // formatting for human-readable output
 // caller must free result on all of the following!
+// NB: dnp3_format_object shows relative times as such; dnp3_format_oblock
+//     shows them resolved if the block has a CTO.
 char *dnp3_format_object(DNP3_Group g, DNP3_Variation v, const DNP3_Object o);
 char *dnp3_format_oblock(const DNP3_ObjectBlock *ob);
 char *dnp3_format_fragment(const DNP3_Fragment *frag);
@@ -3,6 +3,8 @@
 #include <dnp3hammer.h>
 
 #include <hammer/glue.h>
+#include <string.h>     // memcpy, memcmp
+#include <assert.h>
 #include "hammer.h" // XXX placeholder for extensions
 #include "obj/binary.h"
 #include "obj/binoutcmd.h"
@@ -13,6 +15,7 @@
 #include "obj/iin.h"
 #include "obj/application.h"
 #include "g120_auth.h"
+#include "record.h"
 #include "util.h"
 
 #include "app.h"
@@ -21,42 +24,74 @@
 HParser *dnp3_p_app_request;
 HParser *dnp3_p_app_response;
 HParser *dnp3_p_app_fragment;
+HParser *dnp3_p_app_request_ohdrs;
+HParser *dnp3_p_app_response_ohdrs;
+HParser *dnp3_p_app_fragment_ohdrs;
 
 
 /// AGGRESSIVE-MODE AUTHENTICATION ///
 
 static HParsedToken *act_with_ama(const HParseResult *p, void *env)
 {
-    DNP3_Fragment *frag = H_ALLOC(DNP3_Fragment);
-    DNP3_AuthData *a = H_ALLOC(DNP3_AuthData);
-
-    // XXX this is wrong; the incoming objects are raw, not yet a DNP3_Fragment
-    //     leave all this to act_fragment!?
+    // input is a sequence: (auth_aggr, odata, auth_mac)
+    // or (auth_aggr, auth_mac) if odata yielded no token (h_epsilon_p)
+    HCountedArray *seq = H_CAST_SEQ(p->ast);
+    size_t n = seq->used;
+    const HParsedToken *od = (n > 2) ? seq->elements[1] : NULL;
+
+    // propagate TT_ERR on objects, including the auth objects themselves
+    for(size_t i=0; i<n; i++) {
+        if(seq->elements[i] && H_ISERR(seq->elements[i]->token_type))
+            return seq->elements[i];
+    }
 
-    // input is a sequence: (auth_aggr, fragment, auth_mac)
-    *frag = *H_FIELD(DNP3_Fragment, 1);
+    const DNP3_ObjectBlock *aggr = H_CAST(DNP3_ObjectBlock, seq->elements[0]);
+    const DNP3_ObjectBlock *mac = H_CAST(DNP3_ObjectBlock, seq->elements[n-1]);
+    DNP3_AuthData *a = H_ALLOC(DNP3_AuthData);
 
-    // XXX fill AuthData from H_FIELD(..., 0) and H_FIELD(..., 2)
-    // a->xxx = H_FIELD(..., 1)->xxx;
-    // a->mac = H_FIELD(..., 2);
-    frag->auth = a;
+    a->csq = aggr->objects[0].aggr.csq;
+    a->usr = aggr->objects[0].aggr.usr;
+    a->maclen = mac->objects[0].mac.len;    // <= DNP3_AUTH_MAXMAC
+    memcpy(a->mac, mac->objects[0].mac.data, a->maclen);
 
-    return H_MAKE(DNP3_Fragment, frag);
+    // yield (authdata, odata) as expected by act_fragment
+    HParsedToken *res = H_MAKE_SEQN(2);
+    h_seq_snoc(res, H_MAKE(DNP3_AuthData, a));
+    h_seq_snoc(res, od);
+    return res;
 }
 
+// the start of an aggressive-mode MAC object (g120v9)
+static HParser *auth_mac_hdr;
+
 // combinator: allow aggresive-mode auth objects around base parser
-static HParser *ama(HParser *base)
+static HParser *ama(HParser *base, HParser *body)
 {
     // aggressive mode objects are optional, but if used:
     // g120v3 (aggressive mode request) must be the first object.
     // g120v9 (message authentication code) must be the last object.
+    // NB: body is base but stops in front of g120v9 and leaves it to us.
 
     H_ARULE(with_ama, h_sequence(dnp3_p_g120v3_auth_aggr_block,
-                                 base,
+                                 body,
                                  dnp3_p_g120v9_auth_mac_block, NULL));
-        // XXX parse/validate mac before rest of odata?!
 
-    return base; // XXX h_choice(with_ama, base, NULL);
+    return h_choice(with_ama, base, NULL);
+}
+
+// combinator: ama around a sequence of blocks p, with an optional action.
+// only with aggressive mode does p need to check for the MAC in front of it.
+static HParser *ama_many(HParser *p, HAction act)
+{
+    H_RULE(p_nomac, h_right(h_not(auth_mac_hdr), p));
+    H_RULE(base,    dnp3_p_many(p));
+    H_RULE(body,    dnp3_p_many(p_nomac));
+
+    if(act) {
+        base = h_action(base, act, NULL);
+        body = h_action(body, act, NULL);
+    }
+    return ama(base, body);
 }
 
 
@@ -65,6 +100,13 @@ static HParser *ama(HParser *base)
 // object data parsers, indexed by function code
 static HParser *odata[256] = {NULL};
 
+// header-only variants of the above (see dnp3_p_ohdr)
+static HParser *odata_ohdrs[256] = {NULL};
+
+// object blocks in responses (for dnp3_p_app_fragment_select)
+static HParser *rsp_block;
+static HParser *unsol_block;
+
 // response function codes and associated (possible) object types
 //
 // this table is an inversion of table 3 ("Object definition summary")
@@ -150,6 +192,11 @@ static HParser *odata[256] = {NULL};
 // in case none of the branches match, the h_choice has the OBJ_UNKNOWN case as
 // a catch-all. this must be the case for all such h_choices. we use the
 // dnp3_p_objchoice combinator to abstract that.
+//
+// because a block parser never fails after group and variation have matched,
+// dnp3_p_objchoice can replace the choice by a table lookup on those two
+// bytes. for this to work, composite alternatives must be built with
+// dnp3_p_blockchoice and dnp3_p_blockseq instead of h_choice and dnp3_p_seq.
 
 static void init_odata(void)
 {
@@ -162,74 +209,74 @@ static void init_odata(void)
     //H_RULE(rblock_attr,     dnp3_p_attr_rblock);
 
     // binary inputs
-    H_RULE(rblock_binin,    h_choice(dnp3_p_binin_rblock,
-                                     dnp3_p_bininev_rblock,
-                                     dnp3_p_dblbitin_rblock,
-                                     dnp3_p_dblbitinev_rblock, NULL));
-    H_RULE(oblock_binin,    h_choice(dnp3_p_binin_oblock,
-                                     dnp3_p_bininev_oblock,
-                                     dnp3_p_dblbitin_oblock,
-                                     dnp3_p_dblbitinev_oblock, NULL));
+    H_RULE(rblock_binin,    dnp3_p_blockchoice(dnp3_p_binin_rblock,
+                                               dnp3_p_bininev_rblock,
+                                               dnp3_p_dblbitin_rblock,
+                                               dnp3_p_dblbitinev_rblock, NULL));
+    H_RULE(oblock_binin,    dnp3_p_blockchoice(dnp3_p_binin_oblock,
+                                               dnp3_p_bininev_oblock,
+                                               dnp3_p_dblbitin_oblock,
+                                               dnp3_p_dblbitinev_oblock, NULL));
 
     // binary outputs
-    H_RULE(rblock_binout,   h_choice(dnp3_p_binout_rblock,
-                                     dnp3_p_binoutev_rblock,
-                                     dnp3_p_binoutcmdev_rblock, NULL));
-    H_RULE(oblock_binout,   h_choice(dnp3_p_binout_oblock,
-                                     dnp3_p_binoutev_oblock,
-                                     dnp3_p_g12v1_binoutcmd_crob_oblock,
-                                     dnp3_p_g12v2_binoutcmd_pcb_oblock,
-                                     dnp3_p_g12v3_binoutcmd_pcm_rblock,
-                                        // XXX stricter rules for PCB/PCM in responses?
-                                     dnp3_p_binoutcmdev_oblock, NULL));
+    H_RULE(rblock_binout,   dnp3_p_blockchoice(dnp3_p_binout_rblock,
+                                               dnp3_p_binoutev_rblock,
+                                               dnp3_p_binoutcmdev_rblock, NULL));
+    H_RULE(oblock_binout,   dnp3_p_blockchoice(dnp3_p_binout_oblock,
+                                               dnp3_p_binoutev_oblock,
+                                               dnp3_p_g12v1_binoutcmd_crob_oblock,
+                                               dnp3_p_g12v2_binoutcmd_pcb_oblock,
+                                               dnp3_p_g12v3_binoutcmd_pcm_rblock,
+                                                  // XXX stricter rules for PCB/PCM in responses?
+                                               dnp3_p_binoutcmdev_oblock, NULL));
 
     // counters
-    H_RULE(rblock_ctr,      h_choice(dnp3_p_ctr_rblock,
-                                     dnp3_p_ctrev_rblock,
-                                     dnp3_p_frozenctr_rblock,
-                                     dnp3_p_frozenctrev_rblock, NULL));
-    H_RULE(oblock_ctr,      h_choice(dnp3_p_ctr_oblock,
-                                     dnp3_p_ctrev_oblock,
-                                     dnp3_p_frozenctr_oblock,
-                                     dnp3_p_frozenctrev_oblock, NULL));
+    H_RULE(rblock_ctr,      dnp3_p_blockchoice(dnp3_p_ctr_rblock,
+                                               dnp3_p_ctrev_rblock,
+                                               dnp3_p_frozenctr_rblock,
+                                               dnp3_p_frozenctrev_rblock, NULL));
+    H_RULE(oblock_ctr,      dnp3_p_blockchoice(dnp3_p_ctr_oblock,
+                                               dnp3_p_ctrev_oblock,
+                                               dnp3_p_frozenctr_oblock,
+                                               dnp3_p_frozenctrev_oblock, NULL));
 
     // analog inputs
-    H_RULE(rblock_anain,    h_choice(dnp3_p_anain_rblock,
-                                     dnp3_p_anainev_rblock,
-                                     dnp3_p_frozenanain_rblock,
-                                     dnp3_p_frozenanainev_rblock,
-                                     dnp3_p_anaindeadband_rblock, NULL));
-    H_RULE(oblock_anain,    h_choice(dnp3_p_anain_oblock,
-                                     dnp3_p_anainev_oblock,
-                                     dnp3_p_frozenanain_oblock,
-                                     dnp3_p_frozenanainev_oblock,
-                                     dnp3_p_anaindeadband_oblock, NULL));
+    H_RULE(rblock_anain,    dnp3_p_blockchoice(dnp3_p_anain_rblock,
+                                               dnp3_p_anainev_rblock,
+                                               dnp3_p_frozenanain_rblock,
+                                               dnp3_p_frozenanainev_rblock,
+                                               dnp3_p_anaindeadband_rblock, NULL));
+    H_RULE(oblock_anain,    dnp3_p_blockchoice(dnp3_p_anain_oblock,
+                                               dnp3_p_anainev_oblock,
+                                               dnp3_p_frozenanain_oblock,
+                                               dnp3_p_frozenanainev_oblock,
+                                               dnp3_p_anaindeadband_oblock, NULL));
 
     // analog outputs
-    H_RULE(rblock_anaout,   h_choice(dnp3_p_anaoutstatus_rblock,
-                                     dnp3_p_anaoutev_rblock,
-                                     dnp3_p_anaoutcmdev_rblock, NULL));
-    H_RULE(oblock_anaout,   h_choice(dnp3_p_anaoutstatus_oblock,
-                                     dnp3_p_anaout_oblock,
-                                     dnp3_p_anaoutev_oblock,
-                                     dnp3_p_anaoutcmdev_oblock, NULL));
+    H_RULE(rblock_anaout,   dnp3_p_blockchoice(dnp3_p_anaoutstatus_rblock,
+                                               dnp3_p_anaoutev_rblock,
+                                               dnp3_p_anaoutcmdev_rblock, NULL));
+    H_RULE(oblock_anaout,   dnp3_p_blockchoice(dnp3_p_anaoutstatus_oblock,
+                                               dnp3_p_anaout_oblock,
+                                               dnp3_p_anaoutev_oblock,
+                                               dnp3_p_anaoutcmdev_oblock, NULL));
 
     // times
-    H_RULE(rblock_time,     h_choice(dnp3_p_g50v1_time_rblock,
-                                     dnp3_p_g50v4_indexed_time_rblock, NULL));
-    H_RULE(oblock_time,     h_choice(dnp3_p_g50v1_time_oblock,
-                                     dnp3_p_g50v4_indexed_time_oblock,
-                                     dnp3_p_cto_oblock,
-                                     dnp3_p_delay_oblock, NULL));
-    H_RULE(wblock_time,     h_choice(dnp3_p_g50v1_time_oblock,
-                                     dnp3_p_g50v3_recorded_time_oblock,
-                                     dnp3_p_g50v4_indexed_time_oblock, NULL));
+    H_RULE(rblock_time,     dnp3_p_blockchoice(dnp3_p_g50v1_time_rblock,
+                                               dnp3_p_g50v4_indexed_time_rblock, NULL));
+    H_RULE(oblock_time,     dnp3_p_blockchoice(dnp3_p_g50v1_time_oblock,
+                                               dnp3_p_g50v4_indexed_time_oblock,
+                                               dnp3_p_cto_oblock,
+                                               dnp3_p_delay_oblock, NULL));
+    H_RULE(wblock_time,     dnp3_p_blockchoice(dnp3_p_g50v1_time_oblock,
+                                               dnp3_p_g50v3_recorded_time_oblock,
+                                               dnp3_p_g50v4_indexed_time_oblock, NULL));
 
     // class data
-    H_RULE(rblock_class,    h_choice(dnp3_p_g60v1_class0_rblock,
-                                     dnp3_p_g60v2_class1_rblock,
-                                     dnp3_p_g60v3_class2_rblock,
-                                     dnp3_p_g60v4_class3_rblock, NULL));
+    H_RULE(rblock_class,    dnp3_p_blockchoice(dnp3_p_g60v1_class0_rblock,
+                                               dnp3_p_g60v2_class1_rblock,
+                                               dnp3_p_g60v3_class2_rblock,
+                                               dnp3_p_g60v4_class3_rblock, NULL));
 
 //                                 g70v5...,  // files   XXX oblock!!!
 //                                 g70v6...,
@@ -264,7 +311,7 @@ static void init_odata(void)
                                              rblock_class,
                                              dnp3_p_iin_rblock,
                                              NULL));
-    H_RULE(read,            dnp3_p_many(read_oblock));
+    H_RULE(read,            ama_many(read_oblock, NULL));
     // XXX NB parsing pseudocode in AN2012-004b does NOT work for READ requests.
     //     it misses the case that a function code requires object headers
     //     but no objects. never mind that it might require an object with some
@@ -276,57 +323,74 @@ static void init_odata(void)
                                              wblock_time,   // XXX multiple blocks ok?!
                                              dnp3_p_iin_oblock,
                                              NULL));
-    H_RULE(write,           dnp3_p_many(write_oblock));
+    H_RULE(write,           ama_many(write_oblock, NULL));
 
     #define act_select dnp3_p_act_flatten
     H_RULE(pcb,             dnp3_p_g12v2_binoutcmd_pcb_oblock);
     H_RULE(pcm,             dnp3_p_g12v3_binoutcmd_pcm_oblock);
-    H_RULE(select_pcb,      dnp3_p_seq(pcb, dnp3_p_many1(pcm)));
+    H_RULE(select_pcb,      dnp3_p_blockseq(pcb, dnp3_p_many1(pcm)));
     H_RULE(select_oblock,   dnp3_p_objchoice(select_pcb,
                                              dnp3_p_g12v1_binoutcmd_crob_oblock,
                                              dnp3_p_anaout_oblock,  // XXX or _sblock?!
                                              NULL));
-    H_ARULE(select,         dnp3_p_many(select_oblock));
+    H_RULE(select,          ama_many(select_oblock, act_select));
         // XXX empty select requests valid?
         // XXX is it valid to have many pcb-pcm blocks in the same request? to mix pcbs and crobs?
 
-    H_RULE(freezable,       h_choice(dnp3_p_ctr_fblock, dnp3_p_anain_fblock, NULL));
+    H_RULE(freezable,       dnp3_p_blockchoice(dnp3_p_ctr_fblock, dnp3_p_anain_fblock, NULL));
     H_RULE(clearable,       dnp3_p_ctr_fblock);
 
-    H_RULE(freeze,          dnp3_p_many(dnp3_p_objchoice(freezable, NULL)));
-    H_RULE(freeze_clear,    dnp3_p_many(dnp3_p_objchoice(clearable, NULL)));
+    H_RULE(freeze,          ama_many(dnp3_p_objchoice(freezable, NULL), NULL));
+    H_RULE(freeze_clear,    ama_many(dnp3_p_objchoice(clearable, NULL), NULL));
 
     #define act_freeze_at_time dnp3_p_act_flatten
     H_RULE(tdi,             dnp3_p_g50v2_time_interval_oblock);
     H_RULE(frz_schedule,    dnp3_p_seq(tdi, dnp3_p_many(freezable)));
-    H_ARULE(freeze_at_time, dnp3_p_many(frz_schedule));
+    H_RULE(freeze_at_time,  ama_many(frz_schedule, act_freeze_at_time));
 
     H_RULE(applid,          dnp3_p_g90v1_applid_oblock);
-    H_RULE(application,     dnp3_p_many(dnp3_p_objchoice(applid, NULL)));
+    H_RULE(application,     ama_many(dnp3_p_objchoice(applid, NULL), NULL));
+
+    // secure authentication (SAv5), without aggressive mode
+    H_RULE(auth_challenge,  dnp3_p_g120v1_auth_challenge_block);
+    H_RULE(auth_reply,      dnp3_p_g120v2_auth_reply_block);
+    H_RULE(auth_keystatreq, dnp3_p_g120v4_auth_keystatreq_block);
+    H_RULE(auth_keystatus,  dnp3_p_g120v5_auth_keystatus_block);
+    H_RULE(auth_keychange,  dnp3_p_g120v6_auth_keychange_block);
+    H_RULE(auth_error,      dnp3_p_g120v7_auth_error_block);
+    H_RULE(auth_req_oblock, dnp3_p_objchoice(auth_challenge, auth_reply,
+                                             auth_keystatreq, auth_keychange,
+                                             NULL));
+    H_RULE(auth_rsp_oblock, dnp3_p_objchoice(auth_challenge, auth_reply,
+                                             auth_keystatus, auth_error,
+                                             NULL));
+    H_RULE(authenticate_req, dnp3_p_many(auth_req_oblock));
+    H_RULE(auth_req_no_ack, dnp3_p_many(dnp3_p_objchoice(auth_error, NULL)));
+    H_RULE(authenticate_rsp, dnp3_p_many(auth_rsp_oblock));
 
     // XXX the below point types are not listed as allowed with fc 20/21 in AN2013-004b.
     // they are allowed in class assignments, though
-    H_RULE(event_point,     h_choice(dnp3_p_binin_rblock,
-                                     dnp3_p_dblbitin_rblock,
-                                     dnp3_p_binout_rblock,
-                                     dnp3_p_binoutcmd_rblock,
-                                     dnp3_p_ctr_rblock,
-                                     dnp3_p_frozenctr_rblock,
-                                     dnp3_p_anain_rblock,
-                                     dnp3_p_frozenanain_rblock,
-                                     dnp3_p_anaoutstatus_rblock,
-                                     dnp3_p_anaout_rblock,
-                                     NULL));
-    H_RULE(event_class,     h_choice(dnp3_p_g60v2_class1_rblock,
-                                     dnp3_p_g60v3_class2_rblock,
-                                     dnp3_p_g60v4_class3_rblock,
-                                     NULL));
+    H_RULE(event_point,     dnp3_p_blockchoice(dnp3_p_binin_rblock,
+                                               dnp3_p_dblbitin_rblock,
+                                               dnp3_p_binout_rblock,
+                                               dnp3_p_binoutcmd_rblock,
+                                               dnp3_p_ctr_rblock,
+                                               dnp3_p_frozenctr_rblock,
+                                               dnp3_p_anain_rblock,
+                                               dnp3_p_frozenanain_rblock,
+                                               dnp3_p_anaoutstatus_rblock,
+                                               dnp3_p_anaout_rblock,
+                                               NULL));
+    H_RULE(event_class,     dnp3_p_blockchoice(dnp3_p_g60v2_class1_rblock,
+                                               dnp3_p_g60v3_class2_rblock,
+                                               dnp3_p_g60v4_class3_rblock,
+                                               NULL));
     H_RULE(en_unsol_oblock, dnp3_p_objchoice(event_class, event_point, NULL));
-    H_RULE(enable_unsol,    dnp3_p_many(en_unsol_oblock));
+    H_RULE(enable_unsol,    ama_many(en_unsol_oblock, NULL));
 
     #define act_assign_class dnp3_p_act_flatten
     H_RULE(assign_set,      dnp3_p_seq(rblock_class, dnp3_p_many(event_point)));
-    H_ARULE(assign_class,   dnp3_p_many(assign_set));
+    H_RULE(assign_class,    ama_many(assign_set, act_assign_class));
 
     H_RULE(rsp_oblock,      dnp3_p_objchoice(//oblock_attr,
                                              oblock_binin,
@@ -337,7 +401,7 @@ static void init_odata(void)
                                              oblock_time,
                                              dnp3_p_iin_oblock,
                                              NULL));
-    H_RULE(response,        dnp3_p_many(rsp_oblock));
+    H_RULE(response,        ama_many(rsp_oblock, NULL));
 
     H_RULE(unsol_oblock,    dnp3_p_objchoice(dnp3_p_bininev_oblock,
                                              dnp3_p_dblbitinev_oblock,
@@ -351,35 +415,38 @@ static void init_odata(void)
                                              dnp3_p_anaoutcmdev_oblock,
                                              dnp3_p_cto_oblock,
                                              NULL));
-    H_RULE(unsolicited,     dnp3_p_many(unsol_oblock));
+    H_RULE(unsolicited,     ama_many(unsol_oblock, NULL));
 
+    rsp_block = rsp_oblock;
+    unsol_block = unsol_oblock;
 
-    H_RULE(empty_req,       ama(h_epsilon_p()));
+
+    H_RULE(empty_req,       ama(h_epsilon_p(), h_epsilon_p()));
     H_RULE(not_supp,        dnp3_p_err_func_not_supp);
 
     odata[DNP3_CONFIRM] = empty_req;
-    odata[DNP3_READ]    = ama(read);
-    odata[DNP3_WRITE]   = ama(write);
+    odata[DNP3_READ]    = read;
+    odata[DNP3_WRITE]   = write;
     odata[DNP3_SELECT]            = // -.
     odata[DNP3_OPERATE]           = // -.
     odata[DNP3_DIRECT_OPERATE]    = // -v
-    odata[DNP3_DIRECT_OPERATE_NR] = ama(select);
+    odata[DNP3_DIRECT_OPERATE_NR] = select;
     odata[DNP3_IMMED_FREEZE]      = // -v
-    odata[DNP3_IMMED_FREEZE_NR]   = ama(freeze);
+    odata[DNP3_IMMED_FREEZE_NR]   = freeze;
     odata[DNP3_FREEZE_CLEAR]      = // -v
-    odata[DNP3_FREEZE_CLEAR_NR]   = ama(freeze_clear);
+    odata[DNP3_FREEZE_CLEAR_NR]   = freeze_clear;
     odata[DNP3_FREEZE_AT_TIME]    = // -v
-    odata[DNP3_FREEZE_AT_TIME_NR] = ama(freeze_at_time);
+    odata[DNP3_FREEZE_AT_TIME_NR] = freeze_at_time;
     odata[DNP3_COLD_RESTART]      = empty_req;
     odata[DNP3_WARM_RESTART]      = empty_req;
     odata[DNP3_INITIALIZE_DATA]   = not_supp; // obsolete
     odata[DNP3_INITIALIZE_APPL]   = // -.
     odata[DNP3_START_APPL]        = // -v
-    odata[DNP3_STOP_APPL]         = ama(application);
+    odata[DNP3_STOP_APPL]         = application;
     odata[DNP3_SAVE_CONFIG]       = not_supp; // deprecated
     odata[DNP3_ENABLE_UNSOLICITED]  = // -v
-    odata[DNP3_DISABLE_UNSOLICITED] = ama(enable_unsol);
-    odata[DNP3_ASSIGN_CLASS]        = ama(assign_class);
+    odata[DNP3_DISABLE_UNSOLICITED] = enable_unsol;
+    odata[DNP3_ASSIGN_CLASS]        = assign_class;
     odata[DNP3_DELAY_MEASURE]       = empty_req;
     odata[DNP3_RECORD_CURRENT_TIME] = empty_req;
 
@@ -387,11 +454,45 @@ static void init_odata(void)
         //   may not use variation 0
         //   may not use group 60
         //   may not use range specifier 0x6
-    odata[DNP3_RESPONSE] = ama(response);    // XXX ? or depend on req. fc?!
-    odata[DNP3_UNSOLICITED_RESPONSE] = ama(unsolicited);
+    odata[DNP3_RESPONSE] = response;    // XXX ? or depend on req. fc?!
+    odata[DNP3_UNSOLICITED_RESPONSE] = unsolicited;
+
+    odata[DNP3_AUTHENTICATE_REQ]    = authenticate_req;
+    odata[DNP3_AUTH_REQ_NO_ACK]     = auth_req_no_ack;
+    odata[DNP3_AUTHENTICATE_RESP]   = authenticate_rsp;
+
+    H_RULE(ohdrs_none,      ama_many(dnp3_p_ohdr(OHDR_NONE), NULL));
+    H_RULE(ohdrs_objects,   ama_many(dnp3_p_ohdr(OHDR_OBJECTS), NULL));
+    H_RULE(ohdrs_time,      ama_many(dnp3_p_ohdr(OHDR_TIME), NULL));
+    H_RULE(ohdrs_auth,      dnp3_p_many(dnp3_p_ohdr(OHDR_OBJECTS)));
 
-    //odata[DNP3_AUTHENTICATE_REQ]    = authenticate_req;
-    //odata[DNP3_AUTH_REQ_NO_ACK]     = auth_req_no_ack;
+    for(int fc=0; fc<256; fc++) {
+        if(odata[fc] == empty_req || odata[fc] == not_supp)
+            odata_ohdrs[fc] = odata[fc];
+    }
+    odata_ohdrs[DNP3_READ]    = ohdrs_none;
+    odata_ohdrs[DNP3_WRITE]   = ohdrs_objects;
+    odata_ohdrs[DNP3_SELECT]            =
+    odata_ohdrs[DNP3_OPERATE]           =
+    odata_ohdrs[DNP3_DIRECT_OPERATE]    =
+    odata_ohdrs[DNP3_DIRECT_OPERATE_NR] = ohdrs_objects;
+    odata_ohdrs[DNP3_IMMED_FREEZE]      =
+    odata_ohdrs[DNP3_IMMED_FREEZE_NR]   =
+    odata_ohdrs[DNP3_FREEZE_CLEAR]      =
+    odata_ohdrs[DNP3_FREEZE_CLEAR_NR]   = ohdrs_none;
+    odata_ohdrs[DNP3_FREEZE_AT_TIME]    =
+    odata_ohdrs[DNP3_FREEZE_AT_TIME_NR] = ohdrs_time;
+    odata_ohdrs[DNP3_INITIALIZE_APPL]   =
+    odata_ohdrs[DNP3_START_APPL]        =
+    odata_ohdrs[DNP3_STOP_APPL]         = ohdrs_objects;
+    odata_ohdrs[DNP3_ENABLE_UNSOLICITED]  =
+    odata_ohdrs[DNP3_DISABLE_UNSOLICITED] =
+    odata_ohdrs[DNP3_ASSIGN_CLASS]        = ohdrs_none;
+    odata_ohdrs[DNP3_RESPONSE]            =
+    odata_ohdrs[DNP3_UNSOLICITED_RESPONSE] = ohdrs_objects;
+    odata_ohdrs[DNP3_AUTHENTICATE_REQ]    =
+    odata_ohdrs[DNP3_AUTH_REQ_NO_ACK]     =
+    odata_ohdrs[DNP3_AUTHENTICATE_RESP]   = ohdrs_auth;
 }
 
 
@@ -413,6 +514,8 @@ static HParsedToken *act_fragment(const HParseResult *p, void *user)
 
     // propagate TT_ERR on objects
     if(p->ast && H_ISERR(p->ast->token_type)) {
+        dnp3_p_count_reject(p->ast);
+
         // we use (XXX abuse?) the user field on our TT_ERR token to report the
         // application header (as a DNP3_Fragment structure without objects),
         // so that an outstation can generate a correct response to requests.
@@ -446,14 +549,24 @@ static HParsedToken *act_fragment(const HParseResult *p, void *user)
         size_t n = od->seq->used;
         frag->nblocks = n;
         frag->odata = h_arena_malloc(p->arena, sizeof(DNP3_ObjectBlock *) * n);
+
+        // resolve relative times against the last CTO seen, as we go
+        const DNP3_ObjectBlock *cto = NULL;
         for(size_t i=0; i<frag->nblocks; i++) {
-            frag->odata[i] = H_INDEX(DNP3_ObjectBlock, od, i);
+            DNP3_ObjectBlock *ob = H_INDEX(DNP3_ObjectBlock, od, i);
+
+            frag->odata[i] = ob;
+            if(ob->group == DNP3_GROUP_CTO)
+                cto = ob;
+            else
+                dnp3_oblock_resolve(ob, cto);
         }
     } else {
         // single-oblock case
         frag->nblocks = 1;
         frag->odata = H_ALLOC(DNP3_ObjectBlock *);
         frag->odata[0] = H_CAST(DNP3_ObjectBlock, od);
+        dnp3_oblock_resolve(frag->odata[0], NULL);
     }
 
     return H_MAKE(DNP3_Fragment, frag);
@@ -471,9 +584,12 @@ static HParsedToken *act_fragment_errfc(const HParseResult *p, void *user)
     return h_make_err(p->arena, ERR_FUNC_NOT_SUPP, frag);
 }
 
-// parse the rest of a fragment, after the application header
+// parse the rest of a fragment, after the application header.
+// env is the table of object data parsers to use (odata or odata_ohdrs).
 static HParser *k_fragment(HAllocator *mm__, const HParsedToken *hdr, void *env)
 {
+    HParser **table = env;
+
     // propagate TT_ERR on function code
     HParsedToken *fc_ = H_INDEX_TOKEN(hdr, 1);
     if(H_ISERR(fc_->token_type))
@@ -482,7 +598,7 @@ static HParser *k_fragment(HAllocator *mm__, const HParsedToken *hdr, void *env)
     int fc = H_CAST_UINT(fc_);
 
     // basic object data parser
-    HParser *p = odata[fc];
+    HParser *p = table[fc];
     if(p == NULL)
         goto err;
 
@@ -557,6 +673,102 @@ static bool validate_tryresponse(HParseResult *p, void *user)
     return (p->ast->token_type != ERR_FUNC_NOT_SUPP);
 }
 
+/// SELECTIVE DECODING ///
+
+// application headers (set in dnp3_p_init_app)
+static HParser *req_header_;
+static HParser *rsp_header_;
+
+// fragment parsers built by dnp3_p_app_fragment_select, by arguments.
+// like the other parsers they are never freed, so the number is bounded and
+// the cache is static.
+#define MAXSELECTIVE 8
+
+struct Selective {
+    bool all;               // mask == NULL
+    DNP3_Interest mask;
+    unsigned flags;
+    HParser *table[256];    // by function code, cf. odata
+    HParser *p;
+};
+
+static struct Selective selective[MAXSELECTIVE];
+static size_t nselective = 0;
+static bool selective_lock = false;
+
+// building parsers also touches the block registry in oblock.c
+#ifdef __GNUC__
+#define LOCK(x)     while(__atomic_test_and_set(&(x), __ATOMIC_ACQUIRE)) {}
+#define UNLOCK(x)   __atomic_clear(&(x), __ATOMIC_RELEASE)
+#else
+#define LOCK(x)     // XXX not thread-safe
+#define UNLOCK(x)
+#endif
+
+// object blocks in responses, as selected by the given arguments
+static HParser *rsp_oblocks(HParser *block, const struct Selective *s)
+{
+    if(s->flags & DNP3_PACK_RAW)
+        block = dnp3_p_oblock_lazy(block);
+    if(!s->all)
+        block = dnp3_p_oblock_select(block, &s->mask, OHDR_OBJECTS);
+    return ama_many(block, NULL);
+}
+
+static HParser *build_selective(struct Selective *s)
+{
+    HParser **table = s->table;
+
+    // only responses carry the point data that consumers subscribe to;
+    // requests are always decoded in full.
+    memcpy(table, odata, sizeof(odata));
+    table[DNP3_RESPONSE] = rsp_oblocks(rsp_block, s);
+    table[DNP3_UNSOLICITED_RESPONSE] = rsp_oblocks(unsol_block, s);
+
+    H_RULE (request,    h_bind(req_header_, k_fragment, table));
+    H_RULE (response,   h_bind(rsp_header_, k_fragment, table));
+    H_RULE (tryrsp,     h_attr_bool(response, validate_tryresponse, NULL));
+    H_RULE (fragment,   h_choice(tryrsp, request, NULL));
+
+    return little_endian(fragment);
+}
+
+HParser *dnp3_p_app_fragment_select(const DNP3_Interest *mask,
+                                    unsigned flags)
+{
+    HParser *p = dnp3_p_app_fragment;   // if the cache is full
+
+    flags &= DNP3_PACK_RAW;     // the others don't concern parsing
+    if(!mask && !flags)
+        return dnp3_p_app_fragment;
+
+    LOCK(selective_lock);
+    for(size_t i=0; i<nselective; i++) {
+        struct Selective *s = &selective[i];
+
+        if(s->flags == flags && s->all == !mask &&
+           (!mask || memcmp(&s->mask, mask, sizeof(DNP3_Interest)) == 0)) {
+            p = s->p;
+            goto done;
+        }
+    }
+
+    if(nselective < MAXSELECTIVE) {
+        struct Selective *s = &selective[nselective];
+
+        s->all = !mask;
+        if(mask)
+            s->mask = *mask;
+        s->flags = flags;
+        s->p = p = build_selective(s);
+        nselective++;
+    }
+
+done:
+    UNLOCK(selective_lock);
+    return p;
+}
+
 void dnp3_p_init_app(void)
 {
     // initialize object block and associated parsers/combinators
@@ -571,6 +783,10 @@ void dnp3_p_init_app(void)
     dnp3_p_init_class();
     dnp3_p_init_iin();
     dnp3_p_init_application();
+    dnp3_p_init_g120_auth();
+
+    auth_mac_hdr = h_sequence(dnp3_p_ch(DNP3_GROUP_AUTH),
+                              dnp3_p_ch(DNP3_VARIATION_AUTH_MAC), NULL);
 
     // initialize request-specific "object data" parsers
     init_odata();
@@ -619,8 +835,11 @@ void dnp3_p_init_app(void)
                                  h_sequence(rspac, rspfc, iin, NULL),
                                  h_sequence(anyrspac, erspfc, iin, NULL), NULL));
 
-    H_RULE (request,    h_bind(req_header, k_fragment, NULL));
-    H_RULE (response,   h_bind(rsp_header, k_fragment, NULL));
+    req_header_ = req_header;
+    rsp_header_ = rsp_header;
+
+    H_RULE (request,    h_bind(req_header, k_fragment, odata));
+    H_RULE (response,   h_bind(rsp_header, k_fragment, odata));
 
     H_VRULE(tryresponse, response);
     H_RULE (fragment,   h_choice(tryresponse, request, NULL));
@@ -629,4 +848,16 @@ void dnp3_p_init_app(void)
     dnp3_p_app_request  = little_endian(request);
     dnp3_p_app_response = little_endian(response);
     dnp3_p_app_fragment = little_endian(fragment);
+
+    // header-only variants
+    H_RULE (request_ohdrs,  h_bind(req_header, k_fragment, odata_ohdrs));
+    H_RULE (response_ohdrs, h_bind(rsp_header, k_fragment, odata_ohdrs));
+
+    H_RULE (tryrsp_ohdrs,   h_attr_bool(response_ohdrs,
+                                        validate_tryresponse, NULL));
+    H_RULE (fragment_ohdrs, h_choice(tryrsp_ohdrs, request_ohdrs, NULL));
+
+    dnp3_p_app_request_ohdrs  = little_endian(request_ohdrs);
+    dnp3_p_app_response_ohdrs = little_endian(response_ohdrs);
+    dnp3_p_app_fragment_ohdrs = little_endian(fragment_ohdrs);
 }
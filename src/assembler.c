@@ -0,0 +1,307 @@
+// response assembler: joins the fragments of multi-fragment responses
+//
+// the fragments of a solicited response carry consecutive sequence numbers
+// (mod 16), the first marked FIR and the last FIN. the assembler keeps a
+// reference to each fragment until the last one arrives, then reports the
+// whole response with an array of all its object blocks. the blocks are
+// not copied; they remain part of their fragments.
+//
+// a broken sequence drops the partial response, as does exceeding a memory
+// limit or (see dnp3_assembler_expire) a timeout.
+
+#include <dnp3hammer.h>
+#include <string.h>
+#include "hammer.h"
+#include "assoctab.h"
+
+
+#define SEQMASK 0x0F            // sequence numbers are 4 bits
+#define MINFRAGS 4              // initial array size per response
+
+// a response in progress
+struct Partial {
+    const DNP3_Fragment **frags;    // retained
+    size_t n;
+    size_t max;                 // allocated size of frags
+    size_t nblocks;
+    size_t bytes;               // memory accounted to the fragments
+    uint8_t expect;             // sequence number of the next fragment
+    uint64_t last;              // time of the last fragment
+};
+
+struct Assoc {
+    struct AssocEntry e;
+    struct Partial p;           // empty if p.n = 0
+};
+
+struct DNP3_Assembler_ {
+    HAllocator *mm;
+    AssocTable assocs;
+
+    size_t maxfragments;        // per response
+    size_t maxbytes;            // over all partial responses
+    size_t bytes;
+
+    DNP3_AssemblerStats stats;
+
+    DNP3_ResponseDone done;
+    void *env;
+};
+
+
+DNP3_Assembler *dnp3_assembler__m(HAllocator *mm, DNP3_ResponseDone done,
+                                  void *env)
+{
+    DNP3_Assembler *as = mm->alloc(mm, sizeof(DNP3_Assembler));
+    if(!as) return NULL;
+
+    memset(as, 0, sizeof(DNP3_Assembler));
+    as->mm = mm;
+    dnp3_assoctab_init(&as->assocs, mm);
+    as->maxfragments = DNP3_ASSEMBLER_MAXFRAGMENTS;
+    as->maxbytes = DNP3_ASSEMBLER_MAXBYTES;
+    as->done = done;
+    as->env = env;
+
+    return as;
+}
+
+DNP3_Assembler *dnp3_assembler(DNP3_ResponseDone done, void *env)
+{
+    return dnp3_assembler__m(h_system_allocator, done, env);
+}
+
+// release the fragments of a partial response
+static void clear(DNP3_Assembler *as, struct Partial *p)
+{
+    for(size_t i=0; i<p->n; i++)
+        dnp3_fragment_release(p->frags[i]);
+    as->bytes -= p->bytes;
+    p->n = 0;
+    p->nblocks = 0;
+    p->bytes = 0;
+}
+
+// a partial response is abandoned
+static void drop(DNP3_Assembler *as, struct Partial *p, size_t *counter)
+{
+    if(p->n == 0)
+        return;
+    (*counter)++;
+    clear(as, p);
+}
+
+void dnp3_assembler_free(DNP3_Assembler *as)
+{
+    HAllocator *mm = as->mm;
+
+    for(struct AssocEntry *e = as->assocs.first; e; e = e->next) {
+        struct Assoc *a = (struct Assoc *)e;
+        clear(as, &a->p);
+        if(a->p.frags)
+            mm->free(mm, a->p.frags);
+    }
+    dnp3_assoctab_free(&as->assocs);
+    mm->free(mm, as);
+}
+
+int dnp3_assembler_set_limits(DNP3_Assembler *as, size_t maxfragments,
+                              size_t maxbytes)
+{
+    if(maxfragments < 1)
+        return -1;
+
+    // drop partial responses over the new limits, least recently active
+    // first
+    struct AssocEntry *e;
+    for(e = as->assocs.first; e; e = e->next) {
+        struct Assoc *a = (struct Assoc *)e;
+        if(a->p.n > maxfragments)
+            drop(as, &a->p, &as->stats.overflows);
+    }
+    for(e = as->assocs.last; e && as->bytes > maxbytes; e = e->prev)
+        drop(as, &((struct Assoc *)e)->p, &as->stats.overflows);
+
+    as->maxfragments = maxfragments;
+    as->maxbytes = maxbytes;
+    return 0;
+}
+
+void dnp3_assembler_stats(const DNP3_Assembler *as, DNP3_AssemblerStats *stats)
+{
+    *stats = as->stats;
+    stats->bytes = as->bytes;
+}
+
+// make room for the bytes of a new fragment by dropping the partial
+// responses of the least recently active associations other than a
+static bool make_room(DNP3_Assembler *as, const struct Assoc *a, size_t bytes)
+{
+    if(a->p.bytes + bytes > as->maxbytes)
+        return false;
+
+    while(as->bytes + bytes > as->maxbytes) {
+        struct AssocEntry *e;
+
+        for(e = as->assocs.last; e; e = e->prev) {
+            if(e != &a->e && ((struct Assoc *)e)->p.n > 0)
+                break;
+        }
+        if(!e)
+            return false;
+        drop(as, &((struct Assoc *)e)->p, &as->stats.overflows);
+    }
+
+    return true;
+}
+
+// add a fragment to the partial response
+static bool append(DNP3_Assembler *as, struct Assoc *a, uint64_t now,
+                   const DNP3_Fragment *frag)
+{
+    struct Partial *p = &a->p;
+    HAllocator *mm = as->mm;
+    size_t bytes = dnp3_fragment_size(frag, 0);
+
+    if(p->n >= as->maxfragments || !make_room(as, a, bytes)) {
+        as->stats.overflows++;
+        clear(as, p);
+        return false;
+    }
+
+    if(p->n == p->max) {
+        size_t max = p->max ? 2 * p->max : MINFRAGS;
+        const DNP3_Fragment **frags =
+            p->frags ? mm->realloc(mm, p->frags, max * sizeof *frags)
+                     : mm->alloc(mm, max * sizeof *frags);
+        if(!frags) {
+            as->stats.overflows++;
+            clear(as, p);
+            return false;
+        }
+        p->frags = frags;
+        p->max = max;
+    }
+
+    p->frags[p->n++] = dnp3_fragment_retain(frag);
+    p->nblocks += frag->nblocks;
+    p->bytes += bytes;
+    as->bytes += bytes;
+    p->expect = (frag->ac.seq + 1) & SEQMASK;
+    p->last = now;
+    return true;
+}
+
+static void report(DNP3_Assembler *as, const DNP3_Response *resp)
+{
+    as->stats.responses++;
+    if(resp->nfragments > 1)
+        as->stats.assembled++;
+    if(as->done)
+        as->done(as->env, resp);
+}
+
+// report the complete response and clear it
+static int deliver(DNP3_Assembler *as, struct Assoc *a)
+{
+    struct Partial *p = &a->p;
+    HAllocator *mm = as->mm;
+    const DNP3_Fragment *last = p->frags[p->n - 1];
+    DNP3_ObjectBlock **odata = NULL;
+
+    if(p->nblocks > 0) {
+        odata = mm->alloc(mm, p->nblocks * sizeof(DNP3_ObjectBlock *));
+        if(!odata) {
+            drop(as, p, &as->stats.overflows);
+            return -1;
+        }
+    }
+
+    // chain the blocks of all fragments
+    size_t k = 0;
+    for(size_t i=0; i<p->n; i++) {
+        for(size_t j=0; j<p->frags[i]->nblocks; j++)
+            odata[k++] = p->frags[i]->odata[j];
+    }
+
+    DNP3_Response resp = {
+        a->e.key, p->frags[0]->ac.seq, last->iin,
+        p->frags, p->n,
+        odata, p->nblocks
+    };
+    report(as, &resp);
+
+    if(odata)
+        mm->free(mm, odata);
+    clear(as, p);
+    return 0;
+}
+
+int dnp3_assembler_update(DNP3_Assembler *as, uint32_t assoc, uint64_t now,
+                          const DNP3_Fragment *frag)
+{
+    // unsolicited responses are always single fragments
+    bool uns = (frag->fc == DNP3_UNSOLICITED_RESPONSE);
+    if(frag->fc != DNP3_RESPONSE && !uns)
+        return 0;
+
+    struct Assoc *a = dnp3_assoctab_lookup(&as->assocs, assoc,
+                                           sizeof(struct Assoc));
+    if(!a)
+        return -1;
+    struct Partial *p = &a->p;
+
+    // a first fragment supersedes a partial response
+    if(frag->ac.fir && !uns)
+        drop(as, p, &as->stats.aborted);
+
+    if(uns || (frag->ac.fir && frag->ac.fin)) {
+        // pass single fragments through as they are
+        DNP3_Response resp = {
+            assoc, frag->ac.seq, frag->iin,
+            &frag, 1,
+            frag->odata, frag->nblocks
+        };
+        report(as, &resp);
+        return 0;
+    }
+
+    if(!frag->ac.fir) {
+        if(p->n == 0) {
+            as->stats.discontinuities++;    // no start
+            return 0;
+        }
+        if(frag->ac.seq == ((p->expect - 1) & SEQMASK)) {
+            as->stats.duplicates++;         // retransmitted
+            return 0;
+        }
+        if(frag->ac.seq != p->expect) {
+            as->stats.discontinuities++;
+            clear(as, p);
+            return 0;
+        }
+    }
+
+    if(!append(as, a, now, frag))
+        return 0;
+    if(frag->ac.fin)
+        return deliver(as, a);
+    return 0;
+}
+
+size_t dnp3_assembler_expire(DNP3_Assembler *as, uint64_t now,
+                             uint64_t timeout)
+{
+    size_t n = 0;
+
+    for(struct AssocEntry *e = as->assocs.first; e; e = e->next) {
+        struct Partial *p = &((struct Assoc *)e)->p;
+
+        if(p->n > 0 && now >= p->last && now - p->last >= timeout) {
+            drop(as, p, &as->stats.timeouts);
+            n++;
+        }
+    }
+
+    return n;
+}
@@ -0,0 +1,117 @@
+// association table, see assoctab.h
+
+#include <stdbool.h>
+#include <string.h>
+#include "assoctab.h"
+
+
+#define MINSIZE 16      // initial number of slots
+
+void dnp3_assoctab_init(AssocTable *t, HAllocator *mm)
+{
+    memset(t, 0, sizeof(AssocTable));
+    t->mm = mm;
+}
+
+void dnp3_assoctab_free(AssocTable *t)
+{
+    HAllocator *mm = t->mm;
+    struct AssocEntry *e;
+
+    while((e = t->first)) {
+        t->first = e->next;
+        mm->free(mm, e);
+    }
+    if(t->index)
+        mm->free(mm, t->index);
+    dnp3_assoctab_init(t, mm);
+}
+
+static size_t hash(uint32_t key)
+{
+    uint64_t x = key * 0x9E3779B97F4A7C15ull;
+    return (size_t)(x >> 32);
+}
+
+// find the entry with the given key, or the free slot for it.
+// the index must not be empty.
+static struct AssocEntry **lookup_slot(struct AssocEntry **index, size_t size,
+                                       uint32_t key)
+{
+    for(size_t i = hash(key); ; i++) {
+        struct AssocEntry **slot = &index[i & (size - 1)];
+
+        if(!*slot || (*slot)->key == key)
+            return slot;
+    }
+}
+
+// keep the index at most half full, so probes end quickly
+static bool grow(AssocTable *t)
+{
+    if(2 * (t->n + 1) <= t->size)
+        return true;
+
+    size_t size = t->size ? 2 * t->size : MINSIZE;
+    size_t bytes = size * sizeof(struct AssocEntry *);
+    struct AssocEntry **index = t->mm->alloc(t->mm, bytes);
+    if(!index)
+        return false;
+    memset(index, 0, bytes);
+
+    for(struct AssocEntry *e = t->first; e; e = e->next)
+        *lookup_slot(index, size, e->key) = e;
+
+    if(t->index)
+        t->mm->free(t->mm, t->index);
+    t->index = index;
+    t->size = size;
+    return true;
+}
+
+static void unlink_entry(AssocTable *t, struct AssocEntry *e)
+{
+    if(e->prev) e->prev->next = e->next; else t->first = e->next;
+    if(e->next) e->next->prev = e->prev; else t->last = e->prev;
+}
+
+static void push_front(AssocTable *t, struct AssocEntry *e)
+{
+    e->prev = NULL;
+    e->next = t->first;
+    if(t->first) t->first->prev = e; else t->last = e;
+    t->first = e;
+}
+
+void *dnp3_assoctab_find(const AssocTable *t, uint32_t key)
+{
+    if(t->size == 0)
+        return NULL;
+    return *lookup_slot(t->index, t->size, key);
+}
+
+void *dnp3_assoctab_lookup(AssocTable *t, uint32_t key, size_t size)
+{
+    struct AssocEntry *e = dnp3_assoctab_find(t, key);
+
+    if(e) {
+        if(e != t->first) {
+            unlink_entry(t, e);
+            push_front(t, e);
+        }
+        return e;
+    }
+
+    if(!grow(t))
+        return NULL;
+    e = t->mm->alloc(t->mm, size);
+    if(!e) return NULL;
+
+    memset(e, 0, size);
+    e->key = key;
+    *lookup_slot(t->index, t->size, key) = e;
+    push_front(t, e);
+    t->n++;
+
+    return e;
+}
@@ -0,0 +1,41 @@
+// association table: per-association state, keyed by a 32-bit id
+//
+// entries are found through a hash table (open addressing) and kept in a
+// doubly linked list ordered by use, most recent first, so the least
+// recently used ones can be found at the tail. each entry type begins with
+// a struct AssocEntry.
+
+#ifndef DNP3_ASSOCTAB_H_SEEN
+#define DNP3_ASSOCTAB_H_SEEN
+
+#include <hammer/hammer.h>
+#include <stdint.h>
+
+struct AssocEntry {
+    struct AssocEntry *prev;    // more recently used
+    struct AssocEntry *next;    // less recently used
+    uint32_t key;
+};
+
+typedef struct {
+    HAllocator *mm;
+    struct AssocEntry **index;  // NULL for empty slots
+    size_t size;                // number of slots, power of 2 (or 0)
+    size_t n;                   // number of entries
+    struct AssocEntry *first;   // most recently used
+    struct AssocEntry *last;    // least recently used
+} AssocTable;
+
+void dnp3_assoctab_init(AssocTable *t, HAllocator *mm);
+
+// free all entries. the caller releases what they point to beforehand.
+void dnp3_assoctab_free(AssocTable *t);
+
+// find the given association without changing the order. NULL if not found.
+void *dnp3_assoctab_find(const AssocTable *t, uint32_t key);
+
+// find the given association and mark it most recently used. if it does not
+// exist, create it as size zeroed bytes. returns NULL if out of memory.
+void *dnp3_assoctab_lookup(AssocTable *t, uint32_t key, size_t size);
+
+#endif // DNP3_ASSOCTAB_H_SEEN
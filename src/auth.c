@@ -0,0 +1,288 @@
+// secure authentication: HMAC-SHA-256 over aggressive-mode fragments
+//
+// HMAC(K, m) = H((K ^ opad) || H((K ^ ipad) || m)). both padded keys fill
+// exactly one block, so their compression is done once per key (see
+// DNP3_AuthKey) and every MAC costs only the blocks of m plus one more for
+// the outer hash.
+
+#include <dnp3hammer.h>
+#include <string.h>
+#include "sha256.h"
+#include "auth.h"
+
+
+// a message to be hashed after one block of padded key: the concatenation
+// of up to two pieces, followed by the SHA-256 padding
+struct Msg {
+    const uint8_t *piece[2];
+    size_t len[2];
+    size_t total;           // len[0] + len[1]
+    size_t nblocks;         // including padding
+    size_t i;               // next block
+    uint8_t buf[SHA256_BLOCK];
+};
+
+static void msg_init(struct Msg *m, const uint8_t *a, size_t alen,
+                     const uint8_t *b, size_t blen)
+{
+    m->piece[0] = a;
+    m->len[0] = alen;
+    m->piece[1] = b;
+    m->len[1] = blen;
+    m->total = alen + blen;
+    m->nblocks = (m->total + 8) / SHA256_BLOCK + 1;     // 0x80 and length
+    m->i = 0;
+}
+
+// copy n bytes from offset off of the message
+static void msg_copy(const struct Msg *m, uint8_t *out, size_t off, size_t n)
+{
+    for(int k=0; k<2 && n>0; k++) {
+        if(off >= m->len[k]) {
+            off -= m->len[k];
+            continue;
+        }
+        size_t x = m->len[k] - off;
+        if(x > n)
+            x = n;
+        memcpy(out, m->piece[k] + off, x);
+        out += x;
+        n -= x;
+        off = 0;
+    }
+}
+
+// the next block of the message, NULL after the last
+static const uint8_t *msg_block(struct Msg *m)
+{
+    if(m->i >= m->nblocks)
+        return NULL;
+
+    size_t off = m->i++ * SHA256_BLOCK;
+
+    // whole blocks within one piece are used in place
+    if(off + SHA256_BLOCK <= m->len[0])
+        return m->piece[0] + off;
+    if(off >= m->len[0] && off - m->len[0] + SHA256_BLOCK <= m->len[1])
+        return m->piece[1] + (off - m->len[0]);
+
+    size_t n = (off < m->total) ? m->total - off : 0;
+    if(n > SHA256_BLOCK)
+        n = SHA256_BLOCK;
+    memset(m->buf, 0, SHA256_BLOCK);
+    msg_copy(m, m->buf, off, n);
+    if(off + n == m->total && n < SHA256_BLOCK)
+        m->buf[n] = 0x80;
+
+    if(m->i == m->nblocks) {
+        // length in bits, including the key block
+        uint64_t bits = (uint64_t)(SHA256_BLOCK + m->total) * 8;
+        for(int k=0; k<8; k++)
+            m->buf[SHA256_BLOCK - 1 - k] = bits >> (8 * k);
+    }
+    return m->buf;
+}
+
+// the single block of the outer hash over an inner digest
+static void outer_block(uint8_t *blk, const uint32_t h[8])
+{
+    uint64_t bits = (SHA256_BLOCK + SHA256_DIGEST) * 8;
+
+    memset(blk, 0, SHA256_BLOCK);
+    sha256_digest(blk, h);
+    blk[SHA256_DIGEST] = 0x80;
+    for(int k=0; k<8; k++)
+        blk[SHA256_BLOCK - 1 - k] = bits >> (8 * k);
+}
+
+void dnp3_auth_key(DNP3_AuthKey *key, const uint8_t *k, size_t len)
+{
+    uint8_t kb[SHA256_BLOCK] = {0};
+    uint8_t pad[SHA256_BLOCK];
+
+    // long keys are replaced by their hash
+    if(len > SHA256_BLOCK) {
+        struct Msg m;
+        const uint8_t *blk;
+        uint32_t h[8];
+
+        // NB: msg_block counts a key block ahead of the message; hash the
+        //     first block of k in its place.
+        sha256_init(h);
+        sha256_block(h, k);
+        msg_init(&m, k + SHA256_BLOCK, len - SHA256_BLOCK, NULL, 0);
+        while((blk = msg_block(&m)))
+            sha256_block(h, blk);
+        sha256_digest(kb, h);
+    } else {
+        memcpy(kb, k, len);
+    }
+
+    for(int i=0; i<SHA256_BLOCK; i++)
+        pad[i] = kb[i] ^ 0x36;
+    sha256_init(key->inner);
+    sha256_block(key->inner, pad);
+
+    for(int i=0; i<SHA256_BLOCK; i++)
+        pad[i] = kb[i] ^ 0x5c;
+    sha256_init(key->outer);
+    sha256_block(key->outer, pad);
+}
+
+void dnp3_auth_mac(const DNP3_AuthKey *key, const uint8_t *chal,
+                   size_t chal_len, const uint8_t *msg, size_t len,
+                   uint8_t *out)
+{
+    struct Msg m;
+    const uint8_t *blk;
+    uint8_t ob[SHA256_BLOCK];
+    uint32_t h[8];
+
+    memcpy(h, key->inner, sizeof h);
+    msg_init(&m, chal, chal_len, msg, len);
+    while((blk = msg_block(&m)))
+        sha256_block(h, blk);
+
+    outer_block(ob, h);
+    memcpy(h, key->outer, sizeof h);
+    sha256_block(h, ob);
+    sha256_digest(out, h);
+}
+
+// compare the leading n bytes of a MAC in constant time
+bool dnp3_auth_mac_equal(const uint8_t *a, const uint8_t *b, size_t n)
+{
+    uint8_t x = 0;
+
+    for(size_t i=0; i<n; i++)
+        x |= a[i] ^ b[i];
+    return (x == 0);
+}
+
+// the message that check c covers, false if the check is malformed
+static bool check_msg(struct Msg *m, const DNP3_AuthCheck *c)
+{
+    const DNP3_AuthData *a = c->auth;
+
+    if(a->maclen == 0 || a->maclen > DNP3_AUTH_MAXMAC || c->len < a->maclen)
+        return false;
+    msg_init(m, c->chal, c->chal_len, c->buf, c->len - a->maclen);
+    return true;
+}
+
+bool dnp3_auth_verify(const DNP3_AuthKey *key, const uint8_t *chal,
+                      size_t chal_len, const uint8_t *buf, size_t len,
+                      const DNP3_AuthData *auth)
+{
+    uint8_t mac[SHA256_DIGEST];
+
+    if(auth->maclen == 0 || auth->maclen > DNP3_AUTH_MAXMAC ||
+       len < auth->maclen)
+        return false;
+
+    dnp3_auth_mac(key, chal, chal_len, buf, len - auth->maclen, mac);
+    return dnp3_auth_mac_equal(mac, auth->mac, auth->maclen);
+}
+
+
+// batch verification...
+//
+// checks are spread over SHA256_LANES lanes that are compressed in lock
+// step. a lane runs the blocks of its inner hash, then the outer block, and
+// takes the next check when it is done. idle lanes at the end compress a
+// dummy block.
+
+enum Phase { IDLE, INNER, OUTER };
+
+struct Lane {
+    enum Phase phase;
+    size_t idx;             // of the check
+    struct Msg m;
+    uint8_t ob[SHA256_BLOCK];
+};
+
+size_t dnp3_auth_verify_batch(const DNP3_AuthCheck *checks, size_t n,
+                              bool *ok)
+{
+    static const uint8_t dummy[SHA256_BLOCK];
+    struct Lane lanes[SHA256_LANES];
+    uint32_t h[8][SHA256_LANES];
+    const uint8_t *blk[SHA256_LANES];
+    uint8_t mac[SHA256_DIGEST];
+    size_t next = 0, nok = 0;
+
+    for(int l=0; l<SHA256_LANES; l++)
+        lanes[l].phase = IDLE;
+
+    for(;;) {
+        int busy = 0;
+
+        // start checks on idle lanes
+        for(int l=0; l<SHA256_LANES; l++) {
+            struct Lane *ln = &lanes[l];
+
+            while(ln->phase == IDLE && next < n) {
+                const DNP3_AuthCheck *c = &checks[next];
+
+                ln->idx = next++;
+                ok[ln->idx] = false;
+                if(!check_msg(&ln->m, c))
+                    continue;
+                for(int i=0; i<8; i++)
+                    h[i][l] = c->key->inner[i];
+                ln->phase = INNER;
+            }
+            if(ln->phase != IDLE)
+                busy++;
+        }
+        if(!busy)
+            break;
+
+        // gather the next block of every lane
+        for(int l=0; l<SHA256_LANES; l++) {
+            struct Lane *ln = &lanes[l];
+
+            if(ln->phase == INNER)
+                blk[l] = msg_block(&ln->m);
+            else if(ln->phase == OUTER)
+                blk[l] = ln->ob;
+            else
+                blk[l] = dummy;
+        }
+
+        sha256_block_lanes(h, blk);
+
+        // advance the lanes that finished a hash
+        for(int l=0; l<SHA256_LANES; l++) {
+            struct Lane *ln = &lanes[l];
+            const DNP3_AuthCheck *c;
+            uint32_t hl[8];
+
+            if(ln->phase == IDLE)
+                continue;
+            if(ln->phase == INNER && ln->m.i < ln->m.nblocks)
+                continue;
+
+            c = &checks[ln->idx];
+
+            for(int i=0; i<8; i++)
+                hl[i] = h[i][l];
+
+            if(ln->phase == INNER) {
+                outer_block(ln->ob, hl);
+                for(int i=0; i<8; i++)
+                    h[i][l] = c->key->outer[i];
+                ln->phase = OUTER;
+            } else {
+                sha256_digest(mac, hl);
+                ok[ln->idx] = dnp3_auth_mac_equal(mac, c->auth->mac,
+                                                  c->auth->maclen);
+                if(ok[ln->idx])
+                    nok++;
+                ln->phase = IDLE;
+            }
+        }
+    }
+
+    return nok;
+}
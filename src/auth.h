@@ -0,0 +1,12 @@
+// secure authentication internals shared by the MAC and session code
+
+#ifndef DNP3_AUTH_H_SEEN
+#define DNP3_AUTH_H_SEEN
+
+#include <dnp3hammer.h>
+
+
+// compare the leading n bytes of two MACs in constant time
+bool dnp3_auth_mac_equal(const uint8_t *a, const uint8_t *b, size_t n);
+
+#endif // DNP3_AUTH_H_SEEN
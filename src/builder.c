@@ -0,0 +1,823 @@
+// response builder: lays out point values in as few bytes as possible
+//
+// points are collected per type and, on build, sorted by index. each run of
+// consecutive indexes is sent either as one range block (qc=00-02) or split
+// into pieces whose points can use the same variations; each piece then goes
+// into a range block of its own or into the index-prefixed blocks (qc=17,
+// 28, 39) of its type, whichever is smaller. every block uses the smallest
+// variation that can represent all of its points: packed binaries and
+// variations without flags where the flags are just ONLINE, 16-bit or
+// single-precision values where they suffice.
+//
+// the blocks are finally split into fragments of at most the configured size
+// as encoded by dnp3_encode_fragment. for comparison, the same points are
+// also sized in a naive encoding: index-prefixed blocks (qc=28) of the
+// full-width variations with flags.
+
+#include <dnp3hammer.h>
+#include <stdlib.h>     // qsort
+#include <string.h>
+#include <float.h>      // FLT_MAX
+#include <assert.h>
+#include "hammer.h"
+#include "record.h"     // dnp3_wire_bits
+#include "app.h"        // G, V
+
+
+#define MINPOINTS   64      // initial array size per point type
+#define MAXVARIANTS 6       // per point type
+#define HDRSIZE     4       // response header (ac, fc, iin)
+#define OHDRSIZE    3       // object header (group, variation, qc)
+
+// value formats
+enum {
+    VAL_NONE,           // binaries, state is part of the flags
+    VAL_UINT16,
+    VAL_UINT32,
+    VAL_INT16,
+    VAL_INT32,
+    VAL_FLT32,
+    VAL_FLT64
+};
+
+struct Variant {
+    DNP3_Variation v;   // 0 if unused
+    bool flags;         // with flag octet; otherwise implies ONLINE
+    uint8_t value;      // VAL_*
+};
+
+struct TypeInfo {
+    DNP3_Group g;
+    struct Variant vs[MAXVARIANTS];
+};
+
+#define VAR(g, v, flags, val) {V(g, v), flags, VAL_##val}
+
+// the static variations of each point type
+static const struct TypeInfo types[DNP3_NPOINTTYPES] = {
+    [DNP3_POINT_BININ] = {G(BININ), {
+        VAR(BININ, PACKED,  false, NONE),
+        VAR(BININ, FLAGS,   true,  NONE)}},
+    [DNP3_POINT_DBLBITIN] = {G(DBLBITIN), {
+        VAR(DBLBITIN, PACKED,   false, NONE),
+        VAR(DBLBITIN, FLAGS,    true,  NONE)}},
+    [DNP3_POINT_BINOUT] = {G(BINOUT), {
+        VAR(BINOUT, PACKED, false, NONE),
+        VAR(BINOUT, FLAGS,  true,  NONE)}},
+    [DNP3_POINT_CTR] = {G(CTR), {
+        VAR(CTR, 32BIT,         true,  UINT32),
+        VAR(CTR, 16BIT,         true,  UINT16),
+        VAR(CTR, 32BIT_NOFLAG,  false, UINT32),
+        VAR(CTR, 16BIT_NOFLAG,  false, UINT16)}},
+    [DNP3_POINT_FROZENCTR] = {G(FROZENCTR), {
+        VAR(FROZENCTR, 32BIT,           true,  UINT32),
+        VAR(FROZENCTR, 16BIT,           true,  UINT16),
+        VAR(FROZENCTR, 32BIT_NOFLAG,    false, UINT32),
+        VAR(FROZENCTR, 16BIT_NOFLAG,    false, UINT16)}},
+    [DNP3_POINT_ANAIN] = {G(ANAIN), {
+        VAR(ANAIN, 32BIT,           true,  INT32),
+        VAR(ANAIN, 16BIT,           true,  INT16),
+        VAR(ANAIN, 32BIT_NOFLAG,    false, INT32),
+        VAR(ANAIN, 16BIT_NOFLAG,    false, INT16),
+        VAR(ANAIN, FLOAT,           true,  FLT32),
+        VAR(ANAIN, DOUBLE,          true,  FLT64)}},
+    [DNP3_POINT_FROZENANAIN] = {G(FROZENANAIN), {
+        VAR(FROZENANAIN, 32BIT,         true,  INT32),
+        VAR(FROZENANAIN, 16BIT,         true,  INT16),
+        VAR(FROZENANAIN, 32BIT_NOFLAG,  false, INT32),
+        VAR(FROZENANAIN, 16BIT_NOFLAG,  false, INT16),
+        VAR(FROZENANAIN, FLOAT,         true,  FLT32),
+        VAR(FROZENANAIN, DOUBLE,        true,  FLT64)}},
+    [DNP3_POINT_ANAOUTSTATUS] = {G(ANAOUTSTATUS), {
+        VAR(ANAOUTSTATUS, 32BIT,    true, INT32),
+        VAR(ANAOUTSTATUS, 16BIT,    true, INT16),
+        VAR(ANAOUTSTATUS, FLOAT,    true, FLT32),
+        VAR(ANAOUTSTATUS, DOUBLE,   true, FLT64)}}
+};
+
+#undef VAR
+
+struct Entry {
+    uint32_t index;
+    uint8_t mask;       // variants that can represent the point
+    size_t order;       // to keep the last of several values
+    DNP3_Point pt;
+};
+
+struct Points {
+    struct Entry *v;
+    size_t n;
+    size_t cap;
+};
+
+// a planned block, split further as needed to fit into fragments
+struct Plan {
+    DNP3_PointType type;
+    uint8_t var;        // index into types[type].vs
+    bool range;         // range or index-prefixed
+    size_t first;       // range: position of the first point
+    const size_t *pos;  // index-prefixed: positions of the points
+    size_t count;
+    uint8_t minwidth;   // of index prefixes
+};
+
+struct DNP3_ResponseBuilder_ {
+    HAllocator *mm;
+    size_t maxfrag;
+    size_t order;       // of the next point added
+    struct Points points[DNP3_NPOINTTYPES];
+
+    HArena *arena;      // result of the last build
+    DNP3_Fragment *frags;
+    size_t nfrags;
+};
+
+
+DNP3_ResponseBuilder *dnp3_response_builder__m(HAllocator *mm, size_t maxfrag)
+{
+    if(maxfrag < DNP3_MIN_FRAGSIZE)
+        return NULL;
+
+    DNP3_ResponseBuilder *b = mm->alloc(mm, sizeof(DNP3_ResponseBuilder));
+    if(!b) return NULL;
+
+    memset(b, 0, sizeof(DNP3_ResponseBuilder));
+    b->mm = mm;
+    b->maxfrag = maxfrag;
+
+    return b;
+}
+
+DNP3_ResponseBuilder *dnp3_response_builder(size_t maxfrag)
+{
+    return dnp3_response_builder__m(h_system_allocator, maxfrag);
+}
+
+static void clear_result(DNP3_ResponseBuilder *b)
+{
+    if(b->arena)
+        h_delete_arena(b->arena);
+    b->arena = NULL;
+    b->frags = NULL;
+    b->nfrags = 0;
+}
+
+void dnp3_response_reset(DNP3_ResponseBuilder *b)
+{
+    clear_result(b);
+    for(int t=0; t<DNP3_NPOINTTYPES; t++)
+        b->points[t].n = 0;
+    b->order = 0;
+}
+
+void dnp3_response_builder_free(DNP3_ResponseBuilder *b)
+{
+    HAllocator *mm = b->mm;
+
+    clear_result(b);
+    for(int t=0; t<DNP3_NPOINTTYPES; t++) {
+        if(b->points[t].v)
+            mm->free(mm, b->points[t].v);
+    }
+    mm->free(mm, b);
+}
+
+// the flags implied by packed variations and those without flags
+static bool online_only(DNP3_Flags f)
+{
+    return (f.online && !f.restart && !f.comm_lost && !f.remote_forced &&
+            !f.local_forced && !f.chatter_filter && !f.discontinuity &&
+            !f.over_range && !f.reference_err);
+}
+
+static bool value_fits(uint8_t format, double x)
+{
+    // NB: range checks first, out-of-range conversions are undefined
+    switch(format) {
+    case VAL_UINT16:    return (x >= 0 && x <= UINT16_MAX && x == (uint16_t)x);
+    case VAL_UINT32:    return (x >= 0 && x <= UINT32_MAX && x == (uint32_t)x);
+    case VAL_INT16:     return (x >= INT16_MIN && x <= INT16_MAX &&
+                                x == (int16_t)x);
+    case VAL_INT32:     return (x >= INT32_MIN && x <= INT32_MAX &&
+                                x == (int32_t)x);
+    case VAL_FLT32:     return (x >= -FLT_MAX && x <= FLT_MAX && x == (float)x);
+    default:            return true;
+    }
+}
+
+// size of a variant's objects in bits
+static size_t varbits(DNP3_PointType t, int i)
+{
+    return dnp3_wire_bits(types[t].g, types[t].vs[i].v);
+}
+
+static uint8_t point_mask(DNP3_PointType t, const DNP3_Point *pt)
+{
+    uint8_t mask = 0;
+
+    for(int i=0; i<MAXVARIANTS && types[t].vs[i].v; i++) {
+        const struct Variant *var = &types[t].vs[i];
+
+        if((var->flags || online_only(pt->flags)) &&
+           value_fits(var->value, pt->value))
+            mask |= 1 << i;
+    }
+
+    return mask;
+}
+
+// the variants used in the naive encoding: with flags, full-width values
+static uint8_t naive_mask(DNP3_PointType t)
+{
+    uint8_t mask = 0;
+
+    for(int i=0; i<MAXVARIANTS && types[t].vs[i].v; i++) {
+        const struct Variant *var = &types[t].vs[i];
+
+        if(var->flags && var->value != VAL_UINT16 && var->value != VAL_INT16)
+            mask |= 1 << i;
+    }
+
+    return mask;
+}
+
+// the smallest variant in mask, -1 if none. packed variants (less than a
+// byte per object) are only allowed in range blocks.
+static int best(DNP3_PointType t, uint8_t mask, bool packed)
+{
+    int res = -1;
+
+    for(int i=0; i<MAXVARIANTS && types[t].vs[i].v; i++) {
+        size_t bits = varbits(t, i);
+
+        if(!(mask >> i & 1) || (!packed && bits < 8))
+            continue;
+        if(res < 0 || bits < varbits(t, res))
+            res = i;
+    }
+
+    return res;
+}
+
+int dnp3_response_add(DNP3_ResponseBuilder *b, DNP3_PointType type,
+                      uint32_t index, const DNP3_Point *pt)
+{
+    if((unsigned)type >= DNP3_NPOINTTYPES)
+        return -1;
+
+    // the full-width variations must be able to hold the value
+    uint8_t mask = point_mask(type, pt);
+    if(!(mask & naive_mask(type)))
+        return -1;
+
+    struct Points *pts = &b->points[type];
+    if(pts->n == pts->cap) {
+        HAllocator *mm = b->mm;
+        size_t cap = pts->cap ? 2 * pts->cap : MINPOINTS;
+        struct Entry *v = pts->v ? mm->realloc(mm, pts->v, cap * sizeof *v)
+                                 : mm->alloc(mm, cap * sizeof *v);
+        if(!v)
+            return -1;
+        pts->v = v;
+        pts->cap = cap;
+    }
+
+    struct Entry *e = &pts->v[pts->n++];
+    e->index = index;
+    e->mask = mask;
+    e->order = b->order++;
+    e->pt = *pt;
+
+    return 0;
+}
+
+static int cmp_entry(const void *a_, const void *b_)
+{
+    const struct Entry *a = a_;
+    const struct Entry *b = b_;
+
+    if(a->index != b->index)
+        return (a->index < b->index) ? -1 : 1;
+    return (a->order < b->order) ? -1 : (a->order > b->order);
+}
+
+// sort points by index, keeping only the last value for each
+static void prepare(struct Points *pts)
+{
+    size_t i, n = 0;
+
+    if(pts->n == 0)
+        return;
+
+    qsort(pts->v, pts->n, sizeof(struct Entry), cmp_entry);
+    for(i=0; i+1<pts->n; i++) {
+        if(pts->v[i].index != pts->v[i+1].index)
+            pts->v[n++] = pts->v[i];
+    }
+    pts->v[n++] = pts->v[i];
+    pts->n = n;
+}
+
+// width of a range, count, or index field for the given value
+static size_t width(uint64_t x)
+{
+    return (x <= 0xFF) ? 1 : (x <= 0xFFFF) ? 2 : 4;
+}
+
+static const uint8_t range_qc[5] = {[1] = 0x00, [2] = 0x01, [4] = 0x02};
+static const uint8_t index_qc[5] = {[1] = 0x17, [2] = 0x28, [4] = 0x39};
+
+static const struct Entry *entry_at(const DNP3_ResponseBuilder *b,
+                                    const struct Plan *pb, size_t i)
+{
+    size_t k = pb->pos ? pb->pos[i] : pb->first + i;
+    return &b->points[pb->type].v[k];
+}
+
+// qualifier and size of the points [from,from+c) of a planned block
+static size_t piece_size(const DNP3_ResponseBuilder *b, const struct Plan *pb,
+                         size_t from, size_t c, uint8_t *qc)
+{
+    size_t bits = varbits(pb->type, pb->var);
+    size_t w = width(entry_at(b, pb, from + c - 1)->index);     // largest
+
+    assert(c > 0);
+    if(pb->range) {
+        *qc = range_qc[w];
+        return OHDRSIZE + 2 * w + (c * bits + 7) / 8;
+    }
+
+    // counts and index prefixes of the same width (qc=17,28,39)
+    if(width(c) > w)
+        w = width(c);
+    if(pb->minwidth > w)
+        w = pb->minwidth;
+    *qc = index_qc[w];
+    return OHDRSIZE + w + c * (w + bits / 8);
+}
+
+static size_t plan_size(const DNP3_ResponseBuilder *b, const struct Plan *pb)
+{
+    uint8_t qc;
+    return piece_size(b, pb, 0, pb->count, &qc);
+}
+
+// the end of the piece of points starting at s that can use the same
+// variants, up to e
+static size_t piece_end(const struct Points *ps, size_t s, size_t e)
+{
+    size_t k;
+
+    for(k=s+1; k<e && ps->v[k].mask == ps->v[s].mask; k++)
+        ;
+    return k;
+}
+
+// collect the points assigned to each variant (or -1) into lists in pos,
+// in index order. cnt gives the lengths of the lists, start their offsets.
+static void collect(const int8_t *assign, size_t n, const size_t cnt[],
+                    size_t start[], size_t *pos)
+{
+    size_t off[MAXVARIANTS];
+
+    start[0] = 0;
+    for(int i=1; i<MAXVARIANTS; i++)
+        start[i] = start[i-1] + cnt[i-1];
+    memcpy(off, start, sizeof off);
+
+    for(size_t k=0; k<n; k++) {
+        if(assign[k] >= 0)
+            pos[off[assign[k]]++] = k;
+    }
+}
+
+// plan the index-prefixed blocks of type t, for the points with a variant
+// in assign (which is updated)
+static size_t plan_lists(const DNP3_ResponseBuilder *b, DNP3_PointType t,
+                         HArena *arena, int8_t *assign, struct Plan *out)
+{
+    const struct Points *ps = &b->points[t];
+    size_t n = ps->n, np = 0;
+    size_t hdr = OHDRSIZE + width(ps->v[n-1].index);
+    size_t cnt[MAXVARIANTS] = {0};
+    size_t start[MAXVARIANTS];
+    uint8_t gmask[MAXVARIANTS];
+
+    memset(gmask, 0xFF, sizeof gmask);
+    for(size_t k=0; k<n; k++) {
+        if(assign[k] >= 0) {
+            cnt[assign[k]]++;
+            gmask[assign[k]] &= ps->v[k].mask;
+        }
+    }
+
+    // fold small lists into a wider variant that can hold their points
+    // where that costs less than a block header. smallest lists first.
+    for(;;) {
+        int src = -1, dst = -1;
+        size_t extra = 0;
+
+        for(int i=0; i<MAXVARIANTS; i++) {
+            if(cnt[i] == 0 || (src >= 0 && cnt[i] >= cnt[src]))
+                continue;
+            for(int j=0; j<MAXVARIANTS; j++) {
+                if(j == i || cnt[j] == 0 || !(gmask[i] >> j & 1) ||
+                   varbits(t, j) < varbits(t, i))
+                    continue;
+
+                size_t x = cnt[i] * (varbits(t, j) - varbits(t, i)) / 8;
+                if(x < hdr && (src != i || x < extra)) {
+                    src = i;
+                    dst = j;
+                    extra = x;
+                }
+            }
+        }
+        if(src < 0)
+            break;
+
+        for(size_t k=0; k<n; k++) {
+            if(assign[k] == src)
+                assign[k] = dst;
+        }
+        cnt[dst] += cnt[src];
+        cnt[src] = 0;
+        gmask[dst] &= gmask[src];
+    }
+
+    size_t *pos = h_arena_malloc(arena, n * sizeof(size_t));
+    collect(assign, n, cnt, start, pos);
+
+    for(int i=0; i<MAXVARIANTS; i++) {
+        const size_t *p = pos + start[i];
+        size_t from = 0;
+
+        if(cnt[i] == 0)
+            continue;
+
+        // split where the indexes grow wider if it saves more than a header
+        for(size_t k=1; k<cnt[i]; k++) {
+            if(width(ps->v[p[k]].index) == width(ps->v[p[k-1]].index))
+                continue;
+
+            struct Plan rest = {t, i, false, 0, p + from, cnt[i] - from, 0};
+            struct Plan lo = rest, hi = rest;
+            lo.count = k - from;
+            hi.pos = p + k;
+            hi.count = cnt[i] - k;
+            if(plan_size(b, &lo) + plan_size(b, &hi) < plan_size(b, &rest)) {
+                out[np++] = lo;
+                from = k;
+            }
+        }
+        out[np++] = (struct Plan){t, i, false, 0, p + from, cnt[i] - from, 0};
+    }
+
+    return np;
+}
+
+// plan the run of consecutive points [a,e): either the whole run in one
+// range block or each piece in the cheaper of a range block or an index list.
+// lists of the variants in shared are taken to exist anyway, others count
+// with their header. returns the number of range blocks put into out and the
+// variants of the lists used in *lists.
+static size_t plan_run(const DNP3_ResponseBuilder *b, DNP3_PointType t,
+                       size_t a, size_t e, size_t w, uint8_t shared,
+                       int8_t *assign, struct Plan *out, uint8_t *lists)
+{
+    const struct Points *ps = &b->points[t];
+    size_t np = 0, s, k;
+    uint8_t mask = ps->v[a].mask;
+
+    for(s=a+1; s<e; s++)
+        mask &= ps->v[s].mask;
+
+    // the whole run in one range block...
+    int var = best(t, mask, true);
+    assert(var >= 0);   // full-width variations fit all points
+    struct Plan whole = {t, var, true, a, NULL, e - a, 0};
+    size_t whole_size = plan_size(b, &whole);
+
+    // ...or in pieces
+    size_t pieces_size = 0;
+    uint8_t used = shared;
+    *lists = 0;
+    for(s=a; s<e; s=k) {
+        k = piece_end(ps, s, e);
+        mask = ps->v[s].mask;
+
+        int lvar = best(t, mask, false);
+        struct Plan r = {t, best(t, mask, true), true, s, NULL, k - s, 0};
+        size_t range = plan_size(b, &r);
+        size_t list = (k - s) * (w + varbits(t, lvar) / 8);
+        if(!(used >> lvar & 1))
+            list += OHDRSIZE + w;
+
+        if(range <= list) {
+            out[np++] = r;
+            memset(assign + s, -1, k - s);
+            pieces_size += range;
+        } else {
+            memset(assign + s, lvar, k - s);
+            used |= 1 << lvar;
+            *lists |= 1 << lvar;
+            pieces_size += list;
+        }
+    }
+
+    if(whole_size <= pieces_size) {
+        out[0] = whole;
+        memset(assign + a, -1, e - a);
+        *lists = 0;
+        return 1;
+    }
+    return np;
+}
+
+// plan the blocks for the points of type t, see the top of this file.
+// out must have room for one block per point plus three per variant.
+static size_t plan_type(const DNP3_ResponseBuilder *b, DNP3_PointType t,
+                        HArena *arena, struct Plan *out)
+{
+    const struct Points *ps = &b->points[t];
+    size_t n = ps->n, np = 0;
+    size_t a, e;
+    uint8_t lists;
+
+    if(n == 0)
+        return 0;
+
+    // variant of each point in the index-prefixed blocks, -1 if in a range
+    int8_t *assign = h_arena_malloc(arena, n);
+    size_t w = width(ps->v[n-1].index);     // estimated index prefix size
+
+    // which lists would be shared by several runs? a list used by just one
+    // run must pay for its header there.
+    size_t users[MAXVARIANTS] = {0};
+    uint8_t shared = 0;
+    for(a=0; a<n; a=e) {
+        for(e=a+1; e<n && ps->v[e].index == ps->v[e-1].index + 1; e++)
+            ;
+        plan_run(b, t, a, e, w, 0xFF, assign, out, &lists);
+        for(int i=0; i<MAXVARIANTS; i++)
+            users[i] += lists >> i & 1;
+    }
+    for(int i=0; i<MAXVARIANTS; i++) {
+        if(users[i] > 1)
+            shared |= 1 << i;
+    }
+
+    for(a=0; a<n; a=e) {
+        for(e=a+1; e<n && ps->v[e].index == ps->v[e-1].index + 1; e++)
+            ;
+        np += plan_run(b, t, a, e, w, shared, assign, out + np, &lists);
+    }
+
+    return np + plan_lists(b, t, arena, assign, out + np);
+}
+
+// plan the naive encoding of the points of type t (one block per variant)
+static size_t plan_naive(const DNP3_ResponseBuilder *b, DNP3_PointType t,
+                         HArena *arena, struct Plan *out)
+{
+    const struct Points *ps = &b->points[t];
+    size_t n = ps->n, np = 0;
+    size_t cnt[MAXVARIANTS] = {0};
+    size_t start[MAXVARIANTS];
+
+    if(n == 0)
+        return 0;
+
+    int8_t *assign = h_arena_malloc(arena, n);
+    size_t *pos = h_arena_malloc(arena, n * sizeof(size_t));
+    for(size_t k=0; k<n; k++) {
+        assign[k] = best(t, ps->v[k].mask & naive_mask(t), false);
+        assert(assign[k] >= 0);
+        cnt[assign[k]]++;
+    }
+    collect(assign, n, cnt, start, pos);
+
+    for(int i=0; i<MAXVARIANTS; i++) {
+        if(cnt[i] > 0)
+            out[np++] = (struct Plan){t, i, false, 0, pos + start[i], cnt[i], 2};
+    }
+
+    return np;
+}
+
+static DNP3_Object make_object(DNP3_PointType t, const struct Variant *var,
+                               const DNP3_Point *pt)
+{
+    DNP3_Object o;
+
+    memset(&o, 0, sizeof o);
+    switch(var->value) {
+    case VAL_NONE:
+        if(var->flags)
+            o.flags = pt->flags;
+        else if(t == DNP3_POINT_DBLBITIN)
+            o.dblbit = pt->flags.state;
+        else
+            o.bit = pt->flags.state;
+        break;
+    case VAL_UINT16:
+    case VAL_UINT32:
+        o.ctr.flags = pt->flags;
+        o.ctr.value = pt->value;
+        break;
+    case VAL_INT16:
+    case VAL_INT32:
+        o.ana.flags = pt->flags;
+        o.ana.sint = pt->value;
+        break;
+    default:
+        o.ana.flags = pt->flags;
+        o.ana.flt = pt->value;
+    }
+
+    return o;
+}
+
+// splitting planned blocks into fragments...
+
+struct Layout {
+    size_t maxfrag;
+    size_t room;                // left in the current fragment
+    size_t nfrags;
+    size_t nblocks;
+    size_t bytes;
+
+    // output, NULL when only sizing
+    DNP3_Fragment *frags;
+    DNP3_ObjectBlock **odata;   // for all fragments
+    DNP3_ObjectBlock *blocks;
+    HArena *arena;
+};
+
+static void new_fragment(struct Layout *l)
+{
+    if(l->frags) {
+        DNP3_Fragment *frag = &l->frags[l->nfrags];
+
+        memset(frag, 0, sizeof(DNP3_Fragment));
+        frag->fc = DNP3_RESPONSE;
+        frag->odata = l->odata + l->nblocks;
+    }
+
+    l->nfrags++;
+    l->bytes += HDRSIZE;
+    l->room = l->maxfrag - HDRSIZE;
+}
+
+static bool emit_piece(const DNP3_ResponseBuilder *b, struct Layout *l,
+                       const struct Plan *pb, size_t from, size_t c,
+                       uint8_t qc)
+{
+    const struct Variant *var = &types[pb->type].vs[pb->var];
+    DNP3_ObjectBlock *ob = &l->blocks[l->nblocks];
+
+    memset(ob, 0, sizeof(DNP3_ObjectBlock));
+    ob->group = types[pb->type].g;
+    ob->variation = var->v;
+    ob->count = c;
+    ob->prefixcode = qc >> 4;
+    ob->rangespec = qc & 0xF;
+    ob->objects = h_arena_malloc(l->arena, c * sizeof(DNP3_Object));
+    if(!ob->objects)
+        return false;
+
+    if(pb->range) {
+        ob->range_base = entry_at(b, pb, from)->index;
+    } else {
+        ob->indexes = h_arena_malloc(l->arena, c * sizeof(uint32_t));
+        if(!ob->indexes)
+            return false;
+    }
+
+    for(size_t i=0; i<c; i++) {
+        const struct Entry *e = entry_at(b, pb, from + i);
+
+        ob->objects[i] = make_object(pb->type, var, &e->pt);
+        if(ob->indexes)
+            ob->indexes[i] = e->index;
+    }
+
+    l->odata[l->nblocks] = ob;
+    l->frags[l->nfrags - 1].nblocks++;
+    return true;
+}
+
+static bool layout(const DNP3_ResponseBuilder *b, struct Layout *l,
+                   const struct Plan *plans, size_t nplans)
+{
+    uint8_t qc;
+
+    new_fragment(l);
+    for(size_t i=0; i<nplans; i++) {
+        const struct Plan *pb = &plans[i];
+        size_t from = 0;
+
+        while(from < pb->count) {
+            size_t c = pb->count - from;
+            size_t size = piece_size(b, pb, from, c, &qc);
+
+            if(size > l->room) {
+                // largest piece that fits
+                size_t lo = 0, hi = c;
+                while(lo < hi) {
+                    size_t mid = (lo + hi + 1) / 2;
+                    if(piece_size(b, pb, from, mid, &qc) <= l->room)
+                        lo = mid;
+                    else
+                        hi = mid - 1;
+                }
+                if(lo == 0) {
+                    // cf. DNP3_MIN_FRAGSIZE
+                    assert(l->room < l->maxfrag - HDRSIZE);
+                    new_fragment(l);
+                    continue;
+                }
+                c = lo;
+                size = piece_size(b, pb, from, c, &qc);
+            }
+
+            if(l->frags && !emit_piece(b, l, pb, from, c, qc))
+                return false;
+            l->nblocks++;
+            l->room -= size;
+            l->bytes += size;
+            from += c;
+        }
+    }
+
+    return true;
+}
+
+size_t dnp3_response_build(DNP3_ResponseBuilder *b, DNP3_BuildStats *stats)
+{
+    size_t n = 0, nplans = 0, nnaive = 0;
+
+    clear_result(b);
+    b->arena = h_new_arena(b->mm, 0);
+    if(!b->arena)
+        return 0;
+
+    for(int t=0; t<DNP3_NPOINTTYPES; t++) {
+        prepare(&b->points[t]);
+        n += b->points[t].n;
+    }
+
+    // plan the blocks
+    struct Plan *plans = h_arena_malloc(b->arena, (n + DNP3_NPOINTTYPES *
+                                        3 * MAXVARIANTS) * sizeof(struct Plan));
+    struct Plan *naive = h_arena_malloc(b->arena, DNP3_NPOINTTYPES *
+                                        MAXVARIANTS * sizeof(struct Plan));
+    if(!plans || !naive)
+        goto fail;
+    for(int t=0; t<DNP3_NPOINTTYPES; t++) {
+        nplans += plan_type(b, t, b->arena, plans + nplans);
+        nnaive += plan_naive(b, t, b->arena, naive + nnaive);
+    }
+
+    // size both, then lay out the fragments for real
+    struct Layout ln = {b->maxfrag};
+    struct Layout ls = {b->maxfrag};
+    layout(b, &ln, naive, nnaive);
+    layout(b, &ls, plans, nplans);
+
+    struct Layout l = {b->maxfrag};
+    l.arena = b->arena;
+    l.frags = h_arena_malloc(b->arena, ls.nfrags * sizeof(DNP3_Fragment));
+    l.odata = h_arena_malloc(b->arena,
+                             ls.nblocks * sizeof(DNP3_ObjectBlock *) + 1);
+    l.blocks = h_arena_malloc(b->arena,
+                              ls.nblocks * sizeof(DNP3_ObjectBlock) + 1);
+    if(!l.frags || !l.odata || !l.blocks)
+        goto fail;
+    if(!layout(b, &l, plans, nplans))
+        goto fail;
+    assert(l.nfrags == ls.nfrags && l.bytes == ls.bytes);
+
+    l.frags[0].ac.fir = 1;
+    l.frags[l.nfrags - 1].ac.fin = 1;
+    b->frags = l.frags;
+    b->nfrags = l.nfrags;
+
+    if(stats) {
+        stats->nfragments = l.nfrags;
+        stats->nblocks = l.nblocks;
+        stats->bytes = l.bytes;
+        stats->naive_bytes = ln.bytes;
+        stats->saved = (ln.bytes > l.bytes) ? ln.bytes - l.bytes : 0;
+    }
+    return b->nfrags;
+
+fail:
+    clear_result(b);
+    return 0;
+}
+
+DNP3_Fragment *dnp3_response_fragment(DNP3_ResponseBuilder *b, size_t i)
+{
+    return (i < b->nfrags) ? &b->frags[i] : NULL;
+}
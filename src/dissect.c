@@ -2,12 +2,14 @@
 #include <hammer/hammer.h>
 #include <hammer/glue.h>
 #include "hammer.h"
+#include "util.h"
 
 #include <string.h>
 #include <stdlib.h>
 
 
 #define BUFLEN 4619 // enough for 4096B over 1 frame or 355 empty segments
+                    // (also the default size of the input buffer)
 #define CTXMAX 1024 // maximum number of connection contexts
 #define TBUFLEN (BUFLEN/13*2)   // 13 = min. size of a frame
                                 // 2  = max. number of tokens per frame
@@ -15,11 +17,24 @@
 
 // internal data structures
 
+// a previously parsed application fragment
+struct CacheEntry {
+    struct CacheEntry *next;    // most recently used first
+
+    uint32_t hash;
+    uint8_t *payload;           // copy of the input, sequence number masked
+    size_t len;
+    const DNP3_Fragment *fragment;  // shared (see below), NULL on error
+    HTokenType err;             // error token type if fragment is NULL
+    size_t size;                // memory accounted to this entry
+};
+
 struct Context {
     struct Context *next;
 
     uint16_t src;
     uint16_t dst;
+    uint8_t dir;            // of the last frame, 1 = master to outstation
 
     // transport function
     DNP3_Segment last_segment;
@@ -30,12 +45,31 @@ struct Context {
     // raw valid frames
     uint8_t buf[BUFLEN];
     size_t n;
+
+    // fragment cache
+    struct CacheEntry *cache;   // linked list
+    size_t ncache;
+};
+
+// events collected for the batch callback over one call to feed()
+struct Batch {
+    DNP3_BatchFrame *frames;
+    size_t nframes, maxframes;
+    DNP3_BatchSegment *segments;
+    size_t nsegments, maxsegments;
+    DNP3_BatchPayload *payloads;
+    size_t npayloads, maxpayloads;
+    DNP3_BatchFragment *fragments;
+    size_t nfragments, maxfragments;
+
+    HArena *arena;              // copies of payloads and raw frames
 };
 
 typedef struct {
     StreamProcessor base;
     uint8_t *buf;               // input buffer
     size_t bufsize;
+    size_t start, end;          // pending input is buf[start..end)
     struct Context *contexts;   // linked list
 
     // callbacks
@@ -47,11 +81,27 @@ typedef struct {
     HAllocator *mm_parse;
     HAllocator *mm_context;
     HAllocator *mm_results;
+
+    // fragment cache configuration
+    size_t cache_max;           // max. number of entries per context
+    size_t cache_maxbytes;      // max. total memory
+
+    unsigned pack;              // layout of result fragments (DNP3_PACK_*)
+    DNP3_Interest *interest;    // objects to decode, NULL for all
+    HParser *fragment_parser;   // according to pack and interest
+
+    struct Batch batch;         // if cb.batch is set
+
+    DNP3_Tracker *tracker;      // NULL if unused
+    DNP3_Assembler *assembler;  // NULL if unused
+    DNP3_AuthEngine *auth;      // NULL if unused
+    uint64_t now;               // time of the input
+
+    DNP3_DissectorStats stats;
 } Dissector;
 
 
 // high-level parsers  XXX should these be exported?!
-HParser *dnp3_p_synced_frame;       // skips bytes until valid frame header
 HParser *dnp3_p_transport_function; // the transport-layer state machine
 
 
@@ -209,11 +259,6 @@ static HParser *ttok(const HParser *p)
 
 void dnp3_dissector_init(void)
 {
-    HParser *sync = h_indirect();
-    H_RULE(sync_, h_choice(dnp3_p_link_frame, h_right(h_uint8(), sync), NULL));
-        // XXX is it correct to skip one byte looking for the frame start?
-    h_bind_indirect(sync, sync_);
-
     H_ARULE(ptr,    h_bits(sizeof(void *) * 8, false));
     p_ptr = ptr;
 
@@ -241,7 +286,6 @@ void dnp3_dissector_init(void)
     int tfun_compile = !h_compile(tfun, PB_LALR, NULL);
     assert(tfun_compile);
 
-    dnp3_p_synced_frame = sync;
     dnp3_p_transport_function = tfun;
 }
 
@@ -287,6 +331,295 @@ HParseResult *feed_tfun(Dissector *self,
     return r;
 }
 
+// fragment cache...
+
+// FNV-1a over the payload, with the sequence number masked out
+static uint32_t payload_hash(const uint8_t *t, size_t len)
+{
+    uint32_t h = 2166136261u;
+
+    for(size_t i=0; i<len; i++) {
+        h ^= (i == 0) ? (t[i] & 0xF0) : t[i];
+        h *= 16777619u;
+    }
+
+    return h;
+}
+
+static bool payload_equal(const struct CacheEntry *e,
+                          const uint8_t *t, size_t len)
+{
+    return (e->len == len &&
+            e->payload[0] == (t[0] & 0xF0) &&
+            memcmp(e->payload + 1, t + 1, len - 1) == 0);
+}
+
+static void free_cache_entry(Dissector *self, struct CacheEntry *e)
+{
+    self->stats.cache_bytes -= e->size;
+    if(e->fragment)
+        dnp3_fragment_release(e->fragment);
+    self->mm_context->free(self->mm_context, e->payload);
+    self->mm_context->free(self->mm_context, e);
+}
+
+// drop the least recently used entry of the given context
+static void evict_cache_entry(Dissector *self, struct Context *ctx)
+{
+    struct CacheEntry **pnext = &ctx->cache;
+
+    assert(*pnext != NULL);
+    while((*pnext)->next)
+        pnext = &(*pnext)->next;
+
+    free_cache_entry(self, *pnext);
+    *pnext = NULL;
+    ctx->ncache--;
+    self->stats.cache_evictions++;
+}
+
+static void flush_cache(Dissector *self, struct Context *ctx)
+{
+    struct CacheEntry *e;
+
+    while((e = ctx->cache)) {
+        ctx->cache = e->next;
+        free_cache_entry(self, e);
+    }
+    ctx->ncache = 0;
+}
+
+static struct CacheEntry *lookup_cache(Dissector *self, struct Context *ctx,
+                                       uint32_t hash,
+                                       const uint8_t *t, size_t len)
+{
+    struct CacheEntry **pnext;
+    struct CacheEntry *e;
+
+    for(pnext=&ctx->cache; (e = *pnext); pnext=&e->next) {
+        if(e->hash == hash && payload_equal(e, t, len)) {
+            *pnext = e->next;           // unlink
+            e->next = ctx->cache;       // move to front of list
+            ctx->cache = e;
+
+            self->stats.cache_hits++;
+            return e;
+        }
+    }
+
+    self->stats.cache_misses++;
+    return NULL;
+}
+
+// store a parse result in the cache, evicting old entries as necessary.
+// the result is either a shared fragment, of which the cache takes a
+// reference, or an error (frag = NULL).
+static void insert_cache(Dissector *self, struct Context *ctx, uint32_t hash,
+                         const uint8_t *t, size_t len,
+                         HTokenType err, const DNP3_Fragment *frag)
+{
+    size_t size = sizeof(struct CacheEntry) + len;
+    if(frag)
+        size += dnp3_fragment_size(frag, 0);    // already packed
+
+    // make room
+    if(ctx->ncache >= self->cache_max && ctx->cache)
+        evict_cache_entry(self, ctx);
+    while(self->stats.cache_bytes + size > self->cache_maxbytes && ctx->cache)
+        evict_cache_entry(self, ctx);
+    if(self->stats.cache_bytes + size > self->cache_maxbytes)
+        return;
+
+    HAllocator *mm = self->mm_context;
+    struct CacheEntry *e = mm->alloc(mm, sizeof(struct CacheEntry));
+    if(!e)
+        return;
+    e->payload = mm->alloc(mm, len);
+    if(!e->payload) {
+        mm->free(mm, e);
+        return;
+    }
+    e->fragment = frag ? dnp3_fragment_retain(frag) : NULL;
+    e->err = err;
+
+    memcpy(e->payload, t, len);
+    e->payload[0] &= 0xF0;
+    e->len = len;
+    e->hash = hash;
+    e->size = size;
+
+    e->next = ctx->cache;
+    ctx->cache = e;
+    ctx->ncache++;
+    self->stats.cache_bytes += size;
+}
+
+// batched events...
+
+// make room for one more element in an array, returns false on failure
+static bool grow(HAllocator *mm, void **arr, size_t n, size_t *max,
+                 size_t size)
+{
+    if(n < *max)
+        return true;
+
+    size_t m = *max ? 2 * *max : 16;
+    void *p = *arr ? mm->realloc(mm, *arr, m * size)
+                   : mm->alloc(mm, m * size);
+    if(!p)
+        return false;
+    *arr = p;
+    *max = m;
+    return true;
+}
+
+#define GROW(self, A) \
+    grow((self)->mm_context, (void **)&(self)->batch.A, (self)->batch.n##A, \
+         &(self)->batch.max##A, sizeof(*(self)->batch.A))
+
+// copy the given bytes into the batch arena
+static uint8_t *batch_copy(Dissector *self, const uint8_t *buf, size_t len)
+{
+    if(!buf)
+        return NULL;
+
+    if(!self->batch.arena) {
+        self->batch.arena = h_new_arena(self->mm_parse, 0);
+        if(!self->batch.arena)
+            return NULL;
+    }
+
+    uint8_t *copy = h_arena_malloc(self->batch.arena, len);
+    if(copy)
+        memcpy(copy, buf, len);
+    return copy;
+}
+
+static void batch_frame(Dissector *self, const DNP3_Frame *frame,
+                        const uint8_t *buf, size_t len, bool invalid)
+{
+    if(!GROW(self, frames)) {
+        error("out of memory for batch\n");
+        return;
+    }
+
+    DNP3_BatchFrame *e = &self->batch.frames[self->batch.nframes++];
+    e->frame = *frame;
+    e->frame.payload = batch_copy(self, frame->payload,
+                                  frame->len > 0 ? frame->len : 0);
+    e->buf = buf;   // in the input buffer, valid until the end of feed()
+    e->len = len;
+    e->invalid = invalid;
+}
+
+static void batch_segment(Dissector *self, const DNP3_Segment *segment)
+{
+    if(!GROW(self, segments)) {
+        error("out of memory for batch\n");
+        return;
+    }
+
+    DNP3_BatchSegment *e = &self->batch.segments[self->batch.nsegments++];
+    e->segment = *segment;
+    e->segment.payload = batch_copy(self, segment->payload, segment->len);
+    e->frame = self->batch.nframes - 1;
+}
+
+// buf = NULL for n discarded bytes
+static void batch_payload(Dissector *self, const uint8_t *buf, size_t n)
+{
+    if(!GROW(self, payloads)) {
+        error("out of memory for batch\n");
+        return;
+    }
+
+    DNP3_BatchPayload *e = &self->batch.payloads[self->batch.npayloads++];
+    e->buf = batch_copy(self, buf, n);
+    e->len = (e->buf || !buf) ? n : 0;
+    e->segment = self->batch.nsegments - 1;
+}
+
+// frag = NULL for an invalid fragment
+static void batch_fragment(Dissector *self, struct Context *ctx,
+                           const DNP3_Fragment *frag, DNP3_ParseError err,
+                           bool unchanged)
+{
+    if(!GROW(self, fragments)) {
+        error("out of memory for batch\n");
+        return;
+    }
+
+    DNP3_BatchFragment *e = &self->batch.fragments[self->batch.nfragments++];
+    e->fragment = frag ? dnp3_fragment_retain(frag) : NULL;
+    e->err = err;
+    e->unchanged = unchanged;
+    e->buf = batch_copy(self, ctx->buf, ctx->n);
+    e->len = e->buf ? ctx->n : 0;
+    e->segment = self->batch.nsegments - 1;
+    e->payload = self->batch.npayloads - 1;
+}
+
+// pass the collected events to the batch callback and reset
+static void flush_batch(Dissector *self)
+{
+    struct Batch *b = &self->batch;
+
+    if(b->nframes == 0 && b->nsegments == 0 && b->npayloads == 0 &&
+       b->nfragments == 0)
+        return;
+
+    DNP3_Batch batch = {
+        b->frames, b->nframes,
+        b->segments, b->nsegments,
+        b->fragments, b->nfragments,
+        b->payloads, b->npayloads
+    };
+    CALLBACK(batch, &batch);
+
+    for(size_t i=0; i<b->nfragments; i++) {
+        if(b->fragments[i].fragment)
+            dnp3_fragment_release(b->fragments[i].fragment);
+    }
+    b->nframes = b->nsegments = b->npayloads = b->nfragments = 0;
+    if(b->arena) {
+        h_delete_arena(b->arena);
+        b->arena = NULL;
+    }
+}
+
+// report a parsed fragment, individually or as part of the batch
+static void emit_fragment(Dissector *self, struct Context *ctx,
+                          const DNP3_Fragment *frag, bool unchanged)
+{
+    uint32_t assoc = ctx->dir ? dnp3_association(ctx->dst, ctx->src)
+                              : dnp3_association(ctx->src, ctx->dst);
+    if(self->tracker &&
+       dnp3_tracker_update(self->tracker, assoc, ctx->dir, self->now, frag) < 0)
+        error("out of memory for transaction tracking\n");
+    if(self->assembler && !ctx->dir &&
+       dnp3_assembler_update(self->assembler, assoc, self->now, frag) < 0)
+        error("out of memory for response assembly\n");
+    if(self->auth)
+        dnp3_auth_update(self->auth, assoc, ctx->dir, self->now,
+                         ctx->buf, ctx->n, frag);
+
+    if(self->cb.batch)
+        batch_fragment(self, ctx, frag, 0, unchanged);
+    else if(unchanged && self->cb.app_unchanged)
+        CALLBACK(app_unchanged, frag, ctx->buf, ctx->n);
+    else
+        CALLBACK(app_fragment, frag, ctx->buf, ctx->n);
+}
+
+static void emit_invalid(Dissector *self, struct Context *ctx,
+                         DNP3_ParseError err)
+{
+    if(self->cb.batch)
+        batch_fragment(self, ctx, NULL, err, false);
+    else
+        CALLBACK(app_invalid, err);
+}
+
 // allocates up to CTXMAX contexts, or recycles the least recently used
 static
 struct Context *lookup_context(Dissector *self, uint16_t src, uint16_t dst)
@@ -332,6 +665,7 @@ struct Context *lookup_context(Dissector *self, uint16_t src, uint16_t dst)
 
         ctx->n = 0;
         reset_tfun(ctx);
+        flush_cache(self, ctx);
 
         ctx->next = self->contexts;
         ctx->src = src;
@@ -346,21 +680,73 @@ static
 void process_transport_payload(Dissector *self, struct Context *ctx,
                                const uint8_t *t, size_t len)
 {
-    CALLBACK(transport_payload, t, len);
+    if(self->cb.batch)
+        batch_payload(self, t, len);
+    else
+        CALLBACK(transport_payload, t, len);
+
+    // check for a repeated payload
+    bool cache = (self->cache_max > 0 && len > 0);
+    uint32_t hash = 0;
+    if(cache) {
+        hash = payload_hash(t, len);
+
+        struct CacheEntry *e = lookup_cache(self, ctx, hash, t, len);
+        if(e) {
+            if(!e->fragment) {
+                emit_invalid(self, ctx, e->err);
+                return;
+            }
+
+            // the cached fragment differs at most in the sequence number.
+            // fragments are read-only once handed out, so a different
+            // sequence number needs a fresh copy; it replaces the cached one.
+            uint8_t seq = t[0] & 0x0F;
+            if(e->fragment->ac.seq != seq) {
+                DNP3_Fragment *copy =
+                    dnp3_fragment_share__m(self->mm_results, e->fragment, 0);
+                if(!copy) {
+                    error("out of memory for fragment\n");
+                    return;
+                }
+                copy->ac.seq = seq;
+                dnp3_fragment_release(e->fragment);
+                e->fragment = copy;
+            }
+
+            emit_fragment(self, ctx, e->fragment, true);
+            return;
+        }
+    }
 
     // try to parse a message fragment
-    HParseResult *r = h_parse__m(self->mm_parse, dnp3_p_app_fragment, t, len);
+    HParseResult *r = h_parse__m(self->mm_parse, self->fragment_parser, t, len);
     if(r) {
         assert(r->ast != NULL);
-        if(H_ISERR(r->ast->token_type)) {
-            CALLBACK(app_invalid, r->ast->token_type);
-        } else {
-            DNP3_Fragment *fragment = H_CAST(DNP3_Fragment, r->ast);    // XXX copy to result mem
-            CALLBACK(app_fragment, fragment, ctx->buf, ctx->n);
+        HTokenType tt = r->ast->token_type;
+        DNP3_Fragment *fragment = NULL;
+
+        // move the fragment out of the parse arena into result memory
+        if(!H_ISERR(tt)) {
+            fragment = dnp3_fragment_share__m(self->mm_results,
+                                              H_CAST(DNP3_Fragment, r->ast),
+                                              self->pack);
+            if(!fragment)
+                error("out of memory for fragment\n");
         }
         h_parse_result_free(r);
+
+        if(H_ISERR(tt)) {
+            emit_invalid(self, ctx, tt);
+        } else if(fragment) {
+            emit_fragment(self, ctx, fragment, false);
+        }
+        if(cache && (fragment || H_ISERR(tt)))
+            insert_cache(self, ctx, hash, t, len, tt, fragment);
+        if(fragment)
+            dnp3_fragment_release(fragment);
     } else {
-        CALLBACK(app_invalid, 0);
+        emit_invalid(self, ctx, 0);
     }
 }
 
@@ -381,7 +767,10 @@ void process_transport_segment(Dissector *self,
     size_t n;
     HParseResult *r;
 
-    CALLBACK(transport_segment, segment);
+    if(self->cb.batch)
+        batch_segment(self, segment);
+    else
+        CALLBACK(transport_segment, segment);
 
     // convert to input tokens for transport function
     n = transport_tokens(segment, &ctx->last_segment, buf);
@@ -405,6 +794,8 @@ void process_transport_segment(Dissector *self,
         if(r->ast) {
             HBytes b = H_CAST_BYTES(r->ast);
             process_transport_payload(self, ctx, b.token, b.len);
+        } else if(self->cb.batch) {
+            batch_payload(self, NULL, ctx->n);
         } else {
             CALLBACK(transport_discard, ctx->n);
         }
@@ -425,11 +816,16 @@ void process_link_frame(Dissector *self,
     HParseResult *r;
 
     if(!dnp3_link_validate_frame(frame)) {
-        CALLBACK(link_invalid, frame);
+        if(self->cb.batch)
+            batch_frame(self, frame, buf, len, true);
+        else
+            CALLBACK(link_invalid, frame);
         return;
     }
 
-    if(CALLBACK(link_frame, frame, buf, len) != 0)
+    if(self->cb.batch)
+        batch_frame(self, frame, buf, len, false);
+    else if(CALLBACK(link_frame, frame, buf, len) != 0)
         return;
 
     // payload handling
@@ -444,6 +840,7 @@ void process_link_frame(Dissector *self,
             error("connection context failed to allocate\n");
             break;
         }
+        ctx->dir = frame->dir;
 
         // parse and process payload as transport segment
         r = h_parse__m(self->mm_parse, dnp3_p_transport_segment,
@@ -476,32 +873,78 @@ void process_link_frame(Dissector *self,
     }
 }
 
+// position of the next possible frame start (0x05 0x64) in buf[i..n), or n.
+// a 0x05 in the last position may still become one.
+static size_t frame_start(const uint8_t *buf, size_t i, size_t n)
+{
+    const uint8_t *p;
+
+    while(i < n && (p = memchr(buf + i, 0x05, n - i))) {
+        i = p - buf;
+        if(i + 1 == n || buf[i + 1] == 0x64)
+            return i;
+        i++;
+    }
+    return n;
+}
+
 static int dissector_feed(StreamProcessor *base, size_t n)
 {
     Dissector *self = (Dissector *)base;
     HParseResult *r;
-    size_t m=0;
+    size_t m = self->start;
+    size_t k = m;
+
+    assert(n <= base->bufsize);
+    self->end += n;
 
-    // parse and process link layer frames
+    // parse and process link layer frames, skipping bytes in between.
+    // NB: the search is a loop, not a parser; a recursive skip would nest
+    //     once per byte of junk and could exhaust the stack on large input.
     HAllocator *mm = self->mm_parse;
-    while((r = h_parse__m(mm, dnp3_p_synced_frame, base->buf+m, n-m))) {
+    while((k = frame_start(self->buf, k, self->end)) < self->end) {
+        r = h_parse__m(mm, dnp3_p_link_frame, self->buf+k, self->end-k);
+        if(!r) {
+            k++;    // incomplete or invalid, look further
+            continue;
+        }
+
         size_t consumed = r->bit_length/8;
         assert(r->bit_length%8 == 0);
         assert(consumed > 0);
         assert(r->ast);
 
+        // raw input includes the skipped bytes, if any
         process_link_frame(self, H_CAST(DNP3_Frame, r->ast),    // XXX copy to result mem
-                           base->buf+m, consumed);
+                           self->buf+m, k-m + consumed);
         h_parse_result_free(r);
 
-        m += consumed;
+        m = k = k + consumed;
     }
 
-    // flush consumed input
-    n -= m;
-    memmove(self->buf, base->buf+m, n);
-    base->buf = self->buf + n;
-    base->bufsize = BUFLEN - n;
+    // a valid frame starting further back would be complete and have
+    // parsed, so only the rest needs to be kept
+    if(self->end - m >= DNP3_MAX_FRAME)
+        m = self->end - (DNP3_MAX_FRAME - 1);
+
+    base->consumed = m - self->start;
+    self->start = m;
+
+    // deliver batched events while the input is still in place
+    flush_batch(self);
+
+    // input is appended until less than half of the buffer is left, then
+    // the pending bytes (less than a frame) are moved to the front
+    size_t pending = self->end - self->start;
+    if(pending == 0) {
+        self->start = self->end = 0;
+    } else if(self->bufsize - self->end < self->bufsize / 2) {
+        memmove(self->buf, self->buf + self->start, pending);
+        self->start = 0;
+        self->end = pending;
+    }
+    base->buf = self->buf + self->end;
+    base->bufsize = self->bufsize - self->end;
 
     return 0;
 }
@@ -514,34 +957,60 @@ static int dissector_finish(StreamProcessor *base)
     struct Context *p;
     while((p = self->contexts)) {
         self->contexts = p->next;
+        flush_cache(self, p);
         self->mm_context->free(self->mm_context, p);
     }
 
+    // free batch arrays
+    flush_batch(self);
+    if(self->batch.frames)
+        self->mm_context->free(self->mm_context, self->batch.frames);
+    if(self->batch.segments)
+        self->mm_context->free(self->mm_context, self->batch.segments);
+    if(self->batch.payloads)
+        self->mm_context->free(self->mm_context, self->batch.payloads);
+    if(self->batch.fragments)
+        self->mm_context->free(self->mm_context, self->batch.fragments);
+
     // free input buffer
     self->mm_input->free(self->mm_input, self->buf);
 
+    free(self->interest);
+
     free(self);
     return 0;
 }
 
-StreamProcessor *dnp3_dissector__m(HAllocator *mm_input,
-                                   HAllocator *mm_parse,
-                                   HAllocator *mm_context,
-                                   HAllocator *mm_results,
-                                   DNP3_Callbacks cb, void *env)
+StreamProcessor *dnp3_dissector_sized__m(HAllocator *mm_input,
+                                         HAllocator *mm_parse,
+                                         HAllocator *mm_context,
+                                         HAllocator *mm_results,
+                                         size_t bufsize,
+                                         DNP3_Callbacks cb, void *env)
 {
+    if(bufsize == 0)
+        bufsize = BUFLEN;
+    if(bufsize < DNP3_MIN_BUFSIZE)
+        return NULL;
+
     Dissector *p = malloc(sizeof(Dissector));
     if(!p) return NULL;
 
-    uint8_t *buf = mm_input->alloc(mm_input, BUFLEN);
-    if(!buf) return NULL;
+    uint8_t *buf = mm_input->alloc(mm_input, bufsize);
+    if(!buf) {
+        free(p);
+        return NULL;
+    }
 
     p->base.buf     = buf;
-    p->base.bufsize = BUFLEN;
+    p->base.bufsize = bufsize;
     p->base.feed    = dissector_feed;
     p->base.finish  = dissector_finish;
+    p->base.consumed = 0;
     p->buf          = buf;
-    p->bufsize      = BUFLEN;
+    p->bufsize      = bufsize;
+    p->start        = 0;
+    p->end          = 0;
     p->contexts     = NULL;
     p->cb           = cb;
     p->env          = env;
@@ -549,16 +1018,142 @@ StreamProcessor *dnp3_dissector__m(HAllocator *mm_input,
     p->mm_parse     = mm_parse;
     p->mm_context   = mm_context;
     p->mm_results   = mm_results;
+    p->cache_max    = 0;
+    p->cache_maxbytes = 0;
+    p->pack         = 0;
+    p->interest     = NULL;
+    p->fragment_parser = dnp3_p_app_fragment;
+    memset(&p->batch, 0, sizeof(p->batch));
+    p->tracker      = NULL;
+    p->assembler    = NULL;
+    p->auth         = NULL;
+    p->now          = 0;
+    memset(&p->stats, 0, sizeof(p->stats));
 
     assert((StreamProcessor *)p == &p->base);
     return &p->base;
 }
 
+int dnp3_dissector_set_cache(StreamProcessor *base, size_t entries,
+                             size_t maxbytes)
+{
+    Dissector *self = (Dissector *)base;
+
+    // shrink existing caches to the new limits
+    for(struct Context *ctx = self->contexts; ctx; ctx = ctx->next) {
+        while(ctx->ncache > entries)
+            evict_cache_entry(self, ctx);
+    }
+    for(struct Context *ctx = self->contexts; ctx; ctx = ctx->next) {
+        while(self->stats.cache_bytes > maxbytes && ctx->cache)
+            evict_cache_entry(self, ctx);
+    }
+
+    self->cache_max = entries;
+    self->cache_maxbytes = maxbytes;
+    return 0;
+}
+
+// pick the fragment parser after a change of options
+static void select_parser(Dissector *self)
+{
+    HParser *p = dnp3_p_app_fragment_select(self->interest, self->pack);
+
+    // cached fragments may have been parsed differently
+    if(p != self->fragment_parser) {
+        for(struct Context *ctx = self->contexts; ctx; ctx = ctx->next) {
+            while(ctx->cache)
+                evict_cache_entry(self, ctx);
+        }
+    }
+    self->fragment_parser = p;
+}
+
+int dnp3_dissector_set_pack(StreamProcessor *base, unsigned flags)
+{
+    Dissector *self = (Dissector *)base;
+
+    if(flags & ~(DNP3_PACK_COMPACT | DNP3_PACK_RAW))
+        return -1;
+
+    self->pack = flags;
+    select_parser(self);
+    return 0;
+}
+
+int dnp3_dissector_set_interest(StreamProcessor *base,
+                                const DNP3_Interest *mask)
+{
+    Dissector *self = (Dissector *)base;
+
+    if(mask && !self->interest) {
+        self->interest = malloc(sizeof(DNP3_Interest));
+        if(!self->interest)
+            return -1;
+    }
+    if(mask) {
+        *self->interest = *mask;
+    } else {
+        free(self->interest);
+        self->interest = NULL;
+    }
+
+    select_parser(self);
+    return 0;
+}
+
+void dnp3_dissector_stats(const StreamProcessor *base,
+                          DNP3_DissectorStats *stats)
+{
+    const Dissector *self = (const Dissector *)base;
+    *stats = self->stats;
+}
+
+void dnp3_dissector_set_tracker(StreamProcessor *base, DNP3_Tracker *tr)
+{
+    Dissector *self = (Dissector *)base;
+    self->tracker = tr;
+}
+
+void dnp3_dissector_set_assembler(StreamProcessor *base, DNP3_Assembler *as)
+{
+    Dissector *self = (Dissector *)base;
+    self->assembler = as;
+}
+
+void dnp3_dissector_set_auth(StreamProcessor *base, DNP3_AuthEngine *eng)
+{
+    Dissector *self = (Dissector *)base;
+    self->auth = eng;
+}
+
+void dnp3_dissector_set_time(StreamProcessor *base, uint64_t now)
+{
+    Dissector *self = (Dissector *)base;
+    self->now = now;
+}
+
+StreamProcessor *dnp3_dissector__m(HAllocator *mm_input,
+                                   HAllocator *mm_parse,
+                                   HAllocator *mm_context,
+                                   HAllocator *mm_results,
+                                   DNP3_Callbacks cb, void *env)
+{
+    return dnp3_dissector_sized__m(mm_input, mm_parse, mm_context, mm_results,
+                                   0, cb, env);
+}
+
+StreamProcessor *dnp3_dissector_sized(size_t bufsize,
+                                      DNP3_Callbacks cb, void *env)
+{
+    return dnp3_dissector_sized__m(h_system_allocator,
+                                   h_system_allocator,
+                                   h_system_allocator,
+                                   h_system_allocator,
+                                   bufsize, cb, env);
+}
+
 StreamProcessor *dnp3_dissector(DNP3_Callbacks cb, void *env)
 {
-    return dnp3_dissector__m(h_system_allocator,
-                             h_system_allocator,
-                             h_system_allocator,
-                             h_system_allocator,
-                             cb, env);
+    return dnp3_dissector_sized(0, cb, env);
 }
@@ -1,6 +1,7 @@
 
 #include <dnp3hammer.h>
 
+#include "hammer.h"
 #include "util.h"
 #include "app.h"
 #include "transport.h"
@@ -8,18 +9,47 @@
 
 void dnp3_dissector_init(void); // from dissector.c
 
+static size_t ncompiled;    // top-level parsers on a deterministic backend
+
 void dnp3_p_init(void)
 {
     dnp3_p_init_util();
     dnp3_p_init_app();
     dnp3_p_init_transport();
     dnp3_p_init_link();
+
+    // move the top-level parsers off the packrat backend where
+    // dnp3_p_compile accepts them. Hammer applies a backend only at the top
+    // level, so a grammar with any part that is not context-free (h_bind
+    // etc.) stays on packrat as a whole. the transport segment grammar is
+    // kept context-free for this (see transport.c).
+    HParser *top[] = {dnp3_p_link_frame,
+                      dnp3_p_transport_segment,
+                      dnp3_p_app_request,
+                      dnp3_p_app_response,
+                      dnp3_p_app_fragment,
+                      dnp3_p_app_request_ohdrs,
+                      dnp3_p_app_response_ohdrs,
+                      dnp3_p_app_fragment_ohdrs};
+    ncompiled = 0;
+    for(size_t i=0; i<sizeof(top)/sizeof(*top); i++) {
+        if(dnp3_p_compile(top[i]) != PB_PACKRAT)
+            ncompiled++;
+    }
 }
 
 // XXX debug
 void *h_pprint_lr_info(FILE *f, HParser *p);
 void h_pprint_lrtable(FILE *f, void *, void *, int);
 
+void dnp3_init_stats(DNP3_InitStats *stats)
+{
+    // parsers are built with dnp3_p_mm, which counts what they hold
+    dnp3_p_mem_stats(&stats->allocs, &stats->bytes);
+    dnp3_p_interned_stats(&stats->interned, &stats->interned_hits);
+    stats->compiled = ncompiled;
+}
+
 void dnp3_init(void)
 {
     dnp3_p_init();
@@ -0,0 +1,487 @@
+// application-layer fragment encoding, the inverse of dnp3_p_app_fragment
+//
+// encoding takes two passes over the fragment. the first validates it and
+// computes its exact size on the wire (dnp3_fragment_encoded_size), the
+// second writes it into the caller's buffer without any allocation.
+//
+// object data is taken from whichever form a block holds (objects, records
+// or raw); raw objects are copied as they are. blocks without object data
+// are written as object headers (and index prefixes) only, as in requests.
+
+#include <dnp3hammer.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+#include "record.h"
+#include "app.h"    // G, V, GV
+
+
+// qualifier codes, cf. the table in oblock.c
+enum QualifierKind {
+    Q_INVALID = 0,
+    Q_RANGE,            // range field (start,stop)
+    Q_ALL,              // no range field
+    Q_COUNT,            // range field (count)
+    Q_INDEX,            // range field (count), objects prefixed with index
+    Q_SIZE              // range field (count), objects prefixed with size
+};
+
+struct Qualifier {
+    uint8_t kind;       // enum QualifierKind
+    uint8_t pwidth;     // width of object prefix [bytes]
+    uint8_t rwidth;     // width of range field(s) [bytes]
+};
+
+static struct Qualifier qualifier(const DNP3_ObjectBlock *ob)
+{
+    static const uint8_t width[3] = {1, 2, 4};
+    unsigned pc = ob->prefixcode;
+    unsigned rsc = ob->rangespec;
+
+    if(pc == 0 && rsc <= 5)
+        return (struct Qualifier){Q_RANGE, 0, width[rsc % 3]};
+    if(pc == 0 && rsc == 6)
+        return (struct Qualifier){Q_ALL, 0, 0};
+    if(pc == 0 && rsc >= 7 && rsc <= 9)
+        return (struct Qualifier){Q_COUNT, 0, width[rsc - 7]};
+    if(pc >= 1 && pc <= 3 && rsc >= 7 && rsc <= 9)
+        return (struct Qualifier){Q_INDEX, width[pc - 1], width[rsc - 7]};
+    if(pc >= 4 && pc <= 6 && rsc == 0xB)
+        return (struct Qualifier){Q_SIZE, width[pc - 4], 1};
+    return (struct Qualifier){Q_INVALID, 0, 0};
+}
+
+// largest value of an unsigned field of the given width in bytes (1, 2, 4)
+static uint64_t maxval(size_t width)
+{
+    return ((uint64_t)1 << (8 * width)) - 1;
+}
+
+static bool is_response(DNP3_FunctionCode fc)
+{
+    return (fc == DNP3_RESPONSE || fc == DNP3_UNSOLICITED_RESPONSE ||
+            fc == DNP3_AUTHENTICATE_RESP);
+}
+
+static bool has_data(const DNP3_ObjectBlock *ob)
+{
+    return (ob->objects || ob->records || ob->raw);
+}
+
+// size of a free-format object (qc=5B) without its size prefix, 0 if the
+// block's objects are not free-format. cf. freefmt in g120_auth.c.
+static size_t freefmt_size(const DNP3_ObjectBlock *ob, const DNP3_Object *o)
+{
+    switch(ob->group << 8 | ob->variation) {
+    case GV(APPL, ID):              return o->applid.len;
+    case GV(AUTH, CHALLENGE):       return 8 + o->auth->len;
+    case GV(AUTH, REPLY):           return 6 + o->auth->len;
+    case GV(AUTH, KEYSTATUS):       return 11 + o->auth->len + o->auth->maclen;
+    case GV(AUTH, KEYCHANGE):       return 6 + o->auth->len;
+    case GV(AUTH, ERROR):           return 15 + o->auth->len;
+    default:                        return 0;
+    }
+}
+
+// size of an object on the wire in bits, 0 if not supported.
+// aggressive-mode objects are encoded from frag->auth only.
+static size_t objbits(DNP3_Group g, DNP3_Variation v)
+{
+    if(g == G(AUTH) && v == V(AUTH, AGGR))
+        return 0;
+    return dnp3_object_bits(g, v);
+}
+
+// size of a block on the wire in bytes, 0 if it cannot be encoded
+static size_t block_size(const DNP3_ObjectBlock *ob)
+{
+    struct Qualifier q = qualifier(ob);
+    size_t size = 3;    // group, variation, qualifier
+    size_t bits;
+
+    // range field
+    switch(q.kind) {
+    case Q_RANGE:
+        if(ob->count == 0 ||
+           (uint64_t)ob->range_base + ob->count - 1 > maxval(q.rwidth))
+            return 0;
+        size += 2 * q.rwidth;
+        break;
+    case Q_ALL:
+        if(has_data(ob))
+            return 0;
+        return size;
+    case Q_COUNT:
+    case Q_INDEX:
+    case Q_SIZE:
+        if(ob->count == 0 || ob->count > maxval(q.rwidth))
+            return 0;
+        size += q.rwidth;
+        break;
+    default:
+        return 0;
+    }
+
+    // index prefixes
+    if(q.kind == Q_INDEX) {
+        if(!ob->indexes)
+            return 0;
+        for(size_t i=0; i<ob->count; i++) {
+            if(ob->indexes[i] > maxval(q.pwidth))
+                return 0;
+        }
+        size += ob->count * q.pwidth;
+    }
+
+    // objects
+    if(q.kind == Q_SIZE) {
+        if(!ob->objects)
+            return 0;
+        for(size_t i=0; i<ob->count; i++) {
+            size_t len = freefmt_size(ob, &ob->objects[i]);
+            if(len == 0 || len > maxval(q.pwidth))
+                return 0;
+            size += q.pwidth + len;
+        }
+        return size;
+    }
+    if(!has_data(ob))
+        return size;
+
+    bits = objbits(ob->group, ob->variation);
+    if(bits == 0 || (ob->raw && ob->stride != bits))
+        return 0;
+    if(bits < 8) {
+        // packed, only with ranges
+        if(q.kind != Q_RANGE)
+            return 0;
+        return size + (ob->count * bits + 7) / 8;
+    }
+    return size + ob->count * (bits / 8);
+}
+
+size_t dnp3_fragment_encoded_size(const DNP3_Fragment *frag)
+{
+    size_t size = is_response(frag->fc) ? 4 : 2;
+
+    // aggressive mode: g120v3 (qc=07) first, g120v9 (qc=5B) last
+    if(frag->auth) {
+        if(frag->auth->maclen == 0 || frag->auth->maclen > DNP3_AUTH_MAXMAC)
+            return 0;
+        size += 4 + 6;                          // header, csq, usr
+        size += 6 + frag->auth->maclen;         // header, size, MAC
+    }
+
+    for(size_t i=0; i<frag->nblocks; i++) {
+        size_t n = block_size(frag->odata[i]);
+
+        if(n == 0)
+            return 0;
+        size += n;
+    }
+
+    return size;
+}
+
+// little-endian integer fields
+static void put(uint8_t **p, uint64_t x, size_t nbytes)
+{
+    for(size_t i=0; i<nbytes; i++)
+        *(*p)++ = x >> (8*i);
+}
+
+static void put_flt32(uint8_t **p, double x)
+{
+    union { float f; uint32_t u; } f32;
+
+    f32.f = x;
+    put(p, f32.u, 4);
+}
+
+static void put_flt64(uint8_t **p, double x)
+{
+    union { double f; uint64_t u; } f64;
+
+    f64.f = x;
+    put(p, f64.u, 8);
+}
+
+static uint8_t ac_octet(DNP3_AppControl ac)
+{
+    return ac.fir << 7 | ac.fin << 6 | ac.con << 5 | ac.uns << 4 | ac.seq;
+}
+
+static uint16_t iin_bits(DNP3_IntIndications iin)
+{
+    return iin.broadcast            << DNP3_IIN_BROADCAST
+         | iin.class1               << DNP3_IIN_CLASS1
+         | iin.class2               << DNP3_IIN_CLASS2
+         | iin.class3               << DNP3_IIN_CLASS3
+         | iin.need_time            << DNP3_IIN_NEED_TIME
+         | iin.local_ctrl           << DNP3_IIN_LOCAL_CTRL
+         | iin.device_trouble       << DNP3_IIN_DEVICE_TROUBLE
+         | iin.device_restart       << DNP3_IIN_DEVICE_RESTART
+         | iin.func_not_supp        << DNP3_IIN_FUNC_NOT_SUPP
+         | iin.obj_unknown          << DNP3_IIN_OBJ_UNKNOWN
+         | iin.param_error          << DNP3_IIN_PARAM_ERROR
+         | iin.eventbuf_overflow    << DNP3_IIN_EVENTBUF_OVERFLOW
+         | iin.already_executing    << DNP3_IIN_ALREADY_EXECUTING
+         | iin.config_corrupt       << DNP3_IIN_CONFIG_CORRUPT;
+}
+
+// write a single (byte-sized) object, cf. objbits
+static void put_object(uint8_t **p, DNP3_Group g, DNP3_Variation v,
+                       const DNP3_Object *o)
+{
+    size_t n = dnp3_wire_bits(g, v);
+
+    if(n > 0) {
+        dnp3_wire_put(g, v, *p, 0, o);
+        *p += n / 8;
+        return;
+    }
+
+    switch(g << 8 | v) {
+    case GV(BINOUTCMD, CROB):
+    case GV(BINOUTCMD, PCB):
+        put(p, o->cmd.optype | o->cmd.queue << 4 | o->cmd.clear << 5
+               | o->cmd.tcc << 6, 1);
+        put(p, o->cmd.count, 1);
+        put(p, o->cmd.on, 4);
+        put(p, o->cmd.off, 4);
+        put(p, o->cmd.status & 0x7F, 1);
+        break;
+
+    // analog output (command) value and status
+    case GV(ANAOUT, 32BIT):
+        put(p, (uint32_t)o->ana.sint, 4);
+        put(p, o->ana.status, 1);
+        break;
+    case GV(ANAOUT, 16BIT):
+        put(p, (uint16_t)o->ana.sint, 2);
+        put(p, o->ana.status, 1);
+        break;
+    case GV(ANAOUT, FLOAT):
+        put_flt32(p, o->ana.flt);
+        put(p, o->ana.status, 1);
+        break;
+    case GV(ANAOUT, DOUBLE):
+        put_flt64(p, o->ana.flt);
+        put(p, o->ana.status, 1);
+        break;
+
+    // analog output command events: status, value, optional time
+    case GV(ANAOUTCMDEV, 32BIT):
+    case GV(ANAOUTCMDEV, 32BIT_TIME):
+        put(p, o->ana.status & 0x7F, 1);
+        put(p, (uint32_t)o->ana.sint, 4);
+        break;
+    case GV(ANAOUTCMDEV, 16BIT):
+    case GV(ANAOUTCMDEV, 16BIT_TIME):
+        put(p, o->ana.status & 0x7F, 1);
+        put(p, (uint16_t)o->ana.sint, 2);
+        break;
+    case GV(ANAOUTCMDEV, FLOAT):
+    case GV(ANAOUTCMDEV, FLOAT_TIME):
+        put(p, o->ana.status & 0x7F, 1);
+        put_flt32(p, o->ana.flt);
+        break;
+    case GV(ANAOUTCMDEV, DOUBLE):
+    case GV(ANAOUTCMDEV, DOUBLE_TIME):
+        put(p, o->ana.status & 0x7F, 1);
+        put_flt64(p, o->ana.flt);
+        break;
+
+    case GV(TIME, TIME):
+    case GV(TIME, RECORDED_TIME):
+    case GV(CTO, SYNC):
+    case GV(CTO, UNSYNC):
+        put(p, o->time.abstime, 6);
+        break;
+    case GV(TIME, TIME_INTERVAL):
+        put(p, o->time.abstime, 6);
+        put(p, o->time.interval, 4);
+        break;
+    case GV(TIME, INDEXED_TIME):
+        put(p, o->time.abstime, 6);
+        put(p, o->time.interval, 4);
+        put(p, o->time.unit, 1);
+        break;
+
+    case GV(DELAY, S):
+        put(p, o->delay / 1000, 2);
+        break;
+    case GV(DELAY, MS):
+        put(p, o->delay, 2);
+        break;
+
+    case GV(AUTH, KEYSTATREQ):
+        put(p, o->auth->usr, 2);
+        break;
+
+    default:
+        assert(!"unreachable");
+    }
+
+    // timestamp of analog output command events
+    switch(g << 8 | v) {
+    case GV(ANAOUTCMDEV, 32BIT_TIME):
+    case GV(ANAOUTCMDEV, 16BIT_TIME):
+    case GV(ANAOUTCMDEV, FLOAT_TIME):
+    case GV(ANAOUTCMDEV, DOUBLE_TIME):
+        put(p, o->timed.abstime, 6);
+        break;
+    }
+}
+
+// write a free-format object (without its size prefix), cf. freefmt_size
+static uint8_t *put_freefmt(uint8_t *p, const DNP3_ObjectBlock *ob,
+                            const DNP3_Object *o)
+{
+    const DNP3_AuthMessage *m = o->auth;
+
+    if(ob->group == G(APPL)) {
+        memcpy(p, o->applid.str, o->applid.len);
+        return p + o->applid.len;
+    }
+
+    put(&p, m->seq, 4);
+    put(&p, m->usr, 2);
+    switch(ob->variation) {
+    case V(AUTH, CHALLENGE):
+        put(&p, m->mal, 1);
+        put(&p, m->code, 1);
+        break;
+    case V(AUTH, KEYSTATUS):
+        put(&p, m->kwa, 1);
+        put(&p, m->code, 1);
+        put(&p, m->mal, 1);
+        put(&p, m->len, 2);             // challenge data length
+        break;
+    case V(AUTH, ERROR):
+        put(&p, m->assoc, 2);
+        put(&p, m->code, 1);
+        put(&p, m->time, 6);
+        break;
+    default:                            // reply, key change
+        break;
+    }
+    memcpy(p, m->data, m->len + m->maclen);     // data followed by MAC
+    return p + m->len + m->maclen;
+}
+
+// write a block that has passed block_size
+static uint8_t *put_block(uint8_t *p, const DNP3_ObjectBlock *ob)
+{
+    struct Qualifier q = qualifier(ob);
+    DNP3_Object o;
+    size_t bits;
+
+    *p++ = ob->group;
+    *p++ = ob->variation;
+    *p++ = ob->prefixcode << 4 | ob->rangespec;
+
+    switch(q.kind) {
+    case Q_RANGE:
+        put(&p, ob->range_base, q.rwidth);
+        put(&p, ob->range_base + ob->count - 1, q.rwidth);
+        break;
+    case Q_COUNT:
+    case Q_INDEX:
+    case Q_SIZE:
+        put(&p, ob->count, q.rwidth);
+        break;
+    }
+
+    // variable-format objects, prefixed with their size
+    if(q.kind == Q_SIZE) {
+        for(size_t i=0; i<ob->count; i++) {
+            put(&p, freefmt_size(ob, &ob->objects[i]), q.pwidth);
+            p = put_freefmt(p, ob, &ob->objects[i]);
+        }
+        return p;
+    }
+
+    // index prefixes only
+    if(!has_data(ob)) {
+        if(q.kind == Q_INDEX) {
+            for(size_t i=0; i<ob->count; i++)
+                put(&p, ob->indexes[i], q.pwidth);
+        }
+        return p;
+    }
+
+    bits = objbits(ob->group, ob->variation);
+
+    // packed objects, padded to a whole octet
+    if(bits < 8) {
+        size_t n = (ob->count * bits + 7) / 8;
+
+        if(ob->raw) {
+            memcpy(p, ob->raw, n);
+        } else {
+            memset(p, 0, n);
+            for(size_t i=0; i<ob->count; i++) {
+                dnp3_oblock_get(ob, i, &o);
+                dnp3_oblock_unresolve(ob, &o);
+                dnp3_wire_put(ob->group, ob->variation, p, i, &o);
+            }
+        }
+        return p + n;
+    }
+
+    for(size_t i=0; i<ob->count; i++) {
+        if(q.kind == Q_INDEX)
+            put(&p, ob->indexes[i], q.pwidth);
+        if(ob->raw) {
+            memcpy(p, ob->raw + i * (bits / 8), bits / 8);
+            p += bits / 8;
+        } else {
+            dnp3_oblock_get(ob, i, &o);
+            dnp3_oblock_unresolve(ob, &o);
+            put_object(&p, ob->group, ob->variation, &o);
+        }
+    }
+
+    return p;
+}
+
+size_t dnp3_encode_fragment(uint8_t *buf, size_t bufsize,
+                            const DNP3_Fragment *frag)
+{
+    size_t size = dnp3_fragment_encoded_size(frag);
+    uint8_t *p = buf;
+
+    if(size == 0 || size > bufsize)
+        return 0;
+
+    *p++ = ac_octet(frag->ac);
+    *p++ = frag->fc;
+    if(is_response(frag->fc))
+        put(&p, iin_bits(frag->iin), 2);
+
+    if(frag->auth) {
+        *p++ = G(AUTH);
+        *p++ = V(AUTH, AGGR);
+        *p++ = 0x07;
+        *p++ = 1;
+        put(&p, frag->auth->csq, 4);
+        put(&p, frag->auth->usr, 2);
+    }
+
+    for(size_t i=0; i<frag->nblocks; i++)
+        p = put_block(p, frag->odata[i]);
+
+    if(frag->auth) {
+        *p++ = G(AUTH);
+        *p++ = V(AUTH, MAC);
+        *p++ = 0x5B;
+        *p++ = 1;
+        put(&p, frag->auth->maclen, 2);
+        memcpy(p, frag->auth->mac, frag->auth->maclen);
+        p += frag->auth->maclen;
+    }
+
+    assert((size_t)(p - buf) == size);
+    return size;
+}
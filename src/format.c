@@ -142,6 +142,16 @@ static int append_time(char **res, size_t *size, const char *pre, uint64_t time,
 #define append_reltime(res, size, time) append_time(res, size, "@+", time, true)
 #define append_interval_ms(res, size, time) append_time(res, size, "+", time, true)
 
+// relative times are shown as such only if they could not be resolved
+static int append_timed(char **res, size_t *size, DNP3_Object o,
+                        bool resolved)
+{
+    if(resolved)
+        return append_abstime(res, size, o.timed.abstime);
+    else
+        return append_reltime(res, size, o.timed.reltime);
+}
+
 static int append_interval(char **res, size_t *size, uint32_t val, DNP3_IntervalUnit unit)
 {
     const char *u = NULL;
@@ -200,7 +210,19 @@ static int append_string(char **res, size_t *size, const char *s, size_t n)
     return x;
 }
 
-char *dnp3_format_object(DNP3_Group g, DNP3_Variation v, const DNP3_Object o)
+static int append_hex(char **res, size_t *size, const char *pre,
+                      const uint8_t *data, size_t n)
+{
+    int x = appendf(res, size, "%s", pre);
+
+    for(size_t i=0; i<n && x>=0; i++)
+        x = appendf(res, size, "%02x", (unsigned)data[i]);
+    return x;
+}
+
+// resolved: relative times have been resolved (see DNP3_ObjectBlock.nocto)
+static char *format_object(DNP3_Group g, DNP3_Variation v, const DNP3_Object o,
+                           bool resolved)
 {
     size_t size;
     char *res = NULL;
@@ -225,7 +247,7 @@ char *dnp3_format_object(DNP3_Group g, DNP3_Variation v, const DNP3_Object o)
         break;
     case GV(BININEV, RELTIME):
         append_bin_flags(&res, &size, o.timed.flags);
-        append_reltime(&res, &size, o.timed.reltime);
+        append_timed(&res, &size, o, resolved);
         break;
     case GV(DBLBITIN, PACKED):
         appendf(&res, &size, "%c", (int)dblbit_sym[o.dblbit]);
@@ -240,7 +262,7 @@ char *dnp3_format_object(DNP3_Group g, DNP3_Variation v, const DNP3_Object o)
         break;
     case GV(DBLBITINEV, RELTIME):
         append_dblbit_flags(&res, &size, o.timed.flags);
-        append_reltime(&res, &size, o.timed.reltime);
+        append_timed(&res, &size, o, resolved);
         break;
     case GV(BINOUTCMD, CROB):
     case GV(BINOUTCMD, PCB):
@@ -399,6 +421,44 @@ char *dnp3_format_object(DNP3_Group g, DNP3_Variation v, const DNP3_Object o)
     case GV(APPL, ID):
         append_string(&res, &size, o.applid.str, o.applid.len);
         break;
+    case GV(AUTH, CHALLENGE):
+        appendf(&res, &size, "csq=%"PRIu32" usr=%"PRIu16" mal=%d rsn=%d",
+                o.auth->seq, o.auth->usr, (int)o.auth->mal, (int)o.auth->code);
+        append_hex(&res, &size, " data=", o.auth->data, o.auth->len);
+        break;
+    case GV(AUTH, REPLY):
+        appendf(&res, &size, "csq=%"PRIu32" usr=%"PRIu16,
+                o.auth->seq, o.auth->usr);
+        append_hex(&res, &size, " mac=", o.auth->data, o.auth->len);
+        break;
+    case GV(AUTH, KEYSTATREQ):
+        appendf(&res, &size, "usr=%"PRIu16, o.auth->usr);
+        break;
+    case GV(AUTH, KEYSTATUS):
+        appendf(&res, &size, "ksq=%"PRIu32" usr=%"PRIu16" kwa=%d kst=%d mal=%d",
+                o.auth->seq, o.auth->usr, (int)o.auth->kwa, (int)o.auth->code,
+                (int)o.auth->mal);
+        append_hex(&res, &size, " data=", o.auth->data, o.auth->len);
+        if(o.auth->maclen > 0)
+            append_hex(&res, &size, " mac=", o.auth->data + o.auth->len,
+                       o.auth->maclen);
+        break;
+    case GV(AUTH, KEYCHANGE):
+        appendf(&res, &size, "ksq=%"PRIu32" usr=%"PRIu16,
+                o.auth->seq, o.auth->usr);
+        append_hex(&res, &size, " key=", o.auth->data, o.auth->len);
+        break;
+    case GV(AUTH, ERROR):
+        appendf(&res, &size, "csq=%"PRIu32" usr=%"PRIu16" aid=%"PRIu16
+                " err=%d ", o.auth->seq, o.auth->usr, o.auth->assoc,
+                (int)o.auth->code);
+        append_abstime(&res, &size, o.auth->time);
+        if(o.auth->len > 0) {
+            appendf(&res, &size, " ");
+            append_string(&res, &size, (const char *)o.auth->data,
+                          o.auth->len);
+        }
+        break;
     }
 
     if(!res)
@@ -407,11 +467,17 @@ char *dnp3_format_object(DNP3_Group g, DNP3_Variation v, const DNP3_Object o)
     return res;
 }
 
+char *dnp3_format_object(DNP3_Group g, DNP3_Variation v, const DNP3_Object o)
+{
+    return format_object(g, v, o, false);
+}
+
 char *dnp3_format_oblock_(const DNP3_ObjectBlock *ob, bool do_data)
 {
     size_t size;
     char *res = NULL;
-    const char *sep = ob->objects ? ":" : "";
+    bool objects = dnp3_oblock_has_objects(ob);
+    const char *sep = objects ? ":" : "";
     int x;
 
     // group, variation, qc
@@ -439,16 +505,18 @@ char *dnp3_format_oblock_(const DNP3_ObjectBlock *ob, bool do_data)
     }
 
     // objects/indexes
-    if(ob->indexes || ob->objects) {
+    if(ob->indexes || objects) {
         for(size_t i=0; i<ob->count; i++) {
             if(appendf(&res, &size, " ") < 0) goto err;
             if(ob->indexes) {
                 x = appendf(&res, &size, "#%"PRIu32"%s", ob->indexes[i], sep);
                 if(x<0) goto err;
             }
-            if(ob->objects) {
-                DNP3_Object o = ob->objects[i];
-                char *s = dnp3_format_object(ob->group, ob->variation, o);
+            if(objects) {
+                DNP3_Object o;
+                dnp3_oblock_get(ob, i, &o);
+                char *s = format_object(ob->group, ob->variation, o,
+                                        !ob->nocto);
                 x = appendf(&res, &size, "%s", s);
                 free(s);
                 if(x<0) goto err;
@@ -544,7 +612,8 @@ char *dnp3_format_fragment_(const DNP3_Fragment *frag, bool do_objects, bool do_
 
     // add authdata
     if(frag->auth) {
-        x = appendf(&res, &size, " [auth]");    // XXX
+        x = appendf(&res, &size, " [auth usr=%"PRIu16" csq=%"PRIu32"]",
+                    frag->auth->usr, frag->auth->csq);
         if(x<0) goto err;
     }
 
@@ -0,0 +1,326 @@
+// single-allocation copies of parsed fragments
+//
+// a fragment as returned by the parser is spread over many small arena
+// allocations. the functions below compute its exact size and lay it out
+// contiguously in a single block of memory:
+//
+//   DNP3_Fragment
+//   DNP3_AuthData                  (if present)
+//   DNP3_ObjectBlock *[nblocks]    (odata)
+//   DNP3_ObjectBlock  [nblocks]
+//   per block: DNP3_Object [count], records or raw objects,
+//              uint32_t [count] (if indexed)
+//   strings                        (g90v1 application ids, g120 data)
+//
+// all internal pointers point into the block, so it can be freed with a
+// single call, copied with memcpy and relocated with dnp3_fragment_relocate.
+
+#include <dnp3hammer.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+#include "hammer.h"
+#include "record.h"
+#include "app.h"    // G, V
+
+
+// round up to the strictest alignment of any member
+union MaxAlign { double d; uint64_t u; void *p; };
+#define ALIGN(n) (((n) + sizeof(union MaxAlign) - 1) \
+                  & ~(sizeof(union MaxAlign) - 1))
+
+// blocks whose objects point to strings of their own
+static bool has_strings(const DNP3_ObjectBlock *ob)
+{
+    return (ob->group == G(APPL) && ob->variation == V(APPL, ID));
+}
+
+// blocks whose objects point to authentication messages
+static bool has_messages(const DNP3_ObjectBlock *ob)
+{
+    if(ob->group != G(AUTH))
+        return false;
+    switch(ob->variation) {
+    case V(AUTH, CHALLENGE):
+    case V(AUTH, REPLY):
+    case V(AUTH, KEYSTATREQ):
+    case V(AUTH, KEYSTATUS):
+    case V(AUTH, KEYCHANGE):
+    case V(AUTH, ERROR):
+        return true;
+    default:
+        return false;
+    }
+}
+
+// size of an authentication message, data followed by MAC
+static size_t message_size(const DNP3_AuthMessage *m)
+{
+    return sizeof(DNP3_AuthMessage) + m->len + m->maclen;
+}
+
+// should the block's objects be stored as compact records?
+static bool compact(const DNP3_ObjectBlock *ob, unsigned flags)
+{
+    return ((flags & DNP3_PACK_COMPACT) && ob->objects &&
+            dnp3_record_bits(ob->group, ob->variation) > 0);
+}
+
+// size of the block's records, as present or to be made
+static size_t records_size(const DNP3_ObjectBlock *ob)
+{
+    return dnp3_record_size(ob->group, ob->variation, ob->count);
+}
+
+// size of the block's raw objects
+static size_t raw_size(const DNP3_ObjectBlock *ob)
+{
+    return (ob->count * ob->stride + 7) / 8;
+}
+
+size_t dnp3_fragment_size(const DNP3_Fragment *frag, unsigned flags)
+{
+    size_t size = ALIGN(sizeof(DNP3_Fragment));
+
+    if(frag->auth)
+        size += ALIGN(sizeof(DNP3_AuthData));
+    size += ALIGN(frag->nblocks * sizeof(DNP3_ObjectBlock *));
+    size += ALIGN(frag->nblocks * sizeof(DNP3_ObjectBlock));
+
+    for(size_t i=0; i<frag->nblocks; i++) {
+        const DNP3_ObjectBlock *ob = frag->odata[i];
+
+        if(ob->raw)
+            size += ALIGN(raw_size(ob));
+        else if(ob->records || compact(ob, flags))
+            size += ALIGN(records_size(ob));
+        else if(ob->objects)
+            size += ALIGN(ob->count * sizeof(DNP3_Object));
+        if(ob->indexes)
+            size += ALIGN(ob->count * sizeof(uint32_t));
+        if(ob->objects && has_messages(ob)) {
+            for(size_t j=0; j<ob->count; j++)
+                size += ALIGN(message_size(ob->objects[j].auth));
+        }
+        if(ob->objects && has_strings(ob)) {
+            for(size_t j=0; j<ob->count; j++)
+                size += ob->objects[j].applid.len + 1;  // null-terminated
+        }
+    }
+
+    return ALIGN(size);
+}
+
+// take n bytes from the front of the buffer
+static void *take(uint8_t **p, size_t n)
+{
+    void *res = *p;
+    *p += n;
+    return res;
+}
+
+DNP3_Fragment *dnp3_fragment_pack(void *buf, const DNP3_Fragment *frag,
+                                  unsigned flags)
+{
+    uint8_t *p = buf;
+    DNP3_Fragment *res = take(&p, ALIGN(sizeof(DNP3_Fragment)));
+
+    *res = *frag;
+
+    if(frag->auth) {
+        res->auth = take(&p, ALIGN(sizeof(DNP3_AuthData)));
+        memcpy(res->auth, frag->auth, sizeof(DNP3_AuthData));
+    }
+
+    res->odata = take(&p, ALIGN(frag->nblocks * sizeof(DNP3_ObjectBlock *)));
+    DNP3_ObjectBlock *blocks =
+        take(&p, ALIGN(frag->nblocks * sizeof(DNP3_ObjectBlock)));
+
+    for(size_t i=0; i<frag->nblocks; i++) {
+        const DNP3_ObjectBlock *ob = frag->odata[i];
+        DNP3_ObjectBlock *b = &blocks[i];
+
+        *b = *ob;
+        res->odata[i] = b;
+
+        if(ob->raw) {
+            size_t n = raw_size(ob);
+            b->raw = take(&p, ALIGN(n));
+            memcpy(b->raw, ob->raw, n);
+        } else if(ob->records) {
+            size_t n = records_size(ob);
+            b->records = take(&p, ALIGN(n));
+            memcpy(b->records, ob->records, n);
+        } else if(compact(ob, flags)) {
+            size_t n = records_size(ob);
+            b->records = take(&p, ALIGN(n));
+            memset(b->records, 0, n);
+            for(size_t j=0; j<ob->count; j++) {
+                DNP3_Object o = ob->objects[j];
+                dnp3_oblock_unresolve(ob, &o);  // records keep reltime
+                dnp3_record_put(ob->group, ob->variation, b->records, j, &o);
+            }
+            b->objects = NULL;
+        } else if(ob->objects) {
+            size_t n = ob->count * sizeof(DNP3_Object);
+            b->objects = take(&p, ALIGN(n));
+            memcpy(b->objects, ob->objects, n);
+            if(has_messages(b)) {
+                for(size_t j=0; j<b->count; j++) {
+                    DNP3_Object *o = &b->objects[j];
+                    size_t m = message_size(o->auth);
+                    DNP3_AuthMessage *a = take(&p, ALIGN(m));
+
+                    memcpy(a, o->auth, m);
+                    o->auth = a;
+                }
+            }
+        }
+        if(ob->indexes) {
+            size_t n = ob->count * sizeof(uint32_t);
+            b->indexes = take(&p, ALIGN(n));
+            memcpy(b->indexes, ob->indexes, n);
+        }
+    }
+
+    // strings go last, they need no alignment
+    for(size_t i=0; i<frag->nblocks; i++) {
+        DNP3_ObjectBlock *b = res->odata[i];
+
+        if(!b->objects || !has_strings(b))
+            continue;
+        for(size_t j=0; j<b->count; j++) {
+            DNP3_Object *o = &b->objects[j];
+            size_t n = o->applid.len;
+            char *s = take(&p, n + 1);
+
+            memcpy(s, o->applid.str, n);
+            s[n] = '\0';
+            o->applid.str = s;
+        }
+    }
+
+    assert((size_t)(p - (uint8_t *)buf) <= dnp3_fragment_size(frag, flags));
+    return res;
+}
+
+// shift a pointer into the block by the given offset
+#define MOVE(x, delta) \
+    do { if(x) x = (void *)((uint8_t *)(x) + (delta)); } while(0)
+
+DNP3_Fragment *dnp3_fragment_relocate(void *buf, const void *oldbase)
+{
+    DNP3_Fragment *frag = buf;
+    ptrdiff_t delta = (uint8_t *)buf - (const uint8_t *)oldbase;
+
+    if(delta == 0)
+        return frag;
+
+    MOVE(frag->auth, delta);
+    MOVE(frag->odata, delta);
+    for(size_t i=0; i<frag->nblocks; i++) {
+        MOVE(frag->odata[i], delta);
+
+        DNP3_ObjectBlock *ob = frag->odata[i];
+        MOVE(ob->objects, delta);
+        MOVE(ob->records, delta);
+        MOVE(ob->raw, delta);
+        MOVE(ob->indexes, delta);
+        if(ob->objects && has_strings(ob)) {
+            for(size_t j=0; j<ob->count; j++)
+                MOVE(ob->objects[j].applid.str, delta);
+        }
+        if(ob->objects && has_messages(ob)) {
+            for(size_t j=0; j<ob->count; j++)
+                MOVE(ob->objects[j].auth, delta);
+        }
+    }
+
+    return frag;
+}
+
+DNP3_Fragment *dnp3_fragment_copy__m(HAllocator *mm__,
+                                     const DNP3_Fragment *frag, unsigned flags)
+{
+    void *buf = mm__->alloc(mm__, dnp3_fragment_size(frag, flags));
+
+    if(!buf)
+        return NULL;
+    return dnp3_fragment_pack(buf, frag, flags);
+}
+
+DNP3_Fragment *dnp3_fragment_copy(const DNP3_Fragment *frag, unsigned flags)
+{
+    return dnp3_fragment_copy__m(h_system_allocator, frag, flags);
+}
+
+
+// reference-counted copies, as passed to the dissector callbacks...
+//
+// the packed fragment is preceded by a small header that holds the
+// allocator and the reference count. the magic number lets debug builds
+// catch fragments that were not made by dnp3_fragment_share*.
+
+#define SHARED_MAGIC 0xD3F5A7ED
+
+struct Shared {
+    uint32_t magic;         // SHARED_MAGIC while alive
+    HAllocator *mm;
+    size_t refs;
+};
+
+#define SHAREDSIZE ALIGN(sizeof(struct Shared))
+
+// the count may be touched from several threads
+#ifdef __GNUC__
+#define INCREF(x) __atomic_add_fetch(&(x), 1, __ATOMIC_RELAXED)
+#define DECREF(x) __atomic_sub_fetch(&(x), 1, __ATOMIC_ACQ_REL)
+#else
+#define INCREF(x) (++(x))   // XXX not thread-safe
+#define DECREF(x) (--(x))
+#endif
+
+static struct Shared *shared(const DNP3_Fragment *frag)
+{
+    struct Shared *sh = (struct Shared *)((uint8_t *)frag - SHAREDSIZE);
+
+    assert(sh->magic == SHARED_MAGIC);  // not shared or already freed
+    return sh;
+}
+
+DNP3_Fragment *dnp3_fragment_share__m(HAllocator *mm__,
+                                      const DNP3_Fragment *frag, unsigned flags)
+{
+    uint8_t *buf = mm__->alloc(mm__,
+                               SHAREDSIZE + dnp3_fragment_size(frag, flags));
+
+    if(!buf)
+        return NULL;
+
+    struct Shared *sh = (struct Shared *)buf;
+    sh->magic = SHARED_MAGIC;
+    sh->mm = mm__;
+    sh->refs = 1;
+    return dnp3_fragment_pack(buf + SHAREDSIZE, frag, flags);
+}
+
+DNP3_Fragment *dnp3_fragment_share(const DNP3_Fragment *frag, unsigned flags)
+{
+    return dnp3_fragment_share__m(h_system_allocator, frag, flags);
+}
+
+const DNP3_Fragment *dnp3_fragment_retain(const DNP3_Fragment *frag)
+{
+    INCREF(shared(frag)->refs);
+    return frag;
+}
+
+void dnp3_fragment_release(const DNP3_Fragment *frag)
+{
+    struct Shared *sh = shared(frag);
+
+    if(DECREF(sh->refs) == 0) {
+        sh->magic = 0;
+        sh->mm->free(sh->mm, sh);
+    }
+}
@@ -1,25 +1,251 @@
-
 #include <dnp3hammer.h>
 
 #include <hammer/glue.h>
+#include <stdint.h>
+#include <string.h>
 #include "g120_auth.h"
 #include "app.h"
+#include "util.h"
 
+HParser *dnp3_p_g120v1_auth_challenge_block;
+HParser *dnp3_p_g120v2_auth_reply_block;
 HParser *dnp3_p_g120v3_auth_aggr_block;
+HParser *dnp3_p_g120v4_auth_keystatreq_block;
+HParser *dnp3_p_g120v5_auth_keystatus_block;
+HParser *dnp3_p_g120v6_auth_keychange_block;
+HParser *dnp3_p_g120v7_auth_error_block;
 HParser *dnp3_p_g120v9_auth_mac_block;
 
+// fixed parts of the free-format objects, see freefmt()
+static HParser *challenge_fixed;
+static HParser *reply_fixed;
+static HParser *keystatus_fixed;
+static HParser *keychange_fixed;
+static HParser *error_fixed;
+
+static HParsedToken *act_auth_aggr(const HParseResult *p, void *user)
+{
+    DNP3_Object *o = H_ALLOC(DNP3_Object);
+
+    // p = (seqno, userno)
+    o->aggr.csq = H_FIELD_UINT(0);
+    o->aggr.usr = H_FIELD_UINT(1);
+
+    return H_MAKE(DNP3_Object, o);
+}
+
+static HParsedToken *act_mac(const HParseResult *p, void *user)
+{
+    DNP3_Object *o = H_ALLOC(DNP3_Object);
+    HCountedArray *a = H_CAST_SEQ(p->ast);
+    size_t n = a->used;
+
+    o->mac.len = n;
+    o->mac.data = h_arena_malloc(p->arena, n);
+    for(size_t i=0; i<n; i++)
+        o->mac.data[i] = H_CAST_UINT(a->elements[i]);
+
+    return H_MAKE(DNP3_Object, o);
+}
+
+// an authentication message with room for n bytes of data
+static DNP3_AuthMessage *message(HArena *arena, size_t n)
+{
+    DNP3_AuthMessage *m = h_arena_malloc(arena, sizeof(DNP3_AuthMessage) + n);
+
+    memset(m, 0, sizeof(DNP3_AuthMessage));
+    return m;
+}
+
+// copy the variable-length data of a free-format object; with a MAC of
+// maclen bytes at the end.
+static DNP3_AuthMessage *take_data(const HParseResult *p, size_t maclen)
+{
+    HCountedArray *a = H_FIELD_SEQ(1);
+    size_t n = a->used;
+    DNP3_AuthMessage *m = message(p->arena, n);
+
+    m->len = n - maclen;
+    m->maclen = maclen;
+    for(size_t i=0; i<n; i++)
+        m->data[i] = H_CAST_UINT(a->elements[i]);
+
+    return m;
+}
+
+static HParsedToken *act_auth_keystatreq(const HParseResult *p, void *user)
+{
+    DNP3_Object *o = H_ALLOC(DNP3_Object);
+
+    o->auth = message(p->arena, 0);
+    o->auth->usr = H_CAST_UINT(p->ast);
+
+    return H_MAKE(DNP3_Object, o);
+}
+
+static HParsedToken *act_challenge(const HParseResult *p, void *user)
+{
+    DNP3_Object *o = H_ALLOC(DNP3_Object);
+
+    // p = ((seqno, userno, mal, reason), data)
+    o->auth = take_data(p, 0);
+    o->auth->seq  = H_FIELD_UINT(0, 0);
+    o->auth->usr  = H_FIELD_UINT(0, 1);
+    o->auth->mal  = H_FIELD_UINT(0, 2);
+    o->auth->code = H_FIELD_UINT(0, 3);
+
+    return H_MAKE(DNP3_Object, o);
+}
+
+static HParsedToken *act_reply(const HParseResult *p, void *user)
+{
+    DNP3_Object *o = H_ALLOC(DNP3_Object);
+
+    // p = ((seqno, userno), mac)
+    o->auth = take_data(p, 0);
+    o->auth->seq = H_FIELD_UINT(0, 0);
+    o->auth->usr = H_FIELD_UINT(0, 1);
+
+    return H_MAKE(DNP3_Object, o);
+}
+
+static HParsedToken *act_keystatus(const HParseResult *p, void *user)
+{
+    DNP3_Object *o = H_ALLOC(DNP3_Object);
+
+    // p = ((seqno, userno, kwa, status, mal, cdl), data ++ mac)
+    o->auth = take_data(p, H_FIELD_SEQ(1)->used - H_FIELD_UINT(0, 5));
+    o->auth->seq  = H_FIELD_UINT(0, 0);
+    o->auth->usr  = H_FIELD_UINT(0, 1);
+    o->auth->kwa  = H_FIELD_UINT(0, 2);
+    o->auth->code = H_FIELD_UINT(0, 3);
+    o->auth->mal  = H_FIELD_UINT(0, 4);
+
+    return H_MAKE(DNP3_Object, o);
+}
+
+static HParsedToken *act_keychange(const HParseResult *p, void *user)
+{
+    DNP3_Object *o = H_ALLOC(DNP3_Object);
+
+    // p = ((seqno, userno), keydata)
+    o->auth = take_data(p, 0);
+    o->auth->seq = H_FIELD_UINT(0, 0);
+    o->auth->usr = H_FIELD_UINT(0, 1);
+
+    return H_MAKE(DNP3_Object, o);
+}
+
+static HParsedToken *act_error(const HParseResult *p, void *user)
+{
+    DNP3_Object *o = H_ALLOC(DNP3_Object);
+
+    // p = ((seqno, userno, assoc, code, time), text)
+    o->auth = take_data(p, 0);
+    o->auth->seq   = H_FIELD_UINT(0, 0);
+    o->auth->usr   = H_FIELD_UINT(0, 1);
+    o->auth->assoc = H_FIELD_UINT(0, 2);
+    o->auth->code  = H_FIELD_UINT(0, 3);
+    o->auth->time  = H_FIELD_UINT(0, 4);
+
+    return H_MAKE(DNP3_Object, o);
+}
+
+// the challenge data length (CDL) of a key status must fit the object
+static bool validate_keystatus(HParseResult *p, void *user)
+{
+    return (H_FIELD_UINT(0, 5) <= H_FIELD_SEQ(1)->used);
+}
+
+// free-format objects (A45.1): a fixed part of len bytes, followed by
+// between min and max bytes of data that fill the size n given in the
+// object prefix. valid (optional) checks the fields against the data.
+static HParser *freefmt(HAllocator *mm__, size_t n, HParser *fixed,
+                        size_t len, size_t min, size_t max,
+                        HPredicate valid, HAction act)
+{
+    if(n < len + min || n > len + max)
+        return h_nothing_p__m(mm__);
+
+    HParser *data = h_repeat_n__m(mm__, h_uint8__m(mm__), n - len);
+    HParser *p = h_sequence__m(mm__, fixed, data, NULL);
+    if(valid)
+        p = h_attr_bool__m(mm__, p, valid, NULL);
+    return h_action__m(mm__, p, act, NULL);
+}
+
+static HParser *auth_challenge(HAllocator *mm__, size_t n)
+{
+    return freefmt(mm__, n, challenge_fixed, 8, 4, SIZE_MAX, NULL,
+                   act_challenge);
+}
+
+static HParser *auth_reply(HAllocator *mm__, size_t n)
+{
+    return freefmt(mm__, n, reply_fixed, 6, 1, DNP3_AUTH_MAXMAC, NULL,
+                   act_reply);
+}
+
+static HParser *auth_keystatus(HAllocator *mm__, size_t n)
+{
+    return freefmt(mm__, n, keystatus_fixed, 11, 0, SIZE_MAX,
+                   validate_keystatus, act_keystatus);
+}
+
+static HParser *auth_keychange(HAllocator *mm__, size_t n)
+{
+    return freefmt(mm__, n, keychange_fixed, 6, 1, SIZE_MAX, NULL,
+                   act_keychange);
+}
+
+static HParser *auth_error(HAllocator *mm__, size_t n)
+{
+    return freefmt(mm__, n, error_fixed, 15, 0, SIZE_MAX, NULL, act_error);
+}
+
 static HParser *auth_mac(HAllocator *mm__, size_t n)  // n = size in object prefix
 {
-    return h_repeat_n__m(mm__, h_uint8__m(mm__), n);
+    if(n < 1 || n > DNP3_AUTH_MAXMAC)
+        return h_nothing_p__m(mm__);
+    return h_action__m(mm__, h_repeat_n__m(mm__, h_uint8__m(mm__), n),
+                             act_mac, NULL);
 }
 
 void dnp3_p_init_g120_auth(void)
 {
     // A45.3
-    H_RULE(seqno,     h_uint32());
-    H_RULE(userno,    h_int_range(h_uint16(), 1, 65535));
-    H_RULE(auth_aggr, h_sequence(seqno, userno, NULL));
+    H_RULE (seqno,     h_uint32());
+    H_RULE (userno,    h_int_range(h_uint16(), 1, 65535));
+    H_RULE (assocno,   h_uint16());
+    H_RULE (errcode,   h_uint8());
+    H_RULE (mal,       h_uint8());      // MAC algorithm
+    H_RULE (kwa,       h_uint8());      // key wrap algorithm
+    H_RULE (reason,    h_uint8());
+    H_RULE (status,    h_uint8());      // key status
+    H_RULE (cdl,       h_uint16());     // challenge data length
+
+    H_ARULE(auth_aggr, h_sequence(seqno, userno, NULL));
+    H_ARULE(auth_keystatreq, userno);
+
+    challenge_fixed = h_sequence(seqno, userno, mal, reason, NULL);
+    reply_fixed     = h_sequence(seqno, userno, NULL);
+    keystatus_fixed = h_sequence(seqno, userno, kwa, status, mal, cdl, NULL);
+    keychange_fixed = h_sequence(seqno, userno, NULL);
+    error_fixed     = h_sequence(seqno, userno, assocno, errcode,
+                                 dnp3_p_dnp3time, NULL);
 
+    dnp3_p_g120v1_auth_challenge_block =
+        dnp3_p_single_vf(G_V(AUTH, CHALLENGE), auth_challenge);
+    dnp3_p_g120v2_auth_reply_block =
+        dnp3_p_single_vf(G_V(AUTH, REPLY), auth_reply);
     dnp3_p_g120v3_auth_aggr_block = dnp3_p_single(G_V(AUTH, AGGR), auth_aggr);
+    dnp3_p_g120v4_auth_keystatreq_block =
+        dnp3_p_single(G_V(AUTH, KEYSTATREQ), auth_keystatreq);
+    dnp3_p_g120v5_auth_keystatus_block =
+        dnp3_p_single_vf(G_V(AUTH, KEYSTATUS), auth_keystatus);
+    dnp3_p_g120v6_auth_keychange_block =
+        dnp3_p_single_vf(G_V(AUTH, KEYCHANGE), auth_keychange);
+    dnp3_p_g120v7_auth_error_block =
+        dnp3_p_single_vf(G_V(AUTH, ERROR), auth_error);
     dnp3_p_g120v9_auth_mac_block = dnp3_p_single_vf(G_V(AUTH, MAC), auth_mac);
 }
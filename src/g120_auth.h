@@ -1,4 +1,12 @@
 #include <hammer/hammer.h>
 
+extern HParser *dnp3_p_g120v1_auth_challenge_block;
+extern HParser *dnp3_p_g120v2_auth_reply_block;
 extern HParser *dnp3_p_g120v3_auth_aggr_block;
+extern HParser *dnp3_p_g120v4_auth_keystatreq_block;
+extern HParser *dnp3_p_g120v5_auth_keystatus_block;
+extern HParser *dnp3_p_g120v6_auth_keychange_block;
+extern HParser *dnp3_p_g120v7_auth_error_block;
 extern HParser *dnp3_p_g120v9_auth_mac_block;
+
+void dnp3_p_init_g120_auth(void);
@@ -22,6 +22,7 @@ static HParsedToken *act_error(const HParseResult *p, void *user)
     int code = (intptr_t)user;
     HParsedToken *tok = h_arena_malloc(p->arena, sizeof(HParsedToken));
     tok->token_type = code;
+    tok->user = NULL;
     return tok;
 }
 
@@ -32,6 +33,12 @@ HParser *h_error(int code)
     // could implement in terms of h_unit, but would need an alloc
     return h_action(h_epsilon_p(), act_error, (void *)(intptr_t)code);
 }
+HParser *h_error__m(HAllocator *mm__, int code)
+{
+    assert(H_ISERR(code));
+    return h_action__m(mm__, h_epsilon_p__m(mm__), act_error,
+                       (void *)(intptr_t)code);
+}
 
 // helper not officially exported by hammer, but I know it is ;)
 HParsedToken *h_make_(HArena *arena, HTokenType type);
@@ -82,6 +89,16 @@ HParser *h_float64(void)
     return h_action(h_uint64(), act_double, NULL);
 }
 
+HParser *h_float32__m(HAllocator *mm__)
+{
+    return h_action__m(mm__, h_uint32__m(mm__), act_float, NULL);
+}
+
+HParser *h_float64__m(HAllocator *mm__)
+{
+    return h_action__m(mm__, h_uint64__m(mm__), act_double, NULL);
+}
+
 static void *h_slob_alloc(HAllocator *mm, size_t size)
 {
     SLOB *slob = (SLOB *)(mm+1);
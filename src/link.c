@@ -46,11 +46,17 @@ static const uint16_t crctable[256] = {
     0x91AF, 0xA7F1, 0xFD13, 0xCB4D, 0x48D7, 0x7E89, 0x246B, 0x1235
 };
 
+// feed one byte into a running (uninverted) CRC
+static inline uint16_t crc_update(uint16_t crc, uint8_t byte)
+{
+    return (crc>>8) ^ crctable[((uint8_t)crc ^ byte) & 0xFF];
+}
+
 uint16_t dnp3_crc(uint8_t *bytes, size_t len)
 {
     uint16_t crc = 0;
     for(size_t i=0; i<len; i++) {
-        crc = (crc>>8) ^ crctable[((uint8_t)crc ^ bytes[i]) & 0xFF];
+        crc = crc_update(crc, bytes[i]);
     }
     crc = ~crc; // invert
 
@@ -309,3 +315,83 @@ bool dnp3_link_fcv(const DNP3_Frame *frame)
         return 0;
     }
 }
+
+
+// frame encoding...
+
+// append the CRC over the last block, little-endian
+static uint8_t *put_crc(uint8_t *out, uint16_t crc)
+{
+    crc = ~crc;
+    *out++ = crc & 0xFF;
+    *out++ = crc >> 8;
+    return out;
+}
+
+size_t dnp3_link_encode_framev(uint8_t *buf, size_t bufsize,
+                               const DNP3_Frame *frame,
+                               const HBytes *payload, size_t n)
+{
+    size_t len = 0;
+    for(size_t i=0; i<n; i++)
+        len += payload[i].len;
+    if(len > DNP3_MAX_PAYLOAD || bufsize < dnp3_link_size(len))
+        return 0;
+
+    uint8_t *out = buf;
+    uint16_t crc = 0;
+
+    // header
+    uint8_t ctrl = (frame->dir << 7) | ((frame->func & 0x10) << 2)
+                 | (frame->fcb << 5) | (frame->fcv << 4) | (frame->func & 0xF);
+    uint8_t hdr[8] = {0x05, 0x64, len + 5, ctrl,
+                      frame->destination & 0xFF, frame->destination >> 8,
+                      frame->source & 0xFF, frame->source >> 8};
+    for(int i=0; i<8; i++)
+        crc = crc_update(crc, *out++ = hdr[i]);
+    out = put_crc(out, crc);
+
+    // payload in blocks of 16 bytes, each followed by its CRC
+    size_t k = 0;   // bytes in the current block
+    crc = 0;
+    for(size_t i=0; i<n; i++) {
+        for(size_t j=0; j<payload[i].len; j++) {
+            crc = crc_update(crc, *out++ = payload[i].token[j]);
+            if(++k == 16) {
+                out = put_crc(out, crc);
+                crc = 0;
+                k = 0;
+            }
+        }
+    }
+    if(k > 0)
+        out = put_crc(out, crc);
+
+    assert(out - buf == dnp3_link_size(len));
+    return out - buf;
+}
+
+size_t dnp3_link_encode_frame(uint8_t *buf, size_t bufsize,
+                              const DNP3_Frame *frame)
+{
+    HBytes payload = {frame->payload, frame->len > 0 ? frame->len : 0};
+
+    if(frame->len > 0 && !frame->payload)
+        return 0;
+    return dnp3_link_encode_framev(buf, bufsize, frame, &payload, 1);
+}
+
+size_t dnp3_link_encode_frames(uint8_t *buf, size_t bufsize,
+                               const DNP3_Frame *frames, size_t n)
+{
+    size_t m = 0;
+
+    for(size_t i=0; i<n; i++) {
+        size_t k = dnp3_link_encode_frame(buf + m, bufsize - m, &frames[i]);
+        if(k == 0)
+            return 0;
+        m += k;
+    }
+
+    return m;
+}
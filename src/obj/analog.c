@@ -48,19 +48,31 @@ static HParsedToken *act_int_noflag(const HParseResult *p, void *user)
 #define act_int32_noflag act_int_noflag
 #define act_int16_noflag act_int_noflag
 
-static HParsedToken *act_flags(const HParseResult *p, void *user)
+// flag octets (bit 0 first)
+DNP3_Flags dnp3_ana_flags(uint8_t x)
 {
-    DNP3_Object *o = H_ALLOC(DNP3_Object);
-
-    o->flags.online          = H_FIELD_UINT(0);
-    o->flags.restart         = H_FIELD_UINT(1);
-    o->flags.comm_lost       = H_FIELD_UINT(2);
-    o->flags.remote_forced   = H_FIELD_UINT(3);
-    o->flags.local_forced    = H_FIELD_UINT(4);
-    o->flags.over_range      = H_FIELD_UINT(5);
-    o->flags.reference_err   = H_FIELD_UINT(6);
+    DNP3_Flags f = {0};
+
+    f.online          = x & 1;
+    f.restart         = (x >> 1) & 1;
+    f.comm_lost       = (x >> 2) & 1;
+    f.remote_forced   = (x >> 3) & 1;
+    f.local_forced    = (x >> 4) & 1;
+    f.over_range      = (x >> 5) & 1;
+    f.reference_err   = (x >> 6) & 1;
+                                        // bit 7 reserved
+    return f;
+}
 
-    return H_MAKE(DNP3_Object, o);
+uint8_t dnp3_ana_octet(DNP3_Flags f)
+{
+    return f.online
+         | f.restart << 1
+         | f.comm_lost << 2
+         | f.remote_forced << 3
+         | f.local_forced << 4
+         | f.over_range << 5
+         | f.reference_err << 6;
 }
 
 static HParsedToken *act_int_flag(const HParseResult *p, void *user)
@@ -238,18 +250,8 @@ static HParsedToken *act_flt_cmdev_time(const HParseResult *p, void *user)
 
 void dnp3_p_init_analog(void)
 {
-    H_RULE (bit,         h_bits(1, false));
     H_RULE (reserved,    dnp3_p_reserved(1));
-
-    H_ARULE(flags,      h_sequence(bit,    // ONLINE
-                                   bit,    // RESTART
-                                   bit,    // COMM_LOST
-                                   bit,    // REMOTE_FORCED
-                                   bit,    // LOCAL_FORCED
-                                   bit,    // OVER_RANGE
-                                   bit,    // REFERENCE_ERR
-                                   reserved,
-                                   NULL));
+    H_RULE (flags,       dnp3_p_flags(dnp3_ana_flags, ANA_FLAGS_RESERVED));
 
     H_RULE (int32,      h_int32());
     H_RULE (int16,      h_int16());
@@ -312,9 +314,9 @@ void dnp3_p_init_analog(void)
                                             V(ANAIN, FLOAT),
                                             V(ANAIN, DOUBLE), 0);
     dnp3_p_anain_fblock     = dnp3_p_specific_rblock(G(ANAIN), DNP3_VARIATION_ANY);
-    dnp3_p_anain_oblock     = h_choice(oblock_i32fl, oblock_i16fl,
-                                       oblock_i32nofl, oblock_i16nofl,
-                                       oblock_f32fl, oblock_f64fl, NULL);
+    dnp3_p_anain_oblock     = dnp3_p_blockchoice(oblock_i32fl, oblock_i16fl,
+                                                 oblock_i32nofl, oblock_i16nofl,
+                                                 oblock_f32fl, oblock_f64fl, NULL);
 
     // group 31: frozen analog inputs...
     H_RULE(oblock_frzi32fl,    dnp3_p_oblock(G_V(FROZENANAIN, 32BIT), int32_flag));
@@ -335,10 +337,10 @@ void dnp3_p_init_analog(void)
                                                   V(FROZENANAIN, 16BIT_NOFLAG),
                                                   V(FROZENANAIN, FLOAT),
                                                   V(FROZENANAIN, DOUBLE), 0);
-    dnp3_p_frozenanain_oblock     = h_choice(oblock_frzi32fl, oblock_frzi16fl,
-                                             oblock_frzi32fl_t, oblock_frzi16fl_t,
-                                             oblock_frzi32nofl, oblock_frzi16nofl,
-                                             oblock_frzf32fl, oblock_frzf64fl, NULL);
+    dnp3_p_frozenanain_oblock     = dnp3_p_blockchoice(oblock_frzi32fl, oblock_frzi16fl,
+                                                       oblock_frzi32fl_t, oblock_frzi16fl_t,
+                                                       oblock_frzi32nofl, oblock_frzi16nofl,
+                                                       oblock_frzf32fl, oblock_frzf64fl, NULL);
 
     // group 32: analog input events...
     H_RULE(oblock_evi32fl,    dnp3_p_oblock(G_V(ANAINEV, 32BIT), int32_flag));
@@ -359,10 +361,10 @@ void dnp3_p_init_analog(void)
                                               V(ANAINEV, DOUBLE),
                                               V(ANAINEV, FLOAT_TIME),
                                               V(ANAINEV, DOUBLE_TIME), 0);
-    dnp3_p_anainev_oblock     = h_choice(oblock_evi32fl, oblock_evi16fl,
-                                         oblock_evi32fl_t, oblock_evi16fl_t,
-                                         oblock_evf32fl, oblock_evf64fl,
-                                         oblock_evf32fl_t, oblock_evf64fl_t, NULL);
+    dnp3_p_anainev_oblock     = dnp3_p_blockchoice(oblock_evi32fl, oblock_evi16fl,
+                                                   oblock_evi32fl_t, oblock_evi16fl_t,
+                                                   oblock_evf32fl, oblock_evf64fl,
+                                                   oblock_evf32fl_t, oblock_evf64fl_t, NULL);
 
     // group 33: frozen analog input events...
     H_RULE(oblock_frzevi32fl,    dnp3_p_oblock(G_V(FROZENANAINEV, 32BIT), int32_flag));
@@ -383,10 +385,10 @@ void dnp3_p_init_analog(void)
                                                     V(FROZENANAINEV, DOUBLE),
                                                     V(FROZENANAINEV, FLOAT_TIME),
                                                     V(FROZENANAINEV, DOUBLE_TIME), 0);
-    dnp3_p_frozenanainev_oblock     = h_choice(oblock_frzevi32fl, oblock_frzevi16fl,
-                                               oblock_frzevi32fl_t, oblock_frzevi16fl_t,
-                                               oblock_frzevf32fl, oblock_frzevf64fl,
-                                               oblock_frzevf32fl_t, oblock_frzevf64fl_t, NULL);
+    dnp3_p_frozenanainev_oblock     = dnp3_p_blockchoice(oblock_frzevi32fl, oblock_frzevi16fl,
+                                                         oblock_frzevi32fl_t, oblock_frzevi16fl_t,
+                                                         oblock_frzevf32fl, oblock_frzevf64fl,
+                                                         oblock_frzevf32fl_t, oblock_frzevf64fl_t, NULL);
 
     // group 34: analog input deadbands...
     H_RULE(oblock_dbi16,    dnp3_p_oblock(G_V(ANAINDEADBAND, 16BIT), deadband_16));
@@ -397,7 +399,7 @@ void dnp3_p_init_analog(void)
                                                 V(ANAINDEADBAND, 16BIT),
                                                 V(ANAINDEADBAND, 32BIT),
                                                 V(ANAINDEADBAND, FLOAT), 0);
-    dnp3_p_anaindeadband_oblock = h_choice(oblock_dbi16, oblock_dbi32, oblock_dbf32, NULL);
+    dnp3_p_anaindeadband_oblock = dnp3_p_blockchoice(oblock_dbi16, oblock_dbi32, oblock_dbf32, NULL);
 
     // group 40: analog output status...
     H_RULE(oblock_stati32,    dnp3_p_oblock(G_V(ANAOUTSTATUS, 32BIT), int32_flag));
@@ -410,8 +412,8 @@ void dnp3_p_init_analog(void)
                                                V(ANAOUTSTATUS, 16BIT),
                                                V(ANAOUTSTATUS, FLOAT),
                                                V(ANAOUTSTATUS, DOUBLE), 0);
-    dnp3_p_anaoutstatus_oblock = h_choice(oblock_stati32, oblock_stati16,
-                                          oblock_statf32, oblock_statf64, NULL);
+    dnp3_p_anaoutstatus_oblock = dnp3_p_blockchoice(oblock_stati32, oblock_stati16,
+                                                    oblock_statf32, oblock_statf64, NULL);
 
     // group 41: analog outputs...
     H_RULE(oblock_outi32_s,  dnp3_p_oblock(G_V(ANAOUT, 32BIT), int32_out_s));
@@ -431,10 +433,10 @@ void dnp3_p_init_analog(void)
                                              V(ANAOUT, 16BIT),
                                              V(ANAOUT, FLOAT),
                                              V(ANAOUT, DOUBLE), 0);
-    dnp3_p_anaout_sblock     = h_choice(oblock_outi32_s, oblock_outi16_s,
-                                        oblock_outf32_s, oblock_outf64_s, NULL);
-    dnp3_p_anaout_oblock     = h_choice(oblock_outi32, oblock_outi16,
-                                        oblock_outf32, oblock_outf64, NULL);
+    dnp3_p_anaout_sblock     = dnp3_p_blockchoice(oblock_outi32_s, oblock_outi16_s,
+                                                  oblock_outf32_s, oblock_outf64_s, NULL);
+    dnp3_p_anaout_oblock     = dnp3_p_blockchoice(oblock_outi32, oblock_outi16,
+                                                  oblock_outf32, oblock_outf64, NULL);
 
     // group 42: analog output events...
     H_RULE(oblock_outevi32,    dnp3_p_oblock(G_V(ANAOUTEV, 32BIT), int32_flag));
@@ -455,10 +457,10 @@ void dnp3_p_init_analog(void)
                                            V(ANAOUTEV, DOUBLE),
                                            V(ANAOUTEV, FLOAT_TIME),
                                            V(ANAOUTEV, DOUBLE_TIME), 0);
-    dnp3_p_anaoutev_oblock = h_choice(oblock_outevi32, oblock_outevi16,
-                                      oblock_outevi32_t, oblock_outevi16_t,
-                                      oblock_outevf32, oblock_outevf64,
-                                      oblock_outevf32_t, oblock_outevf64_t, NULL);
+    dnp3_p_anaoutev_oblock = dnp3_p_blockchoice(oblock_outevi32, oblock_outevi16,
+                                                oblock_outevi32_t, oblock_outevi16_t,
+                                                oblock_outevf32, oblock_outevf64,
+                                                oblock_outevf32_t, oblock_outevf64_t, NULL);
 
     // group 43: analog output command events...
     H_RULE(oblock_cmdevi32,    dnp3_p_oblock(G_V(ANAOUTCMDEV, 32BIT), int32_cmdev));
@@ -479,8 +481,8 @@ void dnp3_p_init_analog(void)
                                               V(ANAOUTCMDEV, DOUBLE),
                                               V(ANAOUTCMDEV, FLOAT_TIME),
                                               V(ANAOUTCMDEV, DOUBLE_TIME), 0);
-    dnp3_p_anaoutcmdev_oblock = h_choice(oblock_cmdevi32, oblock_cmdevi16,
-                                         oblock_cmdevi32_t, oblock_cmdevi16_t,
-                                         oblock_cmdevf32, oblock_cmdevf64,
-                                         oblock_cmdevf32_t, oblock_cmdevf64_t, NULL);
+    dnp3_p_anaoutcmdev_oblock = dnp3_p_blockchoice(oblock_cmdevi32, oblock_cmdevi16,
+                                                   oblock_cmdevi32_t, oblock_cmdevi16_t,
+                                                   oblock_cmdevf32, oblock_cmdevf64,
+                                                   oblock_cmdevf32_t, oblock_cmdevf64_t, NULL);
 }
@@ -4,6 +4,15 @@
 
 void dnp3_p_init_analog(void);
 
+// decode flag octets (also analog outputs); bits in the reserved mask must
+// be zero
+DNP3_Flags dnp3_ana_flags(uint8_t x);
+
+// encode a flag octet, the inverse of the above
+uint8_t dnp3_ana_octet(DNP3_Flags f);
+
+#define ANA_FLAGS_RESERVED      0x80
+
 extern HParser *dnp3_p_anain_rblock;
 extern HParser *dnp3_p_anain_fblock;    // for freeze - always variation 0
 extern HParser *dnp3_p_anain_oblock;
@@ -41,35 +41,60 @@ static HParsedToken *act_packed2(const HParseResult *p, void *user)
     return H_MAKE(DNP3_Object, o);
 }
 
-static HParsedToken *act_flags(const HParseResult *p, void *user)
+// flag octets (bit 0 first)
+DNP3_Flags dnp3_binin_flags(uint8_t x)
 {
-    DNP3_Object *o = H_ALLOC(DNP3_Object);
+    DNP3_Flags f = {0};
+
+    f.online          = x & 1;
+    f.restart         = (x >> 1) & 1;
+    f.comm_lost       = (x >> 2) & 1;
+    f.remote_forced   = (x >> 3) & 1;
+    f.local_forced    = (x >> 4) & 1;
+    f.chatter_filter  = (x >> 5) & 1;
+                                        // bit 6 reserved
+    f.state           = (x >> 7) & 1;
+
+    return f;
+}
 
-    o->flags.online          = H_FIELD_UINT(0);
-    o->flags.restart         = H_FIELD_UINT(1);
-    o->flags.comm_lost       = H_FIELD_UINT(2);
-    o->flags.remote_forced   = H_FIELD_UINT(3);
-    o->flags.local_forced    = H_FIELD_UINT(4);
-    o->flags.chatter_filter  = H_FIELD_UINT(5);
-    o->flags.state           = H_FIELD_UINT(6);
+DNP3_Flags dnp3_dblbit_flags(uint8_t x)
+{
+    DNP3_Flags f = dnp3_binin_flags(x);
 
-    return H_MAKE(DNP3_Object, o);
+    f.state           = (x >> 6) & 3;   // DNP3_DblBit
+
+    return f;
 }
 
-#define act_flags2 act_flags
+DNP3_Flags dnp3_binout_flags(uint8_t x)
+{
+    DNP3_Flags f = dnp3_binin_flags(x);
+
+    f.chatter_filter  = 0;              // bits 5,6 reserved
 
-static HParsedToken *act_outflags(const HParseResult *p, void *user)
+    return f;
+}
+
+uint8_t dnp3_binin_octet(DNP3_Flags f)
 {
-    DNP3_Object *o = H_ALLOC(DNP3_Object);
+    return f.online
+         | f.restart << 1
+         | f.comm_lost << 2
+         | f.remote_forced << 3
+         | f.local_forced << 4
+         | f.chatter_filter << 5
+         | (f.state & 1) << 7;
+}
 
-    o->flags.online          = H_FIELD_UINT(0);
-    o->flags.restart         = H_FIELD_UINT(1);
-    o->flags.comm_lost       = H_FIELD_UINT(2);
-    o->flags.remote_forced   = H_FIELD_UINT(3);
-    o->flags.local_forced    = H_FIELD_UINT(4);
-    o->flags.state           = H_FIELD_UINT(5);
+uint8_t dnp3_dblbit_octet(DNP3_Flags f)
+{
+    return (dnp3_binin_octet(f) & 0x3F) | f.state << 6;
+}
 
-    return H_MAKE(DNP3_Object, o);
+uint8_t dnp3_binout_octet(DNP3_Flags f)
+{
+    return dnp3_binin_octet(f) & ~BINOUT_FLAGS_RESERVED;
 }
 
 static HParsedToken *act_flags_abs(const HParseResult *p, void *user)
@@ -89,7 +114,7 @@ static HParsedToken *act_flags_rel(const HParseResult *p, void *user)
 
     // p = (flags, reltime)
     o->timed.flags = H_FIELD(DNP3_Object, 0)->flags;
-    o->timed.reltime = H_FIELD_UINT(1);
+    o->timed.reltime = H_FIELD_UINT(1);     // resolved by act_fragment
 
     return H_MAKE(DNP3_Object, o);
 }
@@ -101,36 +126,12 @@ void dnp3_p_init_binary(void)
 {
     H_RULE (bit,         h_bits(1, false));
     H_RULE (dblbit,      h_bits(2, false));
-    H_RULE (reserved,    dnp3_p_reserved(1));
 
     H_ARULE(packed,     bit);
     H_ARULE(packed2,    dblbit);
-    H_ARULE(flags,      h_sequence(bit,    // ONLINE
-                                   bit,    // RESTART
-                                   bit,    // COMM_LOST
-                                   bit,    // REMOTE_FORCED
-                                   bit,    // LOCAL_FORCED
-                                   bit,    // CHATTER_FILTER
-                                   reserved,
-                                   bit,    // STATE
-                                   NULL));
-    H_ARULE(flags2,     h_sequence(bit,    // ONLINE
-                                   bit,    // RESTART
-                                   bit,    // COMM_LOST
-                                   bit,    // REMOTE_FORCED
-                                   bit,    // LOCAL_FORCED
-                                   bit,    // CHATTER_FILTER
-                                   dblbit, // STATE
-                                   NULL));
-    H_ARULE(outflags,   h_sequence(bit,    // ONLINE
-                                   bit,    // RESTART
-                                   bit,    // COMM_LOST
-                                   bit,    // REMOTE_FORCED
-                                   bit,    // LOCAL_FORCED
-                                   reserved,
-                                   reserved,
-                                   bit,    // STATE
-                                   NULL));
+    H_RULE (flags,      dnp3_p_flags(dnp3_binin_flags, BININ_FLAGS_RESERVED));
+    H_RULE (flags2,     dnp3_p_flags(dnp3_dblbit_flags, DBLBIT_FLAGS_RESERVED));
+    H_RULE (outflags,   dnp3_p_flags(dnp3_binout_flags, BINOUT_FLAGS_RESERVED));
 
     H_ARULE(flags_abs,  h_sequence(flags, dnp3_p_dnp3time, NULL));
     H_ARULE(flags_rel,  h_sequence(flags, dnp3_p_reltime, NULL));
@@ -145,7 +146,7 @@ void dnp3_p_init_binary(void)
     dnp3_p_binin_rblock     = dnp3_p_rblock(G(BININ),
                                             V(BININ, PACKED),
                                             V(BININ, FLAGS), 0);
-    dnp3_p_binin_oblock     = h_choice(oblock_packed, oblock_flags, NULL);
+    dnp3_p_binin_oblock     = dnp3_p_blockchoice(oblock_packed, oblock_flags, NULL);
 
     // group 2: binary input events...
     H_RULE (oblock_notime,      dnp3_p_oblock(G_V(BININEV, NOTIME), flags));
@@ -156,9 +157,9 @@ void dnp3_p_init_binary(void)
                                             V(BININEV, NOTIME),
                                             V(BININEV, ABSTIME),
                                             V(BININEV, RELTIME), 0);
-    dnp3_p_bininev_oblock   = h_choice(oblock_notime,
-                                       oblock_abstime,
-                                       oblock_reltime, NULL);
+    dnp3_p_bininev_oblock   = dnp3_p_blockchoice(oblock_notime,
+                                                 oblock_abstime,
+                                                 oblock_reltime, NULL);
 
     // group 3: double-bit binary inputs...
     H_RULE (oblock_packed2,     dnp3_p_oblock_packed(G_V(DBLBITIN, PACKED), packed2));
@@ -167,7 +168,7 @@ void dnp3_p_init_binary(void)
     dnp3_p_dblbitin_rblock  = dnp3_p_rblock(G(DBLBITIN),
                                             V(DBLBITIN, PACKED),
                                             V(DBLBITIN, FLAGS), 0);
-    dnp3_p_dblbitin_oblock  = h_choice(oblock_packed2, oblock_flags2, NULL);
+    dnp3_p_dblbitin_oblock  = dnp3_p_blockchoice(oblock_packed2, oblock_flags2, NULL);
 
     // group 4: double-bit binary input events...
     H_RULE (oblock_notime2,     dnp3_p_oblock(G_V(DBLBITINEV, NOTIME), flags2));
@@ -178,9 +179,9 @@ void dnp3_p_init_binary(void)
                                              V(DBLBITINEV, NOTIME),
                                              V(DBLBITINEV, ABSTIME),
                                              V(DBLBITINEV, RELTIME), 0);
-    dnp3_p_dblbitinev_oblock = h_choice(oblock_notime2,
-                                        oblock_abstime2,
-                                        oblock_reltime2, NULL);
+    dnp3_p_dblbitinev_oblock = dnp3_p_blockchoice(oblock_notime2,
+                                                  oblock_abstime2,
+                                                  oblock_reltime2, NULL);
 
     // group 10: binary outputs...
     H_RULE (oblock_outpacked,   dnp3_p_oblock_packed(G_V(BINOUT, PACKED), packed));
@@ -189,7 +190,7 @@ void dnp3_p_init_binary(void)
     dnp3_p_binout_rblock    = dnp3_p_rblock(G(BINOUT),
                                             V(BINOUT, PACKED),
                                             V(BINOUT, FLAGS), 0);
-    dnp3_p_binout_oblock    = h_choice(oblock_outpacked, oblock_outflags, NULL);
+    dnp3_p_binout_oblock    = dnp3_p_blockchoice(oblock_outpacked, oblock_outflags, NULL);
     dnp3_p_g10v1_binout_packed_oblock = oblock_outpacked;
 
     // group 11: binary output events...
@@ -199,6 +200,6 @@ void dnp3_p_init_binary(void)
     dnp3_p_binoutev_rblock  = dnp3_p_rblock(G(BINOUTEV),
                                             V(BINOUTEV, NOTIME),
                                             V(BINOUTEV, ABSTIME), 0);
-    dnp3_p_binoutev_oblock  = h_choice(oblock_outnotime,
-                                       oblock_outabstime, NULL);
+    dnp3_p_binoutev_oblock  = dnp3_p_blockchoice(oblock_outnotime,
+                                                 oblock_outabstime, NULL);
 }
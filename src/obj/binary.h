@@ -4,6 +4,20 @@
 
 void dnp3_p_init_binary(void);
 
+// decode flag octets; bits in the reserved masks must be zero
+DNP3_Flags dnp3_binin_flags(uint8_t x);     // also binary output events
+DNP3_Flags dnp3_dblbit_flags(uint8_t x);
+DNP3_Flags dnp3_binout_flags(uint8_t x);
+
+// encode flag octets, the inverse of the above
+uint8_t dnp3_binin_octet(DNP3_Flags f);
+uint8_t dnp3_dblbit_octet(DNP3_Flags f);
+uint8_t dnp3_binout_octet(DNP3_Flags f);
+
+#define BININ_FLAGS_RESERVED    0x40
+#define DBLBIT_FLAGS_RESERVED   0x00
+#define BINOUT_FLAGS_RESERVED   0x60
+
 extern HParser *dnp3_p_binin_rblock;
 extern HParser *dnp3_p_binin_oblock;
 
@@ -106,6 +106,6 @@ void dnp3_p_init_binoutcmd(void)
     dnp3_p_binoutcmdev_rblock = dnp3_p_rblock(G(BINOUTCMDEV),
                                               V(BINOUTCMDEV, NOTIME),
                                               V(BINOUTCMDEV, ABSTIME), 0);
-    dnp3_p_binoutcmdev_oblock = h_choice(oblock_notime,
-                                         oblock_abstime, NULL);
+    dnp3_p_binoutcmdev_oblock = dnp3_p_blockchoice(oblock_notime,
+                                                   oblock_abstime, NULL);
 }
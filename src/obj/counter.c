@@ -18,18 +18,30 @@ HParser *dnp3_p_frozenctrev_rblock;
 HParser *dnp3_p_frozenctrev_oblock;
 
 
-static HParsedToken *act_flags(const HParseResult *p, void *user)
+// flag octets (bit 0 first)
+DNP3_Flags dnp3_ctr_flags(uint8_t x)
 {
-    DNP3_Object *o = H_ALLOC(DNP3_Object);
-
-    o->flags.online          = H_FIELD_UINT(0);
-    o->flags.restart         = H_FIELD_UINT(1);
-    o->flags.comm_lost       = H_FIELD_UINT(2);
-    o->flags.remote_forced   = H_FIELD_UINT(3);
-    o->flags.local_forced    = H_FIELD_UINT(4);
-    o->flags.discontinuity   = H_FIELD_UINT(5);
+    DNP3_Flags f = {0};
+
+    f.online          = x & 1;
+    f.restart         = (x >> 1) & 1;
+    f.comm_lost       = (x >> 2) & 1;
+    f.remote_forced   = (x >> 3) & 1;
+    f.local_forced    = (x >> 4) & 1;
+                                        // bit 5 (ROLLOVER) obsolete, ignored
+    f.discontinuity   = (x >> 6) & 1;
+                                        // bit 7 reserved
+    return f;
+}
 
-    return H_MAKE(DNP3_Object, o);
+uint8_t dnp3_ctr_octet(DNP3_Flags f)
+{
+    return f.online
+         | f.restart << 1
+         | f.comm_lost << 2
+         | f.remote_forced << 3
+         | f.local_forced << 4
+         | f.discontinuity << 6;
 }
 
 static HParsedToken *act_ctr_flag(const HParseResult *p, void *user)
@@ -73,19 +85,7 @@ static HParsedToken *act_ctr(const HParseResult *p, void *user)
 
 void dnp3_p_init_counter(void)
 {
-    H_RULE (bit,        h_bits(1,false));
-    H_RULE (ignore,     h_ignore(bit));
-    H_RULE (reserved,   dnp3_p_reserved(1));
-
-    H_ARULE(flags,      h_sequence(bit,         // ONLINE
-                                   bit,         // RESTART
-                                   bit,         // COMM_LOST
-                                   bit,         // REMOTE_FORCED
-                                   bit,         // LOCAL_FORCED
-                                   ignore,      // (ROLLOVER - obsolete)
-                                   bit,         // DISCONTINUITY
-                                   reserved,
-                                   NULL));
+    H_RULE (flags,      dnp3_p_flags(dnp3_ctr_flags, CTR_FLAGS_RESERVED));
     H_RULE (val32,      h_uint32());
     H_RULE (val16,      h_uint16());
 
@@ -107,11 +107,11 @@ void dnp3_p_init_counter(void)
                                               V(CTR, 32BIT_NOFLAG),
                                               V(CTR, 32BIT_NOFLAG), 0);
     dnp3_p_ctr_fblock = dnp3_p_specific_rblock(G(CTR), DNP3_VARIATION_ANY);
-    dnp3_p_ctr_oblock = h_choice(oblock_32bit_flag,
-                                 oblock_16bit_flag,
-                                 oblock_32bit_noflag,
-                                 oblock_16bit_noflag,
-                                 NULL);
+    dnp3_p_ctr_oblock = dnp3_p_blockchoice(oblock_32bit_flag,
+                                           oblock_16bit_flag,
+                                           oblock_32bit_noflag,
+                                           oblock_16bit_noflag,
+                                           NULL);
 
     // group 21: frozen counters...
     H_RULE(oblock_frz32bit_flag,   dnp3_p_oblock(G_V(FROZENCTR, 32BIT), ctr32_flag));
@@ -128,13 +128,13 @@ void dnp3_p_init_counter(void)
                                             V(FROZENCTR, 16BIT_TIME),
                                             V(FROZENCTR, 32BIT_NOFLAG),
                                             V(FROZENCTR, 32BIT_NOFLAG), 0);
-    dnp3_p_frozenctr_oblock = h_choice(oblock_frz32bit_flag,
-                                       oblock_frz16bit_flag,
-                                       oblock_frz32bit_flag_t,
-                                       oblock_frz16bit_flag_t,
-                                       oblock_frz32bit_noflag,
-                                       oblock_frz16bit_noflag,
-                                       NULL);
+    dnp3_p_frozenctr_oblock = dnp3_p_blockchoice(oblock_frz32bit_flag,
+                                                 oblock_frz16bit_flag,
+                                                 oblock_frz32bit_flag_t,
+                                                 oblock_frz16bit_flag_t,
+                                                 oblock_frz32bit_noflag,
+                                                 oblock_frz16bit_noflag,
+                                                 NULL);
 
     // group 22: counter events...
     H_RULE(oblock_ev32bit_flag,   dnp3_p_oblock(G_V(CTREV, 32BIT), ctr32_flag));
@@ -146,11 +146,11 @@ void dnp3_p_init_counter(void)
                                                   V(CTREV, 16BIT),
                                                   V(CTREV, 32BIT_TIME),
                                                   V(CTREV, 16BIT_TIME), 0);
-    dnp3_p_ctrev_oblock = h_choice(oblock_ev32bit_flag,
-                                   oblock_ev16bit_flag,
-                                   oblock_ev32bit_flag_t,
-                                   oblock_ev16bit_flag_t,
-                                   NULL);
+    dnp3_p_ctrev_oblock = dnp3_p_blockchoice(oblock_ev32bit_flag,
+                                             oblock_ev16bit_flag,
+                                             oblock_ev32bit_flag_t,
+                                             oblock_ev16bit_flag_t,
+                                             NULL);
 
     // group 21: frozen counter events...
     H_RULE(oblock_frzev32bit_flag,   dnp3_p_oblock(G_V(FROZENCTREV, 32BIT), ctr32_flag));
@@ -163,11 +163,11 @@ void dnp3_p_init_counter(void)
                                               V(FROZENCTREV, 16BIT),
                                               V(FROZENCTREV, 32BIT_TIME),
                                               V(FROZENCTREV, 16BIT_TIME), 0);
-    dnp3_p_frozenctrev_oblock = h_choice(oblock_frzev32bit_flag,
-                                         oblock_frzev16bit_flag,
-                                         oblock_frzev32bit_flag_t,
-                                         oblock_frzev16bit_flag_t,
-                                         NULL);
+    dnp3_p_frozenctrev_oblock = dnp3_p_blockchoice(oblock_frzev32bit_flag,
+                                                   oblock_frzev16bit_flag,
+                                                   oblock_frzev32bit_flag_t,
+                                                   oblock_frzev16bit_flag_t,
+                                                   NULL);
 }
 
 
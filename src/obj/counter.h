@@ -4,6 +4,14 @@
 
 void dnp3_p_init_counter(void);
 
+// decode flag octets; bits in the reserved mask must be zero
+DNP3_Flags dnp3_ctr_flags(uint8_t x);
+
+// encode a flag octet, the inverse of the above
+uint8_t dnp3_ctr_octet(DNP3_Flags f);
+
+#define CTR_FLAGS_RESERVED      0x80
+
 extern HParser *dnp3_p_ctr_rblock;
 extern HParser *dnp3_p_ctr_fblock;      // for freeze - always variation 0
 extern HParser *dnp3_p_ctr_oblock;
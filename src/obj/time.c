@@ -105,12 +105,12 @@ void dnp3_p_init_time(void)
     H_RULE (oblock_cto_sync,    dnp3_p_single(G_V(CTO, SYNC), time));
     H_RULE (oblock_cto_unsync,  dnp3_p_single(G_V(CTO, UNSYNC), time));
 
-    dnp3_p_cto_oblock = h_choice(oblock_cto_sync, oblock_cto_unsync, NULL);
+    dnp3_p_cto_oblock = dnp3_p_blockchoice(oblock_cto_sync, oblock_cto_unsync, NULL);
 
     // group 52 (delays)...
     // XXX is single (qc=07,range=1) correct for group 52 (delays)?
     H_RULE (oblock_delay_s,     dnp3_p_single(G_V(DELAY, S), delay_s));
     H_RULE (oblock_delay_ms,    dnp3_p_single(G_V(DELAY, MS), delay_ms));
 
-    dnp3_p_delay_oblock = h_choice(oblock_delay_s, oblock_delay_ms, NULL);
+    dnp3_p_delay_oblock = dnp3_p_blockchoice(oblock_delay_s, oblock_delay_ms, NULL);
 }
@@ -1,66 +1,120 @@
-
 #include <dnp3hammer.h>
 
 #include <hammer/hammer.h>
 #include <hammer/glue.h>
-#include <stdlib.h>     // malloc
+#include <string.h>     // memset
+#include <stdarg.h>
+#include <assert.h>
 #include "hammer.h"
 #include "app.h"
 #include "util.h"
-
-
-static HParser *range_index;
-static HParser *range_addr;
-static HParser *range_none;
-static HParser *range_count;
-static HParser *range_max;
-static HParser *range_count1;
-static HParser *range_vfcount;
-static HParser *range_vfcount1;
-
-static HParser *ohdr_irange;
-static HParser *ohdr_arange;
-static HParser *ohdr_all;
-static HParser *ohdr_count;
-static HParser *ohdr_max;
-static HParser *ohdr_count1;
-
-static HParser *rblock_;
-static HParser *rblock_max;
-
-static HParser *get_rsc;
-static HParser *get_base;
-
-
-// prefix code
-static HParser *withpc(uint8_t x, HParser *p)
+#include "record.h"
+
+
+// qualifier codes and their meanings:
+//
+//   0[0-2]      index range
+//   0[3-5]      address range
+//   06          "all" ((read?) requests only)
+//   0[7-9]      (max) count
+//   [1-3][7-9]  index list (count + index prefix)
+//   [4-6]B      "variable format" (count + size prefix)
+//
+// the qualifier octet is read as a whole and looked up in a table of parsers
+// for the range field and objects that follow it (cf. struct Body).
+// the parsers in the table know their qualifier code and deliver a
+// DNP3_ObjectBlock directly.
+
+enum QualifierKind {
+    Q_INVALID = 0,
+    Q_RANGE,            // range field (start,stop)
+    Q_ALL,              // no range field
+    Q_COUNT,            // range field (count)
+    Q_INDEX,            // range field (count), objects prefixed with index
+    Q_SIZE              // range field (count), objects prefixed with size
+};
+
+struct Qualifier {
+    uint8_t kind;       // enum QualifierKind
+    uint8_t pwidth;     // width of object prefix [bytes]
+    uint8_t rwidth;     // width of range field(s) [bytes]
+};
+
+static struct Qualifier qualifiers[256];    // by qualifier octet
+
+// body flags: which qualifiers to accept in a block (cf. body())
+#define B_RANGE     (1 << Q_RANGE)
+#define B_ALL       (1 << Q_ALL)
+#define B_COUNT     (1 << Q_COUNT)
+#define B_INDEX     (1 << Q_INDEX)
+#define B_SIZE      (1 << Q_SIZE)
+#define B_COUNT16   0x100               // limit counts to 16 bits
+#define B_SINGLE    0x200               // require count == 1
+#define B_RAW       0x400               // keep objects raw (cf. rawobj)
+
+// parsers for what follows the qualifier octet, by qualifier code
+struct Body {
+    HParser *slot[128];     // NULL if not allowed; bit 7 is reserved
+    uint16_t objsize;       // object size for header-only parsing (see below)
+    unsigned flags;         // B_*
+    struct Body *raw;       // variant with B_RAW, see raw_body()
+};
+
+static struct Body *body_rblock;        // read requests
+static struct Body *body_all;           // qc=06 only
+static struct Body *body_max;           // qc=06-08
+static struct Body *body_count1;        // qc=07, count 1
+
+static HParser *uint_[5];               // by width in bytes (1, 2, 4)
+static HParser *count_[5];              // nonzero count by width
+
+static HParser *reject;                 // counts an admission failure
+static size_t admission_rejects;        // updated atomically
+
+static HParser *qc_octet;
+static HParser *gv_octets;
+static HParser *gvq_octets;
+static HParser *ohdr[NOHDR];            // header-only blocks, by OHDR_*
+
+// object sizes for header-only parsing, in bits (cf. dnp3_p_ohdr)
+#define SIZE_UNKNOWN    0xFFFF      // group/variation not known
+#define SIZE_VF         0xFFFE      // variable format, size prefix per object
+
+static uint16_t *objsizes[256];     // by group and variation
+static HParser *ohdr_unknown;
+static HParser *ohdr_unknown_rest;
+
+
+// allocate a DNP3_ObjectBlock for the given qualifier code
+static DNP3_ObjectBlock *new_block(HArena *arena, uint8_t qc)
 {
-    H_RULE(pc_, h_bits(3, false));
-    H_RULE(pc,  bit_big_endian(h_right(dnp3_p_reserved(1), pc_)));
-
-    return h_sequence(dnp3_p_int_exact(pc,x), p, NULL);
+    DNP3_ObjectBlock *ob = h_arena_malloc(arena, sizeof(DNP3_ObjectBlock));
+
+    ob->group = 0;          // filled in by make_block
+    ob->variation = 0;
+    ob->count = 0;
+    ob->range_base = 0;
+    ob->indexes = NULL;
+    ob->objects = NULL;
+    ob->records = NULL;
+    ob->raw = NULL;
+    ob->stride = 0;
+    ob->cto = 0;
+    ob->nocto = 1;      // until resolved (see dnp3_oblock_resolve)
+    ob->unsync = 0;
+    ob->prefixcode = qc >> 4;
+    ob->rangespec = qc & 0xF;
+
+    return ob;
 }
-static HParser *noprefix(HParser *p)
-{
-    return withpc(0, p);
-}
-
-// range specifier code
-static HParser *rsc(uint8_t x)
-{
-    HParser *p = dnp3_p_int_exact(h_bits(4, 0), x);
 
-    // funnel the rsc out via h_put_value so we can find and save it in the
-    // DNP3_ObjectBlock struct later
-    return h_put_value(p, "rsc");
-}
-
-// range fields giving an actual range
+// range fields
 static bool validate_range(HParseResult *p, void *user)
 {
-    // p->ast = (start, stop)
-    uint64_t start = H_FIELD_UINT(0);
-    uint64_t stop  = H_FIELD_UINT(1);
+    // p->ast = (start, stop) or (qc, start, stop); user = index of start
+    size_t i = (uintptr_t)user;
+    uint64_t start = H_FIELD_UINT(i);
+    uint64_t stop  = H_FIELD_UINT(i+1);
 
     // validate that start <= stop
     // validate that count (stop - start + 1) will fit in size_t
@@ -68,113 +122,291 @@ static bool validate_range(HParseResult *p, void *user)
 }
 static HParsedToken *act_range(const HParseResult *p, void *user)
 {
-    // p->ast = (start, stop)
+    // p->ast = (start, stop), user = qc
+    DNP3_ObjectBlock *ob = new_block(p->arena, (uintptr_t)user);
     uint64_t start = H_FIELD_UINT(0);
     uint64_t stop  = H_FIELD_UINT(1);
 
     assert(start <= stop);
     assert(stop - start < SIZE_MAX);
-    return H_MAKE_UINT(stop - start + 1);
+    ob->range_base = start;
+    ob->count = stop - start + 1;
 
+    return H_MAKE(DNP3_ObjectBlock, ob);
 }
-static HParser *range(uint8_t x, HParser *p)
+static HParsedToken *act_all(const HParseResult *p, void *user)
 {
-    H_RULE  (start, h_put_value(p, "range_base"));
-    H_RULE  (stop,  p);
-    H_AVRULE(range, h_sequence(start, stop, NULL));
-
-    return h_right(rsc(x), range);
+    // user = qc
+    DNP3_ObjectBlock *ob = new_block(p->arena, (uintptr_t)user);
+    return H_MAKE(DNP3_ObjectBlock, ob);
 }
 
-// range fields giving a count
+// count fields
 static bool validate_count(HParseResult *p, void *user)
 {
     return (H_CAST_UINT(p->ast) > 0);
 }
-static HParser *count(uint8_t x, HParser *p)
+static HParsedToken *act_count(const HParseResult *p, void *user)
 {
-    return h_right(rsc(x), h_attr_bool(p, validate_count, NULL));
-}
-
-// helper for actions below
-HParsedToken *count_idxs_objs(HArena *arena, size_t count, uint32_t *idxs, DNP3_Object *objs)
-{
-    HParsedToken *res = h_make_seqn(arena, 3);
-    h_seq_snoc(res, h_make_uint(arena, count));
-    h_seq_snoc(res, h_make(arena, TT_USER, idxs));
-    h_seq_snoc(res, h_make(arena, TT_DNP3_Object, objs));
-    return res;
+    // p->ast = count, user = qc
+    DNP3_ObjectBlock *ob = new_block(p->arena, (uintptr_t)user);
+    ob->count = H_CAST_UINT(p->ast);
+    return H_MAKE(DNP3_ObjectBlock, ob);
 }
 
-// semantic actions to generate the (count,idxs,objs) triple in different cases
+// semantic actions for the different cases of (prefixed) objects
 static HParsedToken *act_indexes_objects(const HParseResult *p, void *user)
 {
-    // p->ast = ((idx,obj)...)
+    // p->ast = ((idx,obj)...), user = qc
+    DNP3_ObjectBlock *ob = new_block(p->arena, (uintptr_t)user);
     size_t n = h_seq_len(p->ast);
 
-    uint32_t    *indexes = NULL;
-    DNP3_Object *objects = NULL;
+    ob->count = n;
     if(n > 0) {
-        indexes = h_arena_malloc(p->arena, 4*n);
-        objects = h_arena_malloc(p->arena, sizeof(DNP3_Object) * n);
+        ob->indexes = h_arena_malloc(p->arena, 4*n);
+        ob->objects = h_arena_malloc(p->arena, sizeof(DNP3_Object) * n);
 
         for(size_t i=0; i<n; i++) {
             HParsedToken *i_o = h_seq_index(p->ast, i);
 
-            indexes[i] = H_INDEX_UINT(i_o, 0);
-            objects[i] = *H_INDEX(DNP3_Object, i_o, 1);
+            ob->indexes[i] = H_INDEX_UINT(i_o, 0);
+            ob->objects[i] = *H_INDEX(DNP3_Object, i_o, 1);
         }
     }
 
-    return count_idxs_objs(p->arena, n, indexes, objects);
+    return H_MAKE(DNP3_ObjectBlock, ob);
 }
 static HParsedToken *act_indexes_only(const HParseResult *p, void *user)
 {
-    // p->ast = (idx...)
+    // p->ast = (idx...), user = qc
+    DNP3_ObjectBlock *ob = new_block(p->arena, (uintptr_t)user);
     size_t n = h_seq_len(p->ast);
 
-    uint32_t *indexes = NULL;
+    ob->count = n;
     if(n > 0) {
-        indexes = h_arena_malloc(p->arena, 4*n);
+        ob->indexes = h_arena_malloc(p->arena, 4*n);
 
         for(size_t i=0; i<n; i++) {
-            indexes[i] = H_FIELD_UINT(i);
+            ob->indexes[i] = H_FIELD_UINT(i);
         }
     }
 
-    return count_idxs_objs(p->arena, n, indexes, NULL);
+    return H_MAKE(DNP3_ObjectBlock, ob);
 }
-static HParsedToken *act_objects_only(const HParseResult *p, void *user)
+static DNP3_ObjectBlock *objects_only(const HParseResult *p, uint8_t qc)
 {
     // p->ast = (obj...)
+    DNP3_ObjectBlock *ob = new_block(p->arena, qc);
     size_t n = h_seq_len(p->ast);
 
-    DNP3_Object *objects = NULL;
+    ob->count = n;
     if(n > 0) {
-        objects = h_arena_malloc(p->arena, sizeof(DNP3_Object) * n);
+        ob->objects = h_arena_malloc(p->arena, sizeof(DNP3_Object) * n);
 
         for(size_t i=0; i<n; i++) {
-            objects[i] = *H_FIELD(DNP3_Object, i);
+            ob->objects[i] = *H_FIELD(DNP3_Object, i);
         }
     }
 
-    return count_idxs_objs(p->arena, n, NULL, objects);
+    return ob;
+}
+static HParsedToken *act_objects_only(const HParseResult *p, void *user)
+{
+    // p->ast = (obj...), user = qc
+    return H_MAKE(DNP3_ObjectBlock, objects_only(p, (uintptr_t)user));
 }
+static HParsedToken *act_range_objects(const HParseResult *p, void *user)
+{
+    // p->ast = (obj...), user = (qc,start,stop) token
+    const HParsedToken *r = user;
+    DNP3_ObjectBlock *ob = objects_only(p, H_INDEX_UINT(r, 0));
+
+    ob->range_base = H_INDEX_UINT(r, 1);
+    assert(ob->count == H_INDEX_UINT(r, 2) - ob->range_base + 1);
 
-static HParser *prefixed_index(HParser *idx, HParser *p)
+    return H_MAKE(DNP3_ObjectBlock, ob);
+}
+
+// raw objects...
+//
+// objects that are kept raw (B_RAW) are parsed as plain bit fields of their
+// size, yielding a uint or, above 64 bits, a sequence of two. the semantic
+// actions copy the bits into a byte array, LSB-first as on the wire.
+// the object size (stride) is passed along with the qualifier code.
+
+#define QC_STRIDE(qc, bits) ((uintptr_t)(qc) | (uintptr_t)(bits) << 8)
+
+// store the low n bits of x at bit offset k
+static void putbits(uint8_t *raw, size_t k, uint64_t x, size_t n)
 {
-    HParser *obj;
-    HAction act;
+    if(k % 8 == 0 && n % 8 == 0) {
+        for(size_t j=0; j<n/8; j++)
+            raw[k/8 + j] = x >> (8*j);
+        return;
+    }
+    for(size_t j=0; j<n; j++, k++) {
+        if((x >> j) & 1)
+            raw[k/8] |= 1 << (k%8);
+    }
+}
+
+static void putraw(uint8_t *raw, size_t i, const HParsedToken *obj,
+                   size_t stride)
+{
+    size_t k = i * stride;
 
-    if(p) {
-        obj = h_sequence(idx, p, NULL);
-        act = act_indexes_objects;
+    if(obj->token_type == TT_SEQUENCE) {
+        putbits(raw, k, H_INDEX_UINT(obj, 0), 64);
+        putbits(raw, k + 64, H_INDEX_UINT(obj, 1), stride - 64);
     } else {
-        obj = idx;
-        act = act_indexes_only;
+        putbits(raw, k, H_CAST_UINT(obj), stride);
     }
+}
+
+// p->ast = (obj...) or ((idx,obj)...), user = QC_STRIDE(qc, stride)
+static DNP3_ObjectBlock *raw_objects(const HParseResult *p, uintptr_t user,
+                                     bool indexed)
+{
+    DNP3_ObjectBlock *ob = new_block(p->arena, user & 0xFF);
+    size_t stride = user >> 8;
+    size_t n = h_seq_len(p->ast);
+
+    ob->count = n;
+    ob->stride = stride;
+    if(n > 0) {
+        size_t len = (n * stride + 7) / 8;
+        ob->raw = h_arena_malloc(p->arena, len);
+        memset(ob->raw, 0, len);
+        if(indexed)
+            ob->indexes = h_arena_malloc(p->arena, 4*n);
+
+        for(size_t i=0; i<n; i++) {
+            const HParsedToken *obj = H_FIELD_TOKEN(i);
+
+            if(indexed) {
+                ob->indexes[i] = H_INDEX_UINT(obj, 0);
+                obj = H_INDEX_TOKEN(obj, 1);
+            }
+            putraw(ob->raw, i, obj, stride);
+        }
+    }
+
+    return ob;
+}
+static HParsedToken *act_objects_raw(const HParseResult *p, void *user)
+{
+    return H_MAKE(DNP3_ObjectBlock, raw_objects(p, (uintptr_t)user, false));
+}
+static HParsedToken *act_indexes_raw(const HParseResult *p, void *user)
+{
+    return H_MAKE(DNP3_ObjectBlock, raw_objects(p, (uintptr_t)user, true));
+}
+static HParsedToken *act_range_raw(const HParseResult *p, void *user)
+{
+    // p->ast = (obj...), user = (QC_STRIDE(qc,stride),start,stop) token
+    const HParsedToken *r = user;
+    DNP3_ObjectBlock *ob = raw_objects(p, H_INDEX_UINT(r, 0), false);
+
+    ob->range_base = H_INDEX_UINT(r, 1);
+    assert(ob->count == H_INDEX_UINT(r, 2) - ob->range_base + 1);
+
+    return H_MAKE(DNP3_ObjectBlock, ob);
+}
+
+static bool validate_reserved(HParseResult *p, void *user)
+{
+    uint8_t reserved = (uintptr_t)user;
+    const HParsedToken *x = p->ast;
 
-    return h_action(h_length_value(range_count, obj), act, NULL);
+    // the flag octet comes first
+    if(x->token_type == TT_SEQUENCE)
+        x = H_INDEX_TOKEN(x, 0);
+    return ((H_CAST_UINT(x) & reserved) == 0);
+}
+
+// an object of the given size, kept raw; reserved bits of its flag octet
+// must be zero.
+static HParser *rawobj(size_t bits, uint8_t reserved)
+{
+    HParser *p;
+
+    assert(bits > 0 && bits <= 128);
+    if(bits <= 64)
+        p = dnp3_p_bits(bits, false);
+    else
+        p = h_sequence(dnp3_p_bits(64, false), dnp3_p_bits(bits - 64, false),
+                       NULL);
+    if(reserved)
+        p = h_attr_bool(p, validate_reserved, (void *)(uintptr_t)reserved);
+    return p;
+}
+
+// admission check...
+//
+// a count or range field can announce up to 2^32 objects. before parsing any
+// of them, we check that the remaining input could hold that many objects of
+// the minimum size. otherwise we would build a token for every object that
+// is present before running out of input.
+//
+// a failed check yields a PARAM_ERROR token marked as such. the fragment
+// parser counts it once it is the final result (dnp3_p_count_reject), so
+// alternatives that are backtracked over are not counted.
+
+static char admission;      // marks the error token of a failed check
+
+static HParsedToken *act_reject(const HParseResult *p, void *user)
+{
+    return h_make_err(p->arena, ERR_PARAM_ERROR, &admission);
+}
+
+void dnp3_p_count_reject(const HParsedToken *err)
+{
+    // parsers may run concurrently on different threads
+    if(err->user == &admission)
+        __atomic_add_fetch(&admission_rejects, 1, __ATOMIC_RELAXED);
+}
+
+// yield the admission error (without consuming input) iff n objects of the
+// given size do not fit, fail otherwise
+static HParser *overflow__m(HAllocator *mm__, uint64_t n, size_t bits)
+{
+    if(n > SIZE_MAX / bits)
+        return reject;
+    return h_right__m(mm__, h_not__m(mm__, h_skip__m(mm__, n * bits)), reject);
+}
+
+static HParser *k_overflow(HAllocator *mm__, const HParsedToken *n, void *env)
+{
+    return overflow__m(mm__, H_CAST_UINT(n), (uintptr_t)env);
+}
+
+// check the count parsed by cnt before parsing it again for real with p
+static HParser *admit(HParser *cnt, size_t bits, HParser *p)
+{
+    if(bits == 0)
+        return p;
+    return h_choice(h_bind(cnt, k_overflow, (void *)(uintptr_t)bits), p, NULL);
+}
+
+struct RangeObjects {
+    HParser *obj;
+    size_t bits;        // minimum object size
+    bool raw;           // B_RAW
+};
+
+// continuation for a range of objects: parse (stop-start+1) objects
+static HParser *k_range_objects(HAllocator *mm__, const HParsedToken *r, void *env)
+{
+    // r = (qc,start,stop)
+    const struct RangeObjects *ro = env;
+    uint64_t count = H_INDEX_UINT(r, 2) - H_INDEX_UINT(r, 1) + 1;
+
+    HParser *objs = h_action__m(mm__, h_repeat_n__m(mm__, ro->obj, count),
+                                ro->raw ? act_range_raw : act_range_objects,
+                                (void *)r);
+    if(ro->bits == 0)
+        return objs;
+    return h_choice__m(mm__, overflow__m(mm__, count, ro->bits), objs, NULL);
 }
 
 static HParser *k_bindvf(HAllocator *mm__, const HParsedToken *n, void *user)
@@ -183,223 +415,803 @@ static HParser *k_bindvf(HAllocator *mm__, const HParsedToken *n, void *user)
 
     return q(mm__, H_CAST_UINT(n));
 }
-static HParser *prefixed_size(HParser *vfcnt, HParser *p, HParser *(*q)(HAllocator *, size_t))
+
+// yield the given qualifier code without consuming input
+static HParsedToken *act_qc(const HParseResult *p, void *user)
+{
+    return H_MAKE_UINT((uintptr_t)user);
+}
+
+// the parser for the part after the given qualifier code.
+// objbits is the minimum size of the objects parsed by obj.
+static HParser *slot_(uint8_t qc, unsigned flags, HParser *obj, size_t objbits,
+                      HParser *(*vf)(HAllocator *mm__, size_t))
+{
+    const struct Qualifier *q = &qualifiers[qc];
+    HParser *pfx = uint_[q->pwidth];
+    HParser *cnt = (flags & B_SINGLE) ? dnp3_p_ch(1) : count_[q->rwidth];
+    HParser *rng;
+    void *user = (void *)(uintptr_t)qc;
+    bool raw = (flags & B_RAW);
+
+    // raw objects need their size passed along
+    if(raw)
+        user = (void *)QC_STRIDE(qc, objbits);
+
+    switch(q->kind) {
+    case Q_RANGE:
+        rng = uint_[q->rwidth];
+        if(obj) {
+            // the continuation needs the qualifier code to pass it on
+            HParser *qcp = h_action(h_epsilon_p(), act_qc, user);
+            struct RangeObjects *ro = dnp3_p_alloc(sizeof(struct RangeObjects));
+            assert(ro != NULL);
+            ro->obj = obj;
+            ro->bits = objbits;
+            ro->raw = raw;
+
+            rng = h_attr_bool(h_sequence(qcp, rng, rng, NULL),
+                              validate_range, (void *)1);
+            return h_bind(rng, k_range_objects, ro);
+        } else {
+            rng = h_attr_bool(h_sequence(rng, rng, NULL),
+                              validate_range, (void *)0);
+            return h_action(rng, act_range, user);
+        }
+    case Q_ALL:
+        return h_action(h_epsilon_p(), act_all, user);
+    case Q_COUNT:
+        if(obj)
+            return h_action(h_length_value(cnt, obj),
+                            raw ? act_objects_raw : act_objects_only, user);
+        else
+            return h_action(cnt, act_count, user);
+    case Q_INDEX:
+        if(obj)
+            return h_action(h_length_value(cnt, h_sequence(pfx, obj, NULL)),
+                            raw ? act_indexes_raw : act_indexes_objects, user);
+        else
+            return h_action(h_length_value(cnt, pfx), act_indexes_only, user);
+    case Q_SIZE:
+        assert(vf != NULL);
+        return h_action(h_length_value(cnt, h_bind(pfx, k_bindvf, vf)),
+                        act_objects_only, user);
+    default:
+        assert(!"unreachable");
+        return NULL;
+    }
+}
+
+// the above with the admission check for counts of objects or indexes.
+// ranges are checked in k_range_objects.
+static HParser *slot(uint8_t qc, unsigned flags, HParser *obj, size_t objbits,
+                     HParser *(*vf)(HAllocator *mm__, size_t))
+{
+    const struct Qualifier *q = &qualifiers[qc];
+    size_t bits = q->pwidth * 8 + objbits;  // minimum size incl. prefix
+    HParser *p = slot_(qc, flags, obj, objbits, vf);
+
+    if(!(flags & B_SINGLE) && (q->kind == Q_INDEX || q->kind == Q_SIZE ||
+                               (q->kind == Q_COUNT && obj)))
+        p = admit(count_[q->rwidth], bits, p);
+    return p;
+}
+
+// construct a table of parsers for the qualifiers selected by flags.
+// obj is the object parser or NULL for object headers without objects.
+// bits is the size of its objects, as declared by dnp3_object_bits.
+// vf is the constructor for variable-format objects (with B_SIZE).
+static struct Body *body(unsigned flags, HParser *obj, size_t bits,
+                         HParser *(*vf)(HAllocator *mm__, size_t))
+{
+    struct Body *b = dnp3_p_alloc0(sizeof(struct Body));
+    assert(b != NULL);
+    assert(bits < SIZE_VF);
+    assert(!obj || bits > 0);   // size not declared (dnp3_object_bits)
+
+    b->objsize = vf ? SIZE_VF : bits;
+    b->flags = flags;
+
+    for(int qc=0; qc<128; qc++) {
+        const struct Qualifier *q = &qualifiers[qc];
+
+        if(q->kind == Q_INVALID || !(flags & (1 << q->kind)))
+            continue;
+        if((flags & B_COUNT16) && q->kind == Q_COUNT && q->rwidth > 2)
+            continue;
+        if((flags & B_SINGLE) && q->rwidth != 1)
+            continue;
+
+        b->slot[qc] = slot(qc, flags, obj, bits, vf);
+    }
+
+    return b;
+}
+
+static HParser *k_qualifier(HAllocator *mm__, const HParsedToken *qc, void *env)
+{
+    const struct Body *b = env;
+    uint8_t x = H_CAST_UINT(qc);
+
+    if(x & 0x80)            // reserved bit
+        return NULL;
+    return b->slot[x];      // NULL if not allowed
+}
+
+// header-only parsing...
+//
+// every block constructor records the size of its objects by group and
+// variation. dnp3_p_ohdr uses this to parse object headers anywhere and skip
+// the objects that follow them without decoding.
+//
+// NB: this does not check which objects or qualifiers are allowed with which
+//     function code; a block accepted by any parser is accepted here.
+
+static void note_objsize(uint8_t g, uint8_t v, uint16_t size)
+{
+    if(!objsizes[g]) {
+        objsizes[g] = dnp3_p_alloc(256 * sizeof(uint16_t));
+        assert(objsizes[g] != NULL);
+        for(int i=0; i<256; i++)
+            objsizes[g][i] = SIZE_UNKNOWN;
+    }
+
+    // blocks with objects take precedence over those without
+    if(objsizes[g][v] == SIZE_UNKNOWN || objsizes[g][v] == 0)
+        objsizes[g][v] = size;
+}
+
+static uint16_t lookup_objsize(uint8_t g, uint8_t v)
+{
+    return objsizes[g] ? objsizes[g][v] : SIZE_UNKNOWN;
+}
+
+// skip n objects of the given size, padded to a whole octet
+static HParser *skip__m(HAllocator *mm__, uint64_t n, size_t bits)
+{
+    if(bits > 0 && n > (SIZE_MAX - 7) / bits)
+        return NULL;
+    return h_skip__m(mm__, (n * bits + 7) & ~(size_t)7);
+}
+
+// continuation after a range field (start,stop) or count, env = object size
+static HParser *k_skip_range(HAllocator *mm__, const HParsedToken *r, void *env)
+{
+    uint64_t n = H_INDEX_UINT(r, 1) - H_INDEX_UINT(r, 0) + 1;
+    HParser *skip = skip__m(mm__, n, (uintptr_t)env);
+
+    return skip ? h_right__m(mm__, skip, h_unit__m(mm__, r)) : NULL;
+}
+
+static HParser *k_skip_count(HAllocator *mm__, const HParsedToken *n, void *env)
+{
+    HParser *skip = skip__m(mm__, H_CAST_UINT(n), (uintptr_t)env);
+
+    return skip ? h_right__m(mm__, skip, h_unit__m(mm__, n)) : NULL;
+}
+
+// variable-format objects: skip each according to its size prefix
+static HParser *k_skip_bytes(HAllocator *mm__, const HParsedToken *n, void *env)
 {
-    return h_action(h_length_value(vfcnt, h_bind(p, k_bindvf, q)),
-                    act_objects_only, NULL);
+    return h_skip__m(mm__, H_CAST_UINT(n) * 8);
 }
 
-static HParser *oblock_range_(HParser *p)
+static HParser *k_skip_sized(HAllocator *mm__, const HParsedToken *n, void *env)
 {
-    H_RULE(range,   h_choice(range_index, range_addr, NULL));
-        // XXX are address ranges really allowed with all types of objects or
-        //     only where the spec actually says so (g102, g110)?
-    H_RULE(objs,    h_action(h_length_value(range, p),
-                             act_objects_only, NULL));
+    HParser *pfx = env;
+    HParser *obj = h_bind__m(mm__, pfx, k_skip_bytes, NULL);
 
-    return noprefix(objs);
+    return h_right__m(mm__, h_repeat_n__m(mm__, obj, H_CAST_UINT(n)),
+                      h_unit__m(mm__, n));
 }
 
-static HParser *oblock_index_(HParser *p)
+static HParsedToken *act_ohdr(const HParseResult *p, void *user)
 {
-    return h_choice(withpc(1, prefixed_index(h_uint8(), p)), 
-                    withpc(2, prefixed_index(h_uint16(), p)),
-                    withpc(3, prefixed_index(h_uint32(), p)), NULL);
+    // p = ((grp,var,qc), range), range = (start,stop) | count | (nothing)
+    const HParsedToken *hdr = H_FIELD_TOKEN(0);
+    uint8_t qc = H_INDEX_UINT(hdr, 2);
+    DNP3_ObjectBlock *ob = new_block(p->arena, qc);
+
+    ob->group = H_INDEX_UINT(hdr, 0);
+    ob->variation = H_INDEX_UINT(hdr, 1);
+    switch(qualifiers[qc].kind) {
+    case Q_RANGE:
+        ob->range_base = H_FIELD_UINT(1, 0);
+        ob->count = H_FIELD_UINT(1, 1) - ob->range_base + 1;
+        break;
+    case Q_COUNT:
+    case Q_INDEX:
+    case Q_SIZE:
+        ob->count = H_FIELD_UINT(1);
+        break;
+    }
+
+    return H_MAKE(DNP3_ObjectBlock, ob);
 }
 
-static HParser *oblock_vf_(HParser *cnt, HParser *(*p)(HAllocator *mm__, size_t))
+// the range field and objects after the given object header, skipping
+// objects of the given size. flags (B_SINGLE) restrict the count.
+static HParser *ohdr_rest(HAllocator *mm__, const HParsedToken *hdr,
+                          uintptr_t objects, uint16_t size, unsigned flags)
 {
-    return h_choice(withpc(4, prefixed_size(cnt, h_uint8(), p)), 
-                    withpc(5, prefixed_size(cnt, h_uint16(), p)),
-                    withpc(6, prefixed_size(cnt, h_uint32(), p)), NULL);
+    // hdr = (grp,var,qc)
+    uint8_t g  = H_INDEX_UINT(hdr, 0);
+    uint8_t qc = H_INDEX_UINT(hdr, 2);
+    const struct Qualifier *q = &qualifiers[qc];
+    HParser *rng, *cnt = count_[q->rwidth];
+
+    if(flags & B_SINGLE)
+        cnt = dnp3_p_ch(1);
+
+    // objects are expected with all groups (OHDR_OBJECTS), none, or only
+    // with time objects (OHDR_TIME, for FREEZE_AT_TIME)
+    switch(objects) {
+    case OHDR_NONE:     size = 0; break;
+    case OHDR_TIME:     if(g != G(TIME)) size = 0; break;
+    }
+    if((size == SIZE_VF) != (q->kind == Q_SIZE))
+        return dnp3_p_err_param_error;
+
+    switch(q->kind) {
+    case Q_RANGE:
+        rng = h_attr_bool__m(mm__, h_sequence__m(mm__, uint_[q->rwidth],
+                                                 uint_[q->rwidth], NULL),
+                             validate_range, (void *)0);
+        if(size > 0)
+            rng = h_bind__m(mm__, rng, k_skip_range, (void *)(uintptr_t)size);
+        break;
+    case Q_ALL:
+        rng = h_epsilon_p__m(mm__);
+        break;
+    case Q_COUNT:
+        rng = size ? h_bind__m(mm__, cnt, k_skip_count, (void *)(uintptr_t)size)
+                   : cnt;
+        break;
+    case Q_INDEX:
+        size += q->pwidth * 8;
+        rng = h_bind__m(mm__, cnt, k_skip_count, (void *)(uintptr_t)size);
+        break;
+    case Q_SIZE:
+        rng = h_bind__m(mm__, cnt, k_skip_sized, uint_[q->pwidth]);
+        break;
+    default:    // invalid or reserved qualifier
+        return dnp3_p_err_param_error;
+    }
+
+    rng = h_sequence__m(mm__, h_unit__m(mm__, hdr), rng, NULL);
+    rng = h_action__m(mm__, rng, act_ohdr, NULL);
+    return h_choice__m(mm__, rng, dnp3_p_err_param_error, NULL);
+}
+
+static HParser *k_ohdr(HAllocator *mm__, const HParsedToken *hdr, void *env)
+{
+    // hdr = (grp,var,qc)
+    uint16_t size = lookup_objsize(H_INDEX_UINT(hdr, 0), H_INDEX_UINT(hdr, 1));
+
+    if(size == SIZE_UNKNOWN)
+        return dnp3_p_err_obj_unknown;
+    return ohdr_rest(mm__, hdr, (uintptr_t)env, size, 0);
+}
+
+HParser *dnp3_p_ohdr(int objects)
+{
+    assert(objects >= 0 && objects < NOHDR);
+    return ohdr[objects];
 }
 
 void init_oblock(void)
 {
-    // qualifier codes and their meanings:
-    //
-    //   0[0-2]      index range
-    //   0[3-5]      address range
-    //   06          "all" ((read?) requests only)
-    //   0[7-9]      (max) count
-    //   [1-3][7-9]  index list (count + index prefix)
-    //   [4-6]B      "variable format" (count + size prefix)
-
-    range_index =  h_choice(range(0x0, h_uint8()),
-                            range(0x1, h_uint16()),
-                            range(0x2, h_uint32()), NULL);
-    range_addr =   h_choice(range(0x3, h_uint8()),
-                            range(0x4, h_uint16()),
-                            range(0x5, h_uint32()), NULL);
-    range_none =              rsc(0x6);             // no range field
-    range_count =  h_choice(count(0x7, h_uint8()),
-                            count(0x8, h_uint16()),
-                            count(0x9, h_uint32()), NULL);
-    range_max =    h_choice(count(0x7, h_uint8()),
-                            count(0x8, h_uint16()), NULL);
-    range_count1 =          count(0x7, h_ch(1)),    // a single object
-                               // 0xA = reserved
-    range_vfcount =         count(0xB, h_uint8());  // count of var-size objects
-    range_vfcount1 =        count(0xB, h_ch(1));    // a single var-size object
-
-    ohdr_irange = noprefix(range_index);
-    ohdr_arange = noprefix(range_addr);
-    ohdr_all    = noprefix(range_none);
-    ohdr_count  = noprefix(range_count);
-    ohdr_max    = noprefix(range_max);
-    ohdr_count1 = noprefix(range_count1);
-
-    H_RULE(rblock_index, oblock_index_(NULL));
-    rblock_ = h_choice(ohdr_irange, ohdr_arange, ohdr_all, ohdr_count,
-                       rblock_index, NULL);
-
-    rblock_max = h_choice(ohdr_all, ohdr_count, NULL);
-
-    // parsers to fetch the saved range values (used in block())
-    get_rsc =   h_get_value("rsc");
-    get_base =  h_optional(h_get_value("range_base"));
+    static const uint8_t width[3] = {1, 2, 4};
+
+    // fill the table of qualifiers; bit 7 is reserved
+    for(int pc=0; pc<8; pc++) {
+        for(int rsc=0; rsc<16; rsc++) {
+            struct Qualifier *q = &qualifiers[pc << 4 | rsc];
+
+            if(pc == 0 && rsc <= 5)
+                *q = (struct Qualifier){Q_RANGE, 0, width[rsc % 3]};
+            else if(pc == 0 && rsc == 6)
+                *q = (struct Qualifier){Q_ALL, 0, 0};
+            else if(pc == 0 && rsc >= 7 && rsc <= 9)
+                *q = (struct Qualifier){Q_COUNT, 0, width[rsc - 7]};
+            else if(pc >= 1 && pc <= 3 && rsc >= 7 && rsc <= 9)
+                *q = (struct Qualifier){Q_INDEX, width[pc - 1], width[rsc - 7]};
+            else if(pc >= 4 && pc <= 6 && rsc == 0xB)
+                *q = (struct Qualifier){Q_SIZE, width[pc - 4], 1};
+                // 0xA = reserved
+        }
+    }
+
+    for(int i=0; i<3; i++) {
+        int w = width[i];
+        uint_[w]  = dnp3_p_bits(8 * w, false);
+        count_[w] = h_attr_bool(uint_[w], validate_count, NULL);
+    }
+
+    reject = h_action(h_epsilon_p(), act_reject, NULL);
+
+    body_rblock = body(B_RANGE|B_ALL|B_COUNT|B_INDEX, NULL, 0, NULL);
+    body_all    = body(B_ALL, NULL, 0, NULL);
+    body_max    = body(B_ALL|B_COUNT|B_COUNT16, NULL, 0, NULL);
+    body_count1 = body(B_COUNT|B_SINGLE, NULL, 0, NULL);
+
+    // parsers used in block() and dnp3_p_objchoice
+    H_RULE(octet,   uint_[1]);
+    qc_octet = octet;
+    gv_octets = h_sequence(octet, octet, NULL);             // (grp,var)
+    ohdr_unknown_rest = h_right(octet, dnp3_p_err_obj_unknown);     // qc
+    ohdr_unknown = h_right(gv_octets, ohdr_unknown_rest);
+
+    gvq_octets = h_sequence(octet, octet, octet, NULL);     // (grp,var,qc)
+    for(uintptr_t i=0; i<NOHDR; i++)
+        ohdr[i] = h_bind(gvq_octets, k_ohdr, (void *)i);
 }
 
 HParser *group(DNP3_Group g)
 {
-    return h_ch(g);
+    return dnp3_p_ch(g);
 }
 
 HParser *variation(DNP3_Variation v)
 {
-    return h_ch(v);
+    return dnp3_p_ch(v);
+}
+
+// assemble a DNP3_ObjectBlock from group, variation, and the rest of the block
+static HParsedToken *make_block(const HParseResult *p, uint8_t g, uint8_t v,
+                                const HParsedToken *rest)
+{
+    DNP3_ObjectBlock *ob;
+
+    // rest = DNP3_ObjectBlock (without group/variation) | error
+
+    // propagate TT_ERR
+    if(H_ISERR(rest->token_type))
+        return (HParsedToken *)rest;    // XXX discarding const
+
+    ob = H_ALLOC(DNP3_ObjectBlock);
+    *ob = *H_CAST(DNP3_ObjectBlock, rest);
+    ob->group = g;
+    ob->variation = v;
+
+    return H_MAKE(DNP3_ObjectBlock, ob);
 }
 
 static HParsedToken *act_block(const HParseResult *p, void *user)
 {
-    DNP3_ObjectBlock *ob = H_ALLOC(DNP3_ObjectBlock);
-    HParsedToken *tok;
+    // p = (grp,var,rest)
+    return make_block(p, H_FIELD_UINT(0), H_FIELD_UINT(1),
+                      H_INDEX_TOKEN(p->ast, 2));
+}
 
-    // expected structure:
-    // p = (grp,var,((pc,(count,idxs,objs)),rsc,base))
-    //   | (grp,var,((pc,count),rsc,base))              -- plain ohdr case
-    //   | (grp,var,error)
+static HParsedToken *act_block_rest(const HParseResult *p, void *user)
+{
+    // p = rest, user = (grp << 8 | var)
+    uintptr_t gv = (uintptr_t)user;
+    return make_block(p, gv >> 8, gv & 0xFF, p->ast);
+}
 
-    // propagate TT_ERR on the third place
-    if(H_ISERR(H_INDEX_TOKEN(p->ast, 2)->token_type))
-        return H_INDEX_TOKEN(p->ast, 2);
 
-    ob->group = H_FIELD_UINT(0);
-    ob->variation = H_FIELD_UINT(1);
-    ob->prefixcode = H_FIELD_UINT(2, 0, 0);
-    ob->rangespec = H_FIELD_UINT(2, 1);
+// dispatch information about block parsers...
+//
+// for every block parser, we record the (group,variation) pairs it accepts
+// together with a parser for the rest of the block after those two bytes.
+// dnp3_p_objchoice uses this to build a lookup table instead of trying each
+// alternative in turn.
+//
+// NB: this is sound because a block parser, once it has matched group and
+//     variation, never fails (cf. the error propagation dance in block()).
 
-    // range base (can be TT_NONE)
-    tok = H_INDEX_TOKEN(p->ast, 2, 2);
-    if(tok->token_type == TT_NONE) {
-        ob->range_base = 0;
-    } else {
-        ob->range_base = H_CAST_UINT(tok);
+struct BlockEntry {
+    uint8_t group;
+    uint8_t variation;
+    HParser *rest;
+
+    struct Body *quals;                 // qualifiers accepted, object size
+
+    // for building the variant with raw objects (cf. dnp3_p_oblock_lazy)
+    struct Body *body;                  // NULL if not supported
+    HParser *(*f)(HParser *, void *);   // see register_blocks
+    void *env;
+};
+
+struct BlockInfo {
+    struct BlockInfo *next;
+    const HParser *p;
+    size_t n;
+    struct BlockEntry entries[];
+};
+
+static struct BlockInfo *blockinfo = NULL;  // registry of known block parsers
+
+static struct BlockInfo *lookup_blockinfo(const HParser *p)
+{
+    for(struct BlockInfo *b = blockinfo; b; b = b->next) {
+        if(b->p == p)
+            return b;
     }
+    return NULL;
+}
 
-    // objects and indexes
-    tok = H_INDEX_TOKEN(p->ast, 2, 0, 1);
-        // tok corresponds to the block_ argument of block()
-    if(tok->token_type == TT_SEQUENCE) {
-        // tok = (count,idxs,objs)
-        ob->count   = H_INDEX_UINT(tok, 0);
-        ob->indexes = h_assert_type(TT_USER, H_INDEX_TOKEN(tok, 1))->user;
-        ob->objects = H_INDEX(DNP3_Object, tok, 2);
-    } else {
-        // tok = count
-        ob->count = H_CAST_UINT(tok);
+// register the given parser with the concatenation of the entries of the
+// given block parsers, each passed through f(rest, env) if f is not NULL.
+// does nothing if any of ps is not a known block parser.
+static void register_blocks(const HParser *p, HParser **ps, size_t nps,
+                            HParser *(*f)(HParser *, void *), void *env)
+{
+    size_t n = 0;
+
+    for(size_t i=0; i<nps; i++) {
+        struct BlockInfo *b = lookup_blockinfo(ps[i]);
+        if(!b) return;
+        n += b->n;
     }
 
-    return H_MAKE(DNP3_ObjectBlock, ob);
+    struct BlockInfo *info;
+    info = dnp3_p_alloc(sizeof(struct BlockInfo) +
+                        n * sizeof(struct BlockEntry));
+    assert(info != NULL);
+    info->p = p;
+    info->n = 0;
+    for(size_t i=0; i<nps; i++) {
+        struct BlockInfo *b = lookup_blockinfo(ps[i]);
+        for(size_t j=0; j<b->n; j++) {
+            struct BlockEntry *e = &info->entries[info->n++];
+
+            *e = b->entries[j];
+            if(f) {
+                e->rest = f(e->rest, env);
+                if(e->f)
+                    e->body = NULL;     // XXX can't compose these
+                e->f = f;
+                e->env = env;
+            }
+        }
+    }
+
+    info->next = blockinfo;
+    blockinfo = info;
 }
 
-// generic parser for object blocks
-static HParser *block(HParser *grp, HParser *var, HParser *block_)
+// the part of a block after group and variation
+static HParser *block_rest(struct Body *b)
 {
     // the error propagation dance
     // we want a parse failure in group and variation to lead to failure and
     // one in the rest to yield PARAM_ERROR.
-    H_RULE (rest,   h_sequence(block_, dnp3_p_pad, get_rsc, get_base, NULL));
-    H_RULE (e_rest, h_choice(rest, dnp3_p_err_param_error, NULL));
-    H_ARULE(block,  h_sequence(grp, var, e_rest, NULL));
+    #define rest h_left(h_bind(qc_octet, k_qualifier, b), dnp3_p_pad)
+
+    INTERNED((HParser *)b, 0, h_choice(rest, dnp3_p_err_param_error, NULL));
+    #undef rest
+}
+
+// generic parser for object blocks of the given group and variation(s)
+static HParser *blockv(DNP3_Group g, const DNP3_Variation *vs, size_t nvs,
+                       struct Body *b)
+{
+    HParser *e_rest = block_rest(b);
+
+    HParser *var;
+    if(nvs == 1) {
+        var = variation(vs[0]);
+    } else {
+        HParser *vps[nvs+1];
+        for(size_t i=0; i<nvs; i++)
+            vps[i] = variation(vs[i]);
+        vps[nvs] = NULL;
+        var = h_choice__a((void **)vps);
+    }
+
+    H_ARULE(block,  h_sequence(group(g), var, e_rest, NULL));
+
+    // record dispatch information
+    struct BlockInfo *info;
+    info = dnp3_p_alloc(sizeof(struct BlockInfo) +
+                        nvs * sizeof(struct BlockEntry));
+    assert(info != NULL);
+    info->p = block;
+    info->n = nvs;
+    for(size_t i=0; i<nvs; i++) {
+        uintptr_t gv = (g << 8 | vs[i]);
+        info->entries[i].group = g;
+        info->entries[i].variation = vs[i];
+        info->entries[i].rest = h_action(e_rest, act_block_rest, (void *)gv);
+        info->entries[i].quals = b;
+        info->entries[i].body = (nvs == 1) ? b : NULL;
+        info->entries[i].f = NULL;
+        info->entries[i].env = NULL;
+    }
+    info->next = blockinfo;
+    blockinfo = info;
+
+    // record object sizes for header-only parsing
+    for(size_t i=0; i<nvs; i++)
+        note_objsize(g, vs[i], b->objsize);
 
     return block;
 }
 
+static HParser *block(DNP3_Group g, DNP3_Variation v, struct Body *b)
+{
+    return blockv(g, &v, 1, b);
+}
+
+HParser *dnp3_p_blockchoice(HParser *p, ...)
+{
+    va_list args;
+    size_t n=1;
+
+    // count arguments
+    va_start(args, p);
+    while(va_arg(args, HParser *)) n++;
+    va_end(args);
+
+    HParser *ps[n+1];
+    ps[0] = p;
+    va_start(args, p);
+    for(size_t i=1; i<=n; i++)
+        ps[i] = va_arg(args, HParser *);    // includes the terminating NULL
+    va_end(args);
+
+    HParser *choice = h_choice__a((void **)ps);
+    register_blocks(choice, ps, n, NULL, NULL);
+
+    return choice;
+}
+
+static HParser *seq_rest(HParser *rest, void *q)
+{
+    return dnp3_p_seq(rest, q);
+}
+
+HParser *dnp3_p_blockseq(HParser *p, HParser *q)
+{
+    HParser *seq = dnp3_p_seq(p, q);
+    register_blocks(seq, &p, 1, seq_rest, q);
+
+    return seq;
+}
+
+
+// dispatch table: a row of 256 parsers (by variation) for each group
+struct DispatchTable {
+    HParser **rows[256];
+    HParser *unknown;
+};
+
+static HParser *k_dispatch(HAllocator *mm__, const HParsedToken *gv, void *env)
+{
+    struct DispatchTable *t = env;
+
+    // gv = (grp,var)
+    uint8_t g = H_INDEX_UINT(gv, 0);
+    uint8_t v = H_INDEX_UINT(gv, 1);
+
+    if(t->rows[g] && t->rows[g][v])
+        return t->rows[g][v];
+    else
+        return t->unknown;
+}
+
+// the variant of a block body that keeps objects raw, NULL if not possible.
+// the wire format must be known and agree with the size of the objects.
+static struct Body *raw_body(struct Body *b, uint8_t g, uint8_t v)
+{
+    size_t bits = dnp3_wire_bits(g, v);
+
+    if(!b->raw && bits > 0 && bits == b->objsize && !(b->flags & B_SIZE)) {
+        HParser *obj = rawobj(bits, dnp3_wire_reserved(g, v));
+        b->raw = body(b->flags | B_RAW, obj, bits, NULL);
+    }
+    return b->raw;
+}
+
+// the rest of a block after group and variation, keeping objects raw
+static HParser *raw_rest(const struct BlockEntry *e)
+{
+    struct Body *b = e->body ? raw_body(e->body, e->group, e->variation) : NULL;
+    uintptr_t gv = (e->group << 8 | e->variation);
+    HParser *rest;
+
+    if(!b)
+        return NULL;
+    rest = h_action(block_rest(b), act_block_rest, (void *)gv);
+    return e->f ? e->f(rest, e->env) : rest;
+}
+
+// fill a dispatch table from the given block parsers, which must all be
+// known. earlier alternatives take precedence.
+static struct DispatchTable *dispatch_table(HParser **ps, size_t n, bool raw)
+{
+    struct DispatchTable *t = dnp3_p_alloc0(sizeof(struct DispatchTable));
+    assert(t != NULL);
+
+    for(size_t i=0; i<n; i++) {
+        struct BlockInfo *b = lookup_blockinfo(ps[i]);
+        assert(b != NULL);
+        for(size_t j=0; j<b->n; j++) {
+            struct BlockEntry *e = &b->entries[j];
+            HParser *rest = raw ? raw_rest(e) : NULL;
+
+            if(!t->rows[e->group]) {
+                t->rows[e->group] = dnp3_p_alloc0(256 * sizeof(HParser *));
+                assert(t->rows[e->group] != NULL);
+            }
+            if(!t->rows[e->group][e->variation])
+                t->rows[e->group][e->variation] = rest ? rest : e->rest;
+        }
+    }
+    t->unknown = ohdr_unknown_rest;
+
+    return t;
+}
+
+HParser *dnp3_p_objchoice(HParser *p, ...)
+{
+    va_list args;
+    size_t n=1;
+
+    // count arguments
+    va_start(args, p);
+    while(va_arg(args, HParser *)) n++;
+    va_end(args);
+
+    HParser *ps[n+1];
+    ps[0] = p;
+    va_start(args, p);
+    for(size_t i=1; i<=n; i++)
+        ps[i] = va_arg(args, HParser *);    // includes the terminating NULL
+    va_end(args);
+
+    // fall back to trying each alternative if we don't know them all
+    for(size_t i=0; i<n; i++) {
+        if(!lookup_blockinfo(ps[i])) {
+            H_RULE(choice,  h_choice__a((void **)ps));
+            H_RULE(ochoice, h_choice(choice, ohdr_unknown, NULL));
+            return ochoice;
+        }
+    }
+
+    H_RULE(dispatch, h_bind(gv_octets, k_dispatch, dispatch_table(ps, n, false)));
+    register_blocks(dispatch, ps, n, NULL, NULL);
+
+    return dispatch;
+}
+
+HParser *dnp3_p_oblock_lazy(HParser *p)
+{
+    if(!lookup_blockinfo(p))
+        return p;
+
+    H_RULE(dispatch, h_bind(gv_octets, k_dispatch, dispatch_table(&p, 1, true)));
+    register_blocks(dispatch, &p, 1, NULL, NULL);
+
+    return dispatch;
+}
+
+struct Select {
+    const DNP3_Interest *mask;
+    const struct Body **rows[256];  // accepted by the parser, by (grp,var)
+    uintptr_t objects;              // OHDR_*
+};
+
+static HParser *k_select(HAllocator *mm__, const HParsedToken *hdr, void *env)
+{
+    const struct Select *s = env;
+
+    // hdr = (grp,var,qc)
+    uint8_t g  = H_INDEX_UINT(hdr, 0);
+    uint8_t v  = H_INDEX_UINT(hdr, 1);
+    uint8_t qc = H_INDEX_UINT(hdr, 2);
+    const struct Body *b = s->rows[g] ? s->rows[g][v] : NULL;
+
+    // blocks of interest go to the full parser, as do those it does not
+    // accept, with their qualifier, so they yield the same error. CTOs are
+    // always decoded; they are needed to resolve the relative times of later
+    // blocks.
+    if(!b || (qc & 0x80) || !b->slot[qc] || dnp3_interest_has(s->mask, g, v)
+       || g == DNP3_GROUP_CTO)
+        return NULL;    // fall back to the full parser
+    return ohdr_rest(mm__, hdr, s->objects, b->objsize, b->flags);
+}
+
+HParser *dnp3_p_oblock_select(HParser *p, const DNP3_Interest *mask,
+                              int objects)
+{
+    struct BlockInfo *b = lookup_blockinfo(p);
+    if(!b)
+        return p;       // don't know which blocks p accepts
+
+    struct Select *s = dnp3_p_alloc0(sizeof(struct Select));
+    assert(s != NULL);
+    assert(objects >= 0 && objects < NOHDR);
+    s->mask = mask;
+    s->objects = objects;
+    for(size_t i=0; i<b->n; i++) {
+        const struct BlockEntry *e = &b->entries[i];
+
+        if(!s->rows[e->group]) {
+            s->rows[e->group] = dnp3_p_alloc0(256 * sizeof(struct Body *));
+            assert(s->rows[e->group] != NULL);
+        }
+        if(!s->rows[e->group][e->variation])  // earlier ones take precedence
+            s->rows[e->group][e->variation] = e->quals;
+    }
+    return h_choice(h_bind(gvq_octets, k_select, s), p, NULL);
+}
+
 HParser *dnp3_p_rblock(DNP3_Group g, ...)
 {
     va_list args;
-    int n=0, i;
-    HParser **vs;
+    size_t n=1;
 
     // count arguments
     va_start(args, g);
     while(va_arg(args, DNP3_Variation)) n++;
     va_end(args);
 
-    // assemble array of parsers for the given variations 
-    // XXX this array is never freed (but no parsers ever are)
-    // XXX ensure we call parser-allocating functions only once during init
-    vs = malloc((n+2) * sizeof(HParser *));
-    vs[0] = variation(DNP3_VARIATION_ANY);
+    // assemble the given variations, plus 0 (any)
+    DNP3_Variation vs[n];
+    vs[0] = DNP3_VARIATION_ANY;
     va_start(args, g);
-    for(i=1; i<=n; i++)
-        vs[i] = variation(va_arg(args, DNP3_Variation));
+    for(size_t i=1; i<n; i++)
+        vs[i] = va_arg(args, DNP3_Variation);
     va_end(args);
-    vs[i] = NULL;
 
-    return block(group(g), h_choice__a((void **)vs), rblock_);
+    return blockv(g, vs, n, body_rblock);
 }
 
 HParser *dnp3_p_specific_rblock(DNP3_Group g, DNP3_Variation v)
 {
-    return block(group(g), variation(v), rblock_);
+    return block(g, v, body_rblock);
 }
 
 HParser *dnp3_p_rblock_all(DNP3_Group g, DNP3_Variation v)
 {
-    return block(group(g), variation(v), ohdr_all);
+    return block(g, v, body_all);
 }
 
 HParser *dnp3_p_rblock_max(DNP3_Group g, DNP3_Variation v)
 {
-    return block(group(g), variation(v), rblock_max);
+    return block(g, v, body_max);
 }
 
 HParser *dnp3_p_single(DNP3_Group g, DNP3_Variation v, HParser *obj)
 {
-    H_RULE(objs_, h_length_value(range_count1, obj));
-    H_RULE(objs,  h_action(objs_, act_objects_only, NULL));
-
-    return block(group(g), variation(v), noprefix(objs));
+    return block(g, v, body(B_COUNT|B_SINGLE, obj, dnp3_object_bits(g, v),
+                            NULL));
 }
 
 HParser *dnp3_p_single_rblock(DNP3_Group g, DNP3_Variation v)
 {
-    return block(group(g), variation(v), ohdr_count1);
+    return block(g, v, body_count1);
 }
 
 HParser *dnp3_p_single_vf(DNP3_Group g, DNP3_Variation v, HParser *(*obj)(HAllocator *mm__, size_t))
 {
-    return block(group(g), variation(v), oblock_vf_(range_vfcount1, obj));
+    return block(g, v, body(B_SIZE|B_SINGLE, NULL, 0, obj));
 }
 
 HParser *dnp3_p_oblock(DNP3_Group g, DNP3_Variation v, HParser *obj)
 {
-    H_RULE(oblock_, h_choice(oblock_index_(obj),
-                             oblock_range_(obj), NULL));
-
-    return block(group(g), variation(v), oblock_);
+    // XXX are address ranges really allowed with all types of objects or
+    //     only where the spec actually says so (g102, g110)?
+    return block(g, v, body(B_INDEX|B_RANGE, obj, dnp3_object_bits(g, v),
+                            NULL));
 }
 
 HParser *dnp3_p_oblock_packed(DNP3_Group g, DNP3_Variation v, HParser *obj)
 {
-    return block(group(g), variation(v), oblock_range_(obj));
+    return block(g, v, body(B_RANGE, obj, dnp3_object_bits(g, v), NULL));
 }
 
 HParser *dnp3_p_oblock_vf(DNP3_Group g, DNP3_Variation v, HParser *(*obj)(HAllocator *mm__, size_t))
 {
-    H_RULE(oblock_, oblock_vf_(range_vfcount, obj));
+    return block(g, v, body(B_SIZE, NULL, 0, obj));
+}
 
-    return block(group(g), variation(v), oblock_);
+void dnp3_parser_stats(DNP3_ParserStats *stats)
+{
+    stats->admission_rejects = __atomic_load_n(&admission_rejects,
+                                               __ATOMIC_RELAXED);
 }
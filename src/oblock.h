@@ -48,5 +48,47 @@ HParser *dnp3_p_oblock_packed(DNP3_Group g, DNP3_Variation v, HParser *obj);
 // parse an "oblock" of variable-format objects of the given type.
 HParser *dnp3_p_oblock_vf(DNP3_Group g, DNP3_Variation v, HParser *(*obj)(HAllocator *mm__, size_t));
 
+// like h_choice over the given block parsers but remembers which
+// group/variation pairs they accept (for use with dnp3_p_objchoice).
+HParser *dnp3_p_blockchoice(HParser *p, ...);
+
+// like dnp3_p_seq(p, q) for a block parser p; remembers the group/variation
+// pairs accepted by p (for use with dnp3_p_objchoice).
+HParser *dnp3_p_blockseq(HParser *p, HParser *q);
+
+// like h_choice over block parsers but defaults to a ERR_OBJ_UNKNOWN case.
+// dispatches on the group and variation bytes directly if all alternatives
+// were constructed by the above or the other block combinators.
+HParser *dnp3_p_objchoice(HParser *p, ...);
+
+// like the given dnp3_p_objchoice but keep the objects of the blocks raw
+// where their wire format is known (see dnp3_oblock_get).
+HParser *dnp3_p_oblock_lazy(HParser *p);
+
+// parse any object header whose group and variation is known to one of the
+// block parsers above, skipping the objects that follow it. yields a
+// DNP3_ObjectBlock with objects and indexes NULL, or an error like the full
+// parsers. the argument says which objects are expected:
+enum {
+    OHDR_NONE,      // none, object headers only (e.g. READ)
+    OHDR_OBJECTS,   // all objects (e.g. WRITE, RESPONSE)
+    OHDR_TIME,      // only time objects (FREEZE_AT_TIME)
+    NOHDR
+};
+HParser *dnp3_p_ohdr(int objects);
+
+// like the block parser p but skip blocks whose group and variation are not
+// in the given set, as with dnp3_p_ohdr(objects). CTOs (g51) are always
+// decoded. skipped blocks must have a qualifier (and count) that p accepts
+// with their group and variation; other blocks are left to p, so they yield
+// the same errors. the set is not copied. p must be a known block parser (from
+// dnp3_p_objchoice etc.), otherwise it is returned as is.
+HParser *dnp3_p_oblock_select(HParser *p, const DNP3_Interest *mask,
+                              int objects);
+
+// count the final result of a fragment parse in DNP3_ParserStats if it is
+// the error of a failed admission check (count or range too large)
+void dnp3_p_count_reject(const HParsedToken *err);
+
 
 #endif // DNP3_OBLOCK_H_SEEN
@@ -0,0 +1,472 @@
+// point database: a per-association image of point values with change
+// detection
+
+#include <dnp3hammer.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include "hammer.h"
+#include "app.h"    // GV
+#include "assoctab.h"
+
+
+#define MINPOINTS 64            // initial array size per point type
+#define DENSEPOINTS 4096        // indexes below this are kept in a dense array
+#define MINSPARSE 16            // initial hash table size
+#define MAXSPARSE (1 << 16)     // max. number of indexes above DENSEPOINTS
+                                // per type/association
+
+// points of one type: a dense array indexed by point index for the low
+// indexes, a hash table (open addressing) for the rest.
+struct Points {
+    DNP3_Point *v;
+    uint8_t *known;     // bitmap: which points have been seen
+    uint32_t n;         // allocated number of entries
+
+    uint32_t *keys;     // point indexes, 0 for empty slots
+    DNP3_Point *sv;
+    uint32_t size;      // number of slots, power of 2
+    uint32_t used;      // number of occupied slots
+};
+
+struct Assoc {
+    struct AssocEntry e;
+    struct Points points[DNP3_NPOINTTYPES];
+};
+
+struct DNP3_PointDB_ {
+    HAllocator *mm;
+    AssocTable assocs;
+    size_t rejects;         // points dropped for lack of space
+
+    DNP3_PointDelta delta;
+    void *env;
+};
+
+
+DNP3_PointDB *dnp3_pointdb__m(HAllocator *mm, DNP3_PointDelta delta, void *env)
+{
+    DNP3_PointDB *db = mm->alloc(mm, sizeof(DNP3_PointDB));
+    if(!db) return NULL;
+
+    db->mm = mm;
+    dnp3_assoctab_init(&db->assocs, mm);
+    db->rejects = 0;
+    db->delta = delta;
+    db->env = env;
+
+    return db;
+}
+
+DNP3_PointDB *dnp3_pointdb(DNP3_PointDelta delta, void *env)
+{
+    return dnp3_pointdb__m(h_system_allocator, delta, env);
+}
+
+void dnp3_pointdb_free(DNP3_PointDB *db)
+{
+    HAllocator *mm = db->mm;
+
+    for(struct AssocEntry *e = db->assocs.first; e; e = e->next) {
+        struct Assoc *a = (struct Assoc *)e;
+        for(int t=0; t<DNP3_NPOINTTYPES; t++) {
+            if(a->points[t].n > 0) {
+                mm->free(mm, a->points[t].v);
+                mm->free(mm, a->points[t].known);
+            }
+            if(a->points[t].size > 0) {
+                mm->free(mm, a->points[t].keys);
+                mm->free(mm, a->points[t].sv);
+            }
+        }
+    }
+    dnp3_assoctab_free(&db->assocs);
+    mm->free(mm, db);
+}
+
+// make sure the given index is within the dense array, growing it as needed
+static bool reserve(HAllocator *mm, struct Points *pts, uint32_t index)
+{
+    if(index < pts->n)
+        return true;
+    assert(index < DENSEPOINTS);
+
+    uint32_t n = pts->n ? pts->n : MINPOINTS;
+    while(n <= index)
+        n *= 2;
+
+    DNP3_Point *v;
+    uint8_t *known;
+    if(pts->n == 0) {
+        v = mm->alloc(mm, n * sizeof(DNP3_Point));
+        known = mm->alloc(mm, n / 8);
+    } else {
+        v = mm->realloc(mm, pts->v, n * sizeof(DNP3_Point));
+        if(v) pts->v = v;
+        known = mm->realloc(mm, pts->known, n / 8);
+        if(known) pts->known = known;
+    }
+    if(!v || !known) {
+        if(pts->n == 0) {
+            if(v) mm->free(mm, v);
+            if(known) mm->free(mm, known);
+        }
+        return false;
+    }
+
+    memset(known + pts->n/8, 0, (n - pts->n)/8);
+    pts->v = v;
+    pts->known = known;
+    pts->n = n;
+    return true;
+}
+
+// hash table slot for the given index: either the one holding it or the
+// empty one where it would go. size must be nonzero.
+static uint32_t sparse_slot(const uint32_t *keys, uint32_t size, uint32_t index)
+{
+    uint32_t i = (index * 2654435761u) & (size - 1);
+
+    while(keys[i] && keys[i] != index)
+        i = (i + 1) & (size - 1);
+
+    return i;
+}
+
+// double the hash table size (or create it)
+static bool grow_sparse(HAllocator *mm, struct Points *pts)
+{
+    uint32_t size = pts->size ? 2 * pts->size : MINSPARSE;
+
+    uint32_t *keys = mm->alloc(mm, size * sizeof(uint32_t));
+    DNP3_Point *sv = mm->alloc(mm, size * sizeof(DNP3_Point));
+    if(!keys || !sv) {
+        if(keys) mm->free(mm, keys);
+        if(sv) mm->free(mm, sv);
+        return false;
+    }
+    memset(keys, 0, size * sizeof(uint32_t));
+
+    for(uint32_t i=0; i<pts->size; i++) {
+        if(pts->keys[i]) {
+            uint32_t j = sparse_slot(keys, size, pts->keys[i]);
+            keys[j] = pts->keys[i];
+            sv[j] = pts->sv[i];
+        }
+    }
+    if(pts->size > 0) {
+        mm->free(mm, pts->keys);
+        mm->free(mm, pts->sv);
+    }
+
+    pts->keys = keys;
+    pts->sv = sv;
+    pts->size = size;
+    return true;
+}
+
+// look up a known point, NULL if not seen before
+static DNP3_Point *find_point(const struct Points *pts, uint32_t index)
+{
+    if(index < DENSEPOINTS) {
+        if(index >= pts->n || !(pts->known[index/8] & (1 << (index%8))))
+            return NULL;
+        return &pts->v[index];
+    }
+
+    if(pts->size == 0)
+        return NULL;
+    uint32_t i = sparse_slot(pts->keys, pts->size, index);
+    return pts->keys[i] ? &pts->sv[i] : NULL;
+}
+
+// make room for a new point and mark it known.
+// returns NULL if the limit is reached or out of memory.
+static DNP3_Point *add_point(HAllocator *mm, struct Points *pts, uint32_t index)
+{
+    if(index < DENSEPOINTS) {
+        if(!reserve(mm, pts, index))
+            return NULL;
+        pts->known[index/8] |= 1 << (index%8);
+        return &pts->v[index];
+    }
+
+    // keep the load factor at or below 1/2
+    if(pts->used >= MAXSPARSE)
+        return NULL;
+    if(2 * (pts->used + 1) > pts->size && !grow_sparse(mm, pts))
+        return NULL;
+
+    uint32_t i = sparse_slot(pts->keys, pts->size, index);
+    pts->keys[i] = index;
+    pts->used++;
+    return &pts->sv[i];
+}
+
+static bool flags_equal(DNP3_Flags a, DNP3_Flags b)
+{
+    return (a.online == b.online &&
+            a.restart == b.restart &&
+            a.comm_lost == b.comm_lost &&
+            a.remote_forced == b.remote_forced &&
+            a.local_forced == b.local_forced &&
+            a.chatter_filter == b.chatter_filter &&
+            a.discontinuity == b.discontinuity &&
+            a.over_range == b.over_range &&
+            a.reference_err == b.reference_err &&
+            a.state == b.state);
+}
+
+// what an object contributes to a point
+#define HAVE_STATE 1    // flags.state
+#define HAVE_FLAGS 2    // all other flags
+#define HAVE_VALUE 4
+
+// extract point type and value from an object.
+// returns a combination of the HAVE_* bits above, 0 for non-point objects.
+static int object_point(DNP3_Group g, DNP3_Variation v, const DNP3_Object *o,
+                        DNP3_PointType *type, DNP3_Point *pt)
+{
+    switch(g) {
+    case DNP3_GROUP_BININ:
+    case DNP3_GROUP_BININEV:        *type = DNP3_POINT_BININ; break;
+    case DNP3_GROUP_DBLBITIN:
+    case DNP3_GROUP_DBLBITINEV:     *type = DNP3_POINT_DBLBITIN; break;
+    case DNP3_GROUP_BINOUT:
+    case DNP3_GROUP_BINOUTEV:       *type = DNP3_POINT_BINOUT; break;
+    case DNP3_GROUP_CTR:
+    case DNP3_GROUP_CTREV:          *type = DNP3_POINT_CTR; break;
+    case DNP3_GROUP_FROZENCTR:
+    case DNP3_GROUP_FROZENCTREV:    *type = DNP3_POINT_FROZENCTR; break;
+    case DNP3_GROUP_ANAIN:
+    case DNP3_GROUP_ANAINEV:        *type = DNP3_POINT_ANAIN; break;
+    case DNP3_GROUP_FROZENANAIN:
+    case DNP3_GROUP_FROZENANAINEV:  *type = DNP3_POINT_FROZENANAIN; break;
+    case DNP3_GROUP_ANAOUTSTATUS:
+    case DNP3_GROUP_ANAOUTEV:       *type = DNP3_POINT_ANAOUTSTATUS; break;
+    default:
+        return 0;
+    }
+
+    memset(pt, 0, sizeof(DNP3_Point));
+    switch(g << 8 | v) {
+    // binaries, packed format
+    case GV(BININ, PACKED):
+    case GV(BINOUT, PACKED):
+        pt->flags.state = o->bit;
+        return HAVE_STATE;
+    case GV(DBLBITIN, PACKED):
+        pt->flags.state = o->dblbit;
+        return HAVE_STATE;
+
+    // binaries with flags
+    case GV(BININ, FLAGS):
+    case GV(BININEV, NOTIME):
+    case GV(DBLBITIN, FLAGS):
+    case GV(DBLBITINEV, NOTIME):
+    case GV(BINOUT, FLAGS):
+    case GV(BINOUTEV, NOTIME):
+        pt->flags = o->flags;
+        return HAVE_STATE | HAVE_FLAGS;
+    case GV(BININEV, ABSTIME):
+    case GV(BININEV, RELTIME):
+    case GV(DBLBITINEV, ABSTIME):
+    case GV(DBLBITINEV, RELTIME):
+    case GV(BINOUTEV, ABSTIME):
+        pt->flags = o->timed.flags;
+        return HAVE_STATE | HAVE_FLAGS;
+
+    // counters
+    case GV(CTR, 32BIT):
+    case GV(CTR, 16BIT):
+    case GV(CTREV, 32BIT):
+    case GV(CTREV, 16BIT):
+    case GV(FROZENCTR, 32BIT):
+    case GV(FROZENCTR, 16BIT):
+    case GV(FROZENCTREV, 32BIT):
+    case GV(FROZENCTREV, 16BIT):
+        pt->flags = o->ctr.flags;
+        pt->value = o->ctr.value;
+        return HAVE_FLAGS | HAVE_VALUE;
+    case GV(CTREV, 32BIT_TIME):
+    case GV(CTREV, 16BIT_TIME):
+    case GV(FROZENCTR, 32BIT_TIME):
+    case GV(FROZENCTR, 16BIT_TIME):
+    case GV(FROZENCTREV, 32BIT_TIME):
+    case GV(FROZENCTREV, 16BIT_TIME):
+        pt->flags = o->timed.ctr.flags;
+        pt->value = o->timed.ctr.value;
+        return HAVE_FLAGS | HAVE_VALUE;
+    case GV(CTR, 32BIT_NOFLAG):
+    case GV(CTR, 16BIT_NOFLAG):
+    case GV(FROZENCTR, 32BIT_NOFLAG):
+    case GV(FROZENCTR, 16BIT_NOFLAG):
+        pt->value = o->ctr.value;
+        return HAVE_VALUE;
+
+    // analogs
+    case GV(ANAIN, 32BIT):
+    case GV(ANAIN, 16BIT):
+    case GV(ANAINEV, 32BIT):
+    case GV(ANAINEV, 16BIT):
+    case GV(FROZENANAIN, 32BIT):
+    case GV(FROZENANAIN, 16BIT):
+    case GV(FROZENANAINEV, 32BIT):
+    case GV(FROZENANAINEV, 16BIT):
+    case GV(ANAOUTSTATUS, 32BIT):
+    case GV(ANAOUTSTATUS, 16BIT):
+    case GV(ANAOUTEV, 32BIT):
+    case GV(ANAOUTEV, 16BIT):
+        pt->flags = o->ana.flags;
+        pt->value = o->ana.sint;
+        return HAVE_FLAGS | HAVE_VALUE;
+    case GV(ANAIN, FLOAT):
+    case GV(ANAIN, DOUBLE):
+    case GV(ANAINEV, FLOAT):
+    case GV(ANAINEV, DOUBLE):
+    case GV(FROZENANAIN, FLOAT):
+    case GV(FROZENANAIN, DOUBLE):
+    case GV(FROZENANAINEV, FLOAT):
+    case GV(FROZENANAINEV, DOUBLE):
+    case GV(ANAOUTSTATUS, FLOAT):
+    case GV(ANAOUTSTATUS, DOUBLE):
+    case GV(ANAOUTEV, FLOAT):
+    case GV(ANAOUTEV, DOUBLE):
+        pt->flags = o->ana.flags;
+        pt->value = o->ana.flt;
+        return HAVE_FLAGS | HAVE_VALUE;
+    case GV(ANAINEV, 32BIT_TIME):
+    case GV(ANAINEV, 16BIT_TIME):
+    case GV(FROZENANAIN, 32BIT_TIME):
+    case GV(FROZENANAIN, 16BIT_TIME):
+    case GV(FROZENANAINEV, 32BIT_TIME):
+    case GV(FROZENANAINEV, 16BIT_TIME):
+    case GV(ANAOUTEV, 32BIT_TIME):
+    case GV(ANAOUTEV, 16BIT_TIME):
+        pt->flags = o->timed.ana.flags;
+        pt->value = o->timed.ana.sint;
+        return HAVE_FLAGS | HAVE_VALUE;
+    case GV(ANAINEV, FLOAT_TIME):
+    case GV(ANAINEV, DOUBLE_TIME):
+    case GV(FROZENANAINEV, FLOAT_TIME):
+    case GV(FROZENANAINEV, DOUBLE_TIME):
+    case GV(ANAOUTEV, FLOAT_TIME):
+    case GV(ANAOUTEV, DOUBLE_TIME):
+        pt->flags = o->timed.ana.flags;
+        pt->value = o->timed.ana.flt;
+        return HAVE_FLAGS | HAVE_VALUE;
+    case GV(ANAIN, 32BIT_NOFLAG):
+    case GV(ANAIN, 16BIT_NOFLAG):
+    case GV(FROZENANAIN, 32BIT_NOFLAG):
+    case GV(FROZENANAIN, 16BIT_NOFLAG):
+        pt->value = o->ana.sint;
+        return HAVE_VALUE;
+    }
+
+    return 0;
+}
+
+// merge what an object says about a point into the point's previous state.
+// variations without flags (or without a value) leave those parts unchanged.
+static DNP3_Point merge_point(const DNP3_Point *old, const DNP3_Point *pt,
+                              int have)
+{
+    DNP3_Point res = old ? *old : (DNP3_Point){{0}};
+
+    if(have & HAVE_FLAGS) {
+        uint8_t state = res.flags.state;
+        res.flags = pt->flags;
+        res.flags.state = state;
+    }
+    if(have & HAVE_STATE)
+        res.flags.state = pt->flags.state;
+    if(have & HAVE_VALUE)
+        res.value = pt->value;
+
+    return res;
+}
+
+static size_t update_oblock(DNP3_PointDB *db, struct Assoc *a,
+                            const DNP3_ObjectBlock *ob)
+{
+    size_t changes = 0;
+
+    // without a range or index prefix, points are not identifiable
+    if(!dnp3_oblock_has_objects(ob) || (!ob->indexes && ob->rangespec > 5))
+        return 0;
+
+    for(size_t i=0; i<ob->count; i++) {
+        DNP3_PointType type;
+        DNP3_Point pt;
+        DNP3_Object o;
+        dnp3_oblock_get(ob, i, &o);
+        int have = object_point(ob->group, ob->variation, &o, &type, &pt);
+        if(!have)
+            return changes;     // not a point object; same for all i
+
+        uint32_t index = ob->indexes ? ob->indexes[i] : ob->range_base + i;
+        struct Points *pts = &a->points[type];
+        DNP3_Point *cur = find_point(pts, index);
+        DNP3_Point new = merge_point(cur, &pt, have);
+        DNP3_Point old;
+        bool known = (cur != NULL);
+
+        if(known) {
+            // NB: values are compared bitwise
+            if(flags_equal(cur->flags, new.flags) &&
+               memcmp(&cur->value, &new.value, sizeof(double)) == 0)
+                continue;
+            old = *cur;
+        } else {
+            cur = add_point(db->mm, pts, index);
+            if(!cur) {
+                db->rejects++;  // too many points or out of memory
+                continue;
+            }
+        }
+
+        *cur = new;
+        changes++;
+
+        if(db->delta)
+            db->delta(db->env, a->e.key, type, index, known ? &old : NULL,
+                      cur);
+    }
+
+    return changes;
+}
+
+size_t dnp3_pointdb_update(DNP3_PointDB *db, uint32_t assoc,
+                           const DNP3_Fragment *fragment)
+{
+    if(fragment->fc != DNP3_RESPONSE &&
+       fragment->fc != DNP3_UNSOLICITED_RESPONSE)
+        return 0;
+
+    struct Assoc *a = dnp3_assoctab_lookup(&db->assocs, assoc,
+                                           sizeof(struct Assoc));
+    if(!a) return 0;
+
+    size_t changes = 0;
+    for(size_t i=0; i<fragment->nblocks; i++)
+        changes += update_oblock(db, a, fragment->odata[i]);
+
+    return changes;
+}
+
+const DNP3_Point *dnp3_pointdb_get(const DNP3_PointDB *db, uint32_t assoc,
+                                   DNP3_PointType type, uint32_t index)
+{
+    if(type >= DNP3_NPOINTTYPES)
+        return NULL;
+
+    struct Assoc *a = dnp3_assoctab_find(&db->assocs, assoc);
+    if(!a) return NULL;
+
+    return find_point(&a->points[type], index);
+}
+
+size_t dnp3_pointdb_rejects(const DNP3_PointDB *db)
+{
+    return db->rejects;
+}
@@ -0,0 +1,609 @@
+// compact object records, see record.h
+//
+// a record is the concatenation of up to three fields, each stored in
+// little-endian byte order:
+//
+//   flags  (16 bits, the DNP3_Flags struct)  if the variation has flags
+//   value  (1, 2, 8, 16, 32 or 64 bits)
+//   time   (48 bits absolute or 16 bits relative)
+//
+// records of 1 or 2 bits (packed binaries) are packed into bytes LSB-first
+// like on the wire; all others occupy whole bytes.
+//
+// the wire format of the same objects differs only in the flags, which are
+// a single octet whose meaning depends on the group. blocks can keep their
+// objects in that form (raw) and have them decoded on access.
+
+#include <string.h>
+#include <assert.h>
+#include "record.h"
+#include "app.h"    // GV
+#include "obj/binary.h"
+#include "obj/counter.h"
+#include "obj/analog.h"
+
+
+enum RecordValue {
+    VAL_NONE,
+    VAL_BIT,        // o.bit
+    VAL_DBLBIT,     // o.dblbit
+    VAL_CMDEV,      // o.cmdev (8 bits)
+    VAL_CTR16,      // o.ctr.value
+    VAL_CTR32,
+    VAL_INT16,      // o.ana.sint
+    VAL_INT32,
+    VAL_UINT16,     // o.ana.uint
+    VAL_UINT32,
+    VAL_FLT32,      // o.ana.flt
+    VAL_FLT64
+};
+
+enum RecordTime {
+    TIME_NONE,
+    TIME_ABS,       // o.timed.abstime (48 bits)
+    TIME_REL        // o.timed.reltime (16 bits)
+};
+
+struct RecordType {
+    uint8_t flags:1;
+    uint8_t value:4;
+    uint8_t time:2;
+};
+
+static const uint8_t value_bits[] = {
+    [VAL_NONE]   = 0,
+    [VAL_BIT]    = 1,
+    [VAL_DBLBIT] = 2,
+    [VAL_CMDEV]  = 8,
+    [VAL_CTR16]  = 16, [VAL_CTR32]  = 32,
+    [VAL_INT16]  = 16, [VAL_INT32]  = 32,
+    [VAL_UINT16] = 16, [VAL_UINT32] = 32,
+    [VAL_FLT32]  = 32, [VAL_FLT64]  = 64
+};
+
+static const uint8_t time_bits[] = {
+    [TIME_NONE] = 0,
+    [TIME_ABS]  = 48,
+    [TIME_REL]  = 16
+};
+
+#define R(F, VAL, T) ((struct RecordType){F, VAL_##VAL, TIME_##T})
+
+// the layout of each variation's record; value NONE means there is none.
+// cf. dnp3_format_object for which object fields each variation uses.
+static struct RecordType record_type(DNP3_Group g, DNP3_Variation v)
+{
+    switch(g << 8 | v) {
+    case GV(BININ, PACKED):
+    case GV(BINOUT, PACKED):
+    case GV(BINOUTCMD, PCM):
+    case GV(IIN, PACKED):
+        return R(0, BIT, NONE);
+    case GV(DBLBITIN, PACKED):
+        return R(0, DBLBIT, NONE);
+
+    // NB: state of binaries is part of the flags
+    case GV(BININ, FLAGS):
+    case GV(BINOUT, FLAGS):
+    case GV(BININEV, NOTIME):
+    case GV(BINOUTEV, NOTIME):
+    case GV(DBLBITIN, FLAGS):
+    case GV(DBLBITINEV, NOTIME):
+        return R(1, NONE, NONE);
+    case GV(BININEV, ABSTIME):
+    case GV(BINOUTEV, ABSTIME):
+    case GV(DBLBITINEV, ABSTIME):
+        return R(1, NONE, ABS);
+    case GV(BININEV, RELTIME):
+    case GV(DBLBITINEV, RELTIME):
+        return R(1, NONE, REL);
+
+    case GV(BINOUTCMDEV, NOTIME):
+        return R(0, CMDEV, NONE);
+    case GV(BINOUTCMDEV, ABSTIME):
+        return R(0, CMDEV, ABS);
+
+    case GV(CTR, 32BIT):
+    case GV(CTREV, 32BIT):
+    case GV(FROZENCTR, 32BIT):
+    case GV(FROZENCTREV, 32BIT):
+        return R(1, CTR32, NONE);
+    case GV(CTR, 16BIT):
+    case GV(CTREV, 16BIT):
+    case GV(FROZENCTR, 16BIT):
+    case GV(FROZENCTREV, 16BIT):
+        return R(1, CTR16, NONE);
+    case GV(CTR, 32BIT_NOFLAG):
+    case GV(FROZENCTR, 32BIT_NOFLAG):
+        return R(0, CTR32, NONE);
+    case GV(CTR, 16BIT_NOFLAG):
+    case GV(FROZENCTR, 16BIT_NOFLAG):
+        return R(0, CTR16, NONE);
+    case GV(CTREV, 32BIT_TIME):
+    case GV(FROZENCTR, 32BIT_TIME):
+    case GV(FROZENCTREV, 32BIT_TIME):
+        return R(1, CTR32, ABS);
+    case GV(CTREV, 16BIT_TIME):
+    case GV(FROZENCTR, 16BIT_TIME):
+    case GV(FROZENCTREV, 16BIT_TIME):
+        return R(1, CTR16, ABS);
+
+    case GV(ANAIN, 32BIT):
+    case GV(ANAINEV, 32BIT):
+    case GV(FROZENANAIN, 32BIT):
+    case GV(FROZENANAINEV, 32BIT):
+    case GV(ANAOUTSTATUS, 32BIT):
+    case GV(ANAOUTEV, 32BIT):
+        return R(1, INT32, NONE);
+    case GV(ANAIN, 16BIT):
+    case GV(ANAINEV, 16BIT):
+    case GV(FROZENANAIN, 16BIT):
+    case GV(FROZENANAINEV, 16BIT):
+    case GV(ANAOUTSTATUS, 16BIT):
+    case GV(ANAOUTEV, 16BIT):
+        return R(1, INT16, NONE);
+    case GV(ANAIN, 32BIT_NOFLAG):
+    case GV(FROZENANAIN, 32BIT_NOFLAG):
+        return R(0, INT32, NONE);
+    case GV(ANAIN, 16BIT_NOFLAG):
+    case GV(FROZENANAIN, 16BIT_NOFLAG):
+        return R(0, INT16, NONE);
+    case GV(ANAIN, FLOAT):
+    case GV(ANAINEV, FLOAT):
+    case GV(FROZENANAIN, FLOAT):
+    case GV(FROZENANAINEV, FLOAT):
+    case GV(ANAOUTSTATUS, FLOAT):
+    case GV(ANAOUTEV, FLOAT):
+        return R(1, FLT32, NONE);
+    case GV(ANAIN, DOUBLE):
+    case GV(ANAINEV, DOUBLE):
+    case GV(FROZENANAIN, DOUBLE):
+    case GV(FROZENANAINEV, DOUBLE):
+    case GV(ANAOUTSTATUS, DOUBLE):
+    case GV(ANAOUTEV, DOUBLE):
+        return R(1, FLT64, NONE);
+    case GV(ANAINEV, 32BIT_TIME):
+    case GV(FROZENANAIN, 32BIT_TIME):
+    case GV(FROZENANAINEV, 32BIT_TIME):
+    case GV(ANAOUTEV, 32BIT_TIME):
+        return R(1, INT32, ABS);
+    case GV(ANAINEV, 16BIT_TIME):
+    case GV(FROZENANAIN, 16BIT_TIME):
+    case GV(FROZENANAINEV, 16BIT_TIME):
+    case GV(ANAOUTEV, 16BIT_TIME):
+        return R(1, INT16, ABS);
+    case GV(ANAINEV, FLOAT_TIME):
+    case GV(FROZENANAINEV, FLOAT_TIME):
+    case GV(ANAOUTEV, FLOAT_TIME):
+        return R(1, FLT32, ABS);
+    case GV(ANAINEV, DOUBLE_TIME):
+    case GV(FROZENANAINEV, DOUBLE_TIME):
+    case GV(ANAOUTEV, DOUBLE_TIME):
+        return R(1, FLT64, ABS);
+
+    case GV(ANAINDEADBAND, 16BIT):
+        return R(0, UINT16, NONE);
+    case GV(ANAINDEADBAND, 32BIT):
+        return R(0, UINT32, NONE);
+    case GV(ANAINDEADBAND, FLOAT):
+        return R(0, FLT32, NONE);
+
+    default:
+        return R(0, NONE, NONE);
+    }
+}
+
+#undef R
+
+static size_t bits(struct RecordType t)
+{
+    if(t.value == VAL_NONE && !t.flags)
+        return 0;
+    return (t.flags ? 16 : 0) + value_bits[t.value] + time_bits[t.time];
+}
+
+size_t dnp3_record_bits(DNP3_Group g, DNP3_Variation v)
+{
+    return bits(record_type(g, v));
+}
+
+size_t dnp3_record_size(DNP3_Group g, DNP3_Variation v, size_t n)
+{
+    return (n * dnp3_record_bits(g, v) + 7) / 8;
+}
+
+// little-endian integer fields
+static void put(uint8_t **p, uint64_t x, size_t nbytes)
+{
+    for(size_t i=0; i<nbytes; i++)
+        *(*p)++ = x >> (8*i);
+}
+
+static uint64_t get(const uint8_t **p, size_t nbytes)
+{
+    uint64_t x = 0;
+
+    for(size_t i=0; i<nbytes; i++)
+        x |= (uint64_t)*(*p)++ << (8*i);
+    return x;
+}
+
+// encode the value and time fields starting at p
+static void putfields(struct RecordType t, uint8_t *p, const DNP3_Object *o)
+{
+    union { float f; uint32_t u; } f32;
+    union { double f; uint64_t u; } f64;
+
+    switch(t.value) {
+    case VAL_CMDEV:     put(&p, o->cmdev.cs | o->cmdev.status << 1, 1); break;
+    case VAL_CTR16:     put(&p, o->ctr.value, 2); break;
+    case VAL_CTR32:     put(&p, o->ctr.value, 4); break;
+    case VAL_INT16:     put(&p, (uint16_t)o->ana.sint, 2); break;
+    case VAL_INT32:     put(&p, (uint32_t)o->ana.sint, 4); break;
+    case VAL_UINT16:    put(&p, o->ana.uint, 2); break;
+    case VAL_UINT32:    put(&p, o->ana.uint, 4); break;
+    case VAL_FLT32:     f32.f = o->ana.flt; put(&p, f32.u, 4); break;
+    case VAL_FLT64:     f64.f = o->ana.flt; put(&p, f64.u, 8); break;
+    }
+    switch(t.time) {
+    case TIME_ABS:      put(&p, o->timed.abstime, 6); break;
+    case TIME_REL:      put(&p, o->timed.reltime, 2); break;
+    }
+}
+
+void dnp3_record_put(DNP3_Group g, DNP3_Variation v, uint8_t *recs, size_t i,
+                     const DNP3_Object *o)
+{
+    struct RecordType t = record_type(g, v);
+    size_t n = bits(t);
+    uint8_t *p;
+    uint16_t flags;
+
+    assert(n > 0);
+
+    // sub-byte records
+    if(n < 8) {
+        size_t k = i * n;
+        uint8_t x = (t.value == VAL_BIT) ? o->bit : o->dblbit;
+        uint8_t mask = (1 << n) - 1;
+
+        recs[k/8] &= ~(mask << (k%8));
+        recs[k/8] |= (x & mask) << (k%8);
+        return;
+    }
+
+    p = recs + i * (n / 8);
+    if(t.flags) {
+        memcpy(&flags, &o->flags, sizeof flags);
+        put(&p, flags, 2);
+    }
+    putfields(t, p, o);
+}
+
+// decode the value and time fields starting at p
+static void getfields(struct RecordType t, const uint8_t *p, DNP3_Object *o)
+{
+    union { float f; uint32_t u; } f32;
+    union { double f; uint64_t u; } f64;
+    uint8_t x;
+
+    switch(t.value) {
+    case VAL_CMDEV:     x = get(&p, 1);
+                        o->cmdev.cs = x & 1;
+                        o->cmdev.status = x >> 1;
+                        break;
+    case VAL_CTR16:     o->ctr.value = get(&p, 2); break;
+    case VAL_CTR32:     o->ctr.value = get(&p, 4); break;
+    case VAL_INT16:     o->ana.sint = (int16_t)get(&p, 2); break;
+    case VAL_INT32:     o->ana.sint = (int32_t)get(&p, 4); break;
+    case VAL_UINT16:    o->ana.uint = get(&p, 2); break;
+    case VAL_UINT32:    o->ana.uint = get(&p, 4); break;
+    case VAL_FLT32:     f32.u = get(&p, 4); o->ana.flt = f32.f; break;
+    case VAL_FLT64:     f64.u = get(&p, 8); o->ana.flt = f64.f; break;
+    }
+    switch(t.time) {
+    case TIME_ABS:      o->timed.abstime = get(&p, 6); break;
+    case TIME_REL:      o->timed.reltime = get(&p, 2); break;
+    }
+}
+
+static void getrec(struct RecordType t, const uint8_t *recs, size_t i,
+                   DNP3_Object *o)
+{
+    size_t n = bits(t);
+    const uint8_t *p;
+    uint16_t flags;
+    uint8_t x;
+
+    assert(n > 0);
+    memset(o, 0, sizeof(DNP3_Object));
+
+    // sub-byte records
+    if(n < 8) {
+        size_t k = i * n;
+        x = (recs[k/8] >> (k%8)) & ((1 << n) - 1);
+
+        if(t.value == VAL_BIT)
+            o->bit = x;
+        else
+            o->dblbit = x;
+        return;
+    }
+
+    p = recs + i * (n / 8);
+    if(t.flags) {
+        flags = get(&p, 2);
+        memcpy(&o->flags, &flags, sizeof flags);
+    }
+    getfields(t, p, o);
+}
+
+void dnp3_record_get(DNP3_Group g, DNP3_Variation v, const uint8_t *recs,
+                     size_t i, DNP3_Object *o)
+{
+    getrec(record_type(g, v), recs, i, o);
+}
+
+
+// raw objects as on the wire...
+
+struct FlagOctet {
+    DNP3_Flags (*decode)(uint8_t);
+    uint8_t (*encode)(DNP3_Flags);
+    uint8_t reserved;
+};
+
+#define F(PFX, RES) ((struct FlagOctet){dnp3_##PFX##_flags, dnp3_##PFX##_octet, \
+                                        RES##_FLAGS_RESERVED})
+
+// how to code the flag octet of the given group, decode NULL if unknown
+static struct FlagOctet flag_octet(DNP3_Group g)
+{
+    switch(g) {
+    case G(BININ):
+    case G(BININEV):
+    case G(BINOUTEV):
+        return F(binin, BININ);
+    case G(DBLBITIN):
+    case G(DBLBITINEV):
+        return F(dblbit, DBLBIT);
+    case G(BINOUT):
+        return F(binout, BINOUT);
+    case G(CTR):
+    case G(FROZENCTR):
+    case G(CTREV):
+    case G(FROZENCTREV):
+        return F(ctr, CTR);
+    case G(ANAIN):
+    case G(FROZENANAIN):
+    case G(ANAINEV):
+    case G(FROZENANAINEV):
+    case G(ANAOUTSTATUS):
+    case G(ANAOUTEV):
+        return F(ana, ANA);
+    default:
+        return (struct FlagOctet){NULL, NULL, 0};
+    }
+}
+
+#undef F
+
+static size_t wire_bits(DNP3_Group g, struct RecordType t)
+{
+    size_t n = bits(t);
+
+    if(t.flags && !flag_octet(g).decode)
+        return 0;
+    return t.flags ? n - 8 : n;     // one octet instead of DNP3_Flags
+}
+
+size_t dnp3_wire_bits(DNP3_Group g, DNP3_Variation v)
+{
+    return wire_bits(g, record_type(g, v));
+}
+
+size_t dnp3_object_bits(DNP3_Group g, DNP3_Variation v)
+{
+    size_t n = dnp3_wire_bits(g, v);
+
+    if(n > 0)
+        return n;
+
+    switch(g << 8 | v) {
+    case GV(BINOUTCMD, CROB):
+    case GV(BINOUTCMD, PCB):            return 88;
+
+    case GV(ANAOUT, 32BIT):             return 40;
+    case GV(ANAOUT, 16BIT):             return 24;
+    case GV(ANAOUT, FLOAT):             return 40;
+    case GV(ANAOUT, DOUBLE):            return 72;
+
+    case GV(ANAOUTCMDEV, 32BIT):        return 40;
+    case GV(ANAOUTCMDEV, 16BIT):        return 24;
+    case GV(ANAOUTCMDEV, 32BIT_TIME):   return 88;
+    case GV(ANAOUTCMDEV, 16BIT_TIME):   return 72;
+    case GV(ANAOUTCMDEV, FLOAT):        return 40;
+    case GV(ANAOUTCMDEV, DOUBLE):       return 72;
+    case GV(ANAOUTCMDEV, FLOAT_TIME):   return 88;
+    case GV(ANAOUTCMDEV, DOUBLE_TIME):  return 120;
+
+    case GV(TIME, TIME):
+    case GV(TIME, RECORDED_TIME):
+    case GV(CTO, SYNC):
+    case GV(CTO, UNSYNC):               return 48;
+    case GV(TIME, TIME_INTERVAL):       return 80;
+    case GV(TIME, INDEXED_TIME):        return 88;
+
+    case GV(DELAY, S):
+    case GV(DELAY, MS):                 return 16;
+
+    case GV(AUTH, AGGR):                return 48;
+    case GV(AUTH, KEYSTATREQ):          return 16;
+
+    default:                            return 0;
+    }
+}
+
+uint8_t dnp3_wire_reserved(DNP3_Group g, DNP3_Variation v)
+{
+    return record_type(g, v).flags ? flag_octet(g).reserved : 0;
+}
+
+static void getwire(DNP3_Group g, struct RecordType t, const uint8_t *raw,
+                    size_t i, DNP3_Object *o)
+{
+    size_t n = wire_bits(g, t);
+    const uint8_t *p;
+    uint8_t x;
+
+    assert(n > 0);
+
+    // sub-byte objects are laid out like records
+    if(n < 8) {
+        getrec(t, raw, i, o);
+        return;
+    }
+
+    memset(o, 0, sizeof(DNP3_Object));
+    p = raw + i * (n / 8);
+    if(t.flags)
+        o->flags = flag_octet(g).decode(*p++);
+    if(t.value == VAL_CMDEV) {
+        // status in bits 0-6, control state in bit 7
+        x = *p++;
+        o->cmdev.status = x & 0x7F;
+        o->cmdev.cs = x >> 7;
+        t.value = VAL_NONE;
+    }
+    getfields(t, p, o);
+}
+
+void dnp3_wire_get(DNP3_Group g, DNP3_Variation v, const uint8_t *raw,
+                   size_t i, DNP3_Object *o)
+{
+    getwire(g, record_type(g, v), raw, i, o);
+}
+
+void dnp3_wire_put(DNP3_Group g, DNP3_Variation v, uint8_t *raw, size_t i,
+                   const DNP3_Object *o)
+{
+    struct RecordType t = record_type(g, v);
+    size_t n = wire_bits(g, t);
+    uint8_t *p;
+
+    assert(n > 0);
+
+    // sub-byte objects are laid out like records
+    if(n < 8) {
+        dnp3_record_put(g, v, raw, i, o);
+        return;
+    }
+
+    p = raw + i * (n / 8);
+    if(t.flags)
+        *p++ = flag_octet(g).encode(o->flags);
+    if(t.value == VAL_CMDEV) {
+        // status in bits 0-6, control state in bit 7
+        *p++ = o->cmdev.status | o->cmdev.cs << 7;
+        t.value = VAL_NONE;
+    }
+    putfields(t, p, o);
+}
+
+
+
+// relative times...
+
+static bool is_reltime(const DNP3_ObjectBlock *ob)
+{
+    return (record_type(ob->group, ob->variation).time == TIME_REL);
+}
+
+// apply the CTO recorded in the block to one of its objects
+static void settime(const DNP3_ObjectBlock *ob, DNP3_Object *o)
+{
+    if(!ob->nocto)
+        o->timed.abstime = ob->cto + o->timed.reltime;
+}
+
+void dnp3_oblock_resolve(DNP3_ObjectBlock *ob, const DNP3_ObjectBlock *cto)
+{
+    DNP3_Object c;
+
+    // blocks are resolved at most once; objects are updated in place
+    if(!is_reltime(ob) || !ob->nocto)
+        return;
+
+    // the last object of the CTO block counts (there should be only one)
+    if(!cto || cto->count == 0 || !dnp3_oblock_get(cto, cto->count - 1, &c))
+        return;
+    ob->cto = c.time.abstime;
+    ob->nocto = 0;
+    ob->unsync = (cto->variation == DNP3_VARIATION_CTO_UNSYNC);
+
+    // records and raw objects are resolved on access
+    if(ob->objects) {
+        for(size_t i=0; i<ob->count; i++)
+            settime(ob, &ob->objects[i]);
+    }
+}
+
+void dnp3_oblock_unresolve(const DNP3_ObjectBlock *ob, DNP3_Object *o)
+{
+    if(is_reltime(ob) && !ob->nocto)
+        o->timed.reltime = o->timed.abstime - ob->cto;
+}
+
+bool dnp3_oblock_get(const DNP3_ObjectBlock *ob, size_t i, DNP3_Object *o)
+{
+    if(i >= ob->count)
+        return false;
+
+    if(ob->objects) {
+        *o = ob->objects[i];
+        return true;
+    }
+    if(ob->records) {
+        dnp3_record_get(ob->group, ob->variation, ob->records, i, o);
+    } else if(ob->raw) {
+        dnp3_wire_get(ob->group, ob->variation, ob->raw, i, o);
+    } else {
+        return false;
+    }
+
+    if(is_reltime(ob))
+        settime(ob, o);
+    return true;
+}
+
+size_t dnp3_oblock_getn(const DNP3_ObjectBlock *ob, size_t i, size_t n,
+                        DNP3_Object *out)
+{
+    size_t k;
+
+    if(i >= ob->count)
+        return 0;
+    if(n > ob->count - i)
+        n = ob->count - i;
+
+    if(ob->objects) {
+        memcpy(out, ob->objects + i, n * sizeof(DNP3_Object));
+    } else if(ob->records) {
+        struct RecordType t = record_type(ob->group, ob->variation);
+        for(k=0; k<n; k++)
+            getrec(t, ob->records, i+k, out+k);
+    } else if(ob->raw) {
+        struct RecordType t = record_type(ob->group, ob->variation);
+        for(k=0; k<n; k++)
+            getwire(ob->group, t, ob->raw, i+k, out+k);
+    } else {
+        return 0;
+    }
+
+    if(!ob->objects && is_reltime(ob)) {
+        for(k=0; k<n; k++)
+            settime(ob, out+k);
+    }
+
+    return n;
+}
@@ -0,0 +1,57 @@
+// compact object records
+//
+// a DNP3_Object is a union sized for the largest object type, 24 bytes for a
+// timestamped analog. the common point types (binary, counter, analog) can
+// instead be stored as records of exactly the size their variation needs,
+// bit-packed where they are smaller than a byte, or left in their wire
+// format. see dnp3_oblock_get for access.
+
+#ifndef DNP3_RECORD_H_SEEN
+#define DNP3_RECORD_H_SEEN
+
+#include <dnp3hammer.h>
+
+
+// size of a compact record in bits, 0 if the variation has none
+size_t dnp3_record_bits(DNP3_Group g, DNP3_Variation v);
+
+// size of an array of n records in bytes
+size_t dnp3_record_size(DNP3_Group g, DNP3_Variation v, size_t n);
+
+// encode/decode the i-th record of an array
+void dnp3_record_put(DNP3_Group g, DNP3_Variation v, uint8_t *recs, size_t i,
+                     const DNP3_Object *o);
+void dnp3_record_get(DNP3_Group g, DNP3_Variation v, const uint8_t *recs,
+                     size_t i, DNP3_Object *o);
+
+// size of the same objects on the wire in bits, 0 if not supported.
+// these can be kept raw and decoded on access (cf. dnp3_p_oblock_lazy).
+size_t dnp3_wire_bits(DNP3_Group g, DNP3_Variation v);
+
+// size of any fixed-size object on the wire in bits, 0 if the variation has
+// none (variable-format objects, object headers only). block parsers rely
+// on this for the minimum size of their objects.
+size_t dnp3_object_bits(DNP3_Group g, DNP3_Variation v);
+
+// reserved bits of the flag octet (0 if none)
+uint8_t dnp3_wire_reserved(DNP3_Group g, DNP3_Variation v);
+
+// decode/encode the i-th object of an array in wire format
+void dnp3_wire_get(DNP3_Group g, DNP3_Variation v, const uint8_t *raw,
+                   size_t i, DNP3_Object *o);
+void dnp3_wire_put(DNP3_Group g, DNP3_Variation v, uint8_t *raw, size_t i,
+                   const DNP3_Object *o);
+
+// resolve the relative times of a g2v3/g4v3 block against the CTO block
+// (g51) preceding it in the fragment, or NULL if there is none. the CTO is
+// recorded in the block; objects stored as DNP3_Object structs are updated
+// in place (abstime replaces reltime), records and raw objects on access
+// (dnp3_oblock_get). other blocks and blocks already resolved are left
+// alone.
+void dnp3_oblock_resolve(DNP3_ObjectBlock *ob, const DNP3_ObjectBlock *cto);
+
+// turn an object of the given block as returned by dnp3_oblock_get back into
+// its relative form for encoding (dnp3_record_put, dnp3_wire_put).
+void dnp3_oblock_unresolve(const DNP3_ObjectBlock *ob, DNP3_Object *o);
+
+#endif // DNP3_RECORD_H_SEEN
@@ -0,0 +1,502 @@
+// secure authentication sessions: follows SAv5 exchanges per association
+//
+// a station challenges (g120v1) a critical request or response of the
+// other; the reply (g120v2) carries the challenge sequence number (CSQ) and
+// a MAC over the challenge message followed by the critical one. instead of waiting for a challenge, a
+// station may authenticate in aggressive mode (g120v3, g120v9) with a MAC
+// over the last challenge it received and its own message. the session keys
+// are set by the master: it asks for the key status (g120v4), the outstation
+// answers (g120v5) with a key change sequence number (KSQ) and challenge
+// data, the master sends the new keys wrapped in its update key (g120v6),
+// and the outstation confirms with a key status whose MAC covers the key
+// change message.
+//
+// MACs sent by the master are made with the control direction session key,
+// those of the outstation with the monitoring direction key. each user of
+// each association has its own pair of keys.
+//
+// the engine is passive: it does not answer, it reports (see DNP3_AuthEvent).
+// sessions are kept in a table of fixed size allocated up front, indexed by
+// (association, user) through an open-addressing hash. messages referred to
+// by a later MAC are kept in fixed buffers in the session. the last fragment
+// of each association that is not an authentication message is kept as
+// well, in a second table of the same kind, for the challenges referring
+// to it.
+
+#include <dnp3hammer.h>
+#include <stdint.h>
+#include <string.h>
+#include "hammer.h"
+#include "auth.h"
+#include "app.h"    // G, V
+
+
+#define MAXMSG DNP3_MAX_FRAGMENT  // longest message kept for a later MAC
+#define EMPTY UINT32_MAX    // free slot in the index
+
+// a message kept for the MAC of a later one
+struct Message {
+    DNP3_Variation variation;   // 0 if none
+    bool pending;               // a challenge awaiting its reply
+    uint8_t mal;                // MAC algorithm asked for
+    uint32_t seq;               // CSQ or KSQ
+    uint64_t time;
+    size_t len;
+    uint8_t buf[MAXMSG];
+};
+
+// a fragment that may be challenged
+struct Critical {
+    bool dir;
+    size_t len;                 // 0 if none
+    uint8_t buf[MAXMSG];
+};
+
+// the last such fragment of an association
+struct Assoc {
+    uint32_t assoc;
+    struct Critical last;
+};
+
+struct Session {
+    uint32_t assoc;
+    uint16_t usr;
+    bool keys;                  // control and monitor are valid
+    DNP3_AuthKey control;       // MACs sent by the master
+    DNP3_AuthKey monitor;       // MACs sent by the outstation
+    struct Message last[2];     // last challenge or key status, by sender
+    struct Critical challenged[2];  // the fragment each challenge refers to
+    struct Message keychange;   // until confirmed by a key status
+};
+
+struct DNP3_AuthEngine_ {
+    HAllocator *mm;
+    struct Session *sessions;   // [max]
+    size_t n;
+    size_t max;
+    uint32_t *index;            // [mask + 1], into sessions
+    size_t mask;
+    struct Assoc *assocs;       // [max]
+    size_t nassocs;
+    uint32_t *assoc_index;      // [mask + 1], into assocs
+
+    DNP3_AuthStats stats;
+
+    DNP3_AuthNotify notify;
+    DNP3_AuthUnwrap unwrap;
+    void *env;
+};
+
+
+DNP3_AuthEngine *dnp3_auth_engine__m(HAllocator *mm, size_t maxsessions,
+                                     DNP3_AuthNotify notify,
+                                     DNP3_AuthUnwrap unwrap, void *env)
+{
+    if(maxsessions < 1 || maxsessions >= EMPTY / 2)
+        return NULL;
+
+    DNP3_AuthEngine *eng = mm->alloc(mm, sizeof(DNP3_AuthEngine));
+    if(!eng) return NULL;
+
+    memset(eng, 0, sizeof(DNP3_AuthEngine));
+    eng->mm = mm;
+    eng->max = maxsessions;
+    eng->notify = notify;
+    eng->unwrap = unwrap;
+    eng->env = env;
+
+    // at most half full, so probes end quickly
+    size_t size = 1;
+    while(size < 2 * maxsessions)
+        size *= 2;
+    eng->mask = size - 1;
+
+    eng->sessions = mm->alloc(mm, maxsessions * sizeof(struct Session));
+    eng->index = mm->alloc(mm, size * sizeof(uint32_t));
+    eng->assocs = mm->alloc(mm, maxsessions * sizeof(struct Assoc));
+    eng->assoc_index = mm->alloc(mm, size * sizeof(uint32_t));
+    if(!eng->sessions || !eng->index || !eng->assocs || !eng->assoc_index) {
+        dnp3_auth_engine_free(eng);
+        return NULL;
+    }
+    for(size_t i=0; i<size; i++) {
+        eng->index[i] = EMPTY;
+        eng->assoc_index[i] = EMPTY;
+    }
+
+    return eng;
+}
+
+DNP3_AuthEngine *dnp3_auth_engine(size_t maxsessions, DNP3_AuthNotify notify,
+                                  DNP3_AuthUnwrap unwrap, void *env)
+{
+    return dnp3_auth_engine__m(h_system_allocator, maxsessions, notify,
+                               unwrap, env);
+}
+
+void dnp3_auth_engine_free(DNP3_AuthEngine *eng)
+{
+    HAllocator *mm = eng->mm;
+
+    if(eng->sessions)
+        mm->free(mm, eng->sessions);
+    if(eng->index)
+        mm->free(mm, eng->index);
+    if(eng->assocs)
+        mm->free(mm, eng->assocs);
+    if(eng->assoc_index)
+        mm->free(mm, eng->assoc_index);
+    mm->free(mm, eng);
+}
+
+void dnp3_auth_stats(const DNP3_AuthEngine *eng, DNP3_AuthStats *stats)
+{
+    *stats = eng->stats;
+    stats->sessions = eng->n;
+}
+
+static size_t hash(uint32_t assoc, uint16_t usr)
+{
+    uint64_t x = ((uint64_t)assoc << 16 | usr) * 0x9E3779B97F4A7C15ull;
+    return (size_t)(x >> 32);
+}
+
+// find the session of the given user, or the free slot for it
+static uint32_t *lookup_slot(const DNP3_AuthEngine *eng, uint32_t assoc,
+                             uint16_t usr)
+{
+    for(size_t i = hash(assoc, usr); ; i++) {
+        uint32_t *slot = &eng->index[i & eng->mask];
+
+        if(*slot == EMPTY)
+            return slot;
+        struct Session *s = &eng->sessions[*slot];
+        if(s->assoc == assoc && s->usr == usr)
+            return slot;
+    }
+}
+
+static struct Session *lookup(const DNP3_AuthEngine *eng, uint32_t assoc,
+                              uint16_t usr)
+{
+    uint32_t *slot = lookup_slot(eng, assoc, usr);
+    return (*slot == EMPTY) ? NULL : &eng->sessions[*slot];
+}
+
+// find the association, or the free slot for it
+static uint32_t *lookup_assoc_slot(const DNP3_AuthEngine *eng, uint32_t assoc)
+{
+    for(size_t i = hash(assoc, 0); ; i++) {
+        uint32_t *slot = &eng->assoc_index[i & eng->mask];
+
+        if(*slot == EMPTY || eng->assocs[*slot].assoc == assoc)
+            return slot;
+    }
+}
+
+static struct Assoc *lookup_assoc(const DNP3_AuthEngine *eng, uint32_t assoc)
+{
+    uint32_t *slot = lookup_assoc_slot(eng, assoc);
+    return (*slot == EMPTY) ? NULL : &eng->assocs[*slot];
+}
+
+int dnp3_auth_set_keys(DNP3_AuthEngine *eng, uint32_t assoc, uint16_t usr,
+                       const DNP3_AuthKey *control,
+                       const DNP3_AuthKey *monitor)
+{
+    uint32_t *slot = lookup_slot(eng, assoc, usr);
+    struct Session *s;
+
+    if(*slot == EMPTY) {
+        if(eng->n >= eng->max)
+            return -1;
+        *slot = eng->n++;
+        s = &eng->sessions[*slot];
+        memset(s, 0, sizeof(struct Session));
+        s->assoc = assoc;
+        s->usr = usr;
+
+        // every association has at least one user, so this cannot fill up
+        uint32_t *aslot = lookup_assoc_slot(eng, assoc);
+        if(*aslot == EMPTY) {
+            *aslot = eng->nassocs++;
+            eng->assocs[*aslot].assoc = assoc;
+            eng->assocs[*aslot].last.len = 0;
+        }
+    } else {
+        s = &eng->sessions[*slot];
+    }
+
+    s->keys = (control && monitor);
+    if(s->keys) {
+        s->control = *control;
+        s->monitor = *monitor;
+    }
+    return 0;
+}
+
+static void report(DNP3_AuthEngine *eng, const struct Session *s, bool dir,
+                   DNP3_Variation v, uint32_t seq, uint8_t code,
+                   DNP3_AuthResult result)
+{
+    DNP3_AuthEvent ev = {s->assoc, s->usr, dir, v, seq, code, result};
+
+    switch(result) {
+    case DNP3_AUTH_OK:          eng->stats.verified++; break;
+    case DNP3_AUTH_FAILED:      eng->stats.failed++; break;
+    case DNP3_AUTH_NOKEY:       eng->stats.nokey++; break;
+    case DNP3_AUTH_UNSUPPORTED: eng->stats.unsupported++; break;
+    case DNP3_AUTH_UNEXPECTED:  eng->stats.unexpected++; break;
+    case DNP3_AUTH_REJECTED:    eng->stats.errors++; break;
+    case DNP3_AUTH_TIMEOUT:     eng->stats.timeouts++; break;
+    }
+
+    if(eng->notify)
+        eng->notify(eng->env, &ev);
+}
+
+// keep a message for a later MAC. returns false if it is too long.
+static bool keep(DNP3_AuthEngine *eng, struct Message *m, DNP3_Variation v,
+                 uint32_t seq, uint8_t mal, uint64_t now,
+                 const uint8_t *buf, size_t len)
+{
+    if(len > MAXMSG) {
+        eng->stats.overflows++;
+        m->variation = 0;
+        m->pending = false;
+        return false;
+    }
+
+    m->variation = v;
+    m->pending = false;
+    m->mal = mal;
+    m->seq = seq;
+    m->time = now;
+    m->len = len;
+    memcpy(m->buf, buf, len);
+    return true;
+}
+
+// keep a fragment that may be challenged
+static void keep_critical(DNP3_AuthEngine *eng, struct Critical *c, bool dir,
+                          const uint8_t *buf, size_t len)
+{
+    if(len > MAXMSG) {
+        eng->stats.overflows++;
+        c->len = 0;
+        return;
+    }
+
+    c->dir = dir;
+    c->len = len;
+    memcpy(c->buf, buf, len);
+}
+
+// length of the (truncated) MACs of the given algorithm, 0 if unsupported
+static size_t mac_length(uint8_t mal)
+{
+    switch(mal) {
+    case 3: return 8;       // HMAC-SHA-256, truncated to 8 octets
+    case 4: return 16;      // HMAC-SHA-256, truncated to 16 octets
+    default: return 0;      // SHA-1 or AES-GMAC
+    }
+}
+
+// check the MAC sent in direction dir over a followed by b
+static DNP3_AuthResult check(const struct Session *s, bool dir, uint8_t mal,
+                             const uint8_t *a, size_t alen,
+                             const uint8_t *b, size_t blen,
+                             const uint8_t *mac, size_t maclen)
+{
+    uint8_t out[32];
+    size_t n = mac_length(mal);
+
+    if(n == 0)
+        return DNP3_AUTH_UNSUPPORTED;
+    if(!s->keys)
+        return DNP3_AUTH_NOKEY;
+    if(maclen != n)
+        return DNP3_AUTH_FAILED;
+
+    dnp3_auth_mac(dir ? &s->control : &s->monitor, a, alen, b, blen, out);
+    return dnp3_auth_mac_equal(out, mac, n) ? DNP3_AUTH_OK : DNP3_AUTH_FAILED;
+}
+
+static void reply(DNP3_AuthEngine *eng, struct Session *s, bool dir,
+                  const DNP3_Object *o)
+{
+    struct Message *m = &s->last[!dir];
+    struct Critical *c = &s->challenged[!dir];
+    DNP3_AuthResult r;
+
+    if(!m->pending || m->seq != o->auth->seq) {
+        r = DNP3_AUTH_UNEXPECTED;
+    } else {
+        m->pending = false;
+        r = check(s, dir, m->mal, m->buf, m->len, c->buf, c->len,
+                  o->auth->data, o->auth->len);
+    }
+    report(eng, s, dir, V(AUTH, REPLY), o->auth->seq, 0, r);
+}
+
+static void keystatus(DNP3_AuthEngine *eng, struct Session *s, bool dir,
+                      uint64_t now, const uint8_t *buf, size_t len,
+                      const DNP3_Object *o)
+{
+    struct Message *kc = &s->keychange;
+
+    // confirming a key change
+    if(kc->variation) {
+        DNP3_AuthResult r = check(s, dir, o->auth->mal, kc->buf, kc->len,
+                                  NULL, 0, o->auth->data + o->auth->len,
+                                  o->auth->maclen);
+        kc->variation = 0;
+        report(eng, s, dir, V(AUTH, KEYSTATUS), o->auth->seq, 0, r);
+    }
+
+    keep(eng, &s->last[dir], V(AUTH, KEYSTATUS), o->auth->seq, o->auth->mal,
+         now, buf, len);
+}
+
+static void keychange(DNP3_AuthEngine *eng, struct Session *s, bool dir,
+                      uint64_t now, const uint8_t *buf, size_t len,
+                      const DNP3_Object *o)
+{
+    struct Message *m = &s->last[!dir];
+    DNP3_AuthKey control, monitor;
+    DNP3_AuthResult r;
+
+    s->keychange.variation = 0;
+    if(m->variation != V(AUTH, KEYSTATUS) || m->seq != o->auth->seq) {
+        r = DNP3_AUTH_UNEXPECTED;
+    } else if(!eng->unwrap) {
+        s->keys = false;        // new keys we cannot know
+        r = DNP3_AUTH_NOKEY;
+    } else if(!eng->unwrap(eng->env, s->assoc, s->usr, o->auth->data,
+                           o->auth->len, &control, &monitor)) {
+        r = DNP3_AUTH_FAILED;
+    } else {
+        s->control = control;
+        s->monitor = monitor;
+        s->keys = true;
+        eng->stats.keychanges++;
+        keep(eng, &s->keychange, V(AUTH, KEYCHANGE), o->auth->seq, 0,
+             now, buf, len);
+        r = DNP3_AUTH_OK;
+    }
+    report(eng, s, dir, V(AUTH, KEYCHANGE), o->auth->seq, 0, r);
+}
+
+// an authentication object sent in direction dir
+static void message(DNP3_AuthEngine *eng, uint32_t assoc, bool dir,
+                    uint64_t now, const uint8_t *buf, size_t len,
+                    DNP3_Variation v, const DNP3_Object *o)
+{
+    struct Session *s = lookup(eng, assoc, o->auth->usr);
+    if(!s) {
+        eng->stats.unknown++;
+        return;
+    }
+
+    switch(v) {
+    case V(AUTH, CHALLENGE):
+        eng->stats.challenges++;
+        if(keep(eng, &s->last[dir], v, o->auth->seq, o->auth->mal, now,
+                buf, len))
+            s->last[dir].pending = true;
+
+        // the critical fragment is the last one of the other station
+        struct Assoc *a = lookup_assoc(eng, assoc);
+        struct Critical *c = &s->challenged[dir];
+        if(a && a->last.len > 0 && a->last.dir != dir)
+            keep_critical(eng, c, a->last.dir, a->last.buf, a->last.len);
+        else
+            c->len = 0;
+        break;
+    case V(AUTH, REPLY):
+        reply(eng, s, dir, o);
+        break;
+    case V(AUTH, KEYSTATUS):
+        keystatus(eng, s, dir, now, buf, len, o);
+        break;
+    case V(AUTH, KEYCHANGE):
+        keychange(eng, s, dir, now, buf, len, o);
+        break;
+    case V(AUTH, ERROR):
+        s->last[!dir].pending = false;      // the challenge is answered
+        report(eng, s, dir, v, o->auth->seq, o->auth->code,
+               DNP3_AUTH_REJECTED);
+        break;
+    default:                                // key status request
+        break;
+    }
+}
+
+// an aggressive-mode request or response sent in direction dir
+static void aggressive(DNP3_AuthEngine *eng, uint32_t assoc, bool dir,
+                       const uint8_t *buf, size_t len, const DNP3_AuthData *a)
+{
+    struct Session *s = lookup(eng, assoc, a->usr);
+    DNP3_AuthResult r;
+
+    if(!s) {
+        eng->stats.unknown++;
+        return;
+    }
+
+    struct Message *m = &s->last[!dir];
+    if(!m->variation || len < a->maclen)
+        r = DNP3_AUTH_UNEXPECTED;
+    else
+        r = check(s, dir, m->mal, m->buf, m->len, buf, len - a->maclen,
+                  a->mac, a->maclen);
+    report(eng, s, dir, V(AUTH, AGGR), a->csq, 0, r);
+}
+
+void dnp3_auth_update(DNP3_AuthEngine *eng, uint32_t assoc, bool dir,
+                      uint64_t now, const uint8_t *buf, size_t len,
+                      const DNP3_Fragment *frag)
+{
+    if(frag->auth)
+        aggressive(eng, assoc, dir, buf, len, frag->auth);
+
+    if(frag->fc != DNP3_AUTHENTICATE_REQ && frag->fc != DNP3_AUTH_REQ_NO_ACK &&
+       frag->fc != DNP3_AUTHENTICATE_RESP) {
+        struct Assoc *a = lookup_assoc(eng, assoc);
+        if(a)
+            keep_critical(eng, &a->last, dir, buf, len);
+        return;
+    }
+
+    for(size_t i=0; i<frag->nblocks; i++) {
+        const DNP3_ObjectBlock *ob = frag->odata[i];
+
+        if(ob->group != G(AUTH) || !ob->objects)
+            continue;
+        for(size_t j=0; j<ob->count; j++)
+            message(eng, assoc, dir, now, buf, len, ob->variation,
+                    &ob->objects[j]);
+    }
+}
+
+size_t dnp3_auth_expire(DNP3_AuthEngine *eng, uint64_t now, uint64_t timeout)
+{
+    size_t n = 0;
+
+    for(size_t i=0; i<eng->n; i++) {
+        struct Session *s = &eng->sessions[i];
+
+        for(int d=0; d<2; d++) {
+            struct Message *m = &s->last[d];
+
+            if(m->pending && now >= m->time && now - m->time >= timeout) {
+                m->pending = false;
+                report(eng, s, d, V(AUTH, CHALLENGE), m->seq, 0,
+                       DNP3_AUTH_TIMEOUT);
+                n++;
+            }
+        }
+    }
+
+    return n;
+}
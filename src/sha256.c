@@ -0,0 +1,120 @@
+// SHA-256 compression, see sha256.h
+
+#include "sha256.h"
+
+
+static const uint32_t K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+    0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+    0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+    0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+    0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+    0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static const uint32_t H0[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+    0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+#define ROR(x, n)   ((x) >> (n) | (x) << (32 - (n)))
+#define S0(x)       (ROR(x, 2) ^ ROR(x, 13) ^ ROR(x, 22))
+#define S1(x)       (ROR(x, 6) ^ ROR(x, 11) ^ ROR(x, 25))
+#define s0(x)       (ROR(x, 7) ^ ROR(x, 18) ^ ((x) >> 3))
+#define s1(x)       (ROR(x, 17) ^ ROR(x, 19) ^ ((x) >> 10))
+#define CH(x,y,z)   (((x) & (y)) ^ (~(x) & (z)))
+#define MAJ(x,y,z)  (((x) & (y)) ^ ((x) & (z)) ^ ((y) & (z)))
+
+static uint32_t load32(const uint8_t *p)
+{
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 |
+           (uint32_t)p[2] << 8  | (uint32_t)p[3];
+}
+
+void sha256_init(uint32_t h[8])
+{
+    for(int i=0; i<8; i++)
+        h[i] = H0[i];
+}
+
+void sha256_block(uint32_t h[8], const uint8_t *blk)
+{
+    uint32_t w[64];
+    uint32_t a, b, c, d, e, f, g, hh, t1, t2;
+    int i;
+
+    for(i=0; i<16; i++)
+        w[i] = load32(blk + 4*i);
+    for(; i<64; i++)
+        w[i] = s1(w[i-2]) + w[i-7] + s0(w[i-15]) + w[i-16];
+
+    a = h[0]; b = h[1]; c = h[2]; d = h[3];
+    e = h[4]; f = h[5]; g = h[6]; hh = h[7];
+
+    for(i=0; i<64; i++) {
+        t1 = hh + S1(e) + CH(e, f, g) + K[i] + w[i];
+        t2 = S0(a) + MAJ(a, b, c);
+        hh = g; g = f; f = e; e = d + t1;
+        d = c; c = b; b = a; a = t1 + t2;
+    }
+
+    h[0] += a; h[1] += b; h[2] += c; h[3] += d;
+    h[4] += e; h[5] += f; h[6] += g; h[7] += hh;
+}
+
+#define L SHA256_LANES
+#define EACH(l) for(int l=0; l<L; l++)
+
+void sha256_block_lanes(uint32_t h[8][L], const uint8_t *const blk[L])
+{
+    uint32_t w[64][L];
+    uint32_t a[L], b[L], c[L], d[L], e[L], f[L], g[L], hh[L], t1[L], t2[L];
+    int i;
+
+    for(i=0; i<16; i++)
+        EACH(l) w[i][l] = load32(blk[l] + 4*i);
+    for(; i<64; i++)
+        EACH(l) w[i][l] = s1(w[i-2][l]) + w[i-7][l] + s0(w[i-15][l]) + w[i-16][l];
+
+    EACH(l) {
+        a[l] = h[0][l]; b[l] = h[1][l]; c[l] = h[2][l]; d[l] = h[3][l];
+        e[l] = h[4][l]; f[l] = h[5][l]; g[l] = h[6][l]; hh[l] = h[7][l];
+    }
+
+    for(i=0; i<64; i++) {
+        EACH(l) {
+            t1[l] = hh[l] + S1(e[l]) + CH(e[l], f[l], g[l]) + K[i] + w[i][l];
+            t2[l] = S0(a[l]) + MAJ(a[l], b[l], c[l]);
+            hh[l] = g[l]; g[l] = f[l]; f[l] = e[l]; e[l] = d[l] + t1[l];
+            d[l] = c[l]; c[l] = b[l]; b[l] = a[l]; a[l] = t1[l] + t2[l];
+        }
+    }
+
+    EACH(l) {
+        h[0][l] += a[l]; h[1][l] += b[l]; h[2][l] += c[l]; h[3][l] += d[l];
+        h[4][l] += e[l]; h[5][l] += f[l]; h[6][l] += g[l]; h[7][l] += hh[l];
+    }
+}
+
+#undef EACH
+#undef L
+
+void sha256_digest(uint8_t *out, const uint32_t h[8])
+{
+    for(int i=0; i<8; i++) {
+        out[4*i]   = h[i] >> 24;
+        out[4*i+1] = h[i] >> 16;
+        out[4*i+2] = h[i] >> 8;
+        out[4*i+3] = h[i];
+    }
+}
@@ -0,0 +1,28 @@
+// SHA-256 (FIPS 180-4) compression function, as used for the HMACs of
+// secure authentication (see auth.c)
+
+#ifndef DNP3_SHA256_H_SEEN
+#define DNP3_SHA256_H_SEEN
+
+#include <stdint.h>
+
+#define SHA256_BLOCK    64      // bytes per block
+#define SHA256_DIGEST   32      // bytes of output
+#define SHA256_LANES    4       // independent states of sha256_block_lanes
+
+// the initial hash value
+void sha256_init(uint32_t h[8]);
+
+// compress one block into the state h
+void sha256_block(uint32_t h[8], const uint8_t *blk);
+
+// compress one block into each of SHA256_LANES states at once. the states
+// are interleaved: h[i][l] is word i of lane l. unrelated messages can thus
+// be hashed side by side; the lane loops vectorize.
+void sha256_block_lanes(uint32_t h[8][SHA256_LANES],
+                        const uint8_t *const blk[SHA256_LANES]);
+
+// write the state h as a digest (big-endian words)
+void sha256_digest(uint8_t *out, const uint32_t h[8]);
+
+#endif // DNP3_SHA256_H_SEEN
@@ -0,0 +1,257 @@
+// transaction tracker: pairs requests with responses per association
+//
+// a master has at most one solicited request outstanding per outstation. its
+// response may span several fragments: the first one (FIR) carries the
+// request's sequence number, each following one the next number (mod 16),
+// and the last one is marked FIN. fragments with CON set are confirmed by
+// the master with a CONFIRM of the same sequence number. unsolicited
+// responses are tracked separately; they consist of a single fragment and
+// are confirmed with a CONFIRM that has the UNS bit set.
+
+#include <dnp3hammer.h>
+#include <string.h>
+#include "hammer.h"
+#include "assoctab.h"
+
+
+#define SEQMASK 0x0F    // sequence numbers are 4 bits
+
+// a transaction in progress
+struct Pending {
+    bool active;
+    DNP3_Transaction t;
+    uint8_t expect;         // sequence number of the next response fragment
+    bool await_confirm;     // the last fragment asked for a confirm
+    uint8_t confirm_seq;    // ...with this sequence number
+    uint64_t last;          // time of the last activity
+};
+
+struct Assoc {
+    struct AssocEntry e;
+    struct Pending sol;     // solicited
+    struct Pending uns;     // unsolicited
+};
+
+struct DNP3_Tracker_ {
+    HAllocator *mm;
+    AssocTable assocs;
+
+    DNP3_TrackerStats stats;
+
+    DNP3_TransactionDone done;
+    void *env;
+};
+
+
+DNP3_Tracker *dnp3_tracker__m(HAllocator *mm, DNP3_TransactionDone done,
+                              void *env)
+{
+    DNP3_Tracker *tr = mm->alloc(mm, sizeof(DNP3_Tracker));
+    if(!tr) return NULL;
+
+    memset(tr, 0, sizeof(DNP3_Tracker));
+    tr->mm = mm;
+    dnp3_assoctab_init(&tr->assocs, mm);
+    tr->done = done;
+    tr->env = env;
+
+    return tr;
+}
+
+DNP3_Tracker *dnp3_tracker(DNP3_TransactionDone done, void *env)
+{
+    return dnp3_tracker__m(h_system_allocator, done, env);
+}
+
+void dnp3_tracker_free(DNP3_Tracker *tr)
+{
+    HAllocator *mm = tr->mm;
+
+    dnp3_assoctab_free(&tr->assocs);
+    mm->free(mm, tr);
+}
+
+void dnp3_tracker_stats(const DNP3_Tracker *tr, DNP3_TrackerStats *stats)
+{
+    *stats = tr->stats;
+}
+
+// report a transaction and clear it
+static void finish(DNP3_Tracker *tr, struct Pending *p,
+                   DNP3_TransactionStatus status)
+{
+    p->t.status = status;
+    switch(status) {
+    case DNP3_TXN_COMPLETE:     tr->stats.completed++; break;
+    case DNP3_TXN_NORESPONSE:   tr->stats.completed++; break;
+    case DNP3_TXN_ABORTED:      tr->stats.aborted++; break;
+    case DNP3_TXN_TIMEOUT:      tr->stats.timeouts++; break;
+    }
+
+    p->active = false;
+    if(tr->done)
+        tr->done(tr->env, &p->t);
+}
+
+// a pending transaction that is overtaken or times out: if the final
+// response was seen, only its confirm is missing.
+static void cut_short(DNP3_Tracker *tr, struct Pending *p,
+                      DNP3_TransactionStatus status)
+{
+    finish(tr, p, p->t.fin ? DNP3_TXN_COMPLETE : status);
+}
+
+static void start(struct Pending *p, uint32_t assoc, uint64_t now,
+                  const DNP3_Fragment *frag)
+{
+    memset(p, 0, sizeof(struct Pending));
+    p->active = true;
+    p->t.assoc = assoc;
+    p->t.fc = frag->fc;
+    p->t.seq = frag->ac.seq;
+    p->t.time = now;
+    p->expect = frag->ac.seq;
+    p->last = now;
+}
+
+// a response fragment belonging to transaction p
+static void response(DNP3_Tracker *tr, struct Pending *p, uint64_t now,
+                     const DNP3_Fragment *frag, bool fin)
+{
+    if(p->t.nfragments == 0)
+        p->t.first = now - p->t.time;
+    p->t.nfragments++;
+    p->expect = (frag->ac.seq + 1) & SEQMASK;
+    p->await_confirm = frag->ac.con;
+    p->confirm_seq = frag->ac.seq;
+    p->last = now;
+
+    if(fin) {
+        p->t.fin = true;
+        p->t.final = now - p->t.time;
+        if(!frag->ac.con)
+            finish(tr, p, DNP3_TXN_COMPLETE);
+    }
+}
+
+static bool no_response(DNP3_FunctionCode fc)
+{
+    switch(fc) {
+    case DNP3_DIRECT_OPERATE_NR:
+    case DNP3_IMMED_FREEZE_NR:
+    case DNP3_FREEZE_CLEAR_NR:
+    case DNP3_FREEZE_AT_TIME_NR:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// secure authentication messages are interleaved with the transaction they
+// authenticate (challenge and reply); they are not tracked.
+static bool is_auth(DNP3_FunctionCode fc)
+{
+    return (fc == DNP3_AUTHENTICATE_REQ || fc == DNP3_AUTH_REQ_NO_ACK ||
+            fc == DNP3_AUTHENTICATE_RESP);
+}
+
+// from master to outstation
+static bool from_master(DNP3_Tracker *tr, struct Assoc *a, uint64_t now,
+                        const DNP3_Fragment *frag)
+{
+    struct Pending *p;
+
+    if(frag->fc == DNP3_CONFIRM) {
+        p = frag->ac.uns ? &a->uns : &a->sol;
+        if(!p->active || !p->await_confirm || p->confirm_seq != frag->ac.seq)
+            return false;
+
+        p->t.nconfirms++;
+        p->await_confirm = false;
+        p->last = now;
+        if(p->t.fin) {
+            p->t.confirmed = true;
+            p->t.confirm = now - p->t.time;
+            finish(tr, p, DNP3_TXN_COMPLETE);
+        }
+        return true;
+    }
+
+    if(frag->fc >= DNP3_RESPONSE)
+        return false;
+
+    // a new request ends any previous one
+    p = &a->sol;
+    if(p->active)
+        cut_short(tr, p, DNP3_TXN_ABORTED);
+    start(p, a->e.key, now, frag);
+    if(no_response(frag->fc))
+        finish(tr, p, DNP3_TXN_NORESPONSE);
+    return true;
+}
+
+// from outstation to master
+static bool from_outstation(DNP3_Tracker *tr, struct Assoc *a, uint64_t now,
+                            const DNP3_Fragment *frag)
+{
+    struct Pending *p;
+
+    switch(frag->fc) {
+    case DNP3_RESPONSE:
+        p = &a->sol;
+        if(!p->active || p->t.fin || frag->ac.seq != p->expect ||
+           frag->ac.fir != (p->t.nfragments == 0))
+            return false;
+        response(tr, p, now, frag, frag->ac.fin);
+        return true;
+
+    case DNP3_UNSOLICITED_RESPONSE:     // always a single fragment
+        p = &a->uns;
+        if(p->active)
+            cut_short(tr, p, DNP3_TXN_ABORTED);
+        start(p, a->e.key, now, frag);
+        response(tr, p, now, frag, true);
+        return true;
+
+    default:
+        return false;
+    }
+}
+
+int dnp3_tracker_update(DNP3_Tracker *tr, uint32_t assoc, bool dir,
+                        uint64_t now, const DNP3_Fragment *frag)
+{
+    if(is_auth(frag->fc))
+        return 0;
+
+    struct Assoc *a = dnp3_assoctab_lookup(&tr->assocs, assoc,
+                                           sizeof(struct Assoc));
+    if(!a)
+        return -1;
+
+    bool matched = dir ? from_master(tr, a, now, frag)
+                       : from_outstation(tr, a, now, frag);
+    if(!matched)
+        tr->stats.unmatched++;
+    return 0;
+}
+
+size_t dnp3_tracker_expire(DNP3_Tracker *tr, uint64_t now, uint64_t timeout)
+{
+    size_t n = 0;
+
+    for(struct AssocEntry *e = tr->assocs.first; e; e = e->next) {
+        struct Assoc *a = (struct Assoc *)e;
+        struct Pending *ps[] = {&a->sol, &a->uns};
+
+        for(int i=0; i<2; i++) {
+            struct Pending *p = ps[i];
+            if(p->active && now >= p->last && now - p->last >= timeout) {
+                cut_short(tr, p, DNP3_TXN_TIMEOUT);
+                n++;
+            }
+        }
+    }
+
+    return n;
+}
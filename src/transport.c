@@ -3,6 +3,9 @@
 
 #include <hammer/hammer.h>
 #include <hammer/glue.h>
+#include "hammer.h"
+#include "util.h"
+#include "assoctab.h"
 
 
 HParser *dnp3_p_transport_segment;
@@ -11,9 +14,11 @@ static HParsedToken *act_segment(const HParseResult *p, void *user)
 {
     DNP3_Segment *s = H_ALLOC(DNP3_Segment);
 
-    s->fin = H_FIELD_UINT(0, 0);
-    s->fir = H_FIELD_UINT(0, 1);
-    s->seq = H_FIELD_UINT(0, 2);
+    // p->ast = (hdr, (byte...))
+    uint8_t hdr = H_FIELD_UINT(0);
+    s->fin = (hdr >> 7) & 1;
+    s->fir = (hdr >> 6) & 1;
+    s->seq = hdr & 0x3F;
 
     HCountedArray *a = H_FIELD_SEQ(1);
     s->len = a->used;
@@ -28,16 +33,131 @@ static HParsedToken *act_segment(const HParseResult *p, void *user)
 
 void dnp3_p_init_transport(void)
 {
-    H_RULE(bit,     h_bits(1, false));
     H_RULE(byte,    h_uint8());
 
-    H_RULE(fir,     bit);
-    H_RULE(fin,     bit);
-    H_RULE(seqno,   h_bits(6, false));
-    H_RULE(hdr,     h_sequence(fin, fir, seqno, NULL));     // big-endian
-    
+    // the header is taken as a whole byte and split up in act_segment.
+    // this keeps the grammar context-free so it can be compiled (see
+    // dnp3_p_init).
+    //
+    //     fin(1) fir(1) seqno(6)       -- big-endian
+    H_RULE(hdr,     byte);
+
     H_ARULE(segment, h_sequence(hdr, h_many(byte), NULL));
         // XXX is there a minimum number of bytes in the transport payload?
 
     dnp3_p_transport_segment = segment;
 }
+
+
+// segmentation...
+
+#define SEGMAX (DNP3_MAX_PAYLOAD - 1)   // application bytes per segment
+
+// sequence number state of one source/destination pair, keyed by
+// dnp3_association(destination, source)
+struct Stream {
+    struct AssocEntry e;
+    uint8_t seq;            // next sequence number
+};
+
+struct DNP3_TransportEncoder_ {
+    HAllocator *mm;
+    AssocTable streams;
+};
+
+DNP3_TransportEncoder *dnp3_transport_encoder__m(HAllocator *mm)
+{
+    DNP3_TransportEncoder *enc = mm->alloc(mm, sizeof(DNP3_TransportEncoder));
+    if(!enc) return NULL;
+
+    enc->mm = mm;
+    dnp3_assoctab_init(&enc->streams, mm);
+
+    return enc;
+}
+
+DNP3_TransportEncoder *dnp3_transport_encoder(void)
+{
+    return dnp3_transport_encoder__m(h_system_allocator);
+}
+
+void dnp3_transport_encoder_free(DNP3_TransportEncoder *enc)
+{
+    HAllocator *mm = enc->mm;
+
+    dnp3_assoctab_free(&enc->streams);
+    mm->free(mm, enc);
+}
+
+// find or create the given stream
+static struct Stream *lookup_stream(DNP3_TransportEncoder *enc,
+                                    uint16_t source, uint16_t destination)
+{
+    return dnp3_assoctab_lookup(&enc->streams,
+                                dnp3_association(destination, source),
+                                sizeof(struct Stream));
+}
+
+size_t dnp3_transport_nframes(size_t len)
+{
+    return len > 0 ? (len + SEGMAX - 1) / SEGMAX : 1;
+}
+
+size_t dnp3_transport_size(size_t len)
+{
+    size_t n = dnp3_transport_nframes(len);
+    size_t last = len - (n - 1) * SEGMAX;
+
+    return (n - 1) * dnp3_link_size(SEGMAX + 1) + dnp3_link_size(last + 1);
+}
+
+size_t dnp3_transport_encode(DNP3_TransportEncoder *enc,
+                             uint8_t *buf, size_t bufsize,
+                             const DNP3_Frame *hdr,
+                             const uint8_t *fragment, size_t len,
+                             HBytes *frames)
+{
+    if(bufsize < dnp3_transport_size(len))
+        return 0;
+
+    struct Stream *s = lookup_stream(enc, hdr->source, hdr->destination);
+    if(!s)
+        return 0;
+
+    size_t n = dnp3_transport_nframes(len);
+    size_t m = 0;
+    for(size_t i=0; i<n; i++) {
+        size_t off = i * SEGMAX;
+        size_t k = (i < n-1) ? SEGMAX : len - off;
+
+        //     fin(1) fir(1) seqno(6)
+        uint8_t th = ((i == n-1) << 7) | ((i == 0) << 6) | s->seq;
+        HBytes payload[2] = {{&th, 1}, {k ? fragment + off : NULL, k}};
+        s->seq = (s->seq + 1) % 64;
+
+        size_t f = dnp3_link_encode_framev(buf + m, bufsize - m, hdr,
+                                           payload, k ? 2 : 1);
+        assert(f == dnp3_link_size(k + 1));
+        if(frames) {
+            frames[i].token = buf + m;
+            frames[i].len = f;
+        }
+        m += f;
+    }
+
+    return m;
+}
+
+int dnp3_transport_set_seq(DNP3_TransportEncoder *enc,
+                           uint16_t source, uint16_t destination, uint8_t seq)
+{
+    if(seq > 63)
+        return -1;
+
+    struct Stream *s = lookup_stream(enc, source, destination);
+    if(!s)
+        return -1;
+
+    s->seq = seq;
+    return 0;
+}
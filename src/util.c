@@ -2,10 +2,168 @@
 
 #include <hammer/glue.h>
 #include "hammer.h" // XXX placeholder for extensions
+#include <string.h>     // memset
 #include <assert.h>
 #include "util.h"
 
 
+// counting allocator: each block is prefixed with its size so frees and
+// reallocations can be accounted for. updated atomically.
+union Header {
+    size_t size;
+    long double align_;         // keep the block suitably aligned
+    void *palign_;
+};
+
+static size_t mem_allocs;
+static size_t mem_bytes;
+
+static void *count_alloc(HAllocator *mm__, size_t size)
+{
+    union Header *h;
+
+    if(size > SIZE_MAX - sizeof(union Header))
+        return NULL;
+    h = h_system_allocator->alloc(h_system_allocator, sizeof *h + size);
+    if(!h)
+        return NULL;
+    h->size = size;
+    __atomic_add_fetch(&mem_allocs, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&mem_bytes, size, __ATOMIC_RELAXED);
+    return h + 1;
+}
+
+static void *count_realloc(HAllocator *mm__, void *ptr, size_t size)
+{
+    union Header *h;
+    size_t old;
+
+    if(!ptr)
+        return count_alloc(mm__, size);
+    if(size > SIZE_MAX - sizeof(union Header))
+        return NULL;
+
+    h = (union Header *)ptr - 1;
+    old = h->size;
+    h = h_system_allocator->realloc(h_system_allocator, h, sizeof *h + size);
+    if(!h)
+        return NULL;
+    h->size = size;
+    __atomic_add_fetch(&mem_bytes, size, __ATOMIC_RELAXED);
+    __atomic_sub_fetch(&mem_bytes, old, __ATOMIC_RELAXED);
+    return h + 1;
+}
+
+static void count_free(HAllocator *mm__, void *ptr)
+{
+    union Header *h;
+
+    if(!ptr)
+        return;
+    h = (union Header *)ptr - 1;
+    __atomic_sub_fetch(&mem_allocs, 1, __ATOMIC_RELAXED);
+    __atomic_sub_fetch(&mem_bytes, h->size, __ATOMIC_RELAXED);
+    h_system_allocator->free(h_system_allocator, h);
+}
+
+static HAllocator counting = {count_alloc, count_realloc, count_free};
+HAllocator *const dnp3_p_mm = &counting;
+
+void dnp3_p_mem_stats(size_t *allocs, size_t *bytes)
+{
+    *allocs = __atomic_load_n(&mem_allocs, __ATOMIC_RELAXED);
+    *bytes = __atomic_load_n(&mem_bytes, __ATOMIC_RELAXED);
+}
+
+void *dnp3_p_alloc(size_t size)
+{
+    return dnp3_p_mm->alloc(dnp3_p_mm, size);
+}
+
+void *dnp3_p_alloc0(size_t size)
+{
+    void *p = dnp3_p_alloc(size);
+
+    if(p)
+        memset(p, 0, size);
+    return p;
+}
+
+
+// interned parsers...
+//
+// many small parsers (single bytes, bit fields, exact integers) are needed
+// over and over during grammar construction. we build each of them only once
+// and hand out the same instance on subsequent calls. instances are keyed by
+// the constructing function and its arguments.
+
+#define NINTERNBUCKETS 256
+
+struct Interned {
+    struct Interned *next;
+    const char *kind;       // __func__ of the constructing function
+    const HParser *arg;
+    uint64_t x;
+    HParser *p;
+};
+
+static struct Interned *interned[NINTERNBUCKETS];
+static size_t interned_count;   // number of distinct instances
+static size_t interned_hits;    // number of times an instance was reused
+
+static size_t intern_bucket(const char *kind, const HParser *arg, uint64_t x)
+{
+    uint64_t h = (uintptr_t)kind ^ ((uintptr_t)arg * 31) ^ (x * 0x9E3779B97F4A7C15);
+    return (h ^ (h >> 29) ^ (h >> 47)) % NINTERNBUCKETS;
+}
+
+HParser *dnp3_p_lookup_interned(const char *kind, const HParser *arg, uint64_t x)
+{
+    struct Interned *e = interned[intern_bucket(kind, arg, x)];
+
+    for(; e; e = e->next) {
+        if(e->kind == kind && e->arg == arg && e->x == x) {
+            interned_hits++;
+            return e->p;
+        }
+    }
+    return NULL;
+}
+
+HParser *dnp3_p_add_interned(const char *kind, const HParser *arg, uint64_t x,
+                             HParser *p)
+{
+    struct Interned *e = dnp3_p_alloc(sizeof(struct Interned));
+    size_t i = intern_bucket(kind, arg, x);
+
+    assert(e != NULL);
+    e->kind = kind;
+    e->arg = arg;
+    e->x = x;
+    e->p = p;
+    e->next = interned[i];
+    interned[i] = e;
+    interned_count++;
+
+    return p;
+}
+
+void dnp3_p_interned_stats(size_t *count, size_t *hits)
+{
+    *count = interned_count;
+    *hits = interned_hits;
+}
+
+HParser *dnp3_p_ch(uint8_t c)
+{
+    INTERNED(NULL, c, h_ch(c));
+}
+
+HParser *dnp3_p_bits(size_t n, bool sign)
+{
+    INTERNED(NULL, n << 1 | sign, h_bits(n, sign));
+}
+
 static bool is_zero(HParseResult *p, void *user)
 {
     assert(p->ast != NULL);
@@ -14,29 +172,54 @@ static bool is_zero(HParseResult *p, void *user)
 
 HParser *dnp3_p_reserved(size_t n)
 {
-    return h_ignore(h_attr_bool(h_bits(n, false), is_zero, NULL));
+    INTERNED(NULL, n,
+             h_ignore(h_attr_bool(dnp3_p_bits(n, false), is_zero, NULL)));
 }
 
 HParser *dnp3_p_int_exact(HParser *p, uint64_t x)
 {
-    return h_int_range(p, x, x);
+    INTERNED(p, x, h_int_range(p, x, x));
 }
 
-HParser *dnp3_p_objchoice(HParser *p, ...)
+// flag octets decoded via a precomputed table
+static bool validate_flags(HParseResult *p, void *user)
 {
-    va_list ap;
-    va_start(ap, p);
+    uint8_t reserved = (uintptr_t)user;
+    return !(H_CAST_UINT(p->ast) & reserved);
+}
+
+static HParsedToken *act_flags(const HParseResult *p, void *user)
+{
+    const DNP3_Flags *table = user;
+    DNP3_Object *o = H_ALLOC(DNP3_Object);
 
-    // XXX don't generate these anew each call!
-    H_RULE(octet,       h_uint8());
-    H_RULE(ohdr_,       h_repeat_n(octet, 3));  // (grp,var,qc)
-    H_RULE(unk,         h_right(ohdr_, dnp3_p_err_obj_unknown));
+    o->flags = table[H_CAST_UINT(p->ast)];
 
-    H_RULE(ps,          h_choice__v(p, ap));
-    H_RULE(ochoice,     h_choice(ps, unk, NULL));
+    return H_MAKE(DNP3_Object, o);
+}
+
+HParser *dnp3_p_flags(DNP3_Flags (*decode)(uint8_t), uint8_t reserved)
+{
+    DNP3_Flags *table = dnp3_p_alloc(256 * sizeof(DNP3_Flags));
+    assert(table != NULL);
+    for(int i=0; i<256; i++)
+        table[i] = decode(i);
+
+    H_RULE(octet,   dnp3_p_bits(8, false));
+    H_RULE(valid,   h_attr_bool(octet, validate_flags, (void *)(uintptr_t)reserved));
+
+    return h_action(valid, act_flags, table);
+}
+
+HParserBackend dnp3_p_compile(HParser *p)
+{
+    if(h_compile(p, PB_LLk, NULL) == 0)
+        return PB_LLk;
+    if(h_compile(p, PB_LALR, NULL) == 0)
+        return PB_LALR;
 
-    va_end(ap);
-    return ochoice;
+    // not context-free (h_bind, h_attr_bool, etc.) or not deterministic
+    return PB_PACKRAT;
 }
 
 static bool not_err(HParseResult *p, void *user)
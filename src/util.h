@@ -3,6 +3,9 @@
 #ifndef DNP3_UTIL_H_SEEN
 #define DNP3_UTIL_H_SEEN
 
+#include <hammer/hammer.h>
+#include "hammer.h"
+
 // pad with zero bits until the next byte boundary
 extern HParser *dnp3_p_pad;
 
@@ -13,14 +16,99 @@ extern HParser *dnp3_p_err_param_error;
 extern HParser *dnp3_p_err_func_not_supp;
 extern HParser *dnp3_p_err_obj_unknown;
 
+// the following return shared instances; calling them again with the same
+// arguments does not construct a new parser.
+
+// like h_ch(c)
+HParser *dnp3_p_ch(uint8_t c);
+
+// like h_bits(n, sign)
+HParser *dnp3_p_bits(size_t n, bool sign);
+
 // parse n reserved bits; must be zero, ignored in sequences
 HParser *dnp3_p_reserved(size_t n);
 
 // parse an (unsigned) integer x via parser p
 HParser *dnp3_p_int_exact(HParser *p, uint64_t x);
 
-// like h_choice but defaults to a ERR_OBJ_UNKNOWN case
-HParser *dnp3_p_objchoice(HParser *p, ...);
+// number of distinct interned parsers and of calls that reused one
+void dnp3_p_interned_stats(size_t *count, size_t *hits);
+
+// in a parser-constructing function, return the instance previously built
+// for the arguments (ARG,X) or construct it by evaluating EXPR.
+#define INTERNED(ARG, X, EXPR) do {                                         \
+        HParser *p_ = dnp3_p_lookup_interned(__func__, (ARG), (X));         \
+        return p_ ? p_ : dnp3_p_add_interned(__func__, (ARG), (X), (EXPR)); \
+    } while(0)
+
+HParser *dnp3_p_lookup_interned(const char *kind, const HParser *arg, uint64_t x);
+HParser *dnp3_p_add_interned(const char *kind, const HParser *arg, uint64_t x,
+                             HParser *p);
+
+// the allocator for parsers and everything that lives as long as them. it
+// draws from the system allocator and keeps count of the blocks and bytes
+// currently held, see dnp3_p_mem_stats.
+extern HAllocator *const dnp3_p_mm;
+
+// allocate memory that lives as long as the parsers, from dnp3_p_mm.
+// returns NULL if out of memory.
+void *dnp3_p_alloc(size_t size);
+void *dnp3_p_alloc0(size_t size);   // zero-filled
+
+// number and total size of the blocks currently held through dnp3_p_mm
+void dnp3_p_mem_stats(size_t *allocs, size_t *bytes);
+
+// parser constructors used while building the grammar, passed dnp3_p_mm.
+// continuations that build parsers while parsing use the __m variants with
+// the allocator they are given.
+#define h_action(...)           h_action__m(dnp3_p_mm, __VA_ARGS__)
+#define h_aligned(...)          h_aligned__m(dnp3_p_mm, __VA_ARGS__)
+#define h_and(...)              h_and__m(dnp3_p_mm, __VA_ARGS__)
+#define h_attr_bool(...)        h_attr_bool__m(dnp3_p_mm, __VA_ARGS__)
+#define h_bind(...)             h_bind__m(dnp3_p_mm, __VA_ARGS__)
+#define h_bits(...)             h_bits__m(dnp3_p_mm, __VA_ARGS__)
+#define h_ch(...)               h_ch__m(dnp3_p_mm, __VA_ARGS__)
+#define h_choice(...)           h_choice__m(dnp3_p_mm, __VA_ARGS__)
+#define h_choice__a(...)        h_choice__ma(dnp3_p_mm, __VA_ARGS__)
+#define h_compile(...)          h_compile__m(dnp3_p_mm, __VA_ARGS__)
+#define h_end_p()               h_end_p__m(dnp3_p_mm)
+#define h_epsilon_p()           h_epsilon_p__m(dnp3_p_mm)
+#define h_error(...)            h_error__m(dnp3_p_mm, __VA_ARGS__)
+#define h_float32()             h_float32__m(dnp3_p_mm)
+#define h_float64()             h_float64__m(dnp3_p_mm)
+#define h_ignore(...)           h_ignore__m(dnp3_p_mm, __VA_ARGS__)
+#define h_indirect()            h_indirect__m(dnp3_p_mm)
+#define h_int_range(...)        h_int_range__m(dnp3_p_mm, __VA_ARGS__)
+#define h_int16()               h_int16__m(dnp3_p_mm)
+#define h_int32()               h_int32__m(dnp3_p_mm)
+#define h_left(...)             h_left__m(dnp3_p_mm, __VA_ARGS__)
+#define h_length_value(...)     h_length_value__m(dnp3_p_mm, __VA_ARGS__)
+#define h_many(...)             h_many__m(dnp3_p_mm, __VA_ARGS__)
+#define h_many1(...)            h_many1__m(dnp3_p_mm, __VA_ARGS__)
+#define h_middle(...)           h_middle__m(dnp3_p_mm, __VA_ARGS__)
+#define h_not(...)              h_not__m(dnp3_p_mm, __VA_ARGS__)
+#define h_not_in(...)           h_not_in__m(dnp3_p_mm, __VA_ARGS__)
+#define h_optional(...)         h_optional__m(dnp3_p_mm, __VA_ARGS__)
+#define h_repeat_n(...)         h_repeat_n__m(dnp3_p_mm, __VA_ARGS__)
+#define h_right(...)            h_right__m(dnp3_p_mm, __VA_ARGS__)
+#define h_sequence(...)         h_sequence__m(dnp3_p_mm, __VA_ARGS__)
+#define h_token(...)            h_token__m(dnp3_p_mm, __VA_ARGS__)
+#define h_uint8()               h_uint8__m(dnp3_p_mm)
+#define h_uint16()              h_uint16__m(dnp3_p_mm)
+#define h_uint32()              h_uint32__m(dnp3_p_mm)
+#define h_uint64()              h_uint64__m(dnp3_p_mm)
+#define h_unit(...)             h_unit__m(dnp3_p_mm, __VA_ARGS__)
+#define h_with_endianness(...)  h_with_endianness__m(dnp3_p_mm, __VA_ARGS__)
+
+// parse a flag octet, yielding a DNP3_Object with the flags field set.
+// the octet is decoded by a 256-entry table precomputed with the given
+// function. bits set in 'reserved' must be zero.
+HParser *dnp3_p_flags(DNP3_Flags (*decode)(uint8_t), uint8_t reserved);
+
+// compile p with the fastest deterministic backend that accepts it (LL(k),
+// then LALR). grammars that are not context-free or not deterministic are
+// left on the default packrat backend. returns the backend used.
+HParserBackend dnp3_p_compile(HParser *p);
 
 // like h_many/h_many1 but stops on and propagates TT_ERR and friends
 HParser *dnp3_p_many(HParser *p);
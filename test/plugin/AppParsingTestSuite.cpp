@@ -24,3 +24,117 @@ TEST_CASE(SUITE("rejects undersized ASDU"))
     REQUIRE_FALSE(SUCCESS);
 }
 
+
+TEST_CASE(SUITE("reuses cached fragment for repeated payloads"))
+{
+    PluginFixture fix;
+    fix.EnableCache(4, 65536);
+
+    REQUIRE(fix.Parse(TPDUS("C0 81 00 00", false)));
+    REQUIRE(fix.Parse(TPDUS("C1 81 00 00", false)));   // differs in seq only
+    REQUIRE(fix.Parse(TPDUS("C2 81 00 01", false)));   // differs in IIN
+
+    REQUIRE(fix.CheckEvents({
+        Event::LINK_FRAME, Event::TRANS_SEGMENT, Event::TRANS_PAYLOAD, Event::APP_FRAG,
+        Event::LINK_FRAME, Event::TRANS_SEGMENT, Event::TRANS_PAYLOAD, Event::APP_UNCHANGED,
+        Event::LINK_FRAME, Event::TRANS_SEGMENT, Event::TRANS_PAYLOAD, Event::APP_FRAG}));
+
+    auto stats = fix.Stats();
+    REQUIRE(stats.cache_hits == 1);
+    REQUIRE(stats.cache_misses == 2);
+    REQUIRE(stats.cache_evictions == 0);
+    REQUIRE(stats.cache_bytes > 0);
+}
+
+TEST_CASE(SUITE("retained fragments outlive the callbacks"))
+{
+    PluginFixture fix;
+    fix.EnableCache(4, 65536);
+    fix.retain = true;
+
+    REQUIRE(fix.Parse(TPDUS("C0 81 00 00", false)));
+    REQUIRE(fix.Parse(TPDUS("C1 81 00 00", false)));   // cache hit
+    REQUIRE(fix.Parse(TPDUS("C2 01 01 00 06", true)));
+
+    REQUIRE(fix.fragments.size() == 3);
+    REQUIRE(fix.fragments[0]->fc == DNP3_RESPONSE);
+    REQUIRE(fix.fragments[0]->ac.seq == 0);
+    REQUIRE(fix.fragments[1]->fc == DNP3_RESPONSE);
+    REQUIRE(fix.fragments[1]->ac.seq == 1);
+    REQUIRE(fix.fragments[2]->fc == DNP3_READ);
+    REQUIRE(fix.fragments[2]->nblocks == 1);
+    REQUIRE(fix.fragments[2]->odata[0]->group == DNP3_GROUP_BININ);
+}
+
+TEST_CASE(SUITE("decodes only blocks of interest"))
+{
+    PluginFixture fix;
+    DNP3_Interest mask = {};
+    dnp3_interest_add_group(&mask, DNP3_GROUP_ANAIN);
+    fix.SetInterest(&mask);
+    fix.retain = true;
+
+    // binary inputs 3-8, analog input 1
+    REQUIRE(fix.Parse(TPDUS("C0 81 00 00 01 01 00 03 08 19 1E 01 00 01 01 01 12 34 56 78", false)));
+
+    REQUIRE(fix.fragments.size() == 1);
+    REQUIRE(fix.fragments[0]->nblocks == 2);
+    REQUIRE(fix.fragments[0]->odata[0]->group == DNP3_GROUP_BININ);
+    REQUIRE(fix.fragments[0]->odata[0]->count == 6);
+    REQUIRE_FALSE(dnp3_oblock_has_objects(fix.fragments[0]->odata[0]));
+    REQUIRE(fix.fragments[0]->odata[1]->group == DNP3_GROUP_ANAIN);
+    REQUIRE(dnp3_oblock_has_objects(fix.fragments[0]->odata[1]));
+    REQUIRE(fix.fragments[0]->odata[1]->objects[0].ana.sint == 0x78563412);
+}
+
+TEST_CASE(SUITE("keeps objects raw until accessed"))
+{
+    PluginFixture fix;
+    fix.SetPack(DNP3_PACK_RAW);
+    fix.retain = true;
+
+    // analog input 1
+    REQUIRE(fix.Parse(TPDUS("C0 81 00 00 1E 01 00 01 01 01 12 34 56 78", false)));
+
+    REQUIRE(fix.fragments.size() == 1);
+    REQUIRE(fix.fragments[0]->nblocks == 1);
+
+    const DNP3_ObjectBlock* ob = fix.fragments[0]->odata[0];
+    DNP3_Object o;
+    REQUIRE(ob->objects == nullptr);
+    REQUIRE(ob->raw != nullptr);
+    REQUIRE(dnp3_oblock_get(ob, 0, &o));
+    REQUIRE(o.ana.sint == 0x78563412);
+}
+
+TEST_CASE(SUITE("delivers batches once per feed"))
+{
+    PluginFixture fix(true);
+    fix.EnableCache(4, 65536);
+    fix.retain = true;
+
+    // two responses and a request in one chunk
+    REQUIRE(fix.Parse(TPDUS("C0 81 00 00", false) + TPDUS("C1 81 00 00", false) +
+                      TPDUS("C2 01 01 00 06", true)));
+    REQUIRE(fix.Parse(TPDUS("C3 C0", true)));
+
+    REQUIRE(fix.batches.size() == 2);
+    REQUIRE(fix.batches[0].frames == 3);
+    REQUIRE(fix.batches[0].segments == 3);
+    REQUIRE(fix.batches[0].payloads == 3);
+    REQUIRE(fix.batches[0].fragments == 3);
+    REQUIRE(fix.batches[1].payloads == 1);
+    REQUIRE(fix.batches[1].fragments == 1);
+
+    // in order, and only from the batches
+    REQUIRE(fix.CheckEvents({
+        Event::TRANS_PAYLOAD, Event::APP_FRAG,
+        Event::TRANS_PAYLOAD, Event::APP_UNCHANGED,
+        Event::TRANS_PAYLOAD, Event::APP_FRAG,
+        Event::TRANS_PAYLOAD, Event::APP_INVALID}));
+
+    REQUIRE(fix.fragments.size() == 3);
+    REQUIRE(fix.fragments[0]->ac.seq == 0);
+    REQUIRE(fix.fragments[1]->ac.seq == 1);
+    REQUIRE(fix.fragments[2]->fc == DNP3_READ);
+}
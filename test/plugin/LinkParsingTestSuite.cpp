@@ -21,3 +21,30 @@ TEST_CASE(SUITE("Parses until encountering start octets"))
     fix.CheckEvents({Event::LINK_FRAME});
 }
 
+TEST_CASE(SUITE("Holds back partial frames"))
+{
+    PluginFixture fix;
+
+    REQUIRE(fix.Parse("05 64 05 C0 01"));
+    REQUIRE(fix.Consumed() == 0);
+    REQUIRE(fix.events.empty());
+
+    REQUIRE(fix.Parse("00 00 04 E9 21 05 64"));
+    REQUIRE(fix.Consumed() == 10);
+    REQUIRE(fix.CheckEvents({Event::LINK_FRAME}));
+}
+
+TEST_CASE(SUITE("Discards input that cannot start a frame"))
+{
+    PluginFixture fix;
+    std::string junk;
+
+    for(int i = 0; i < 400; ++i)
+        junk += "00 ";
+
+    REQUIRE(fix.Parse(junk));
+    REQUIRE(fix.Consumed() == 400 - (DNP3_MAX_FRAME - 1));
+
+    REQUIRE(fix.Parse("05 64 05 C0 01 00 00 04 E9 21"));
+    REQUIRE(fix.CheckEvents({Event::LINK_FRAME}));
+}
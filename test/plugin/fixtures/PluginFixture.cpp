@@ -24,6 +24,11 @@ void cb_transport_payload(void *env, const uint8_t *s, size_t n)
     static_cast<PluginFixture*>(env)->events.push_back(Event::TRANS_PAYLOAD);
 }
 
+void cb_transport_discard(void *env, size_t n)
+{
+    static_cast<PluginFixture*>(env)->events.push_back(Event::TRANS_DISCARD);
+}
+
 void cb_app_invalid(void *env, DNP3_ParseError e)
 {
     static_cast<PluginFixture*>(env)->events.push_back(Event::APP_INVALID);
@@ -31,18 +36,63 @@ void cb_app_invalid(void *env, DNP3_ParseError e)
 
 void cb_app_fragment(void *env, const DNP3_Fragment *fragment, const uint8_t *buf, size_t len)
 {
-    static_cast<PluginFixture*>(env)->events.push_back(Event::APP_FRAG);
+    auto fix = static_cast<PluginFixture*>(env);
+    fix->events.push_back(Event::APP_FRAG);
+    if(fix->retain)
+        fix->fragments.push_back(dnp3_fragment_retain(fragment));
 }
 
-PluginFixture::PluginFixture()
+void cb_app_unchanged(void *env, const DNP3_Fragment *fragment, const uint8_t *buf, size_t len)
 {
-    DNP3_Callbacks callbacks;
+    auto fix = static_cast<PluginFixture*>(env);
+    fix->events.push_back(Event::APP_UNCHANGED);
+    if(fix->retain)
+        fix->fragments.push_back(dnp3_fragment_retain(fragment));
+}
+
+void cb_batch(void *env, const DNP3_Batch *batch)
+{
+    auto fix = static_cast<PluginFixture*>(env);
+    fix->batches.push_back({batch->nframes, batch->nsegments, batch->npayloads, batch->nfragments});
+
+    // payloads, each followed by the fragment parsed from it
+    size_t j = 0;
+    for(size_t i = 0; i < batch->npayloads; ++i)
+    {
+        if(!batch->payloads[i].buf)
+        {
+            fix->events.push_back(Event::TRANS_DISCARD);
+            continue;
+        }
+        fix->events.push_back(Event::TRANS_PAYLOAD);
+        for(; j < batch->nfragments && batch->fragments[j].payload == i; ++j)
+        {
+            auto fragment = batch->fragments[j].fragment;
+            if(!fragment)
+            {
+                fix->events.push_back(Event::APP_INVALID);
+                continue;
+            }
+            fix->events.push_back(batch->fragments[j].unchanged ? Event::APP_UNCHANGED : Event::APP_FRAG);
+            if(fix->retain)
+                fix->fragments.push_back(dnp3_fragment_retain(fragment));
+        }
+    }
+}
+
+PluginFixture::PluginFixture(bool batch) : retain(false)
+{
+    DNP3_Callbacks callbacks = {};
 
     callbacks.link_frame = cb_link_frame;
     callbacks.transport_segment = cb_transport_segment;
+    callbacks.transport_discard = cb_transport_discard;
     callbacks.transport_payload = cb_transport_payload;
     callbacks.app_invalid = cb_app_invalid;
     callbacks.app_fragment = cb_app_fragment;
+    callbacks.app_unchanged = cb_app_unchanged;
+    if(batch)
+        callbacks.batch = cb_batch;
 
     m_plugin = dnp3_dissector(callbacks, this);
     assert(m_plugin);
@@ -58,6 +108,33 @@ bool PluginFixture::Parse(const std::string& hex)
     return m_plugin->feed(m_plugin, data.Size()) == 0;
 }
 
+void PluginFixture::EnableCache(size_t entries, size_t maxbytes)
+{
+    assert(dnp3_dissector_set_cache(m_plugin, entries, maxbytes) == 0);
+}
+
+void PluginFixture::SetInterest(const DNP3_Interest* mask)
+{
+    assert(dnp3_dissector_set_interest(m_plugin, mask) == 0);
+}
+
+void PluginFixture::SetPack(unsigned flags)
+{
+    assert(dnp3_dissector_set_pack(m_plugin, flags) == 0);
+}
+
+size_t PluginFixture::Consumed() const
+{
+    return m_plugin->consumed;
+}
+
+DNP3_DissectorStats PluginFixture::Stats() const
+{
+    DNP3_DissectorStats stats;
+    dnp3_dissector_stats(m_plugin, &stats);
+    return stats;
+}
+
 bool PluginFixture::CheckEvents(std::initializer_list<Event> expected) const
 {
     if(expected.size() != events.size())
@@ -83,5 +160,10 @@ bool PluginFixture::CheckEvents(std::initializer_list<Event> expected) const
 PluginFixture::~PluginFixture()
 {
     assert(m_plugin->finish(m_plugin) == 0);
+
+    for(auto fragment: fragments)
+    {
+        dnp3_fragment_release(fragment);
+    }
 }
 
@@ -10,35 +10,62 @@
 // plugin callbacks - use these to drive events with the fixture
 int  cb_link_frame(void *env, const DNP3_Frame *frame, const uint8_t *buf, size_t len);
 void cb_transport_segment(void *env, const DNP3_Segment *segment);
+void cb_transport_discard(void *env, size_t n);
 void cb_transport_payload(void *env, const uint8_t *s, size_t n);
 void cb_app_invalid(void *env, DNP3_ParseError e);
 void cb_app_fragment(void *env, const DNP3_Fragment *fragment, const uint8_t *buf, size_t len);
+void cb_app_unchanged(void *env, const DNP3_Fragment *fragment, const uint8_t *buf, size_t len);
+void cb_batch(void *env, const DNP3_Batch *batch);
 
 // corresponding event enums
 enum class Event
 {
     LINK_FRAME,
     TRANS_SEGMENT,
+    TRANS_DISCARD,
     TRANS_PAYLOAD,
     APP_INVALID,
-    APP_FRAG
+    APP_FRAG,
+    APP_UNCHANGED
 };
 
 
 typedef std::pair<const uint8_t*, size_t> slice_t;
 
+// number of frames, segments, payloads and fragments in a batch
+struct BatchSize
+{
+    size_t frames;
+    size_t segments;
+    size_t payloads;
+    size_t fragments;
+};
+
 class PluginFixture
 {
     public:
-        PluginFixture();
+        explicit PluginFixture(bool batch = false);
         ~PluginFixture();
 
         bool Parse(const std::string& hex);
 
+        void EnableCache(size_t entries, size_t maxbytes);
+        void SetInterest(const DNP3_Interest* mask);
+        void SetPack(unsigned flags);
+        DNP3_DissectorStats Stats() const;
+        size_t Consumed() const;
+
         bool CheckEvents(std::initializer_list<Event> expected) const;
 
         std::vector<Event> events;
 
+        // keep references to all fragments passed to the callbacks
+        bool retain;
+        std::vector<const DNP3_Fragment*> fragments;
+
+        // sizes of the batches passed to cb_batch
+        std::vector<BatchSize> batches;
+
     private:
         StreamProcessor* m_plugin;
 };
@@ -73,6 +73,16 @@ static char *format(const HParsedToken *p)
     check_inttype("%p", void *, p, op, q);                              \
   } while(0)
 
+#define check_cmp_uint(n1, op, n2) do {                                 \
+    int LINE = __LINE__;                                                \
+    check_inttype("%" PRIu64, uint64_t, n1, op, n2);                    \
+  } while(0)
+
+#define check_cmp_int(n1, op, n2) do {                                  \
+    int LINE = __LINE__;                                                \
+    check_inttype("%" PRId64, int64_t, n1, op, n2);                     \
+  } while(0)
+
 #define check_string(n1, op, n2) do {                                   \
     const char *_n1 = (n1);                                             \
     const char *_n2 = (n2);                                             \
@@ -97,6 +107,32 @@ void do_check_parse_fail(const HParser* parser, const uint8_t* input, size_t len
     }
 }
 
+// encode a parsed fragment and check that it parses back to the same result
+void do_check_roundtrip(const HParser* parser, const DNP3_Fragment *frag, const char* result, int LINE) {
+    size_t size = dnp3_fragment_encoded_size(frag);
+    if (size == 0) {
+      g_test_message("Encoding failed on line %d: %s", LINE, result);
+      g_test_fail();
+      return;
+    }
+
+    uint8_t *buf = malloc(size);
+    check_cmp_size(dnp3_encode_fragment(buf, size - 1, frag), ==, 0);
+    check_cmp_size(dnp3_encode_fragment(buf, size, frag), ==, size);
+
+    HParseResult *res = h_parse(parser, buf, size);
+    if (!res) {
+      g_test_message("Reparse failed on line %d, while expecting %s", LINE, result);
+      g_test_fail();
+    } else {
+      char *cres = format(res->ast);
+      check_string(cres, == , result);
+      free(cres);
+      h_parse_result_free(res);
+    }
+    free(buf);
+}
+
 void do_check_parse(const HParser* parser, const uint8_t* input, size_t length, const char* result, int LINE) {
     HParseResult *res = h_parse(parser, input, length);
     if (!res) {
@@ -106,6 +142,11 @@ void do_check_parse(const HParser* parser, const uint8_t* input, size_t length,
       char *cres = format(res->ast);
       check_string(cres, == , result);
       free(cres);
+      // every fragment in the corpus must survive parse->encode->parse
+      if (res->ast && res->ast->token_type == (HTokenType)TT_DNP3_Fragment &&
+          (parser == dnp3_p_app_request || parser == dnp3_p_app_response ||
+           parser == dnp3_p_app_fragment))
+        do_check_roundtrip(parser, res->ast->user, result, LINE);
       HArenaStats stats;
       h_allocator_stats(res->arena, &stats);
       g_test_message("Parse used %zd bytes, wasted %zd bytes. "
@@ -253,6 +294,266 @@ static void test_app_fragment(void)
                                      "PARAM_ERROR on [0] (fir,fin) RESPONSE");
 }
 
+static void test_app_ohdrs(void)
+{
+    // object headers are kept, objects and indexes are skipped
+    check_parse(dnp3_p_app_request_ohdrs, "\xC0\x01\x01\x00\x17\x03\x41\x43\x42",9,
+                                          "[0] (fir,fin) READ {g1v0 qc=17}");
+    check_parse(dnp3_p_app_request_ohdrs, "\xC0\x01\x02\x03\x00\x03\x41",7,
+                                          "[0] (fir,fin) READ {g2v3 qc=00 #3..65}");
+    check_parse(dnp3_p_app_request_ohdrs, "\xC1\x02\x0A\x01\x00\x03\x06\x0E",8,
+                                          "[1] (fir,fin) WRITE {g10v1 qc=00 #3..6}");
+    check_parse(dnp3_p_app_request_ohdrs, "\xC3\x0B\x32\x02\x07\x01\xC0\x5F\x63\x1C\xE7\x00\xA0\xBB\x0D\x00\x14\x00\x06",19,
+                                          "[3] (fir,fin) FREEZE_AT_TIME {g50v2 qc=07 range=1} {g20v0 qc=06}");
+    check_parse(dnp3_p_app_response_ohdrs, "\xC0\x81\x00\x00\x01\x01\x00\x03\x08\x19",10,
+                                           "[0] (fir,fin) RESPONSE {g1v1 qc=00 #3..8}");
+    check_parse(dnp3_p_app_response_ohdrs, "\x00\x81\x00\x00\x1E\x01\x39\x01\x00\x00\x00"
+                                           "\x01\x00\x00\x00\x21\x12\x34\x56\x78",20,
+                                           "[0] RESPONSE {g30v1 qc=39}");
+    check_parse(dnp3_p_app_fragment_ohdrs, "\xC2\x00",2, "[2] (fir,fin) CONFIRM");
+    check_parse(dnp3_p_app_fragment_ohdrs, "\xC0\x81\x00\x00\x01\x02\x17\x01\x03\x80",10,
+                                           "[0] (fir,fin) RESPONSE {g1v2 qc=17}");
+
+    // object values are not checked
+    check_parse(dnp3_p_app_fragment_ohdrs, "\xC0\x81\x00\x00\x02\x01\x17\x01\x03\xC3",10,
+                                           "[0] (fir,fin) RESPONSE {g2v1 qc=17}");
+
+    // but the headers and object sizes are
+    check_parse(dnp3_p_app_fragment_ohdrs, "\xC0\xFF",2, "FUNC_NOT_SUPP on [0] (fir,fin) 0xFF");
+    check_parse(dnp3_p_app_fragment_ohdrs, "\xC0\x01\x01",3, "PARAM_ERROR on [0] (fir,fin) READ");
+    check_parse(dnp3_p_app_fragment_ohdrs, "\xC0\x01\xFF\x01\x06",5, "OBJ_UNKNOWN on [0] (fir,fin) READ");
+    check_parse(dnp3_p_app_fragment_ohdrs, "\xC0\x81\x00\x00\x01\x02\x17\x02\x03\x80",10,
+                                           "PARAM_ERROR on [0] (fir,fin) RESPONSE");
+    check_parse(dnp3_p_app_response_ohdrs, "\x00\x81\x00\x00\x1E\x02\x01\x00\x00\xFF\xFF",11,
+                                           "PARAM_ERROR on [0] RESPONSE");
+}
+
+static void test_app_select(void)
+{
+    static const char rsp[] = "\xC0\x81\x00\x00\x01\x01\x00\x03\x08\x19"
+                              "\x1E\x01\x39\x01\x00\x00\x00\x01\x00\x00\x00\x21\x12\x34\x56\x78";
+    DNP3_Interest ana = {{0}}, bin = {{0}};
+    HParser *p;
+
+    dnp3_interest_add_group(&ana, DNP3_GROUP_ANAIN);
+    dnp3_interest_add(&bin, DNP3_GROUP_BININ, DNP3_VARIATION_BININ_PACKED);
+    check_cmp_uint(dnp3_interest_has(&ana, DNP3_GROUP_ANAIN, 7), ==, 1);
+    check_cmp_uint(dnp3_interest_has(&bin, DNP3_GROUP_BININ, 2), ==, 0);
+
+    // blocks outside the set are skipped
+    p = dnp3_p_app_fragment_select(&ana, 0);
+    check_parse(p, rsp,26, "[0] (fir,fin) RESPONSE {g1v1 qc=00 #3..8}"
+                           " {g30v1 qc=39 #1:(online,over_range)2018915346}");
+    p = dnp3_p_app_fragment_select(&bin, 0);
+    check_parse(p, rsp,26, "[0] (fir,fin) RESPONSE {g1v1 qc=00 #3..8: 1 0 0 1 1 0}"
+                           " {g30v1 qc=39}");
+
+    // requests are decoded in full
+    check_parse(p, "\xC0\x01\x01\x00\x17\x03\x41\x43\x42",9,
+                   "[0] (fir,fin) READ {g1v0 qc=17 #65 #67 #66}");
+
+    // invalid blocks of interest are still errors
+    check_parse(p, "\xC0\x81\x00\x00\x01\x01\x17\x00",8,
+                   "PARAM_ERROR on [0] (fir,fin) RESPONSE");
+
+    // blocks not allowed in responses are not skipped
+    p = dnp3_p_app_fragment_select(&ana, 0);
+    check_parse(dnp3_p_app_fragment, "\xC0\x81\x00\x00\x01\x00\x00\x03\x08",9,
+                   "OBJ_UNKNOWN on [0] (fir,fin) RESPONSE");
+    check_parse(p, "\xC0\x81\x00\x00\x01\x00\x00\x03\x08",9,
+                   "OBJ_UNKNOWN on [0] (fir,fin) RESPONSE");
+    p = dnp3_p_app_fragment_select(&bin, 0);
+
+    // skipped blocks are checked against the qualifiers allowed
+    check_parse(dnp3_p_app_fragment, "\xC0\x81\x00\x00\x1E\x01\x06",7,
+                   "PARAM_ERROR on [0] (fir,fin) RESPONSE");
+    check_parse(p, "\xC0\x81\x00\x00\x1E\x01\x06",7,
+                   "PARAM_ERROR on [0] (fir,fin) RESPONSE");
+
+    // parsers are reused for equal sets
+    DNP3_Interest bin2 = bin;
+    check_cmp_ptr(dnp3_p_app_fragment_select(&bin2, 0), ==, p);
+}
+
+static void test_app_lazy(void)
+{
+    HParser *p = dnp3_p_app_fragment_select(NULL, DNP3_PACK_RAW);
+
+    // objects read the same whether raw or decoded
+    check_parse(p, "\xC0\x81\x00\x00\x01\x01\x00\x03\x08\x19",10,
+                   "[0] (fir,fin) RESPONSE {g1v1 qc=00 #3..8: 1 0 0 1 1 0}");
+    check_parse(p, "\xC0\x81\x00\x00\x03\x01\x00\x00\x03\x36",10,
+                   "[0] (fir,fin) RESPONSE {g3v1 qc=00 #0..3: 1 0 - ~}");
+    check_parse(p, "\xC0\x81\x00\x00\x1E\x01\x39\x01\x00\x00\x00\x01\x00\x00\x00\x21\x12\x34\x56\x78",20,
+                   "[0] (fir,fin) RESPONSE {g30v1 qc=39 #1:(online,over_range)2018915346}");
+    check_parse(p, "\xC0\x81\x00\x00\x02\x02\x17\x01\x03\x82\xA0\xFC\x7D\x7A\x4B\x01",16,
+                   "[0] (fir,fin) RESPONSE {g2v2 qc=17 #3:(restart)1@1423689252s}");
+    check_parse(p, "\x00\x81\x00\x00\x14\x01\x17\x01\x01\x41\x12\x34\x56\x78",14,
+                   "[0] RESPONSE {g20v1 qc=17 #1:(online,discontinuity)2018915346}");
+
+    // reserved flags are still checked
+    check_parse(p, "\xC0\x81\x00\x00\x1E\x01\x17\x01\x01\x81\x12\x34\x56\x78",14,
+                   "PARAM_ERROR on [0] (fir,fin) RESPONSE");
+
+    // other objects are decoded in full
+    check_parse(p, "\xC0\x81\x00\x00\x0D\x02\x17\x01\x03\x80\x00\x00\x00\x00\x00\x80",16,
+                   "[0] (fir,fin) RESPONSE {g13v2 qc=17 #3:1@140737488355.328s}");
+
+    // two 32-bit analogs with flags
+    const uint8_t input[] = "\xC0\x81\x00\x00\x1E\x01\x00\x00\x01"
+                            "\x01\x12\x34\x56\x78\x01\x00\x00\x00\x80";
+    HParseResult *res = h_parse(p, input, sizeof(input)-1);
+    check_cmp_ptr(res, !=, NULL);
+    if(!res) return;
+
+    const DNP3_Fragment *frag = res->ast->user;
+    DNP3_ObjectBlock *ob = frag->odata[0];
+    DNP3_Object o;
+    check_cmp_ptr(ob->objects, ==, NULL);
+    check_cmp_ptr(ob->raw, !=, NULL);
+    check_cmp_uint(ob->stride, ==, 40);
+    check_cmp_uint(dnp3_oblock_get(ob, 1, &o), ==, true);
+    check_cmp_uint((uint32_t)o.ana.sint, ==, 0x80000000);
+    check_cmp_uint(o.ana.flags.online, ==, 1);
+
+    // raw objects survive a copy
+    DNP3_Fragment *copy = dnp3_fragment_copy(frag, DNP3_PACK_COMPACT);
+    h_parse_result_free(res);
+    check_cmp_ptr(copy->odata[0]->raw, !=, NULL);
+    check_cmp_uint(dnp3_oblock_get(copy->odata[0], 0, &o), ==, true);
+    check_cmp_uint(o.ana.sint, ==, 2018915346);
+    free(copy);
+}
+
+static void test_app_encode(void)
+{
+    HParser *lazy = dnp3_p_app_fragment_select(NULL, DNP3_PACK_RAW);
+    const uint8_t input[] = "\xC0\x81\x00\x00"
+                            "\x1E\x01\x00\x00\x01"         // g30v1 #0..1
+                            "\x01\x12\x34\x56\x78\x01\x00\x00\x00\x80"
+                            "\x01\x01\x00\x03\x08\x19"     // g1v1 #3..8
+                            "\x02\x02\x17\x01\x03"         // g2v2 #3
+                            "\x82\xA0\xFC\x7D\x7A\x4B\x01";
+    size_t len = sizeof(input) - 1;
+    uint8_t buf[64];
+
+    // decoded, raw and compact objects all encode to the original bytes
+    HParseResult *res = h_parse(dnp3_p_app_response, input, len);
+    HParseResult *raw = h_parse(lazy, input, len);
+    check_cmp_ptr(res, !=, NULL);
+    check_cmp_ptr(raw, !=, NULL);
+    if(!res || !raw) return;
+
+    const DNP3_Fragment *frag = res->ast->user;
+    DNP3_Fragment *compact = dnp3_fragment_copy(frag, DNP3_PACK_COMPACT);
+    const DNP3_Fragment *frags[] = {frag, raw->ast->user, compact};
+
+    check_cmp_ptr(frags[1]->odata[0]->raw, !=, NULL);
+    check_cmp_ptr(compact->odata[0]->records, !=, NULL);
+    for(size_t i=0; i<3; i++) {
+        memset(buf, 0, sizeof buf);
+        check_cmp_uint(dnp3_fragment_encoded_size(frags[i]), ==, len);
+        check_cmp_uint(dnp3_encode_fragment(buf, sizeof buf, frags[i]), ==, len);
+        check_cmp_uint(memcmp(buf, input, len), ==, 0);
+    }
+    free(compact);
+    h_parse_result_free(raw);
+    h_parse_result_free(res);
+
+    // object headers only, with index prefixes
+    uint32_t idx = 256;
+    DNP3_ObjectBlock ob = {0};
+    DNP3_ObjectBlock *odata = &ob;
+    DNP3_Fragment req = {{0}};
+
+    req.ac.fir = req.ac.fin = 1;
+    req.fc = DNP3_READ;
+    req.nblocks = 1;
+    req.odata = &odata;
+    ob.group = DNP3_GROUP_BININ;
+    ob.variation = DNP3_VARIATION_BININ_FLAGS;
+    ob.count = 1;
+    ob.indexes = &idx;
+    ob.prefixcode = 2;
+    ob.rangespec = 7;
+    check_cmp_uint(dnp3_encode_fragment(buf, sizeof buf, &req), ==, 8);
+    check_cmp_uint(memcmp(buf, "\xC0\x01\x01\x02\x27\x01\x00\x01", 8), ==, 0);
+
+    // fields that do not fit, invalid qualifiers
+    ob.prefixcode = 1;
+    check_cmp_uint(dnp3_fragment_encoded_size(&req), ==, 0);
+    ob.prefixcode = 0;
+    ob.rangespec = 0xA;
+    check_cmp_uint(dnp3_fragment_encoded_size(&req), ==, 0);
+    ob.rangespec = 0;
+    ob.range_base = 255;
+    ob.count = 2;
+    check_cmp_uint(dnp3_fragment_encoded_size(&req), ==, 0);
+    ob.count = 1;
+    check_cmp_uint(dnp3_encode_fragment(buf, sizeof buf, &req), ==, 7);
+    check_cmp_uint(memcmp(buf, "\xC0\x01\x01\x02\x00\xFF\xFF", 7), ==, 0);
+}
+
+static void test_app_auth(void)
+{
+    // aggressive mode: g120v3 first, g120v9 last
+    check_parse(dnp3_p_app_request, "\xC0\x00\x78\x03\x07\x01\x05\x00\x00\x00\x01\x00"
+                                    "\x78\x09\x5B\x01\x04\x00\x01\x02\x03\x04",22,
+                                    "[0] (fir,fin) CONFIRM [auth usr=1 csq=5]");
+    check_parse(dnp3_p_app_request, "\xC0\x01\x78\x03\x07\x01\x05\x00\x00\x00\x01\x00\x3C\x02\x06"
+                                    "\x78\x09\x5B\x01\x04\x00\x01\x02\x03\x04",25,
+                                    "[0] (fir,fin) READ {g60v2 qc=06} [auth usr=1 csq=5]");
+    check_parse(dnp3_p_app_request, "\xC0\x01\x78\x03\x07\x01\x05\x00\x00\x00\x01\x00\x3C\x02\x06"
+                                    "\x78\x09\x5B\x01\x00\x00",21,
+                                    "PARAM_ERROR on [0] (fir,fin) READ");
+
+    // HMAC-SHA-256 (RFC 4231, test case 2)
+    DNP3_AuthKey key;
+    uint8_t mac[32];
+    dnp3_auth_key(&key, (const uint8_t *)"Jefe", 4);
+    dnp3_auth_mac(&key, (const uint8_t *)"what do ya want ", 16,
+                  (const uint8_t *)"for nothing?", 12, mac);
+    check_cmp_uint(memcmp(mac, "\x5b\xdc\xc1\x46\xbf\x60\x75\x4e\x6a\x04\x24\x26"
+                               "\x08\x95\x75\xc7\x5a\x00\x3f\x08\x9d\x27\x39\x83"
+                               "\x9d\xec\x58\xb9\x64\xec\x38\x43", 32), ==, 0);
+
+    // the MAC covers the challenge and the fragment up to the MAC value
+    uint8_t input[] = "\xC0\x01"
+                      "\x78\x03\x07\x01\x05\x00\x00\x00\x01\x00"   // g120v3
+                      "\x3C\x02\x06"                               // g60v2
+                      "\x78\x09\x5B\x01\x10\x00"                   // g120v9
+                      "0123456789abcdef";
+    size_t len = sizeof(input) - 1;
+    const uint8_t chal[] = "challenge";
+    size_t chal_len = sizeof(chal) - 1;
+
+    dnp3_auth_key(&key, (const uint8_t *)"session key", 11);
+    dnp3_auth_mac(&key, chal, chal_len, input, len - 16, mac);
+    memcpy(input + len - 16, mac, 16);
+
+    HParseResult *res = h_parse(dnp3_p_app_request, input, len);
+    check_cmp_ptr(res, !=, NULL);
+    if(!res) return;
+    const DNP3_Fragment *frag = res->ast->user;
+    check_cmp_ptr(frag->auth, !=, NULL);
+    check_cmp_uint(frag->auth->maclen, ==, 16);
+    check_cmp_uint(dnp3_auth_verify(&key, chal, chal_len, input, len, frag->auth), ==, true);
+    check_cmp_uint(dnp3_auth_verify(&key, chal, chal_len-1, input, len, frag->auth), ==, false);
+
+    DNP3_AuthCheck checks[5];
+    bool ok[5];
+    for(size_t i=0; i<5; i++)
+        checks[i] = (DNP3_AuthCheck){&key, chal, chal_len, input, len, frag->auth};
+    checks[3].chal_len--;
+    check_cmp_uint(dnp3_auth_verify_batch(checks, 5, ok), ==, 4);
+    check_cmp_uint(ok[3], ==, false);
+    check_cmp_uint(ok[4], ==, true);
+
+    input[14] ^= 1;     // tamper with the object header
+    check_cmp_uint(dnp3_auth_verify(&key, chal, chal_len, input, len, frag->auth), ==, false);
+    h_parse_result_free(res);
+}
+
 static void test_req_fail(void)
 {
     check_parse_fail(dnp3_p_app_request, "",0);
@@ -302,6 +603,8 @@ static void test_req_ohdr(void)
     // invalid group / variation (complete header)
     check_parse(dnp3_p_app_request, "\xC0\x01\x05\x00\x00\x03\x41",7, "OBJ_UNKNOWN on [0] (fir,fin) READ");
     check_parse(dnp3_p_app_request, "\xC0\x01\x32\x00\x06",5, "OBJ_UNKNOWN on [0] (fir,fin) READ");
+    check_parse(dnp3_p_app_request, "\xC0\x01\x01\x63\x06",5, "OBJ_UNKNOWN on [0] (fir,fin) READ");
+    check_parse(dnp3_p_app_request, "\xC0\x01\x01\x00\x06\xFF\x00\x06",8, "OBJ_UNKNOWN on [0] (fir,fin) READ");
 }
 
 static void test_req_confirm(void)
@@ -595,6 +898,30 @@ static void test_rsp_unsolicited(void)
                                      "[0] (con,uns) UNSOLICITED_RESPONSE {g51v2 qc=07 (unsynchronized)@1.024s}");
 }
 
+static void test_rsp_admission(void)
+{
+    DNP3_ParserStats st0, st1;
+
+    dnp3_parser_stats(&st0);
+
+    // count of 2^32-1 indexed analog inputs, only one present
+    check_parse(dnp3_p_app_response, "\x00\x81\x00\x00\x1E\x01\x39\xFF\xFF\xFF\xFF"
+                                     "\x01\x00\x00\x00\x21\x12\x34\x56\x78",20,
+                                     "PARAM_ERROR on [0] RESPONSE");
+    // range of 2^32-1 analog inputs, only one present
+    check_parse(dnp3_p_app_response, "\x00\x81\x00\x00\x1E\x01\x02\x00\x00\x00\x00"
+                                     "\xFE\xFF\xFF\xFF\x21\x12\x34\x56\x78",20,
+                                     "PARAM_ERROR on [0] RESPONSE");
+
+    dnp3_parser_stats(&st1);
+    check_cmp_uint(st1.admission_rejects - st0.admission_rejects, ==, 2);
+
+    // count matching the objects present
+    check_parse(dnp3_p_app_response, "\x00\x81\x00\x00\x1E\x01\x39\x01\x00\x00\x00"
+                                     "\x01\x00\x00\x00\x21\x12\x34\x56\x78",20,
+                                     "[0] RESPONSE {g30v1 qc=39 #1:(online,over_range)2018915346}");
+}
+
 static void test_obj_binin(void)
 {
     check_parse(dnp3_p_app_request, "\xC0\x01\x01\x00\x00\x03\x08",7,
@@ -650,8 +977,7 @@ static void test_obj_bininev(void)
                                      "[0] (fir,fin) RESPONSE {g2v3 qc=17 #3:(online)1@+22.240s}");
     check_parse(dnp3_p_app_response, "\xC0\x81\x00\x00\x02\x03\x17\x01\x03\xC1\x00\x00",12,
                                      "PARAM_ERROR on [0] (fir,fin) RESPONSE");
-        // XXX should the relative time variants generate a PARAM_ERROR unless they are preceded by a
-        //     Common Time-of-Occurance (CTO, group 50) object in the same message?
+        // without a preceding CTO, relative times are left unresolved (see test_obj_cto)
 }
 
 static void test_obj_dblbitin(void)
@@ -715,8 +1041,7 @@ static void test_obj_dblbitinev(void)
                                      "[0] (fir,fin) RESPONSE {g4v3 qc=17 #3:(online)0@+32.768s}");
     check_parse(dnp3_p_app_response, "\xC0\x81\x00\x00\x04\x03\x17\x01\x03\x81\xE0\x56",12,
                                      "[0] (fir,fin) RESPONSE {g4v3 qc=17 #3:(online)1@+22.240s}");
-        // XXX should the relative time variants generate a PARAM_ERROR unless they are preceded by a
-        //     Common Time-of-Occurance (CTO, group 50) object in the same message?
+        // without a preceding CTO, relative times are left unresolved (see test_obj_cto)
 }
 
 static void test_obj_binout(void)
@@ -834,6 +1159,8 @@ static void test_obj_ctr(void)
 {
     check_parse(dnp3_p_app_response, "\x00\x81\x00\x00\x14\x01\x17\x01\x01\x41\x12\x34\x56\x78",14,
                                      "[0] RESPONSE {g20v1 qc=17 #1:(online,discontinuity)2018915346}");
+    check_parse(dnp3_p_app_response, "\x00\x81\x00\x00\x14\x01\x17\x01\x01\x81\x12\x34\x56\x78",14,  // reserved bit set
+                                     "PARAM_ERROR on [0] RESPONSE");
     check_parse(dnp3_p_app_response, "\x00\x81\x00\x00\x14\x02\x17\x01\x01\x20\x12\x34",12,
                                      "[0] RESPONSE {g20v2 qc=17 #1:13330}");
     check_parse(dnp3_p_app_response, "\x00\x81\x00\x00\x14\x05\x17\x01\x01\x12\x34\x56\x78",13,
@@ -886,6 +1213,8 @@ static void test_obj_anain(void)
 {
     check_parse(dnp3_p_app_response, "\x00\x81\x00\x00\x1E\x01\x17\x01\x01\x21\x12\x34\x56\x78",14,
                                      "[0] RESPONSE {g30v1 qc=17 #1:(online,over_range)2018915346}");
+    check_parse(dnp3_p_app_response, "\x00\x81\x00\x00\x1E\x01\x17\x01\x01\x81\x12\x34\x56\x78",14,  // reserved bit set
+                                     "PARAM_ERROR on [0] RESPONSE");
     check_parse(dnp3_p_app_response, "\x00\x81\x00\x00\x1E\x02\x17\x01\x01\x40\x12\x34",12,
                                      "[0] RESPONSE {g30v2 qc=17 #1:(reference_err)13330}");
     check_parse(dnp3_p_app_response, "\x00\x81\x00\x00\x1E\x03\x17\x01\x01\x12\x34\x56\x78",13,
@@ -1061,6 +1390,63 @@ static void test_obj_cto(void)
                                      "[0] RESPONSE {g51v1 qc=07 @1.024s}");
     check_parse(dnp3_p_app_response, "\x00\x81\x00\x00\x33\x02\x07\x01\x00\x04\x00\x00\x00\x00",14,
                                      "[0] RESPONSE {g51v2 qc=07 (unsynchronized)@1.024s}");
+
+    // relative times are resolved against the last CTO before them
+    check_parse(dnp3_p_app_response, "\x00\x81\x00\x00\x33\x01\x07\x01\x00\x04\x00\x00\x00\x00"
+                                     "\x02\x03\x17\x02\x03\x81\xE0\x56\x05\x00\x00\x00",26,
+                                     "[0] RESPONSE {g51v1 qc=07 @1.024s} {g2v3 qc=17 #3:(online)1@23.264s #5:0@1.024s}");
+    check_parse(dnp3_p_app_response, "\x00\x81\x00\x00\x33\x01\x07\x01\x00\x04\x00\x00\x00\x00"
+                                     "\x04\x03\x17\x01\x03\x81\xE0\x56"
+                                     "\x33\x01\x07\x01\x00\x08\x00\x00\x00\x00"
+                                     "\x04\x03\x17\x01\x03\x81\xE0\x56",40,
+                                     "[0] RESPONSE {g51v1 qc=07 @1.024s} {g4v3 qc=17 #3:(online)1@23.264s}"
+                                     " {g51v1 qc=07 @2.048s} {g4v3 qc=17 #3:(online)1@24.288s}");
+    check_parse(dnp3_p_app_response, "\x00\x81\x00\x00\x02\x03\x17\x01\x03\x81\xE0\x56"
+                                     "\x33\x01\x07\x01\x00\x04\x00\x00\x00\x00",22,
+                                     "[0] RESPONSE {g2v3 qc=17 #3:(online)1@+22.240s} {g51v1 qc=07 @1.024s}");
+
+    // also when only the timed objects are selected
+    DNP3_Interest binev = {{0}};
+    dnp3_interest_add_group(&binev, DNP3_GROUP_BININEV);
+    check_parse(dnp3_p_app_fragment_select(&binev, 0),
+                "\x00\x81\x00\x00\x33\x01\x07\x01\x00\x04\x00\x00\x00\x00"
+                "\x02\x03\x17\x01\x03\x81\xE0\x56",22,
+                "[0] RESPONSE {g51v1 qc=07 @1.024s} {g2v3 qc=17 #3:(online)1@23.264s}");
+
+    // the block tells whether and against what kind of CTO they were resolved
+    const uint8_t input[] = "\x00\x81\x00\x00"
+                            "\x02\x03\x17\x01\x03\x81\xE0\x56"     // g2v3 #3
+                            "\x33\x02\x07\x01\x00\x04\x00\x00\x00\x00"
+                            "\x02\x03\x17\x01\x03\x81\xE0\x56";    // g2v3 #3
+    HParser *lazy = dnp3_p_app_fragment_select(NULL, DNP3_PACK_RAW);
+    HParser *ps[] = {dnp3_p_app_response, lazy};
+    DNP3_Object o;
+
+    for(size_t i=0; i<2; i++) {
+        HParseResult *res = h_parse(ps[i], input, sizeof(input)-1);
+        check_cmp_ptr(res, !=, NULL);
+        if(!res) return;
+
+        const DNP3_Fragment *frag = res->ast->user;
+        check_cmp_uint(frag->nblocks, ==, 3);
+        check_cmp_uint(frag->odata[0]->nocto, ==, 1);
+        check_cmp_uint(dnp3_oblock_get(frag->odata[0], 0, &o), ==, true);
+        check_cmp_uint(o.timed.reltime, ==, 22240);
+        check_cmp_uint(frag->odata[2]->nocto, ==, 0);
+        check_cmp_uint(frag->odata[2]->unsync, ==, 1);
+        check_cmp_uint(frag->odata[2]->cto, ==, 1024);
+        check_cmp_uint(dnp3_oblock_get(frag->odata[2], 0, &o), ==, true);
+        check_cmp_uint(o.timed.abstime, ==, 23264);
+
+        // resolved times survive a compact copy
+        DNP3_Fragment *copy = dnp3_fragment_copy(frag, DNP3_PACK_COMPACT);
+        h_parse_result_free(res);
+        check_cmp_ptr(copy->odata[2]->objects, ==, NULL);
+        check_cmp_uint(dnp3_oblock_get(copy->odata[2], 0, &o), ==, true);
+        check_cmp_uint(o.timed.abstime, ==, 23264);
+        check_cmp_uint(copy->odata[2]->unsync, ==, 1);
+        free(copy);
+    }
 }
 
 static void test_obj_delay(void)
@@ -1089,6 +1475,40 @@ static void test_obj_iin(void)
                                      "[0] RESPONSE {g80v1 qc=00 #0..2: 0 1 1}");
 }
 
+static void test_obj_auth(void)
+{
+    check_parse(dnp3_p_app_response, "\xC0\x83\x00\x00\x78\x01\x5B\x01\x0C\x00\x05\x00\x00\x00\x01\x00"
+                                     "\x04\x01\xDE\xAD\xBE\xEF",22,
+                                     "[0] (fir,fin) AUTHENTICATE_RESP {g120v1 qc=5B csq=5 usr=1 mal=4 rsn=1 data=deadbeef}");
+    check_parse(dnp3_p_app_request,  "\xC1\x20\x78\x02\x5B\x01\x0A\x00\x05\x00\x00\x00\x01\x00\x01\x02\x03\x04",18,
+                                     "[1] (fir,fin) AUTHENTICATE_REQ {g120v2 qc=5B csq=5 usr=1 mac=01020304}");
+    check_parse(dnp3_p_app_request,  "\xC2\x20\x78\x04\x07\x01\x01\x00",8,
+                                     "[2] (fir,fin) AUTHENTICATE_REQ {g120v4 qc=07 usr=1}");
+    check_parse(dnp3_p_app_response, "\xC3\x83\x00\x00\x78\x05\x5B\x01\x0F\x00\x07\x00\x00\x00\x01\x00"
+                                     "\x02\x02\x04\x04\x00\x01\x02\x03\x04",25,
+                                     "[3] (fir,fin) AUTHENTICATE_RESP {g120v5 qc=5B ksq=7 usr=1 kwa=2 kst=2 mal=4 data=01020304}");
+    check_parse(dnp3_p_app_response, "\xC3\x83\x00\x00\x78\x05\x5B\x01\x11\x00\x07\x00\x00\x00\x01\x00"
+                                     "\x02\x01\x04\x04\x00\x01\x02\x03\x04\xAA\xBB",27,
+                                     "[3] (fir,fin) AUTHENTICATE_RESP {g120v5 qc=5B ksq=7 usr=1 kwa=2 kst=1 mal=4 data=01020304 mac=aabb}");
+    check_parse(dnp3_p_app_request,  "\xC4\x20\x78\x06\x5B\x01\x0A\x00\x07\x00\x00\x00\x01\x00\xAA\xBB\xCC\xDD",18,
+                                     "[4] (fir,fin) AUTHENTICATE_REQ {g120v6 qc=5B ksq=7 usr=1 key=aabbccdd}");
+    check_parse(dnp3_p_app_request,  "\xC5\x21\x78\x07\x5B\x01\x12\x00\x05\x00\x00\x00\x01\x00\x00\x00"
+                                     "\x01\xDC\x05\x00\x00\x00\x00" "bad",26,
+                                     "[5] (fir,fin) AUTH_REQ_NO_ACK {g120v7 qc=5B csq=5 usr=1 aid=0 err=1 @1.500s 'bad'}");
+
+    // challenge data longer than the object
+    check_parse(dnp3_p_app_response, "\xC3\x83\x00\x00\x78\x05\x5B\x01\x0F\x00\x07\x00\x00\x00\x01\x00"
+                                     "\x02\x02\x04\x05\x00\x01\x02\x03\x04",25,
+                                     "PARAM_ERROR on [3] (fir,fin) AUTHENTICATE_RESP");
+    // key status in a request
+    check_parse(dnp3_p_app_request,  "\xC6\x20\x78\x05\x5B\x01\x0B\x00",8,
+                                     "OBJ_UNKNOWN on [6] (fir,fin) AUTHENTICATE_REQ");
+
+    check_parse(dnp3_p_app_fragment_ohdrs, "\xC0\x83\x00\x00\x78\x01\x5B\x01\x0C\x00\x05\x00\x00\x00\x01\x00"
+                                           "\x04\x01\xDE\xAD\xBE\xEF",22,
+                                           "[0] (fir,fin) AUTHENTICATE_RESP {g120v1 qc=5B}");
+}
+
 static void test_link_raw(void)
 {
     check_parse(dnp3_p_link_frame, "\x05\x64\x05\xF2\x01\x00\xEF\xFF\xBF\xB5",10,
@@ -1213,6 +1633,88 @@ static void test_link_skip(void)
                      "\x01\x02\x03\x04\xB4\x67",52, 52);
 }
 
+static void test_link_encode(void)
+{
+    static const uint8_t wire[] =
+        "\x05\x64\x26\xF3\x01\x00\xEF\xFF\x6B\xF4"
+        "\x00\x01\x02\x03\x04\x05\x06\x07\x08\x09\x0A\x0B\x0C\x0D\x0E\x0F\xEC\x10"
+        "\x10\x11\x12\x13\x14\x15\x16\x17\x18\x19\x1A\x1B\x1C\x1D\x1E\x1F\x27\x03"
+        "\x20\x50\xD6"
+        "\x05\x64\x05\x90\x01\x00\xEF\xFF\x54\xDB";
+    uint8_t data[33];
+    uint8_t buf[2 * DNP3_MAX_FRAME];
+    DNP3_Frame frames[2] = {{0}};
+
+    for(size_t i=0; i<sizeof(data); i++)
+        data[i] = i;
+
+    // (fcb=1) CONFIRMED_USER_DATA, ACK (dfc)
+    frames[0].dir = 1;
+    frames[0].fcb = 1;
+    frames[0].fcv = 1;
+    frames[0].func = DNP3_CONFIRMED_USER_DATA;
+    frames[0].source = 65519;
+    frames[0].destination = 1;
+    frames[0].len = sizeof(data);
+    frames[0].payload = data;
+    frames[1] = frames[0];
+    frames[1].fcb = 0;
+    frames[1].dfc = 1;
+    frames[1].func = DNP3_ACK;
+    frames[1].len = 0;
+    frames[1].payload = NULL;
+
+    check_cmp_uint(dnp3_link_size(33), ==, 49);
+    check_cmp_uint(dnp3_link_encode_frame(buf, sizeof(buf), &frames[0]), ==, 49);
+    check_cmp_uint(memcmp(buf, wire, 49), ==, 0);
+    check_cmp_uint(dnp3_link_encode_frame(buf, 48, &frames[0]), ==, 0);
+
+    // the payload may come in pieces
+    HBytes pieces[3] = {{data, 1}, {data+1, 0}, {data+1, 32}};
+    memset(buf, 0, sizeof(buf));
+    check_cmp_uint(dnp3_link_encode_framev(buf, sizeof(buf), &frames[0], pieces, 3), ==, 49);
+    check_cmp_uint(memcmp(buf, wire, 49), ==, 0);
+
+    // several frames at once
+    memset(buf, 0, sizeof(buf));
+    check_cmp_uint(dnp3_link_encode_frames(buf, sizeof(buf), frames, 2), ==, 59);
+    check_cmp_uint(memcmp(buf, wire, 59), ==, 0);
+
+    // round trip for every payload length
+    for(int n=0; n<=DNP3_MAX_PAYLOAD; n++) {
+        uint8_t payload[DNP3_MAX_PAYLOAD];
+        DNP3_Frame f = frames[0];
+
+        for(int i=0; i<n; i++)
+            payload[i] = 0xA5 ^ i;
+        f.func = n > 0 ? DNP3_UNCONFIRMED_USER_DATA : DNP3_RESET_LINK_STATES;
+        f.fcb = f.fcv = 0;
+        f.len = n;
+        f.payload = payload;
+
+        size_t m = dnp3_link_encode_frame(buf, sizeof(buf), &f);
+        check_cmp_uint(m, ==, dnp3_link_size(n));
+
+        HParseResult *res = h_parse(dnp3_p_link_frame, buf, m);
+        check_cmp_ptr(res, !=, NULL);
+        if(!res) continue;
+        check_cmp_uint(res->bit_length, ==, 8 * m);
+
+        DNP3_Frame *g = res->ast->user;
+        check_cmp_uint(dnp3_link_validate_frame(g), ==, true);
+        check_cmp_uint(g->len, ==, n);
+        check_cmp_uint(g->source, ==, 65519);
+        check_cmp_uint(g->destination, ==, 1);
+        if(n > 0)
+            check_cmp_uint(memcmp(g->payload, payload, n), ==, 0);
+        h_parse_result_free(res);
+    }
+
+    // too long
+    frames[0].len = DNP3_MAX_PAYLOAD + 1;
+    check_cmp_uint(dnp3_link_encode_frame(buf, sizeof(buf), &frames[0]), ==, 0);
+}
+
 static void test_transport(void)
 {
     check_parse(dnp3_p_transport_segment, "\x4A\x01\x02\x03\x04\x05\x06",7,
@@ -1221,6 +1723,785 @@ static void test_transport(void)
     check_parse_fail(dnp3_p_transport_segment, "",0);
 }
 
+// parse the frames of an encoded fragment, checking each segment
+static void check_segments(const HBytes *frames, size_t n, uint8_t seq,
+                           const uint8_t *fragment, size_t len)
+{
+    size_t off = 0;
+
+    for(size_t i=0; i<n; i++) {
+        HParseResult *res = h_parse(dnp3_p_link_frame,
+                                    frames[i].token, frames[i].len);
+        check_cmp_ptr(res, !=, NULL);
+        if(!res) return;
+        check_cmp_uint(res->bit_length, ==, 8 * frames[i].len);
+
+        const DNP3_Frame *f = res->ast->user;
+        check_cmp_uint(dnp3_link_validate_frame(f), ==, true);
+        HParseResult *r = h_parse(dnp3_p_transport_segment,
+                                  f->payload, f->len);
+        check_cmp_ptr(r, !=, NULL);
+        if(r) {
+            const DNP3_Segment *seg = r->ast->user;
+            check_cmp_uint(seg->fir, ==, (i == 0));
+            check_cmp_uint(seg->fin, ==, (i == n-1));
+            check_cmp_uint(seg->seq, ==, (seq + i) % 64);
+            check_cmp_uint(off + seg->len, <=, len);
+            if(off + seg->len <= len)
+                check_cmp_uint(memcmp(seg->payload, fragment + off, seg->len), ==, 0);
+            off += seg->len;
+            h_parse_result_free(r);
+        }
+        h_parse_result_free(res);
+    }
+    check_cmp_uint(off, ==, len);
+}
+
+static void test_transport_encode(void)
+{
+    DNP3_TransportEncoder *enc = dnp3_transport_encoder();
+    DNP3_Frame hdr = {0};
+    uint8_t fragment[600];
+    uint8_t buf[4 * DNP3_MAX_FRAME];
+    HBytes frames[3];
+    size_t n;
+
+    for(size_t i=0; i<sizeof(fragment); i++)
+        fragment[i] = i * 7;
+    hdr.dir = 1;
+    hdr.func = DNP3_UNCONFIRMED_USER_DATA;
+    hdr.source = 65519;
+    hdr.destination = 1;
+
+    check_cmp_uint(dnp3_transport_nframes(0), ==, 1);
+    check_cmp_uint(dnp3_transport_nframes(249), ==, 1);
+    check_cmp_uint(dnp3_transport_nframes(250), ==, 2);
+    check_cmp_uint(dnp3_transport_size(2), ==, 15);
+    check_cmp_uint(dnp3_transport_size(600), ==, 2*DNP3_MAX_FRAME + dnp3_link_size(103));
+
+    // 249 + 249 + 102 bytes
+    n = dnp3_transport_encode(enc, buf, sizeof(buf), &hdr, fragment, 600, frames);
+    check_cmp_uint(n, ==, dnp3_transport_size(600));
+    check_cmp_ptr((void *)frames[0].token, ==, buf);
+    check_cmp_ptr((void *)(frames[2].token + frames[2].len), ==, buf + n);
+    check_segments(frames, 3, 0, fragment, 600);
+
+    // sequence numbers continue per source/destination pair
+    n = dnp3_transport_encode(enc, buf, sizeof(buf), &hdr, fragment, 2, frames);
+    check_cmp_uint(n, ==, 15);
+    check_segments(frames, 1, 3, fragment, 2);
+    check_cmp_uint(dnp3_transport_set_seq(enc, 65519, 1, 63), ==, 0);
+    dnp3_transport_encode(enc, buf, sizeof(buf), &hdr, fragment, 300, frames);
+    check_segments(frames, 2, 63, fragment, 300);
+
+    hdr.source = 1024;
+    dnp3_transport_encode(enc, buf, sizeof(buf), &hdr, fragment, 2, frames);
+    check_segments(frames, 1, 0, fragment, 2);
+
+    // output too small
+    check_cmp_uint(dnp3_transport_encode(enc, buf, 14, &hdr, fragment, 2, NULL), ==, 0);
+    check_cmp_int(dnp3_transport_set_seq(enc, 1024, 1, 64), <, 0);
+
+    dnp3_transport_encoder_free(enc);
+}
+
+struct PointDeltas {
+    size_t n;
+    uint32_t index;         // of the last change
+    bool old;               // was the last changed point known before?
+    DNP3_Point cur;         // last reported point state
+};
+
+static void pointdb_delta(void *env, uint32_t assoc, DNP3_PointType type,
+                          uint32_t index, const DNP3_Point *old,
+                          const DNP3_Point *cur)
+{
+    struct PointDeltas *d = env;
+
+    d->n++;
+    d->index = index;
+    d->old = (old != NULL);
+    d->cur = *cur;
+}
+
+static size_t do_pointdb_update(DNP3_PointDB *db, uint32_t assoc,
+                                const uint8_t *input, size_t len, int LINE)
+{
+    HParseResult *res = h_parse(dnp3_p_app_fragment, input, len);
+    if(!res || H_ISERR(res->ast->token_type)) {
+        g_test_message("Parse failed on line %d", LINE);
+        g_test_fail();
+        return 0;
+    }
+
+    size_t n = dnp3_pointdb_update(db, assoc, res->ast->user);
+    h_parse_result_free(res);
+    return n;
+}
+
+#define pointdb_update(db, assoc, input, len) \
+    do_pointdb_update(db, assoc, (const uint8_t *)(input), len, __LINE__)
+
+static void test_pointdb(void)
+{
+    struct PointDeltas d = {0};
+    DNP3_PointDB *db = dnp3_pointdb(pointdb_delta, &d);
+    uint32_t assoc = dnp3_association(1, 1024);
+    const DNP3_Point *pt;
+
+    // initial integrity poll: all points are new
+    check_cmp_uint(pointdb_update(db, assoc, "\xC0\x81\x00\x00\x01\x01\x00\x03\x08\x19",10), ==, 6);
+    check_cmp_uint(d.n, ==, 6);
+    check_cmp_uint(d.index, ==, 8);
+    check_cmp_uint(d.old, ==, false);
+
+    // identical poll: nothing changed
+    check_cmp_uint(pointdb_update(db, assoc, "\xC1\x81\x00\x00\x01\x01\x00\x03\x08\x19",10), ==, 0);
+    check_cmp_uint(d.n, ==, 6);
+
+    // one state changed
+    check_cmp_uint(pointdb_update(db, assoc, "\xC2\x81\x00\x00\x01\x01\x00\x03\x08\x1B",10), ==, 1);
+    check_cmp_uint(d.index, ==, 4);
+    check_cmp_uint(d.old, ==, true);
+    check_cmp_uint(d.cur.flags.state, ==, 1);
+
+    // flags changed, state unchanged
+    check_cmp_uint(pointdb_update(db, assoc, "\xC3\x81\x00\x00\x01\x02\x17\x01\x03\x81",10), ==, 1);
+    pt = dnp3_pointdb_get(db, assoc, DNP3_POINT_BININ, 3);
+    check_cmp_ptr((void *)pt, !=, NULL);
+    if(pt) {
+        check_cmp_uint(pt->flags.online, ==, 1);
+        check_cmp_uint(pt->flags.state, ==, 1);
+    }
+    check_cmp_uint(pointdb_update(db, assoc, "\xC4\x81\x00\x00\x01\x02\x17\x01\x03\x81",10), ==, 0);
+
+    // analog values
+    check_cmp_uint(pointdb_update(db, assoc, "\x00\x81\x00\x00\x1E\x01\x17\x01\x01\x21\x12\x34\x56\x78",14), ==, 1);
+    check_cmp_uint(pointdb_update(db, assoc, "\x00\x81\x00\x00\x1E\x03\x17\x01\x01\x12\x34\x56\x78",13), ==, 0);
+    check_cmp_uint(pointdb_update(db, assoc, "\x00\x81\x00\x00\x1E\x03\x17\x01\x01\x13\x34\x56\x78",13), ==, 1);
+    pt = dnp3_pointdb_get(db, assoc, DNP3_POINT_ANAIN, 1);
+    check_cmp_ptr((void *)pt, !=, NULL);
+    if(pt) {
+        check_cmp_uint(pt->flags.over_range, ==, 1);    // retained from g30v1
+        check_cmp_uint(pt->value, ==, 2018915347);
+    }
+
+    // associations are separate; requests are ignored
+    check_cmp_ptr((void *)dnp3_pointdb_get(db, assoc+1, DNP3_POINT_ANAIN, 1), ==, NULL);
+    check_cmp_ptr((void *)dnp3_pointdb_get(db, assoc, DNP3_POINT_ANAIN, 2), ==, NULL);
+    check_cmp_uint(pointdb_update(db, assoc, "\xC0\x01\x01\x00\x00\x03\x08",7), ==, 0);
+
+    // high point indexes
+    check_cmp_uint(pointdb_update(db, assoc, "\x00\x81\x00\x00\x1E\x03\x28\x01\x00\x50\xC3\x12\x34\x56\x78",15), ==, 1);
+    check_cmp_uint(pointdb_update(db, assoc, "\x00\x81\x00\x00\x1E\x03\x28\x01\x00\x50\xC3\x12\x34\x56\x78",15), ==, 0);
+    pt = dnp3_pointdb_get(db, assoc, DNP3_POINT_ANAIN, 50000);
+    check_cmp_ptr((void *)pt, !=, NULL);
+    if(pt)
+        check_cmp_uint(pt->value, ==, 2018915346);
+    check_cmp_ptr((void *)dnp3_pointdb_get(db, assoc, DNP3_POINT_ANAIN, 50001), ==, NULL);
+    check_cmp_uint(dnp3_pointdb_rejects(db), ==, 0);
+
+    dnp3_pointdb_free(db);
+}
+
+struct Transactions {
+    size_t n;
+    DNP3_Transaction last;
+};
+
+static void tracker_done(void *env, const DNP3_Transaction *t)
+{
+    struct Transactions *d = env;
+
+    d->n++;
+    d->last = *t;
+}
+
+static void do_tracker_update(DNP3_Tracker *tr, bool dir, uint64_t now,
+                              const uint8_t *input, size_t len, int LINE)
+{
+    HParseResult *res = h_parse(dnp3_p_app_fragment, input, len);
+    if(!res || H_ISERR(res->ast->token_type)) {
+        g_test_message("Parse failed on line %d", LINE);
+        g_test_fail();
+        return;
+    }
+
+    uint32_t assoc = dnp3_association(1, 1024);
+    if(dnp3_tracker_update(tr, assoc, dir, now, res->ast->user) < 0) {
+        g_test_message("Tracker update failed on line %d", LINE);
+        g_test_fail();
+    }
+    h_parse_result_free(res);
+}
+
+// from master (M) or outstation (O)
+#define tracker_M(tr, now, input, len) \
+    do_tracker_update(tr, 1, now, (const uint8_t *)(input), len, __LINE__)
+#define tracker_O(tr, now, input, len) \
+    do_tracker_update(tr, 0, now, (const uint8_t *)(input), len, __LINE__)
+
+static void test_tracker(void)
+{
+    struct Transactions d = {0};
+    DNP3_Tracker *tr = dnp3_tracker(tracker_done, &d);
+    DNP3_TrackerStats stats;
+
+    // two-fragment response, both confirmed
+    tracker_M(tr, 100, "\xC3\x01\x01\x00\x06",5);       // READ
+    tracker_O(tr, 130, "\xA3\x81\x00\x00",4);           // (fir,con)
+    tracker_M(tr, 140, "\xC3\x00",2);
+    tracker_O(tr, 160, "\x64\x81\x00\x00",4);           // (fin,con)
+    check_cmp_uint(d.n, ==, 0);
+    tracker_M(tr, 170, "\xC4\x00",2);
+    check_cmp_uint(d.n, ==, 1);
+    check_cmp_uint(d.last.assoc, ==, dnp3_association(1, 1024));
+    check_cmp_uint(d.last.fc, ==, DNP3_READ);
+    check_cmp_uint(d.last.seq, ==, 3);
+    check_cmp_uint(d.last.status, ==, DNP3_TXN_COMPLETE);
+    check_cmp_uint(d.last.time, ==, 100);
+    check_cmp_uint(d.last.first, ==, 30);
+    check_cmp_uint(d.last.final, ==, 60);
+    check_cmp_uint(d.last.confirm, ==, 70);
+    check_cmp_uint(d.last.nfragments, ==, 2);
+    check_cmp_uint(d.last.nconfirms, ==, 2);
+    check_cmp_uint(d.last.fin, ==, true);
+    check_cmp_uint(d.last.confirmed, ==, true);
+
+    // responses and confirms without a matching request
+    tracker_O(tr, 200, "\xC9\x81\x00\x00",4);
+    tracker_M(tr, 210, "\xC9\x00",2);
+    tracker_M(tr, 220, "\xC5\x01\x01\x00\x06",5);
+    tracker_O(tr, 230, "\xC4\x81\x00\x00",4);           // wrong seq
+    tracker_O(tr, 240, "\x45\x81\x00\x00",4);           // not fir
+    dnp3_tracker_stats(tr, &stats);
+    check_cmp_uint(stats.unmatched, ==, 4);
+
+    // a new request aborts the pending one; no response expected
+    tracker_M(tr, 300, "\xC6\x08\x14\x00\x06",5);       // IMMED_FREEZE_NR
+    check_cmp_uint(d.n, ==, 3);
+    check_cmp_uint(d.last.fc, ==, DNP3_IMMED_FREEZE_NR);
+    check_cmp_uint(d.last.status, ==, DNP3_TXN_NORESPONSE);
+    check_cmp_uint(d.last.nfragments, ==, 0);
+
+    // unconfirmed single-fragment response
+    tracker_M(tr, 400, "\xC7\x01\x01\x00\x06",5);
+    tracker_O(tr, 450, "\xC7\x81\x00\x00",4);
+    check_cmp_uint(d.n, ==, 4);
+    check_cmp_uint(d.last.first, ==, 50);
+    check_cmp_uint(d.last.final, ==, 50);
+    check_cmp_uint(d.last.confirmed, ==, false);
+
+    // unsolicited responses are tracked separately
+    tracker_M(tr, 500, "\xC8\x01\x01\x00\x06",5);
+    tracker_O(tr, 510, "\x32\x82\x00\x00",4);           // (con,uns)
+    tracker_M(tr, 530, "\xD2\x00",2);
+    check_cmp_uint(d.n, ==, 5);
+    check_cmp_uint(d.last.fc, ==, DNP3_UNSOLICITED_RESPONSE);
+    check_cmp_uint(d.last.confirm, ==, 20);
+
+    // timeouts
+    check_cmp_uint(dnp3_tracker_expire(tr, 1000, 1000), ==, 0);
+    check_cmp_uint(dnp3_tracker_expire(tr, 1500, 1000), ==, 1);
+    check_cmp_uint(d.n, ==, 6);
+    check_cmp_uint(d.last.fc, ==, DNP3_READ);
+    check_cmp_uint(d.last.seq, ==, 8);
+    check_cmp_uint(d.last.status, ==, DNP3_TXN_TIMEOUT);
+
+    dnp3_tracker_stats(tr, &stats);
+    check_cmp_uint(stats.completed, ==, 4);
+    check_cmp_uint(stats.aborted, ==, 1);
+    check_cmp_uint(stats.timeouts, ==, 1);
+    dnp3_tracker_free(tr);
+}
+
+struct Responses {
+    size_t n;
+    size_t nfragments;          // of the last response
+    size_t nblocks;
+    uint8_t seq;
+    DNP3_IntIndications iin;
+    bool chained;               // blocks are those of the fragments
+};
+
+static void assembler_done(void *env, const DNP3_Response *r)
+{
+    struct Responses *d = env;
+    size_t k = 0;
+
+    d->n++;
+    d->nfragments = r->nfragments;
+    d->nblocks = r->nblocks;
+    d->seq = r->seq;
+    d->iin = r->iin;
+    d->chained = true;
+    for(size_t i=0; i<r->nfragments; i++) {
+        for(size_t j=0; j<r->fragments[i]->nblocks; j++)
+            d->chained &= (r->odata[k++] == r->fragments[i]->odata[j]);
+    }
+    d->chained &= (k == r->nblocks);
+}
+
+static void do_assembler_update(DNP3_Assembler *as, uint32_t assoc,
+                                uint64_t now, const uint8_t *input, size_t len,
+                                int LINE)
+{
+    HParseResult *res = h_parse(dnp3_p_app_fragment, input, len);
+    if(!res || H_ISERR(res->ast->token_type)) {
+        g_test_message("Parse failed on line %d", LINE);
+        g_test_fail();
+        return;
+    }
+
+    // as passed by the dissector
+    DNP3_Fragment *frag = dnp3_fragment_share(res->ast->user, 0);
+    h_parse_result_free(res);
+
+    if(dnp3_assembler_update(as, assoc, now, frag) < 0) {
+        g_test_message("Assembler update failed on line %d", LINE);
+        g_test_fail();
+    }
+    dnp3_fragment_release(frag);
+}
+
+#define assembler_update_assoc(as, assoc, now, input, len) \
+    do_assembler_update(as, assoc, now, (const uint8_t *)(input), len, \
+                        __LINE__)
+#define assembler_update(as, now, input, len) \
+    assembler_update_assoc(as, dnp3_association(1, 1024), now, input, len)
+
+static void test_assembler(void)
+{
+    struct Responses d = {0};
+    DNP3_Assembler *as = dnp3_assembler(assembler_done, &d);
+    DNP3_AssemblerStats stats;
+
+    // three fragments, one retransmitted; an unsolicited response between
+    assembler_update(as, 100, "\xA3\x81\x00\x00\x01\x01\x00\x00\x02\x05",10);
+    assembler_update(as, 110, "\x24\x81\x00\x00\x1E\x04\x17\x01\x01\x0C\x00",11);
+    assembler_update(as, 120, "\x24\x81\x00\x00\x1E\x04\x17\x01\x01\x0C\x00",11);
+    assembler_update(as, 125, "\xF2\x82\x00\x00",4);
+    check_cmp_uint(d.n, ==, 1);
+    check_cmp_uint(d.nfragments, ==, 1);
+    dnp3_assembler_stats(as, &stats);
+    check_cmp_uint(stats.bytes, >, 0);
+    assembler_update(as, 130, "\x45\x81\x00\x02",4);
+    check_cmp_uint(d.n, ==, 2);
+    check_cmp_uint(d.nfragments, ==, 3);
+    check_cmp_uint(d.nblocks, ==, 2);
+    check_cmp_uint(d.seq, ==, 3);
+    check_cmp_uint(d.iin.obj_unknown, ==, 1);
+    check_cmp_uint(d.chained, ==, true);
+    dnp3_assembler_stats(as, &stats);
+    check_cmp_uint(stats.responses, ==, 2);
+    check_cmp_uint(stats.assembled, ==, 1);
+    check_cmp_uint(stats.duplicates, ==, 1);
+    check_cmp_uint(stats.bytes, ==, 0);
+
+    // broken sequences; requests are ignored
+    assembler_update(as, 200, "\x87\x81\x00\x00",4);
+    assembler_update(as, 210, "\x09\x81\x00\x00",4);     // seq 8 missing
+    assembler_update(as, 220, "\x4A\x81\x00\x00",4);
+    assembler_update(as, 230, "\xC0\x01\x01\x00\x06",5);
+    check_cmp_uint(d.n, ==, 2);
+    dnp3_assembler_stats(as, &stats);
+    check_cmp_uint(stats.discontinuities, ==, 2);
+
+    // a new first fragment supersedes the partial response
+    assembler_update(as, 300, "\x81\x81\x00\x00",4);
+    assembler_update(as, 310, "\xC2\x81\x00\x00",4);
+    check_cmp_uint(d.n, ==, 3);
+    check_cmp_uint(d.seq, ==, 2);
+    dnp3_assembler_stats(as, &stats);
+    check_cmp_uint(stats.aborted, ==, 1);
+
+    // limits and timeouts
+    check_cmp_int(dnp3_assembler_set_limits(as, 2, 1 << 20), ==, 0);
+    assembler_update(as, 400, "\x81\x81\x00\x00",4);
+    assembler_update(as, 410, "\x02\x81\x00\x00",4);
+    assembler_update(as, 420, "\x43\x81\x00\x00",4);
+    check_cmp_uint(d.n, ==, 3);
+    assembler_update(as, 500, "\x84\x81\x00\x00",4);
+    check_cmp_uint(dnp3_assembler_expire(as, 600, 1000), ==, 0);
+    check_cmp_uint(dnp3_assembler_expire(as, 1500, 1000), ==, 1);
+    dnp3_assembler_stats(as, &stats);
+    check_cmp_uint(stats.overflows, ==, 1);
+    check_cmp_uint(stats.timeouts, ==, 1);
+    check_cmp_uint(stats.bytes, ==, 0);
+
+    // lowering the memory limit drops the least recently active first
+    assembler_update(as, 1500, "\x81\x81\x00\x00",4);
+    assembler_update_assoc(as, dnp3_association(2, 1024), 1510,
+                           "\x81\x81\x00\x00",4);
+    dnp3_assembler_stats(as, &stats);
+    check_cmp_int(dnp3_assembler_set_limits(as, 2, stats.bytes - 1), ==, 0);
+    check_cmp_int(dnp3_assembler_set_limits(as, 2, 1 << 20), ==, 0);
+    assembler_update(as, 1520, "\x42\x81\x00\x00",4);
+    check_cmp_uint(d.n, ==, 3);
+    assembler_update_assoc(as, dnp3_association(2, 1024), 1530,
+                           "\x42\x81\x00\x00",4);
+    check_cmp_uint(d.n, ==, 4);
+    check_cmp_uint(d.nfragments, ==, 2);
+    dnp3_assembler_stats(as, &stats);
+    check_cmp_uint(stats.overflows, ==, 2);
+
+    assembler_update(as, 1600, "\x85\x81\x00\x00",4);   // freed with as
+    dnp3_assembler_free(as);
+}
+
+struct AuthEvents {
+    size_t n;
+    DNP3_AuthEvent last;
+};
+
+static void auth_notify(void *env, const DNP3_AuthEvent *ev)
+{
+    struct AuthEvents *d = env;
+
+    d->n++;
+    d->last = *ev;
+}
+
+// the test's key wrap: control key followed by monitor key, 16 bytes each
+static bool auth_unwrap(void *env, uint32_t assoc, uint16_t usr,
+                        const uint8_t *data, size_t len,
+                        DNP3_AuthKey *control, DNP3_AuthKey *monitor)
+{
+    if(len != 32)
+        return false;
+    dnp3_auth_key(control, data, 16);
+    dnp3_auth_key(monitor, data + 16, 16);
+    return true;
+}
+
+static void do_auth_update(DNP3_AuthEngine *eng, bool dir, uint64_t now,
+                           const uint8_t *input, size_t len, int LINE)
+{
+    HParseResult *res = h_parse(dnp3_p_app_fragment, input, len);
+    if(!res || H_ISERR(res->ast->token_type)) {
+        g_test_message("Parse failed on line %d", LINE);
+        g_test_fail();
+        return;
+    }
+
+    uint32_t assoc = dnp3_association(1, 1024);
+    dnp3_auth_update(eng, assoc, dir, now, input, len, res->ast->user);
+    h_parse_result_free(res);
+}
+
+// from master (M) or outstation (O)
+#define auth_M(eng, now, input, len) \
+    do_auth_update(eng, 1, now, (const uint8_t *)(input), len, __LINE__)
+#define auth_O(eng, now, input, len) \
+    do_auth_update(eng, 0, now, (const uint8_t *)(input), len, __LINE__)
+
+static void test_auth_session(void)
+{
+    struct AuthEvents d = {0};
+    DNP3_AuthEngine *eng = dnp3_auth_engine(2, auth_notify, auth_unwrap, &d);
+    uint32_t assoc = dnp3_association(1, 1024);
+    DNP3_AuthKey control, monitor;
+    DNP3_AuthStats stats;
+    uint8_t mac[32];
+
+    dnp3_auth_key(&control, (const uint8_t *)"control key", 11);
+    dnp3_auth_key(&monitor, (const uint8_t *)"monitor key", 11);
+    check_cmp_int(dnp3_auth_set_keys(eng, assoc, 1, &control, &monitor), ==, 0);
+    check_cmp_int(dnp3_auth_set_keys(eng, assoc, 2, NULL, NULL), ==, 0);
+    check_cmp_int(dnp3_auth_set_keys(eng, assoc, 3, NULL, NULL), <, 0);  // full
+
+    // a critical request, its challenge and the reply; the MAC covers the
+    // challenge message followed by the request
+    const uint8_t write[] = "\xC0\x02\x50\x01\x00\x07\x07\x00";
+    const uint8_t chal[] = "\xC0\x83\x00\x00\x78\x01\x5B\x01\x0C\x00\x05\x00\x00\x00\x01\x00"
+                           "\x04\x01\xDE\xAD\xBE\xEF";
+    uint8_t reply[] = "\xC1\x20\x78\x02\x5B\x01\x16\x00\x05\x00\x00\x00\x01\x00"
+                      "0123456789abcdef";
+    dnp3_auth_mac(&control, chal, 22, write, 8, mac);
+    memcpy(reply + 14, mac, 16);
+    auth_M(eng, 90, write, 8);
+    auth_O(eng, 100, chal, 22);
+    auth_M(eng, 110, reply, 30);
+    check_cmp_uint(d.n, ==, 1);
+    check_cmp_uint(d.last.assoc, ==, assoc);
+    check_cmp_uint(d.last.usr, ==, 1);
+    check_cmp_uint(d.last.dir, ==, true);
+    check_cmp_uint(d.last.variation, ==, DNP3_VARIATION_AUTH_REPLY);
+    check_cmp_uint(d.last.seq, ==, 5);
+    check_cmp_uint(d.last.result, ==, DNP3_AUTH_OK);
+    auth_M(eng, 120, reply, 30);                        // replayed
+    check_cmp_uint(d.last.result, ==, DNP3_AUTH_UNEXPECTED);
+
+    // aggressive mode refers to the last challenge
+    uint8_t aggr[] = "\xC2\x01"
+                     "\x78\x03\x07\x01\x06\x00\x00\x00\x01\x00"   // g120v3
+                     "\x3C\x02\x06"                               // g60v2
+                     "\x78\x09\x5B\x01\x10\x00"                   // g120v9
+                     "0123456789abcdef";
+    dnp3_auth_mac(&control, chal, 22, aggr, 21, mac);
+    memcpy(aggr + 21, mac, 16);
+    auth_M(eng, 130, aggr, 37);
+    check_cmp_uint(d.n, ==, 3);
+    check_cmp_uint(d.last.variation, ==, DNP3_VARIATION_AUTH_AGGR);
+    check_cmp_uint(d.last.seq, ==, 6);
+    check_cmp_uint(d.last.result, ==, DNP3_AUTH_OK);
+    aggr[13] ^= 1;
+    auth_M(eng, 140, aggr, 37);
+    check_cmp_uint(d.last.result, ==, DNP3_AUTH_FAILED);
+
+    // key status and key change for a user without keys
+    auth_M(eng, 200, "\xC3\x20\x78\x04\x07\x01\x02\x00",8);
+    const uint8_t keystat[] = "\xC3\x83\x00\x00\x78\x05\x5B\x01\x0F\x00\x07\x00\x00\x00\x02\x00"
+                              "\x02\x02\x04\x04\x00\x01\x02\x03\x04";
+    auth_O(eng, 210, keystat, 25);
+    const uint8_t keychg[] = "\xC4\x20\x78\x06\x5B\x01\x26\x00\x07\x00\x00\x00\x02\x00"
+                             "CCCCCCCCCCCCCCCCMMMMMMMMMMMMMMMM";
+    auth_M(eng, 220, keychg, 46);
+    check_cmp_uint(d.n, ==, 5);
+    check_cmp_uint(d.last.usr, ==, 2);
+    check_cmp_uint(d.last.variation, ==, DNP3_VARIATION_AUTH_KEYCHANGE);
+    check_cmp_uint(d.last.result, ==, DNP3_AUTH_OK);
+
+    // the outstation confirms with a MAC over the key change (new keys)
+    uint8_t confirm[] = "\xC4\x83\x00\x00\x78\x05\x5B\x01\x1F\x00\x08\x00\x00\x00\x02\x00"
+                        "\x02\x01\x04\x04\x00\x01\x02\x03\x04"
+                        "0123456789abcdef";
+    DNP3_AuthKey newmon;
+    dnp3_auth_key(&newmon, (const uint8_t *)"MMMMMMMMMMMMMMMM", 16);
+    dnp3_auth_mac(&newmon, keychg, 46, NULL, 0, mac);
+    memcpy(confirm + 25, mac, 16);
+    auth_O(eng, 230, confirm, 41);
+    check_cmp_uint(d.n, ==, 6);
+    check_cmp_uint(d.last.variation, ==, DNP3_VARIATION_AUTH_KEYSTATUS);
+    check_cmp_uint(d.last.seq, ==, 8);
+    check_cmp_uint(d.last.result, ==, DNP3_AUTH_OK);
+
+    // errors, timeouts, unknown users
+    auth_O(eng, 300, "\xC5\x83\x00\x00\x78\x07\x5B\x01\x0F\x00\x05\x00\x00\x00\x02\x00\x00\x00"
+                     "\x01\x00\x00\x00\x00\x00\x00",25);
+    check_cmp_uint(d.n, ==, 7);
+    check_cmp_uint(d.last.result, ==, DNP3_AUTH_REJECTED);
+    check_cmp_uint(d.last.code, ==, 1);
+    auth_M(eng, 1000, "\xC6\x20\x78\x01\x5B\x01\x0C\x00\x09\x00\x00\x00\x02\x00\x04\x01"
+                      "\xDE\xAD\xBE\xEF",20);
+    check_cmp_uint(dnp3_auth_expire(eng, 1500, 1000), ==, 0);
+    check_cmp_uint(dnp3_auth_expire(eng, 2000, 1000), ==, 1);
+    check_cmp_uint(d.n, ==, 8);
+    check_cmp_uint(d.last.dir, ==, true);
+    check_cmp_uint(d.last.seq, ==, 9);
+    check_cmp_uint(d.last.result, ==, DNP3_AUTH_TIMEOUT);
+    auth_M(eng, 2100, "\xC7\x20\x78\x04\x07\x01\x05\x00",8);
+
+    dnp3_auth_stats(eng, &stats);
+    check_cmp_uint(stats.sessions, ==, 2);
+    check_cmp_uint(stats.challenges, ==, 2);
+    check_cmp_uint(stats.verified, ==, 4);
+    check_cmp_uint(stats.failed, ==, 1);
+    check_cmp_uint(stats.unexpected, ==, 1);
+    check_cmp_uint(stats.keychanges, ==, 1);
+    check_cmp_uint(stats.errors, ==, 1);
+    check_cmp_uint(stats.timeouts, ==, 1);
+    check_cmp_uint(stats.unknown, ==, 1);
+    dnp3_auth_engine_free(eng);
+}
+
+static void response_binin(DNP3_ResponseBuilder *b, uint32_t n)
+{
+    for(uint32_t i=0; i<n; i++) {
+        DNP3_Point pt = {{0}};
+        pt.flags.online = 1;
+        pt.flags.restart = (i == n/2);
+        pt.flags.state = (i % 3 == 0);
+        check_cmp_int(dnp3_response_add(b, DNP3_POINT_BININ, i, &pt), ==, 0);
+    }
+}
+
+static void test_response_build(void)
+{
+    DNP3_ResponseBuilder *b = dnp3_response_builder(2048);
+    DNP3_BuildStats stats;
+    DNP3_Point pt = {{0}};
+    uint8_t buf[2048];
+
+    check_cmp_ptr(dnp3_response_builder(DNP3_MIN_FRAGSIZE - 1), ==, NULL);
+
+    // packed ranges around an exception; 16-bit and float values
+    response_binin(b, 20);
+    pt.flags.online = 1;
+    pt.value = 7;
+    check_cmp_int(dnp3_response_add(b, DNP3_POINT_ANAIN, 1000, &pt), ==, 0);
+    pt.value = 12;  // replaces 7
+    check_cmp_int(dnp3_response_add(b, DNP3_POINT_ANAIN, 1000, &pt), ==, 0);
+    pt.value = 1.5;
+    check_cmp_int(dnp3_response_add(b, DNP3_POINT_ANAIN, 2000, &pt), ==, 0);
+    check_cmp_int(dnp3_response_add(b, DNP3_POINT_CTR, 1, &pt), <, 0);
+    pt.value = -1;
+    check_cmp_int(dnp3_response_add(b, DNP3_POINT_CTR, 1, &pt), <, 0);
+
+    check_cmp_uint(dnp3_response_build(b, &stats), ==, 1);
+    check_cmp_uint(stats.nblocks, ==, 5);
+    check_cmp_uint(stats.bytes, ==, 45);
+    check_cmp_uint(stats.naive_bytes, ==, 93);
+    check_cmp_uint(stats.saved, ==, 48);
+
+    size_t len = dnp3_encode_fragment(buf, sizeof buf, dnp3_response_fragment(b, 0));
+    check_cmp_uint(len, ==, 45);
+    check_parse(dnp3_p_app_response, buf, len,
+                "[0] (fir,fin) RESPONSE {g1v1 qc=00 #0..9: 1 0 0 1 0 0 1 0 0 1}"
+                " {g1v2 qc=00 #10..10: (online,restart)0}"
+                " {g1v1 qc=00 #11..19: 0 1 0 0 1 0 0 1 0}"
+                " {g30v4 qc=01 #1000..1000: 12}"
+                " {g30v5 qc=01 #2000..2000: (online)1.5}");
+    check_cmp_ptr(dnp3_response_fragment(b, 1), ==, NULL);
+    dnp3_response_builder_free(b);
+
+    // minimum fragment size; scattered values go into index lists
+    b = dnp3_response_builder(DNP3_MIN_FRAGSIZE);
+    response_binin(b, 100);
+    for(uint32_t i=0; i<40; i++) {
+        pt.value = i * 1000.5;
+        check_cmp_int(dnp3_response_add(b, DNP3_POINT_ANAIN, i*7, &pt), ==, 0);
+    }
+
+    size_t n = dnp3_response_build(b, &stats), bytes = 0, count = 0;
+    check_cmp_uint(n, ==, stats.nfragments);
+    check_cmp_uint(n, >, 1);
+    check_cmp_uint(stats.saved, >, 0);
+    for(size_t i=0; i<n; i++) {
+        const DNP3_Fragment *frag = dnp3_response_fragment(b, i);
+        check_cmp_uint(frag->ac.fir, ==, (i == 0));
+        check_cmp_uint(frag->ac.fin, ==, (i == n-1));
+
+        len = dnp3_encode_fragment(buf, sizeof buf, frag);
+        check_cmp_uint(len, >, 0);
+        check_cmp_uint(len, <=, DNP3_MIN_FRAGSIZE);
+        bytes += len;
+
+        HParseResult *res = h_parse(dnp3_p_app_response, buf, len);
+        check_cmp_ptr(res, !=, NULL);
+        if(!res) continue;
+        check_cmp_uint(res->ast->token_type, ==, (HTokenType)TT_DNP3_Fragment);
+        for(size_t j=0; j<frag->nblocks; j++)
+            count += frag->odata[j]->count;
+        h_parse_result_free(res);
+    }
+    check_cmp_uint(bytes, ==, stats.bytes);
+    check_cmp_uint(count, ==, 140);
+
+    // empty response
+    dnp3_response_reset(b);
+    check_cmp_uint(dnp3_response_build(b, &stats), ==, 1);
+    check_cmp_uint(stats.bytes, ==, 4);
+    check_cmp_uint(stats.nblocks, ==, 0);
+    dnp3_response_builder_free(b);
+}
+
+static void do_check_fragment_copy(unsigned flags,
+                                   const uint8_t *input, size_t len,
+                                   const char *expected, int LINE)
+{
+    HParseResult *res = h_parse(dnp3_p_app_fragment, input, len);
+    if(!res || H_ISERR(res->ast->token_type)) {
+        g_test_message("Parse failed on line %d", LINE);
+        g_test_fail();
+        return;
+    }
+
+    // pack into a single block, then free the parse result
+    const DNP3_Fragment *frag = res->ast->user;
+    size_t size = dnp3_fragment_size(frag, flags);
+    DNP3_Fragment *copy = dnp3_fragment_copy(frag, flags);
+    h_parse_result_free(res);
+
+    char *s = dnp3_format_fragment(copy);
+    check_string(s, ==, expected);
+    free(s);
+
+    // move the block elsewhere
+    void *buf = malloc(size);
+    memcpy(buf, copy, size);
+    memset(copy, 0xAA, size);
+    free(copy);
+    copy = dnp3_fragment_relocate(buf, copy);
+    check_cmp_ptr((void *)copy, ==, buf);
+
+    s = dnp3_format_fragment(copy);
+    check_string(s, ==, expected);
+    free(s);
+    free(buf);
+}
+
+// check both the default and the compact layout
+#define check_fragment_copy(input, len, expected) do {                  \
+    do_check_fragment_copy(0, (const uint8_t *)(input), len, expected,  \
+                           __LINE__);                                   \
+    do_check_fragment_copy(DNP3_PACK_COMPACT, (const uint8_t *)(input), \
+                           len, expected, __LINE__);                    \
+  } while(0)
+
+static void test_fragment_copy(void)
+{
+    check_fragment_copy("\xC0\x01\x01\x00\x06\x02\x00\x06",8,
+                        "[0] (fir,fin) READ {g1v0 qc=06} {g2v0 qc=06}");
+    check_fragment_copy("\xC3\x10\x5A\x01\x5B\x01\x03\x00\x43\x4C\x36",11,
+                        "[3] (fir,fin) INITIALIZE_APPL {g90v1 qc=5B 'CL6'}");
+    check_fragment_copy("\xC0\x81\x00\x00\x01\x01\x00\x03\x08\x19",10,
+                        "[0] (fir,fin) RESPONSE {g1v1 qc=00 #3..8: 1 0 0 1 1 0}");
+    check_fragment_copy("\xC0\x81\x00\x00\x1E\x03\x17\x02\x01\x12\x34\x56\x78"
+                        "\x05\x00\x00\x00\x80",18,
+                        "[0] (fir,fin) RESPONSE {g30v3 qc=17 #1:2018915346 #5:-2147483648}");
+    check_fragment_copy("\xC0\x81\x00\x00\x02\x02\x17\x01\x03\x82\xA0\xFC\x7D\x7A\x4B\x01",16,
+                        "[0] (fir,fin) RESPONSE {g2v2 qc=17 #3:(restart)1@1423689252s}");
+    check_fragment_copy("\xC0\x81\x00\x00\x02\x03\x17\x01\x03\x81\xE0\x56",12,
+                        "[0] (fir,fin) RESPONSE {g2v3 qc=17 #3:(online)1@+22.240s}");
+    check_fragment_copy("\xC0\x81\x00\x00\x03\x01\x00\x00\x03\x36",10,
+                        "[0] (fir,fin) RESPONSE {g3v1 qc=00 #0..3: 1 0 - ~}");
+    check_fragment_copy("\xC0\x81\x00\x00\x0D\x02\x17\x01\x03\x80\x00\x00\x00\x00\x00\x80",16,
+                        "[0] (fir,fin) RESPONSE {g13v2 qc=17 #3:1@140737488355.328s}");
+    check_fragment_copy("\x00\x81\x00\x00\x14\x01\x17\x01\x01\x41\x12\x34\x56\x78",14,
+                        "[0] RESPONSE {g20v1 qc=17 #1:(online,discontinuity)2018915346}");
+    check_fragment_copy("\x00\x81\x00\x00\x1E\x05\x17\x01\x01\x21\x00\x00\x80\xBF",14,
+                        "[0] RESPONSE {g30v5 qc=17 #1:(online,over_range)-1.0}");
+    check_fragment_copy("\x00\x81\x00\x00\x20\x07\x17\x01\x01\x21\x00\x00\x80\xBF\x00\x00\x00\x00\x00\x00",20,
+                        "[0] RESPONSE {g32v7 qc=17 #1:(online,over_range)-1.0@0s}");
+}
+
+static void test_fragment_compact(void)
+{
+    // six packed binaries and two 32-bit analogs
+    const uint8_t input[] = "\xC0\x81\x00\x00\x01\x01\x00\x03\x08\x19"
+                            "\x1E\x03\x00\x00\x01\x12\x34\x56\x78"
+                                                 "\x00\x00\x00\x80";
+    HParseResult *res = h_parse(dnp3_p_app_fragment, input, sizeof(input)-1);
+    check_cmp_ptr(res, !=, NULL);
+    if(!res) return;
+
+    const DNP3_Fragment *frag = res->ast->user;
+    size_t size = dnp3_fragment_size(frag, 0);
+    size_t csize = dnp3_fragment_size(frag, DNP3_PACK_COMPACT);
+    check_cmp_uint(sizeof(DNP3_Object), <=, 24);
+    check_cmp_uint(csize, <, size);
+    check_cmp_uint(size - csize, >=, 8*sizeof(DNP3_Object) - 16);
+
+    DNP3_Fragment *copy = dnp3_fragment_copy(frag, DNP3_PACK_COMPACT);
+    h_parse_result_free(res);
+
+    DNP3_ObjectBlock *ob = copy->odata[1];
+    DNP3_Object o[3];
+    check_cmp_ptr(copy->odata[0]->objects, ==, NULL);
+    check_cmp_ptr(ob->objects, ==, NULL);
+    check_cmp_ptr(ob->records, !=, NULL);
+    check_cmp_uint(dnp3_oblock_has_objects(ob), ==, true);
+    check_cmp_uint(dnp3_oblock_getn(ob, 0, 3, o), ==, 2);
+    check_cmp_uint(o[0].ana.sint, ==, 2018915346);
+    check_cmp_uint((uint32_t)o[1].ana.sint, ==, 0x80000000);
+    check_cmp_uint(dnp3_oblock_get(ob, 2, o), ==, false);
+    check_cmp_uint(dnp3_oblock_get(copy->odata[0], 3, o), ==, true);
+    check_cmp_uint(o[0].bit, ==, 1);
+
+    free(copy);
+}
+
 #define check_sloballoc_invariants() do {                                   \
     int err = slobcheck(slob);                                              \
     if(err) {                                                               \
@@ -1376,6 +2657,11 @@ int main(int argc, char *argv[])
 
     // unit tests
     g_test_add_func("/app/fragment", test_app_fragment);
+    g_test_add_func("/app/ohdrs", test_app_ohdrs);
+    g_test_add_func("/app/select", test_app_select);
+    g_test_add_func("/app/lazy", test_app_lazy);
+    g_test_add_func("/app/encode", test_app_encode);
+    g_test_add_func("/app/auth", test_app_auth);
     g_test_add_func("/app/req/fail", test_req_fail);
     g_test_add_func("/app/req/ac", test_req_ac);
     g_test_add_func("/app/req/ohdr", test_req_ohdr);
@@ -1403,6 +2689,7 @@ int main(int argc, char *argv[])
     g_test_add_func("/app/rsp/iin", test_rsp_iin);
     g_test_add_func("/app/rsp/null", test_rsp_null);
     g_test_add_func("/app/rsp/unsolicited", test_rsp_unsolicited);
+    g_test_add_func("/app/rsp/admission", test_rsp_admission);
     g_test_add_func("/app/obj/binin", test_obj_binin);
     g_test_add_func("/app/obj/bininev", test_obj_bininev);
     g_test_add_func("/app/obj/dblbitin", test_obj_dblbitin);
@@ -1429,10 +2716,20 @@ int main(int argc, char *argv[])
     g_test_add_func("/app/obj/delay", test_obj_delay);
     g_test_add_func("/app/obj/class", test_obj_class);
     g_test_add_func("/app/obj/iin", test_obj_iin);
+    g_test_add_func("/app/obj/auth", test_obj_auth);
     g_test_add_func("/transport", test_transport);
+    g_test_add_func("/transport/encode", test_transport_encode);
     g_test_add_func("/link/raw", test_link_raw);
     g_test_add_func("/link/valid", test_link_valid);
     g_test_add_func("/link/skip", test_link_skip);
+    g_test_add_func("/link/encode", test_link_encode);
+    g_test_add_func("/pointdb", test_pointdb);
+    g_test_add_func("/tracker", test_tracker);
+    g_test_add_func("/assembler", test_assembler);
+    g_test_add_func("/auth/session", test_auth_session);
+    g_test_add_func("/response/build", test_response_build);
+    g_test_add_func("/fragment/copy", test_fragment_copy);
+    g_test_add_func("/fragment/compact", test_fragment_compact);
     g_test_add_func("/sloballoc/size", test_sloballoc_size);
     g_test_add_func("/sloballoc/merge", test_sloballoc_merge);
     g_test_add_func("/sloballoc/small", test_sloballoc_small);